@@ -0,0 +1,170 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURCOSTOVERLAY_H
+#define DETOURCOSTOVERLAY_H
+
+#include "DetourNavMesh.h"
+#include "DetourStatus.h"
+
+/// A reference to a shape of a cost overlay.
+typedef unsigned int dtCostShapeRef;
+
+/// The maximum number of vertices of a convex cost shape.
+/// @ingroup detour
+static const int DT_COST_SHAPE_MAX_VERTS = 32;
+
+/// Cost multipliers per polygon, painted with circles and convex shapes at runtime.
+///
+/// The multipliers are stored densely per tile and applied by filters that read the overlay in
+/// their getCost(), so areas can be made more expensive without changing area ids and rebuilding
+/// tiles. Shapes are kept until they are removed, and the multipliers of a tile are repainted from
+/// them when the tile is rebuilt or a shape touching it changes.
+/// @ingroup detour
+class dtCostOverlay
+{
+public:
+	dtCostOverlay();
+	~dtCostOverlay();
+
+	/// Initializes the overlay.
+	///  @param[in]	nav			The navigation mesh the overlay covers.
+	///  @param[in]	maxShapes	The maximum number of shapes. [Limit: < 65536]
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav, const int maxShapes);
+
+	/// Adds a cylinder shape.
+	///  @param[in]	pos			The center of the bottom of the cylinder. [(x, y, z)]
+	///  @param[in]	radius		The radius of the cylinder.
+	///  @param[in]	height		The height of the cylinder.
+	///  @param[in]	cost		The multiplier of the polygons the shape overlaps. [Limit: >= 1]
+	///  @param[out]	result		The reference of the shape. [opt]
+	/// @returns The status flags for the operation.
+	dtStatus addCircle(const float* pos, const float radius, const float height, const float cost,
+					   dtCostShapeRef* result);
+
+	/// Adds a convex shape.
+	///  @param[in]	verts		The vertices of the convex polygon. [(x, y, z) * @p nverts]
+	///  @param[in]	nverts		The number of vertices. [Limit: 3 <= value <= #DT_COST_SHAPE_MAX_VERTS]
+	///  @param[in]	hmin		The minimum height of the shape.
+	///  @param[in]	hmax		The maximum height of the shape.
+	///  @param[in]	cost		The multiplier of the polygons the shape overlaps. [Limit: >= 1]
+	///  @param[out]	result		The reference of the shape. [opt]
+	/// @returns The status flags for the operation.
+	dtStatus addConvex(const float* verts, const int nverts, const float hmin, const float hmax, const float cost,
+					   dtCostShapeRef* result);
+
+	/// Removes a shape.
+	///  @param[in]	ref		The reference of the shape.
+	/// @returns The status flags for the operation.
+	dtStatus removeShape(const dtCostShapeRef ref);
+
+	/// Changes the multiplier of a shape.
+	///  @param[in]	ref		The reference of the shape.
+	///  @param[in]	cost	The new multiplier. [Limit: >= 1]
+	/// @returns The status flags for the operation.
+	dtStatus setShapeCost(const dtCostShapeRef ref, const float cost);
+
+	/// Removes all shapes.
+	void clear();
+
+	/// Repaints the tiles that were rebuilt or touched by changed shapes. Shape changes take
+	/// effect in this call.
+	///  @param[out]	changed		True if any tile was repainted. [opt]
+	/// @returns The status flags for the operation.
+	dtStatus update(bool* changed = 0);
+
+	/// The maximum number of shapes the overlay was initialized with, zero before initialization.
+	int getMaxShapes() const { return m_maxShapes; }
+
+	/// The number of shapes in the overlay.
+	int getShapeCount() const { return m_nshapes; }
+
+	/// Returns the cost multiplier of a polygon.
+	///  @param[in]	tile	The tile containing the polygon.
+	///  @param[in]	poly	The polygon.
+	/// @returns The multiplier, or 1 if the tile has not been painted since it was rebuilt.
+	inline float getCost(const dtMeshTile* tile, const dtPoly* poly) const
+	{
+		const dtCostOverlayTile& ot = m_tiles[tile - m_firstTile];
+		if (ot.salt != tile->salt)
+			return 1.0f;
+		return ot.cost[poly - tile->polys];
+	}
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtCostOverlay(const dtCostOverlay&);
+	dtCostOverlay& operator=(const dtCostOverlay&);
+
+	enum dtCostShapeType
+	{
+		DT_COST_SHAPE_EMPTY,
+		DT_COST_SHAPE_CIRCLE,
+		DT_COST_SHAPE_CONVEX
+	};
+
+	struct dtCostShape
+	{
+		float verts[DT_COST_SHAPE_MAX_VERTS*3];	///< The convex polygon, or the center of the circle.
+		int nverts;
+		float radius;
+		float hmin, hmax;
+		float bmin[3], bmax[3];
+		float cost;
+		unsigned short salt;
+		unsigned char type;
+		dtCostShape* next;		///< The next free shape.
+	};
+
+	struct dtCostOverlayTile
+	{
+		unsigned int salt;		///< The salt of the tile the multipliers were painted for, zero if out of date.
+		int maxPolys;			///< The number of polygons the multipliers have room for.
+		float* cost;			///< The multiplier per polygon.
+		bool dirty;				///< True if a shape touching the tile changed.
+	};
+
+	dtCostShape* allocShape(dtCostShapeRef* result);
+	const dtCostShape* getShapeByRef(const dtCostShapeRef ref) const;
+	void markTiles(const float* bmin, const float* bmax);
+	dtStatus paintTile(const int idx);
+
+	const dtNavMesh* m_nav;
+	const dtMeshTile* m_firstTile;
+
+	int m_ntiles;
+	dtCostOverlayTile* m_tiles;
+
+	dtCostShape* m_shapes;
+	dtCostShape* m_nextFreeShape;
+	int m_maxShapes;
+	int m_nshapes;
+};
+
+/// Allocates a cost overlay object using the Detour allocator.
+/// @return A cost overlay that is ready for initialization, or null on failure.
+///  @ingroup detour
+dtCostOverlay* dtAllocCostOverlay();
+
+/// Frees the specified cost overlay object using the Detour allocator.
+///  @param[in]	overlay		A cost overlay allocated using #dtAllocCostOverlay
+///  @ingroup detour
+void dtFreeCostOverlay(dtCostOverlay* overlay);
+
+#endif // DETOURCOSTOVERLAY_H
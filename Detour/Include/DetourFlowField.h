@@ -0,0 +1,135 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURFLOWFIELD_H
+#define DETOURFLOWFIELD_H
+
+#include <float.h>
+#include "DetourNavMesh.h"
+#include "DetourStatus.h"
+#include "DetourPortalSearch.h"
+
+class dtQueryFilter;
+
+/// The path cost and direction from every polygon of a navigation mesh to a single goal.
+///
+/// The field is built by one Dijkstra search outwards from the goal, so any number of agents
+/// heading to the same goal can look up their next polygon instead of each running a path query.
+/// The costs are the costs dtNavMeshQuery::findPath minimizes, measured from the portal a polygon
+/// is left through, and the next polygons form the corridor of the cheapest path to the goal.
+///
+/// The tables are kept per tile. Lookups into a tile that has been removed or rebuilt since the
+/// field was built fail, so agents never follow stale directions. As a rebuilt tile can also
+/// change the best route through other tiles, use isUpToDate() to decide when to rebuild.
+///
+/// One-way off-mesh connections are not used by the field.
+/// @ingroup detour
+class dtFlowField
+{
+public:
+	dtFlowField();
+	~dtFlowField();
+
+	/// Initializes the flow field.
+	///  @param[in]	nav		The navigation mesh the field is built on.
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav);
+
+	/// Computes the field for a goal.
+	///  @param[in]	goalRef		The reference of the goal polygon.
+	///  @param[in]	goalPos		The goal position. [(x, y, z)]
+	///  @param[in]	filter		The polygon filter to apply.
+	///  @param[in]	maxCost		Polygons further from the goal than this are left unreachable,
+	///							which limits the search to the region around the goal.
+	/// @returns The status flags for the operation.
+	dtStatus build(dtPolyRef goalRef, const float* goalPos, const dtQueryFilter* filter,
+				   const float maxCost = FLT_MAX);
+
+	/// Checks that no tile has been added, removed or rebuilt since the field was built.
+	/// @returns True if the field is built and matches the navigation mesh.
+	bool isUpToDate() const;
+
+	/// The path cost from a polygon to the goal.
+	///  @param[in]	ref		The reference of the polygon.
+	///  @param[out]	cost	The cost, or FLT_MAX if the goal cannot be reached from the polygon.
+	/// @returns The status flags for the operation. Fails if the tile of the polygon has changed.
+	dtStatus getCost(dtPolyRef ref, float* cost) const;
+
+	/// The polygon to move to from a polygon to get closer to the goal.
+	///  @param[in]	ref		The reference of the polygon.
+	///  @param[out]	next	The next polygon, or zero if @p ref is the goal polygon.
+	/// @returns The status flags for the operation. Fails if the tile of the polygon has changed
+	/// or the goal cannot be reached from the polygon.
+	dtStatus getNext(dtPolyRef ref, dtPolyRef* next) const;
+
+	/// Follows the field from a polygon to the goal polygon.
+	///  @param[in]	startRef	The reference of the start polygon.
+	///  @param[out]	path		The polygon corridor from the start to the goal polygon. [(polyRef) * @p pathCount]
+	///  @param[out]	pathCount	The number of polygons returned.
+	///  @param[in]	maxPath		The maximum number of polygons the @p path array can hold. [Limit: >= 1]
+	/// @returns The status flags for the operation. If the corridor did not fit, the first
+	/// @p maxPath polygons are returned with #DT_PARTIAL_RESULT and #DT_BUFFER_TOO_SMALL.
+	dtStatus getPath(dtPolyRef startRef, dtPolyRef* path, int* pathCount, const int maxPath) const;
+
+	/// The reference of the goal polygon.
+	dtPolyRef getGoalRef() const { return m_goalRef; }
+
+	/// The goal position. [(x, y, z)]
+	const float* getGoalPos() const { return m_goalPos; }
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtFlowField(const dtFlowField&);
+	dtFlowField& operator=(const dtFlowField&);
+
+	struct dtFlowTile
+	{
+		unsigned int salt;		///< The salt of the tile the tables were computed for.
+		int polyCount;			///< The number of polygons in the tables.
+		float* cost;			///< Cost to the goal per polygon. [Size: polyCount]
+		dtPolyRef* next;		///< Next polygon towards the goal per polygon. [Size: polyCount]
+	};
+
+	class dtFlowVisitor;
+	friend class dtFlowVisitor;
+
+	const dtFlowTile* getTable(dtPolyRef ref, unsigned int* ip) const;
+
+	const dtNavMesh* m_nav;
+
+	int m_ntiles;
+	dtFlowTile* m_tiles;
+	bool m_built;
+
+	dtPolyRef m_goalRef;
+	float m_goalPos[3];
+
+	dtPortalSearch m_search;
+};
+
+/// Allocates a flow field object using the Detour allocator.
+/// @return A flow field that is ready for initialization, or null on failure.
+///  @ingroup detour
+dtFlowField* dtAllocFlowField();
+
+/// Frees the specified flow field object using the Detour allocator.
+///  @param[in]	field		A flow field allocated using #dtAllocFlowField
+///  @ingroup detour
+void dtFreeFlowField(dtFlowField* field);
+
+#endif // DETOURFLOWFIELD_H
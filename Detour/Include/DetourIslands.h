@@ -0,0 +1,136 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURISLANDS_H
+#define DETOURISLANDS_H
+
+#include "DetourNavMesh.h"
+#include "DetourStatus.h"
+
+class dtQueryFilter;
+
+/// Connected component labels of the polygons of a navigation mesh for a filter.
+///
+/// Two polygons on different islands cannot reach each other, so a path query between them can
+/// be rejected without searching. Without the labels dtNavMeshQuery::findPath only finds out by
+/// exhausting its node pool, which makes unreachable goals the most expensive queries.
+///
+/// The labels are built from components local to each tile, which are joined across the tile
+/// borders. When tiles are added, removed or rebuilt, update() recomputes the local components of
+/// those tiles and their neighbours only, and joins the components again.
+/// @ingroup detour
+class dtNavMeshIslands
+{
+public:
+	dtNavMeshIslands();
+	~dtNavMeshIslands();
+
+	/// Initializes the island labels.
+	///  @param[in]	nav		The navigation mesh to label.
+	///  @param[in]	filter	The filter deciding which polygons can be passed. Must stay alive
+	///						as long as the labels are used.
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav, const dtQueryFilter* filter);
+
+	/// Brings the labels up to date with the tiles of the navigation mesh. Must be called after
+	/// tiles change and before the labels are used again.
+	///  @param[out]	changed		True if the labels were recomputed. [opt]
+	/// @returns The status flags for the operation.
+	dtStatus update(bool* changed = 0);
+
+	/// Marks the labels of all tiles out of date. Must be called when polygon flags change
+	/// throughout the mesh, changes to the tiles themselves are detected by update().
+	void invalidate();
+
+	/// Marks the labels of a tile out of date. Must be called when polygon flags of the tile
+	/// change without the tile being rebuilt.
+	///  @param[in]	ref		The reference of the tile.
+	void invalidateTile(dtTileRef ref);
+
+	/// True if the labels match the navigation mesh as of the last update().
+	bool isUpToDate() const { return !m_dirty; }
+
+	/// The number of islands found by the last update().
+	int getIslandCount() const { return m_nislands; }
+
+	/// The island of a polygon.
+	///  @param[in]	ref		The reference of the polygon.
+	/// @returns The island, or zero if the polygon does not pass the filter or is not labelled.
+	unsigned int getIsland(dtPolyRef ref) const;
+
+	/// Checks if a path between two polygons can exist.
+	///  @param[in]	startRef	The reference of the start polygon.
+	///  @param[in]	endRef		The reference of the end polygon.
+	/// @returns False only if both polygons are labelled and lie on different islands.
+	bool isReachable(dtPolyRef startRef, dtPolyRef endRef) const;
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtNavMeshIslands(const dtNavMeshIslands&);
+	dtNavMeshIslands& operator=(const dtNavMeshIslands&);
+
+	struct dtIslandBorder
+	{
+		unsigned int comp;		///< The local component on this side of the link.
+		dtPolyRef ref;			///< The polygon in the other tile.
+	};
+
+	struct dtIslandTile
+	{
+		unsigned int salt;		///< The salt of the tile the components were computed for.
+		int polyCount;			///< The number of polygons in the tables.
+		int x, y;				///< The location of the tile.
+		unsigned int* comp;		///< Local component per polygon, zero if the polygon is blocked. [Size: polyCount]
+		int ncomp;				///< The number of local components.
+		int firstComp;			///< Index of the first local component in the global tables.
+		dtIslandBorder* borders;	///< Links leaving the tile or joining two of its local components, one per link.
+		int nborders;			///< The number of border links.
+		bool dirty;				///< True if the local components must be recomputed.
+	};
+
+	bool refreshTiles();
+	dtStatus computeTile(const int idx);
+	dtStatus joinTiles();
+	int findRoot(int i);
+
+	const dtNavMesh* m_nav;
+	const dtQueryFilter* m_filter;
+
+	int m_ntiles;
+	dtIslandTile* m_tiles;
+	bool m_dirty;
+
+	int* m_parent;				///< Union-find parent per local component, later the island.
+	int m_maxComps;
+	int m_nislands;
+
+	unsigned int* m_stack;		///< Flood fill stack.
+	int m_maxStack;
+};
+
+/// Allocates an island label object using the Detour allocator.
+/// @return An island label object that is ready for initialization, or null on failure.
+///  @ingroup detour
+dtNavMeshIslands* dtAllocNavMeshIslands();
+
+/// Frees the specified island label object using the Detour allocator.
+///  @param[in]	islands		An island label object allocated using #dtAllocNavMeshIslands
+///  @ingroup detour
+void dtFreeNavMeshIslands(dtNavMeshIslands* islands);
+
+#endif // DETOURISLANDS_H
@@ -0,0 +1,194 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURLANDMARKS_H
+#define DETOURLANDMARKS_H
+
+#include "DetourNavMesh.h"
+#include "DetourStatus.h"
+#include "DetourPortalSearch.h"
+
+class dtQueryFilter;
+
+/// The maximum number of landmarks a landmark set can hold.
+/// @ingroup detour
+static const int DT_MAX_LANDMARKS = 16;
+
+static const int DT_LANDMARKS_MAGIC = 'D'<<24 | 'L'<<16 | 'M'<<8 | 'K'; ///< 'DLMK'
+static const int DT_LANDMARKS_VERSION = 3;
+
+/// The costs of a goal polygon used by dtNavMeshLandmarks::getLowerBound().
+/// @ingroup detour
+struct dtLandmarkGoal
+{
+	float bounds[DT_MAX_LANDMARKS*4];	///< (to min, to max, from min, from max) cost per landmark.
+	float changeCost[DT_MAX_LANDMARKS];	///< The least cost between the goal and the tiles changed since each landmark was computed.
+	float minCost;						///< The least cost per unit of distance.
+};
+
+/// Landmark distance tables used to tighten the heuristic of dtNavMeshQuery::findPath.
+///
+/// For each landmark the cost from the landmark to every polygon of the navigation mesh and
+/// back is precomputed using the same graph and costs the path query searches. By the triangle
+/// inequality the difference of two such costs is a lower bound of the cost between two
+/// polygons, which is usually much closer to the real cost than the straight line distance
+/// on large maps with walls, dead ends and expensive areas.
+///
+/// The tables are only valid for the filter they were built with. They are kept per tile,
+/// so tiles that are rebuilt are detected by their salt and the landmarks are recomputed
+/// over time by update(). Until then the tables of the unchanged tiles stay in use, while the
+/// polygons of changed tiles get no bound. A change can open a shorter route, so the bound of
+/// an out of date landmark is limited to the straight line cost of a path through the changed
+/// tiles, which keeps it a lower bound away from the changes.
+/// @ingroup detour
+class dtNavMeshLandmarks
+{
+public:
+	dtNavMeshLandmarks();
+	~dtNavMeshLandmarks();
+
+	/// Initializes the landmark set.
+	///  @param[in]	nav				The navigation mesh the landmarks are placed on.
+	///  @param[in]	filter			The filter the distances are computed with. Must stay alive
+	///								as long as the landmark set is used.
+	///  @param[in]	maxLandmarks	The maximum number of landmarks. [Limit: 1 <= value <= #DT_MAX_LANDMARKS]
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav, const dtQueryFilter* filter, const int maxLandmarks);
+
+	/// Selects new landmarks spread over the navigation mesh and computes their distance tables.
+	///  @param[in]	landmarkCount	The number of landmarks to place. [Limit: <= maxLandmarks]
+	/// @returns The status flags for the operation.
+	dtStatus build(const int landmarkCount);
+
+	/// Checks the navigation mesh for changed tiles and recomputes out of date landmarks, taking
+	/// turns so that every landmark is recomputed even while the mesh keeps changing. Landmarks
+	/// stay in use until they are recomputed, but not for paths that can pass the changed tiles.
+	///  @param[in]	maxLandmarks	The maximum number of landmarks to recompute during this call.
+	///  @param[out]	upToDate		True if all landmarks are up to date after the call. [opt]
+	/// @returns The status flags for the operation.
+	dtStatus update(const int maxLandmarks, bool* upToDate = 0);
+
+	/// Marks all landmarks out of date and stops using them until update() recomputes them.
+	/// Must be called when the area costs of the filter change.
+	void invalidate();
+
+	/// Marks the landmarks out of date for a change of polygon flags in a tile that was not
+	/// rebuilt. Must be called when polygon flags change, changes to the tiles themselves are
+	/// detected by update().
+	///  @param[in]	ref		The reference of the tile.
+	void invalidateTile(dtTileRef ref);
+
+	/// The maximum number of landmarks the set was initialized with.
+	int getMaxLandmarks() const { return m_maxLandmarks; }
+
+	/// The number of landmarks placed.
+	int getLandmarkCount() const { return m_nlandmarks; }
+
+	/// The number of landmarks that are currently used by queries.
+	int getActiveLandmarkCount() const { return m_nactive; }
+
+	/// Collects the goal costs used by getLowerBound().
+	///  @param[in]	ref		The reference of the goal polygon.
+	///  @param[in]	pos		The goal position. [(x, y, z)]
+	///  @param[out]	goal	The goal costs.
+	/// @returns True if at least one landmark can be used for the goal.
+	bool getGoalBounds(dtPolyRef ref, const float* pos, dtLandmarkGoal* goal) const;
+
+	/// A lower bound of the path cost from a position on the border of a polygon to the goal.
+	///  @param[in]	ref		The reference of the polygon.
+	///  @param[in]	pos		The position, a portal the polygon was entered through. [(x, y, z)]
+	///  @param[in]	goal	The goal costs returned by getGoalBounds().
+	/// @returns The lower bound, or zero if nothing is known about the polygon.
+	float getLowerBound(dtPolyRef ref, const float* pos, const dtLandmarkGoal* goal) const;
+
+	/// The size of the data written by storeData().
+	int getDataSize() const;
+
+	/// Writes the landmarks and their distance tables to a buffer.
+	///  @param[out]	data		The buffer. [Size: >= getDataSize()]
+	///  @param[in]	maxDataSize	The size of the buffer.
+	/// @returns The status flags for the operation.
+	dtStatus storeData(unsigned char* data, const int maxDataSize) const;
+
+	/// Restores landmarks written by storeData(). The tables are only used if every tile of the
+	/// current navigation mesh has the same polygons, vertices and polygon flags as when they were
+	/// stored, otherwise all landmarks are recomputed by update().
+	///  @param[in]	data		The data.
+	///  @param[in]	dataSize	The size of the data.
+	/// @returns The status flags for the operation.
+	dtStatus restoreData(const unsigned char* data, const int dataSize);
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtNavMeshLandmarks(const dtNavMeshLandmarks&);
+	dtNavMeshLandmarks& operator=(const dtNavMeshLandmarks&);
+
+	struct dtLandmark
+	{
+		float pos[3];			///< The position the landmark is anchored to.
+		dtPolyRef ref;			///< The polygon containing the position, or zero if there is none.
+		bool valid;				///< True if the distance table of the landmark is used by queries.
+		bool stale;				///< True if the mesh changed since the distance table was computed.
+		float changeMin[3];		///< The bounds of the tiles changed since then, if stale.
+		float changeMax[3];
+	};
+
+	struct dtLandmarkTile
+	{
+		unsigned int salt;		///< The salt of the tile the tables were computed for.
+		int polyCount;			///< The number of polygons in the tables.
+		float bmin[3], bmax[3];	///< The bounds of the tile.
+		float* bounds;			///< (to min, to max, from min, from max) cost per polygon and landmark. [Size: polyCount * maxLandmarks * 4]
+	};
+
+	class dtLandmarkVisitor;
+	friend class dtLandmarkVisitor;
+
+	void refreshTiles();
+	void markChanged(const float* bmin, const float* bmax);
+	void updateActive();
+	dtPolyRef findPolyAt(const float* pos) const;
+	dtStatus computeLandmark(const int idx);
+
+	const dtNavMesh* m_nav;
+	const dtQueryFilter* m_filter;
+
+	int m_maxLandmarks;
+	int m_nlandmarks;
+	dtLandmark m_landmarks[DT_MAX_LANDMARKS];
+	int m_nactive;
+	int m_active[DT_MAX_LANDMARKS];
+	int m_nextUpdate;
+
+	int m_ntiles;
+	dtLandmarkTile* m_tiles;
+
+	dtPortalSearch m_search;
+};
+
+/// Allocates a landmark set object using the Detour allocator.
+/// @return A landmark set that is ready for initialization, or null on failure.
+///  @ingroup detour
+dtNavMeshLandmarks* dtAllocNavMeshLandmarks();
+
+/// Frees the specified landmark set object using the Detour allocator.
+///  @param[in]	landmarks		A landmark set allocated using #dtAllocNavMeshLandmarks
+///  @ingroup detour
+void dtFreeNavMeshLandmarks(dtNavMeshLandmarks* landmarks);
+
+#endif // DETOURLANDMARKS_H
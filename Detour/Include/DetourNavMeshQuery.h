@@ -21,6 +21,7 @@
 
 #include "DetourNavMesh.h"
 #include "DetourStatus.h"
+#include "DetourLandmarks.h"
 
 
 // Define DT_VIRTUAL_QUERYFILTER if you wish to derive a custom filter from dtQueryFilter.
@@ -148,6 +149,8 @@ struct dtRaycastHit
 	float pathCost;
 };
 
+class dtPolyMaskFilter;
+
 /// Provides custom polygon query behavior.
 /// Used by dtNavMeshQuery::queryPolygons.
 /// @ingroup detour
@@ -189,10 +192,21 @@ public:
 	///  							[(polyRef) * @p pathCount]
 	///  @param[out]	pathCount	The number of polygons returned in the @p path array.
 	///  @param[in]		maxPath		The maximum number of polygons the @p path array can hold. [Limit: >= 1]
+	///  @param[in]		landmarks	Landmark distances built with the same filter, used to guide the search. [opt]
 	dtStatus findPath(dtPolyRef startRef, dtPolyRef endRef,
 					  const float* startPos, const float* endPos,
 					  const dtQueryFilter* filter,
-					  dtPolyRef* path, int* pathCount, const int maxPath) const;
+					  dtPolyRef* path, int* pathCount, const int maxPath,
+					  const dtNavMeshLandmarks* landmarks = 0) const;
+
+	/// Finds a path from the start polygon to the end polygon, testing the precomputed
+	/// polygon mask of the filter and computing the costs without virtual calls.
+	/// The parameters are the same as for findPath(..., const dtQueryFilter*, ...).
+	dtStatus findPath(dtPolyRef startRef, dtPolyRef endRef,
+					  const float* startPos, const float* endPos,
+					  const dtPolyMaskFilter* filter,
+					  dtPolyRef* path, int* pathCount, const int maxPath,
+					  const dtNavMeshLandmarks* landmarks = 0) const;
 
 	/// Finds the straight path from the start to the end position within the polygon corridor.
 	///  @param[in]		startPos			Path start position. [(x, y, z)]
@@ -324,6 +338,25 @@ public:
 	dtStatus findNearestPoly(const float* center, const float* halfExtents,
 							 const dtQueryFilter* filter,
 							 dtPolyRef* nearestRef, float* nearestPt) const;
+
+	/// Finds the polygon nearest to the specified center point, testing the precomputed
+	/// polygon mask of the filter without virtual calls.
+	/// The parameters are the same as for findNearestPoly(..., const dtQueryFilter*, ...).
+	dtStatus findNearestPoly(const float* center, const float* halfExtents,
+							 const dtPolyMaskFilter* filter,
+							 dtPolyRef* nearestRef, float* nearestPt) const;
+	
+	/// Finds the polygon nearest to each of a set of points.
+	///  @param[in]		centers		The centers of the search boxes. [(x, y, z) * @p count]
+	///  @param[in]		count		The number of points.
+	///  @param[in]		halfExtents		The search distance along each axis. [(x, y, z)]
+	///  @param[in]		filter		The polygon filter to apply to the query.
+	///  @param[out]	nearestRefs	The reference id of the nearest polygon per point. [(polyRef) * @p count]
+	///  @param[out]	nearestPts	The nearest point on the polygon per point. [opt] [(x, y, z) * @p count]
+	/// @returns The status flags for the query.
+	dtStatus findNearestPolys(const float* centers, const int count, const float* halfExtents,
+							  const dtQueryFilter* filter,
+							  dtPolyRef* nearestRefs, float* nearestPts) const;
 	
 	/// Finds polygons that overlap the search box.
 	///  @param[in]		center		The center of the search box. [(x, y, z)]
@@ -345,6 +378,12 @@ public:
 	dtStatus queryPolygons(const float* center, const float* halfExtents,
 						   const dtQueryFilter* filter, dtPolyQuery* query) const;
 
+	/// Finds polygons that overlap the search box, testing the precomputed polygon mask
+	/// of the filter without virtual calls.
+	/// The parameters are the same as for queryPolygons(..., const dtQueryFilter*, dtPolyQuery*).
+	dtStatus queryPolygons(const float* center, const float* halfExtents,
+						   const dtPolyMaskFilter* filter, dtPolyQuery* query) const;
+
 	/// Finds the non-overlapping navigation polygons in the local neighbourhood around the center position.
 	///  @param[in]		startRef		The reference id of the polygon where the search starts.
 	///  @param[in]		centerPos		The center of the query circle. [(x, y, z)]
@@ -408,6 +447,13 @@ public:
 					 const dtQueryFilter* filter, const unsigned int options,
 					 dtRaycastHit* hit, dtPolyRef prevRef = 0) const;
 
+	/// Casts a 'walkability' ray along the surface of the navigation mesh, testing the precomputed
+	/// polygon mask of the filter and computing the costs without virtual calls.
+	/// The parameters are the same as for raycast(..., const dtQueryFilter*, const unsigned int, dtRaycastHit*, dtPolyRef).
+	dtStatus raycast(dtPolyRef startRef, const float* startPos, const float* endPos,
+					 const dtPolyMaskFilter* filter, const unsigned int options,
+					 dtRaycastHit* hit, dtPolyRef prevRef = 0) const;
+
 
 	/// Finds the distance from the specified position to the nearest polygon wall.
 	///  @param[in]		startRef		The reference id of the polygon containing @p centerPos.
@@ -513,8 +559,29 @@ private:
 	dtNavMeshQuery& operator=(const dtNavMeshQuery&);
 	
 	/// Queries polygons within a tile.
+	template <class TFilter>
 	void queryPolygonsInTile(const dtMeshTile* tile, const float* qmin, const float* qmax,
-							 const dtQueryFilter* filter, dtPolyQuery* query) const;
+							 const TFilter* filter, dtPolyQuery* query) const;
+
+	/// Implementations of the queries with a filter overload for dtPolyMaskFilter.
+	/// TFilter is either dtQueryFilter or dtPolyMaskFilter.
+	template <class TFilter>
+	dtStatus findPathT(dtPolyRef startRef, dtPolyRef endRef,
+					   const float* startPos, const float* endPos,
+					   const TFilter* filter,
+					   dtPolyRef* path, int* pathCount, const int maxPath,
+					   const dtNavMeshLandmarks* landmarks) const;
+	template <class TFilter>
+	dtStatus findNearestPolyT(const float* center, const float* halfExtents,
+							  const TFilter* filter,
+							  dtPolyRef* nearestRef, float* nearestPt) const;
+	template <class TFilter>
+	dtStatus queryPolygonsT(const float* center, const float* halfExtents,
+							const TFilter* filter, dtPolyQuery* query) const;
+	template <class TFilter>
+	dtStatus raycastT(dtPolyRef startRef, const float* startPos, const float* endPos,
+					  const TFilter* filter, const unsigned int options,
+					  dtRaycastHit* hit, dtPolyRef prevRef) const;
 
 	/// Returns portal points between two polygons.
 	dtStatus getPortalPoints(dtPolyRef from, dtPolyRef to, float* left, float* right,
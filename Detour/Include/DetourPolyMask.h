@@ -0,0 +1,173 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURPOLYMASK_H
+#define DETOURPOLYMASK_H
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourCommon.h"
+#include "DetourStatus.h"
+#include "DetourCostOverlay.h"
+
+/// The result of a filter's dtQueryFilter::passFilter() for every polygon of a navigation mesh,
+/// stored as one bit per polygon and tile.
+///
+/// Filters that derive their decision from the polygon flags redo the same work on every visit
+/// of a polygon, through a virtual call. The bits are computed once per tile and looked up by
+/// dtPolyMaskFilter instead.
+///
+/// Tiles are matched by their salt, so rebuilt tiles are detected by update(). Until then, and
+/// for tiles marked with invalidateTile(), the filter is called as before.
+/// @ingroup detour
+class dtPolyMask
+{
+public:
+	dtPolyMask();
+	~dtPolyMask();
+
+	/// Initializes the mask.
+	///  @param[in]	nav		The navigation mesh the mask covers.
+	///  @param[in]	filter	The filter the bits are computed with. Must stay alive
+	///						as long as the mask is used.
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav, const dtQueryFilter* filter);
+
+	/// Computes the bits of the tiles that were added or rebuilt since the last update.
+	///  @param[out]	changed		True if any tile was recomputed. [opt]
+	/// @returns The status flags for the operation.
+	dtStatus update(bool* changed = 0);
+
+	/// Marks the bits of all tiles out of date. Must be called when the filter or polygon flags
+	/// throughout the mesh change, changes to the tiles themselves are detected by update().
+	void invalidate();
+
+	/// Marks the bits of a tile out of date. Must be called when polygon flags of the tile
+	/// change without the tile being rebuilt.
+	///  @param[in]	ref		The reference of the tile.
+	void invalidateTile(dtTileRef ref);
+
+	/// The filter the bits are computed with.
+	const dtQueryFilter* getFilter() const { return m_filter; }
+
+	/// Returns true if the polygon passes the filter.
+	///  @param[in]	ref		The reference id of the polygon.
+	///  @param[in]	tile	The tile containing the polygon.
+	///  @param[in]	poly	The polygon.
+	inline bool passFilter(const dtPolyRef ref, const dtMeshTile* tile, const dtPoly* poly) const
+	{
+		const dtPolyMaskTile& mt = m_tiles[tile - m_firstTile];
+		if (mt.salt != tile->salt)
+			return m_filter->passFilter(ref, tile, poly);
+		const unsigned int ip = (unsigned int)(poly - tile->polys);
+		return (mt.bits[ip >> 5] & (1u << (ip & 31))) != 0;
+	}
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtPolyMask(const dtPolyMask&);
+	dtPolyMask& operator=(const dtPolyMask&);
+
+	struct dtPolyMaskTile
+	{
+		unsigned int salt;		///< The salt of the tile the bits were computed for, zero if out of date.
+		int maxPolys;			///< The number of polygons the bits have room for.
+		unsigned int* bits;		///< One bit per polygon, set if it passes the filter.
+	};
+
+	dtStatus computeTile(const int idx);
+
+	const dtNavMesh* m_nav;
+	const dtQueryFilter* m_filter;
+	const dtMeshTile* m_firstTile;
+
+	int m_ntiles;
+	dtPolyMaskTile* m_tiles;
+};
+
+/// A filter passing the polygons a dtPolyMask was computed for, with the default costs using the
+/// area costs of the mask's filter, multiplied by a cost overlay if one is set.
+///
+/// The dtNavMeshQuery functions that have an overload for this filter test the mask bits and
+/// compute the costs inline, without virtual calls. Derived classes must not change passFilter()
+/// or getCost(), as those overloads do not call them.
+/// @ingroup detour
+class dtPolyMaskFilter : public dtQueryFilter
+{
+public:
+	dtPolyMaskFilter();
+
+	/// Sets the mask to test and copies the area costs and flags of its filter.
+	///  @param[in]	mask	The mask. Must stay alive as long as the filter is used.
+	void setMask(const dtPolyMask* mask);
+
+	/// The mask the filter tests.
+	const dtPolyMask* getMask() const { return m_mask; }
+
+	/// Sets the cost overlay applied to the costs.
+	///  @param[in]	overlay		The overlay, or null for none. Must stay alive as long as the filter is used.
+	void setCostOverlay(const dtCostOverlay* overlay) { m_overlay = overlay; }
+
+	/// The cost overlay applied to the costs, or null if there is none.
+	const dtCostOverlay* getCostOverlay() const { return m_overlay; }
+
+	/// Returns true if the polygon can be visited.
+	///  @param[in]		ref		The reference id of the polygon test.
+	///  @param[in]		tile	The tile containing the polygon.
+	///  @param[in]		poly  The polygon to test.
+	bool passFilter(const dtPolyRef ref,
+					const dtMeshTile* tile,
+					const dtPoly* poly) const;
+
+	/// Returns cost to move from the beginning to the end of a line segment
+	/// that is fully contained within a polygon.
+	/// See dtQueryFilter::getCost() for the parameters.
+	float getCost(const float* pa, const float* pb,
+				  const dtPolyRef prevRef, const dtMeshTile* prevTile, const dtPoly* prevPoly,
+				  const dtPolyRef curRef, const dtMeshTile* curTile, const dtPoly* curPoly,
+				  const dtPolyRef nextRef, const dtMeshTile* nextTile, const dtPoly* nextPoly) const;
+
+	/// The non-virtual version of passFilter().
+	inline bool passMask(const dtPolyRef ref, const dtMeshTile* tile, const dtPoly* poly) const
+	{
+		return m_mask->passFilter(ref, tile, poly);
+	}
+
+	/// The non-virtual version of getCost().
+	inline float getMaskCost(const float* pa, const float* pb, const dtMeshTile* curTile, const dtPoly* curPoly) const
+	{
+		const float cost = dtVdist(pa, pb) * getAreaCost(curPoly->getArea());
+		return m_overlay ? cost * m_overlay->getCost(curTile, curPoly) : cost;
+	}
+
+private:
+	const dtPolyMask* m_mask;
+	const dtCostOverlay* m_overlay;
+};
+
+/// Allocates a polygon mask object using the Detour allocator.
+/// @return A polygon mask that is ready for initialization, or null on failure.
+///  @ingroup detour
+dtPolyMask* dtAllocPolyMask();
+
+/// Frees the specified polygon mask object using the Detour allocator.
+///  @param[in]	mask		A polygon mask allocated using #dtAllocPolyMask
+///  @ingroup detour
+void dtFreePolyMask(dtPolyMask* mask);
+
+#endif // DETOURPOLYMASK_H
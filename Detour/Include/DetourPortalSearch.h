@@ -0,0 +1,142 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURPORTALSEARCH_H
+#define DETOURPORTALSEARCH_H
+
+#include "DetourNavMesh.h"
+#include "DetourStatus.h"
+
+class dtQueryFilter;
+
+/// Receives the portals reached by a dtPortalSearch, in order of increasing cost.
+/// @ingroup detour
+class dtPortalSearchVisitor
+{
+public:
+	virtual ~dtPortalSearchVisitor() {}
+
+	/// Called once for each portal the search settles.
+	///  @param[in]	ref		The polygon entered through the portal.
+	///  @param[in]	fromRef	The polygon on the other side of the portal.
+	///  @param[in]	cost	The cost from the start position to the middle of the portal, or for
+	///						dtPortalSearch::searchBackward() from the middle of the portal to the
+	///						target position.
+	virtual void visit(dtPolyRef ref, dtPolyRef fromRef, float cost) = 0;
+};
+
+/// A one-to-all Dijkstra search over the portals of a navigation mesh.
+///
+/// The search states are the portals between polygons, placed where dtNavMeshQuery::findPath
+/// places its nodes: in the middle of the shared edge. Moving from one portal of a polygon to
+/// another costs dtQueryFilter::getCost() for that polygon, so the costs found match the costs
+/// findPath minimizes. As the costs are symmetric, the cost from the start to a portal is also
+/// the cost from the portal back to the start, as long as the links are two-way. One-way off-mesh
+/// connections only link in their direction of travel, so searches that need the cost back to the
+/// start should search in reverse, see search(), or backward, see searchBackward().
+///
+/// Used to build tables covering the whole mesh, such as landmarks and flow fields.
+/// @ingroup detour
+class dtPortalSearch
+{
+public:
+	dtPortalSearch();
+	~dtPortalSearch();
+
+	/// Initializes the search.
+	///  @param[in]	nav		The navigation mesh to search.
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav);
+
+	/// Searches from a position to all portals that can be reached from it.
+	///  @param[in]	startRef	The polygon containing the start position.
+	///  @param[in]	startPos	The start position. [(x, y, z)]
+	///  @param[in]	filter		The filter to apply.
+	///  @param[in]	maxCost		Portals further than this are not searched.
+	///  @param[in]	visitor		Receives the portals reached.
+	///  @param[in]	reverse		Only follow links that have a link back, so every portal visited
+	///							can also travel back to the start. Links without one, which only
+	///							one-way off-mesh connections have, are skipped in both directions.
+	/// @returns The status flags for the operation. Fails with #DT_OUT_OF_MEMORY if the search
+	/// could not complete, in which case some portals may not have been visited.
+	dtStatus search(dtPolyRef startRef, const float* startPos, const dtQueryFilter* filter,
+					const float maxCost, dtPortalSearchVisitor* visitor, const bool reverse = false);
+
+	/// Searches from all portals that can reach a position to the position, following the links
+	/// against their direction, so the cost found for a portal is the cost of travelling from it
+	/// to the target. One-way off-mesh connections are followed in their direction of travel.
+	///  @param[in]	targetRef	The polygon containing the target position.
+	///  @param[in]	targetPos	The target position. [(x, y, z)]
+	///  @param[in]	filter		The filter to apply.
+	///  @param[in]	maxCost		Portals further than this are not searched.
+	///  @param[in]	visitor		Receives the portals reached.
+	/// @returns The status flags for the operation. Fails with #DT_OUT_OF_MEMORY if the search
+	/// could not complete, in which case some portals may not have been visited.
+	dtStatus searchBackward(dtPolyRef targetRef, const float* targetPos, const dtQueryFilter* filter,
+							const float maxCost, dtPortalSearchVisitor* visitor);
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtPortalSearch(const dtPortalSearch&);
+	dtPortalSearch& operator=(const dtPortalSearch&);
+
+	struct dtPortalTile
+	{
+		float* linkCost;		///< Best cost found for each link of the tile.
+		int maxLinkCount;		///< The size of the link cost array.
+	};
+
+	struct dtPortalHeapItem
+	{
+		float cost;
+		unsigned int tile;
+		unsigned int poly;
+		unsigned int link;
+	};
+
+	/// A link from an off-mesh connection to a polygon that has no link back.
+	struct dtPortalOneWayLink
+	{
+		dtPolyRef ref;			///< The polygon the link points to.
+		unsigned int tile;
+		unsigned int poly;
+		unsigned int link;
+	};
+
+	dtStatus reset();
+	bool push(const dtPortalHeapItem& item);
+	dtPortalHeapItem pop();
+	dtStatus collectOneWayLinks();
+	bool pushPredecessors(dtPolyRef ref, const float* pos, dtPolyRef nextRef, const float cost,
+						  const dtQueryFilter* filter, const float maxCost);
+
+	const dtNavMesh* m_nav;
+
+	int m_ntiles;
+	dtPortalTile* m_tiles;
+
+	dtPortalHeapItem* m_heap;
+	int m_heapSize;
+	int m_heapCapacity;
+
+	dtPortalOneWayLink* m_oneWay;	///< Sorted by the polygon they point to.
+	int m_oneWayCount;
+	int m_oneWayCapacity;
+};
+
+#endif // DETOURPORTALSEARCH_H
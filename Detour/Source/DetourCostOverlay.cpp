@@ -0,0 +1,376 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <string.h>
+#include "DetourCostOverlay.h"
+#include "DetourCommon.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+#include <new>
+
+dtCostOverlay* dtAllocCostOverlay()
+{
+	void* mem = dtAlloc(sizeof(dtCostOverlay), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtCostOverlay;
+}
+
+void dtFreeCostOverlay(dtCostOverlay* overlay)
+{
+	if (!overlay) return;
+	overlay->~dtCostOverlay();
+	dtFree(overlay);
+}
+
+inline dtCostShapeRef encodeShapeId(unsigned int salt, unsigned int it)
+{
+	return ((dtCostShapeRef)salt << 16) | (dtCostShapeRef)it;
+}
+
+inline unsigned int decodeShapeIdSalt(dtCostShapeRef ref)
+{
+	return (unsigned int)((ref >> 16) & 0xffff);
+}
+
+inline unsigned int decodeShapeIdShape(dtCostShapeRef ref)
+{
+	return (unsigned int)(ref & 0xffff);
+}
+
+/// @class dtCostOverlay
+///
+/// The multiplier of a polygon is the product of the costs of all shapes overlapping it, and 1 where
+/// no shape does. A circle overlaps the polygons whose edges come within its radius, a convex shape
+/// the polygons it intersects, both limited to polygons whose height range meets the shape's.
+/// Off-mesh connections are not painted.
+///
+/// Multipliers below 1 are raised to 1. Queries estimate the remaining cost from the unpainted
+/// costs, straight line distances and landmarks, which are only lower bounds while costs can
+/// only grow.
+///
+/// @see dtPolyMaskFilter
+
+dtCostOverlay::dtCostOverlay() :
+	m_nav(0),
+	m_firstTile(0),
+	m_ntiles(0),
+	m_tiles(0),
+	m_shapes(0),
+	m_nextFreeShape(0),
+	m_maxShapes(0),
+	m_nshapes(0)
+{
+}
+
+dtCostOverlay::~dtCostOverlay()
+{
+	for (int i = 0; i < m_ntiles; ++i)
+		dtFree(m_tiles[i].cost);
+	dtFree(m_tiles);
+	dtFree(m_shapes);
+}
+
+dtStatus dtCostOverlay::init(const dtNavMesh* nav, const int maxShapes)
+{
+	if (!nav || maxShapes <= 0 || maxShapes > 0xffff)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	for (int i = 0; i < m_ntiles; ++i)
+		dtFree(m_tiles[i].cost);
+	dtFree(m_tiles);
+	dtFree(m_shapes);
+	m_shapes = 0;
+	m_nextFreeShape = 0;
+	m_maxShapes = 0;
+	m_nshapes = 0;
+
+	m_nav = nav;
+	m_firstTile = nav->getTile(0);
+
+	m_ntiles = nav->getMaxTiles();
+	m_tiles = (dtCostOverlayTile*)dtAlloc(sizeof(dtCostOverlayTile)*m_ntiles, DT_ALLOC_PERM);
+	if (!m_tiles)
+	{
+		m_ntiles = 0;
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	memset(m_tiles, 0, sizeof(dtCostOverlayTile)*m_ntiles);
+
+	m_shapes = (dtCostShape*)dtAlloc(sizeof(dtCostShape)*maxShapes, DT_ALLOC_PERM);
+	if (!m_shapes)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	memset(m_shapes, 0, sizeof(dtCostShape)*maxShapes);
+	m_maxShapes = maxShapes;
+	for (int i = m_maxShapes-1; i >= 0; --i)
+	{
+		m_shapes[i].salt = 1;
+		m_shapes[i].next = m_nextFreeShape;
+		m_nextFreeShape = &m_shapes[i];
+	}
+
+	return DT_SUCCESS;
+}
+
+dtCostOverlay::dtCostShape* dtCostOverlay::allocShape(dtCostShapeRef* result)
+{
+	if (!m_nextFreeShape)
+		return 0;
+
+	dtCostShape* shape = m_nextFreeShape;
+	m_nextFreeShape = shape->next;
+	shape->next = 0;
+	m_nshapes++;
+
+	if (result)
+		*result = encodeShapeId(shape->salt, (unsigned int)(shape - m_shapes));
+	return shape;
+}
+
+const dtCostOverlay::dtCostShape* dtCostOverlay::getShapeByRef(const dtCostShapeRef ref) const
+{
+	const unsigned int idx = decodeShapeIdShape(ref);
+	if ((int)idx >= m_maxShapes)
+		return 0;
+	const dtCostShape* shape = &m_shapes[idx];
+	if (shape->salt != decodeShapeIdSalt(ref) || shape->type == DT_COST_SHAPE_EMPTY)
+		return 0;
+	return shape;
+}
+
+dtStatus dtCostOverlay::addCircle(const float* pos, const float radius, const float height, const float cost,
+								  dtCostShapeRef* result)
+{
+	if (!pos || radius <= 0 || height < 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	dtCostShape* shape = allocShape(result);
+	if (!shape)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+	shape->type = DT_COST_SHAPE_CIRCLE;
+	dtVcopy(shape->verts, pos);
+	shape->nverts = 1;
+	shape->radius = radius;
+	shape->hmin = pos[1];
+	shape->hmax = pos[1] + height;
+	shape->cost = dtMax(cost, 1.0f);
+	dtVset(shape->bmin, pos[0] - radius, shape->hmin, pos[2] - radius);
+	dtVset(shape->bmax, pos[0] + radius, shape->hmax, pos[2] + radius);
+
+	markTiles(shape->bmin, shape->bmax);
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtCostOverlay::addConvex(const float* verts, const int nverts, const float hmin, const float hmax, const float cost,
+								  dtCostShapeRef* result)
+{
+	if (!verts || nverts < 3 || nverts > DT_COST_SHAPE_MAX_VERTS || hmin > hmax)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	dtCostShape* shape = allocShape(result);
+	if (!shape)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+	shape->type = DT_COST_SHAPE_CONVEX;
+	memcpy(shape->verts, verts, sizeof(float)*3*nverts);
+	shape->nverts = nverts;
+	shape->radius = 0;
+	shape->hmin = hmin;
+	shape->hmax = hmax;
+	shape->cost = dtMax(cost, 1.0f);
+	dtVcopy(shape->bmin, verts);
+	dtVcopy(shape->bmax, verts);
+	for (int i = 1; i < nverts; ++i)
+	{
+		dtVmin(shape->bmin, &verts[i*3]);
+		dtVmax(shape->bmax, &verts[i*3]);
+	}
+	shape->bmin[1] = hmin;
+	shape->bmax[1] = hmax;
+
+	markTiles(shape->bmin, shape->bmax);
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtCostOverlay::removeShape(const dtCostShapeRef ref)
+{
+	dtCostShape* shape = (dtCostShape*)getShapeByRef(ref);
+	if (!shape)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	markTiles(shape->bmin, shape->bmax);
+
+	shape->type = DT_COST_SHAPE_EMPTY;
+	// Salt should never be zero.
+	shape->salt = (unsigned short)((shape->salt+1) & 0xffff);
+	if (shape->salt == 0)
+		shape->salt++;
+	shape->next = m_nextFreeShape;
+	m_nextFreeShape = shape;
+	m_nshapes--;
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtCostOverlay::setShapeCost(const dtCostShapeRef ref, const float cost)
+{
+	dtCostShape* shape = (dtCostShape*)getShapeByRef(ref);
+	if (!shape)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	shape->cost = dtMax(cost, 1.0f);
+	markTiles(shape->bmin, shape->bmax);
+
+	return DT_SUCCESS;
+}
+
+void dtCostOverlay::clear()
+{
+	for (int i = 0; i < m_maxShapes; ++i)
+	{
+		if (m_shapes[i].type == DT_COST_SHAPE_EMPTY)
+			continue;
+		dtCostShapeRef ref = encodeShapeId(m_shapes[i].salt, (unsigned int)i);
+		removeShape(ref);
+	}
+}
+
+// Marks the tiles overlapping the bounds for repainting.
+void dtCostOverlay::markTiles(const float* bmin, const float* bmax)
+{
+	static const int MAX_NEIS = 32;
+	const dtMeshTile* neis[MAX_NEIS];
+
+	int minx, miny, maxx, maxy;
+	m_nav->calcTileLoc(bmin, &minx, &miny);
+	m_nav->calcTileLoc(bmax, &maxx, &maxy);
+
+	for (int y = miny; y <= maxy; ++y)
+	{
+		for (int x = minx; x <= maxx; ++x)
+		{
+			const int nneis = m_nav->getTilesAt(x, y, neis, MAX_NEIS);
+			for (int j = 0; j < nneis; ++j)
+				m_tiles[neis[j] - m_firstTile].dirty = true;
+		}
+	}
+}
+
+dtStatus dtCostOverlay::update(bool* changed)
+{
+	if (changed)
+		*changed = false;
+	if (!m_nav)
+		return DT_FAILURE;
+
+	for (int i = 0; i < m_ntiles; ++i)
+	{
+		const dtMeshTile* tile = m_nav->getTile(i);
+		dtCostOverlayTile& ot = m_tiles[i];
+		if (!tile->header)
+		{
+			ot.dirty = false;
+			continue;
+		}
+		if (!ot.dirty && ot.salt == tile->salt)
+			continue;
+
+		dtStatus status = paintTile(i);
+		if (dtStatusFailed(status))
+			return status;
+		if (changed)
+			*changed = true;
+	}
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtCostOverlay::paintTile(const int idx)
+{
+	const dtMeshTile* tile = m_nav->getTile(idx);
+	dtCostOverlayTile& ot = m_tiles[idx];
+	const int polyCount = tile->header->polyCount;
+
+	if (ot.maxPolys < polyCount)
+	{
+		dtFree(ot.cost);
+		ot.maxPolys = 0;
+		ot.salt = 0;
+		ot.cost = (float*)dtAlloc(sizeof(float)*polyCount, DT_ALLOC_PERM);
+		if (!ot.cost)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		ot.maxPolys = polyCount;
+	}
+	for (int i = 0; i < polyCount; ++i)
+		ot.cost[i] = 1.0f;
+
+	float verts[DT_VERTS_PER_POLYGON*3];
+
+	for (int s = 0; s < m_maxShapes; ++s)
+	{
+		const dtCostShape& shape = m_shapes[s];
+		if (shape.type == DT_COST_SHAPE_EMPTY ||
+			!dtOverlapBounds(shape.bmin, shape.bmax, tile->header->bmin, tile->header->bmax))
+			continue;
+
+		for (int i = 0; i < polyCount; ++i)
+		{
+			const dtPoly* poly = &tile->polys[i];
+			if (poly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+				continue;
+
+			const int nv = (int)poly->vertCount;
+			float pmin[3], pmax[3];
+			for (int j = 0; j < nv; ++j)
+				dtVcopy(&verts[j*3], &tile->verts[poly->verts[j]*3]);
+			dtVcopy(pmin, verts);
+			dtVcopy(pmax, verts);
+			for (int j = 1; j < nv; ++j)
+			{
+				dtVmin(pmin, &verts[j*3]);
+				dtVmax(pmax, &verts[j*3]);
+			}
+			if (!dtOverlapBounds(shape.bmin, shape.bmax, pmin, pmax))
+				continue;
+
+			bool overlap;
+			if (shape.type == DT_COST_SHAPE_CIRCLE)
+			{
+				float edged[DT_VERTS_PER_POLYGON];
+				float edget[DT_VERTS_PER_POLYGON];
+				overlap = dtDistancePtPolyEdgesSqr(shape.verts, verts, nv, edged, edget);
+				for (int j = 0; j < nv && !overlap; ++j)
+					overlap = edged[j] <= dtSqr(shape.radius);
+			}
+			else
+			{
+				overlap = dtOverlapPolyPoly2D(shape.verts, shape.nverts, verts, nv);
+			}
+
+			if (overlap)
+				ot.cost[i] *= shape.cost;
+		}
+	}
+
+	ot.salt = tile->salt;
+	ot.dirty = false;
+
+	return DT_SUCCESS;
+}
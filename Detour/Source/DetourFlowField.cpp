@@ -0,0 +1,277 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <string.h>
+#include "DetourFlowField.h"
+#include "DetourCommon.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+#include <new>
+
+dtFlowField* dtAllocFlowField()
+{
+	void* mem = dtAlloc(sizeof(dtFlowField), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtFlowField;
+}
+
+void dtFreeFlowField(dtFlowField* field)
+{
+	if (!field) return;
+	field->~dtFlowField();
+	dtFree(field);
+}
+
+// Records the first, and therefore cheapest, portal each polygon is reached through.
+class dtFlowField::dtFlowVisitor : public dtPortalSearchVisitor
+{
+public:
+	dtFlowVisitor(dtFlowField* field) :
+		m_field(field)
+	{
+	}
+
+	virtual void visit(dtPolyRef ref, dtPolyRef fromRef, float cost)
+	{
+		const dtFlowTile& ft = m_field->m_tiles[m_field->m_nav->decodePolyIdTile(ref)];
+		const unsigned int ip = m_field->m_nav->decodePolyIdPoly(ref);
+		if (cost < ft.cost[ip])
+		{
+			ft.cost[ip] = cost;
+			ft.next[ip] = fromRef;
+		}
+	}
+
+private:
+	dtFlowField* m_field;
+};
+
+/// @class dtFlowField
+///
+/// The search runs from the goal outwards. As the path costs are symmetric, the cost of reaching
+/// a polygon from the goal is the cost of reaching the goal from the polygon, and the polygon the
+/// search came from is the next polygon on the way to the goal.
+///
+/// This only holds for links that can be travelled both ways, so the search skips one-way off-mesh
+/// connections. Agents never get directed down a connection against its direction of travel, but
+/// the field does not use one-way connections either, and polygons only connected to the goal
+/// through one are left unreachable. Use dtNavMeshQuery::findPath for those.
+///
+/// @see dtNavMeshQuery::findPath, dtPortalSearch
+
+dtFlowField::dtFlowField() :
+	m_nav(0),
+	m_ntiles(0),
+	m_tiles(0),
+	m_built(false),
+	m_goalRef(0)
+{
+	dtVset(m_goalPos, 0, 0, 0);
+}
+
+dtFlowField::~dtFlowField()
+{
+	for (int i = 0; i < m_ntiles; ++i)
+	{
+		dtFree(m_tiles[i].cost);
+		dtFree(m_tiles[i].next);
+	}
+	dtFree(m_tiles);
+}
+
+dtStatus dtFlowField::init(const dtNavMesh* nav)
+{
+	if (!nav)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	for (int i = 0; i < m_ntiles; ++i)
+	{
+		dtFree(m_tiles[i].cost);
+		dtFree(m_tiles[i].next);
+	}
+	dtFree(m_tiles);
+	m_tiles = 0;
+	m_ntiles = 0;
+	m_built = false;
+	m_goalRef = 0;
+
+	dtStatus status = m_search.init(nav);
+	if (dtStatusFailed(status))
+		return status;
+
+	m_nav = nav;
+	m_ntiles = nav->getMaxTiles();
+	m_tiles = (dtFlowTile*)dtAlloc(sizeof(dtFlowTile)*m_ntiles, DT_ALLOC_PERM);
+	if (!m_tiles)
+	{
+		m_ntiles = 0;
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	memset(m_tiles, 0, sizeof(dtFlowTile)*m_ntiles);
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtFlowField::build(dtPolyRef goalRef, const float* goalPos, const dtQueryFilter* filter,
+							const float maxCost)
+{
+	if (!m_nav || !m_tiles)
+		return DT_FAILURE;
+	if (!m_nav->isValidPolyRef(goalRef) || !goalPos || !filter)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	m_built = false;
+	m_goalRef = goalRef;
+	dtVcopy(m_goalPos, goalPos);
+
+	// Match the tables to the current tiles and clear them.
+	for (int i = 0; i < m_ntiles; ++i)
+	{
+		const dtMeshTile* tile = m_nav->getTile(i);
+		dtFlowTile& ft = m_tiles[i];
+
+		const int polyCount = tile->header ? tile->header->polyCount : 0;
+		if (ft.polyCount != polyCount)
+		{
+			dtFree(ft.cost);
+			dtFree(ft.next);
+			ft.cost = 0;
+			ft.next = 0;
+			ft.polyCount = 0;
+
+			if (polyCount)
+			{
+				ft.cost = (float*)dtAlloc(sizeof(float)*polyCount, DT_ALLOC_PERM);
+				ft.next = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef)*polyCount, DT_ALLOC_PERM);
+				if (!ft.cost || !ft.next)
+					return DT_FAILURE | DT_OUT_OF_MEMORY;
+				ft.polyCount = polyCount;
+			}
+		}
+
+		ft.salt = tile->salt;
+		for (int j = 0; j < ft.polyCount; ++j)
+		{
+			ft.cost[j] = FLT_MAX;
+			ft.next[j] = 0;
+		}
+	}
+
+	const unsigned int ip = m_nav->decodePolyIdPoly(goalRef);
+	m_tiles[m_nav->decodePolyIdTile(goalRef)].cost[ip] = 0;
+
+	dtFlowVisitor visitor(this);
+	const dtStatus status = m_search.search(goalRef, goalPos, filter, maxCost, &visitor, true);
+	if (dtStatusFailed(status))
+		return status;
+
+	m_built = true;
+	return DT_SUCCESS;
+}
+
+bool dtFlowField::isUpToDate() const
+{
+	if (!m_built)
+		return false;
+
+	for (int i = 0; i < m_ntiles; ++i)
+	{
+		const dtMeshTile* tile = m_nav->getTile(i);
+		const dtFlowTile& ft = m_tiles[i];
+		const int polyCount = tile->header ? tile->header->polyCount : 0;
+		if (ft.polyCount != polyCount || (polyCount && ft.salt != tile->salt))
+			return false;
+	}
+
+	return true;
+}
+
+// Returns the table of the tile of a polygon, or null if the tile has changed since the build.
+const dtFlowField::dtFlowTile* dtFlowField::getTable(dtPolyRef ref, unsigned int* ip) const
+{
+	if (!m_built || !m_nav->isValidPolyRef(ref))
+		return 0;
+
+	unsigned int salt, it;
+	m_nav->decodePolyId(ref, salt, it, *ip);
+	const dtFlowTile& ft = m_tiles[it];
+	if (ft.salt != salt || (int)*ip >= ft.polyCount)
+		return 0;
+
+	return &ft;
+}
+
+dtStatus dtFlowField::getCost(dtPolyRef ref, float* cost) const
+{
+	if (!cost)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	unsigned int ip;
+	const dtFlowTile* ft = getTable(ref, &ip);
+	if (!ft)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	*cost = ft->cost[ip];
+	return DT_SUCCESS;
+}
+
+dtStatus dtFlowField::getNext(dtPolyRef ref, dtPolyRef* next) const
+{
+	if (!next)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	unsigned int ip;
+	const dtFlowTile* ft = getTable(ref, &ip);
+	if (!ft)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (ft->cost[ip] == FLT_MAX)
+		return DT_FAILURE;
+
+	*next = ft->next[ip];
+	return DT_SUCCESS;
+}
+
+dtStatus dtFlowField::getPath(dtPolyRef startRef, dtPolyRef* path, int* pathCount, const int maxPath) const
+{
+	if (!path || !pathCount || maxPath < 1)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	*pathCount = 0;
+
+	dtPolyRef ref = startRef;
+	int n = 0;
+	while (ref)
+	{
+		if (n >= maxPath)
+		{
+			*pathCount = n;
+			return DT_SUCCESS | DT_PARTIAL_RESULT | DT_BUFFER_TOO_SMALL;
+		}
+
+		dtPolyRef next;
+		const dtStatus status = getNext(ref, &next);
+		if (dtStatusFailed(status))
+			return status;
+
+		path[n++] = ref;
+		ref = next;
+	}
+
+	*pathCount = n;
+	return DT_SUCCESS;
+}
@@ -0,0 +1,416 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <string.h>
+#include "DetourIslands.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourCommon.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+#include <new>
+
+// Marks polygons that pass the filter but have not been assigned a component yet.
+static const unsigned int DT_ISLAND_UNVISITED = 0xffffffff;
+
+dtNavMeshIslands* dtAllocNavMeshIslands()
+{
+	void* mem = dtAlloc(sizeof(dtNavMeshIslands), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtNavMeshIslands;
+}
+
+void dtFreeNavMeshIslands(dtNavMeshIslands* islands)
+{
+	if (!islands) return;
+	islands->~dtNavMeshIslands();
+	dtFree(islands);
+}
+
+/// @class dtNavMeshIslands
+///
+/// Links are treated as two-way when joining components, so polygons only reachable through
+/// one-way off-mesh connections may share an island without a path existing. This errs on the
+/// side of searching, never on the side of rejecting a path that exists.
+///
+/// Tiles that change after update() are not noticed until the next update(). Polygons of rebuilt
+/// tiles are reported as not labelled in the meantime, but a rebuilt tile can also join or split
+/// the islands of other tiles, so update() should be called right after the navigation mesh changes.
+///
+/// @see dtNavMeshQuery::findPath
+
+dtNavMeshIslands::dtNavMeshIslands() :
+	m_nav(0),
+	m_filter(0),
+	m_ntiles(0),
+	m_tiles(0),
+	m_dirty(true),
+	m_parent(0),
+	m_maxComps(0),
+	m_nislands(0),
+	m_stack(0),
+	m_maxStack(0)
+{
+}
+
+dtNavMeshIslands::~dtNavMeshIslands()
+{
+	for (int i = 0; i < m_ntiles; ++i)
+	{
+		dtFree(m_tiles[i].comp);
+		dtFree(m_tiles[i].borders);
+	}
+	dtFree(m_tiles);
+	dtFree(m_parent);
+	dtFree(m_stack);
+}
+
+dtStatus dtNavMeshIslands::init(const dtNavMesh* nav, const dtQueryFilter* filter)
+{
+	if (!nav || !filter)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	for (int i = 0; i < m_ntiles; ++i)
+	{
+		dtFree(m_tiles[i].comp);
+		dtFree(m_tiles[i].borders);
+	}
+	dtFree(m_tiles);
+
+	m_nav = nav;
+	m_filter = filter;
+	m_dirty = true;
+	m_nislands = 0;
+
+	m_ntiles = nav->getMaxTiles();
+	m_tiles = (dtIslandTile*)dtAlloc(sizeof(dtIslandTile)*m_ntiles, DT_ALLOC_PERM);
+	if (!m_tiles)
+	{
+		m_ntiles = 0;
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	memset(m_tiles, 0, sizeof(dtIslandTile)*m_ntiles);
+
+	return DT_SUCCESS;
+}
+
+void dtNavMeshIslands::invalidate()
+{
+	for (int i = 0; i < m_ntiles; ++i)
+		m_tiles[i].dirty = true;
+	m_dirty = true;
+}
+
+void dtNavMeshIslands::invalidateTile(dtTileRef ref)
+{
+	if (!m_nav)
+		return;
+	const int it = (int)m_nav->decodePolyIdTile((dtPolyRef)ref);
+	if (it >= m_ntiles)
+		return;
+	m_tiles[it].dirty = true;
+	m_dirty = true;
+}
+
+// Syncs the per tile tables with the tiles of the navigation mesh. A tile that was added, removed
+// or rebuilt also changes the links of its neighbours, so those are recomputed as well.
+// Returns true if any tile changed.
+bool dtNavMeshIslands::refreshTiles()
+{
+	static const int MAX_NEIS = 32;
+	bool changed = false;
+
+	for (int i = 0; i < m_ntiles; ++i)
+	{
+		const dtMeshTile* tile = m_nav->getTile(i);
+		dtIslandTile& it = m_tiles[i];
+
+		// The salt of a labelled tile is never zero.
+		const bool present = tile->header != 0;
+		const bool labelled = it.salt != 0;
+		if (present == labelled && (!present || it.salt == tile->salt))
+			continue;
+
+		changed = true;
+
+		// Mark the neighbours at the old and the new location.
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			if ((pass == 0 && !labelled) || (pass == 1 && !present))
+				continue;
+			const int x = pass == 0 ? it.x : tile->header->x;
+			const int y = pass == 0 ? it.y : tile->header->y;
+			for (int dy = -1; dy <= 1; ++dy)
+			{
+				for (int dx = -1; dx <= 1; ++dx)
+				{
+					const dtMeshTile* neis[MAX_NEIS];
+					const int nneis = m_nav->getTilesAt(x+dx, y+dy, neis, MAX_NEIS);
+					for (int j = 0; j < nneis; ++j)
+						m_tiles[m_nav->decodePolyIdTile((dtPolyRef)m_nav->getTileRef(neis[j]))].dirty = true;
+				}
+			}
+		}
+
+		if (present)
+		{
+			it.salt = tile->salt;
+			it.x = tile->header->x;
+			it.y = tile->header->y;
+			it.dirty = true;
+		}
+		else
+		{
+			dtFree(it.comp);
+			dtFree(it.borders);
+			memset(&it, 0, sizeof(dtIslandTile));
+		}
+	}
+
+	return changed;
+}
+
+// Finds the components of the tile reachable through links inside the tile and collects the
+// links that leave the tile. A fill can also reach a polygon that an earlier fill labelled
+// without linking back, e.g. the end of a one-way off-mesh connection. Those links are collected
+// too, so joinTiles() joins the two components like components of different tiles.
+dtStatus dtNavMeshIslands::computeTile(const int idx)
+{
+	const dtMeshTile* tile = m_nav->getTile(idx);
+	dtIslandTile& it = m_tiles[idx];
+	const int polyCount = tile->header->polyCount;
+
+	it.ncomp = 0;
+	it.nborders = 0;
+
+	if (it.polyCount != polyCount)
+	{
+		dtFree(it.comp);
+		it.comp = (unsigned int*)dtAlloc(sizeof(unsigned int)*dtMax(polyCount, 1), DT_ALLOC_PERM);
+		it.polyCount = it.comp ? polyCount : 0;
+		if (!it.comp)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	if (m_maxStack < polyCount)
+	{
+		dtFree(m_stack);
+		m_stack = (unsigned int*)dtAlloc(sizeof(unsigned int)*polyCount, DT_ALLOC_PERM);
+		m_maxStack = m_stack ? polyCount : 0;
+		if (!m_stack)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	const dtPolyRef base = m_nav->getPolyRefBase(tile);
+	for (int i = 0; i < polyCount; ++i)
+		it.comp[i] = m_filter->passFilter(base | (dtPolyRef)i, tile, &tile->polys[i]) ? DT_ISLAND_UNVISITED : 0;
+
+	int nborders = 0;
+
+	for (int i = 0; i < polyCount; ++i)
+	{
+		if (it.comp[i] != DT_ISLAND_UNVISITED)
+			continue;
+
+		const unsigned int comp = (unsigned int)++it.ncomp;
+		it.comp[i] = comp;
+
+		int nstack = 0;
+		m_stack[nstack++] = (unsigned int)i;
+
+		while (nstack)
+		{
+			const dtPoly* poly = &tile->polys[m_stack[--nstack]];
+			for (unsigned int j = poly->firstLink; j != DT_NULL_LINK; j = tile->links[j].next)
+			{
+				const dtPolyRef ref = tile->links[j].ref;
+				if (!ref)
+					continue;
+				if ((int)m_nav->decodePolyIdTile(ref) != idx)
+				{
+					nborders++;
+					continue;
+				}
+				const unsigned int ip = m_nav->decodePolyIdPoly(ref);
+				if (it.comp[ip] == DT_ISLAND_UNVISITED)
+				{
+					it.comp[ip] = comp;
+					m_stack[nstack++] = ip;
+				}
+				else if (it.comp[ip] && it.comp[ip] != comp)
+				{
+					nborders++;
+				}
+			}
+		}
+	}
+
+	dtFree(it.borders);
+	it.borders = 0;
+	if (nborders)
+	{
+		it.borders = (dtIslandBorder*)dtAlloc(sizeof(dtIslandBorder)*nborders, DT_ALLOC_PERM);
+		if (!it.borders)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+		for (int i = 0; i < polyCount; ++i)
+		{
+			if (!it.comp[i])
+				continue;
+			const dtPoly* poly = &tile->polys[i];
+			for (unsigned int j = poly->firstLink; j != DT_NULL_LINK; j = tile->links[j].next)
+			{
+				const dtPolyRef ref = tile->links[j].ref;
+				if (!ref)
+					continue;
+				const bool inside = (int)m_nav->decodePolyIdTile(ref) == idx;
+				const unsigned int comp = inside ? it.comp[m_nav->decodePolyIdPoly(ref)] : 0;
+				if (!inside || (comp && comp != it.comp[i]))
+				{
+					dtIslandBorder& b = it.borders[it.nborders++];
+					b.comp = it.comp[i];
+					b.ref = ref;
+				}
+			}
+		}
+	}
+
+	it.dirty = false;
+	return DT_SUCCESS;
+}
+
+int dtNavMeshIslands::findRoot(int i)
+{
+	while (m_parent[i] != i)
+	{
+		m_parent[i] = m_parent[m_parent[i]];
+		i = m_parent[i];
+	}
+	return i;
+}
+
+// Joins the local components of all tiles through the links between the tiles.
+dtStatus dtNavMeshIslands::joinTiles()
+{
+	int ncomps = 0;
+	for (int i = 0; i < m_ntiles; ++i)
+	{
+		m_tiles[i].firstComp = ncomps;
+		ncomps += m_tiles[i].ncomp;
+	}
+
+	if (m_maxComps < ncomps)
+	{
+		dtFree(m_parent);
+		m_parent = (int*)dtAlloc(sizeof(int)*ncomps, DT_ALLOC_PERM);
+		m_maxComps = m_parent ? ncomps : 0;
+		if (!m_parent)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	for (int i = 0; i < ncomps; ++i)
+		m_parent[i] = i;
+
+	for (int i = 0; i < m_ntiles; ++i)
+	{
+		const dtIslandTile& it = m_tiles[i];
+		for (int j = 0; j < it.nborders; ++j)
+		{
+			const dtIslandBorder& b = it.borders[j];
+
+			unsigned int salt, ti, ip;
+			m_nav->decodePolyId(b.ref, salt, ti, ip);
+			if ((int)ti >= m_ntiles)
+				continue;
+			const dtIslandTile& nt = m_tiles[ti];
+			if (nt.salt != salt || (int)ip >= nt.polyCount || !nt.comp[ip])
+				continue;
+
+			const int ra = findRoot(it.firstComp + (int)b.comp - 1);
+			const int rb = findRoot(nt.firstComp + (int)nt.comp[ip] - 1);
+			if (ra != rb)
+				m_parent[dtMax(ra, rb)] = dtMin(ra, rb);
+		}
+	}
+
+	// Point every component straight at its island so lookups are constant time.
+	m_nislands = 0;
+	for (int i = 0; i < ncomps; ++i)
+	{
+		m_parent[i] = findRoot(i);
+		if (m_parent[i] == i)
+			m_nislands++;
+	}
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtNavMeshIslands::update(bool* changed)
+{
+	if (changed)
+		*changed = false;
+	if (!m_nav || !m_tiles)
+		return DT_FAILURE;
+
+	if (!refreshTiles() && !m_dirty)
+		return DT_SUCCESS;
+
+	m_dirty = true;
+
+	for (int i = 0; i < m_ntiles; ++i)
+	{
+		if (!m_tiles[i].dirty || !m_nav->getTile(i)->header)
+			continue;
+		const dtStatus status = computeTile(i);
+		if (dtStatusFailed(status))
+			return status;
+	}
+
+	const dtStatus status = joinTiles();
+	if (dtStatusFailed(status))
+		return status;
+
+	m_dirty = false;
+	if (changed)
+		*changed = true;
+
+	return DT_SUCCESS;
+}
+
+unsigned int dtNavMeshIslands::getIsland(dtPolyRef ref) const
+{
+	if (m_dirty || !m_nav)
+		return 0;
+
+	unsigned int salt, ti, ip;
+	m_nav->decodePolyId(ref, salt, ti, ip);
+	if ((int)ti >= m_ntiles)
+		return 0;
+
+	const dtIslandTile& it = m_tiles[ti];
+	if (!it.salt || it.salt != salt || (int)ip >= it.polyCount || !it.comp[ip])
+		return 0;
+
+	return (unsigned int)m_parent[it.firstComp + (int)it.comp[ip] - 1] + 1;
+}
+
+bool dtNavMeshIslands::isReachable(dtPolyRef startRef, dtPolyRef endRef) const
+{
+	const unsigned int a = getIsland(startRef);
+	const unsigned int b = getIsland(endRef);
+	return !a || !b || a == b;
+}
@@ -0,0 +1,782 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <float.h>
+#include <string.h>
+#include "DetourLandmarks.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourCommon.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+#include <new>
+
+// Distance of polygons that cannot be reached from a landmark.
+static const float DT_LANDMARK_UNREACHABLE = FLT_MAX;
+
+struct dtLandmarksHeader
+{
+	int magic;
+	int version;
+	int maxLandmarks;
+	int landmarkCount;
+	int tileCount;
+};
+
+struct dtLandmarksTileHeader
+{
+	int x, y, layer;
+	int polyCount;
+	unsigned int hash;		///< hashTile() of the tile the tables were computed for.
+};
+
+dtNavMeshLandmarks* dtAllocNavMeshLandmarks()
+{
+	void* mem = dtAlloc(sizeof(dtNavMeshLandmarks), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtNavMeshLandmarks;
+}
+
+void dtFreeNavMeshLandmarks(dtNavMeshLandmarks* landmarks)
+{
+	if (!landmarks) return;
+	landmarks->~dtNavMeshLandmarks();
+	dtFree(landmarks);
+}
+
+static unsigned int hashBytes(unsigned int hash, const void* data, const int size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (int i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// FNV-1a hash of what the distances depend on: the ground vertices, the polygons and their flags,
+// which obstacles and gates change. The salt differs between runs, and the links and off-mesh
+// connection end points change as neighbours connect, so they are left out.
+static unsigned int hashTile(const dtMeshTile* tile)
+{
+	const dtMeshHeader* header = tile->header;
+	unsigned int hash = 2166136261u;
+	hash = hashBytes(hash, &header->polyCount, sizeof(header->polyCount));
+	hash = hashBytes(hash, tile->verts, sizeof(float)*3*(header->vertCount - header->offMeshConCount*2));
+	for (int i = 0; i < header->polyCount; ++i)
+	{
+		const dtPoly* poly = &tile->polys[i];
+		hash = hashBytes(hash, poly->verts, sizeof(poly->verts));
+		hash = hashBytes(hash, poly->neis, sizeof(poly->neis));
+		hash = hashBytes(hash, &poly->flags, sizeof(poly->flags));
+		hash = hashBytes(hash, &poly->vertCount, sizeof(poly->vertCount));
+		hash = hashBytes(hash, &poly->areaAndtype, sizeof(poly->areaAndtype));
+	}
+	return hash;
+}
+
+static void getPolyCenter(const dtMeshTile* tile, const dtPoly* poly, float* center)
+{
+	dtVset(center, 0, 0, 0);
+	for (int i = 0; i < (int)poly->vertCount; ++i)
+		dtVadd(center, center, &tile->verts[poly->verts[i]*3]);
+	dtVscale(center, center, 1.0f/(float)poly->vertCount);
+}
+
+/// @class dtNavMeshLandmarks
+///
+/// The distances are computed with a Dijkstra search over the same graph dtNavMeshQuery::findPath
+/// searches: the search states are the portals between polygons, and moving from one portal of
+/// a polygon to another costs dtQueryFilter::getCost() for that polygon. Each polygon stores the
+/// smallest and the largest cost of the portals it can be entered through, so the lower bound
+/// stays admissible whichever portal the path query enters a polygon through. Off-mesh connections
+/// can be one-way, so the costs to the landmark come from a second search over the reversed links
+/// and each bound uses the costs of its own direction.
+///
+/// A landmark that is out of date keeps its tables until update() recomputes it, but a path that
+/// passes a tile changed since then can be cheaper than they say. Such a path costs at least the
+/// straight line distance to the changed tiles and on to the goal at the cheapest area cost, so
+/// the bound of the landmark is limited to that.
+///
+/// Landmarks are placed by farthest point selection, which puts them at the extremes of the
+/// mesh where they give the best bounds.
+///
+/// @see dtNavMeshQuery::findPath
+
+dtNavMeshLandmarks::dtNavMeshLandmarks() :
+	m_nav(0),
+	m_filter(0),
+	m_maxLandmarks(0),
+	m_nlandmarks(0),
+	m_nactive(0),
+	m_nextUpdate(0),
+	m_ntiles(0),
+	m_tiles(0)
+{
+	memset(m_landmarks, 0, sizeof(m_landmarks));
+	memset(m_active, 0, sizeof(m_active));
+}
+
+dtNavMeshLandmarks::~dtNavMeshLandmarks()
+{
+	for (int i = 0; i < m_ntiles; ++i)
+		dtFree(m_tiles[i].bounds);
+	dtFree(m_tiles);
+}
+
+dtStatus dtNavMeshLandmarks::init(const dtNavMesh* nav, const dtQueryFilter* filter, const int maxLandmarks)
+{
+	if (!nav || !filter || maxLandmarks < 1 || maxLandmarks > DT_MAX_LANDMARKS)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	for (int i = 0; i < m_ntiles; ++i)
+		dtFree(m_tiles[i].bounds);
+	dtFree(m_tiles);
+	m_tiles = 0;
+	m_ntiles = 0;
+
+	dtStatus status = m_search.init(nav);
+	if (dtStatusFailed(status))
+		return status;
+
+	m_nav = nav;
+	m_filter = filter;
+	m_maxLandmarks = maxLandmarks;
+	m_nlandmarks = 0;
+	m_nactive = 0;
+	m_nextUpdate = 0;
+
+	m_ntiles = nav->getMaxTiles();
+	m_tiles = (dtLandmarkTile*)dtAlloc(sizeof(dtLandmarkTile)*m_ntiles, DT_ALLOC_PERM);
+	if (!m_tiles)
+	{
+		m_ntiles = 0;
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	memset(m_tiles, 0, sizeof(dtLandmarkTile)*m_ntiles);
+
+	return DT_SUCCESS;
+}
+
+// Syncs the per tile tables with the tiles of the navigation mesh, marking the landmarks out of
+// date where a tile was added, removed or rebuilt.
+void dtNavMeshLandmarks::refreshTiles()
+{
+	const int stride = m_maxLandmarks*4;
+
+	for (int i = 0; i < m_ntiles; ++i)
+	{
+		const dtMeshTile* tile = m_nav->getTile(i);
+		dtLandmarkTile& lt = m_tiles[i];
+
+		if (!tile->header)
+		{
+			if (lt.bounds)
+			{
+				dtFree(lt.bounds);
+				lt.bounds = 0;
+				lt.polyCount = 0;
+				markChanged(lt.bmin, lt.bmax);
+			}
+			continue;
+		}
+
+		if (lt.bounds && lt.salt == tile->salt && lt.polyCount == tile->header->polyCount)
+			continue;
+
+		if (lt.bounds)
+			markChanged(lt.bmin, lt.bmax);
+		dtFree(lt.bounds);
+		lt.polyCount = tile->header->polyCount;
+		lt.salt = tile->salt;
+		dtVcopy(lt.bmin, tile->header->bmin);
+		dtVcopy(lt.bmax, tile->header->bmax);
+		markChanged(lt.bmin, lt.bmax);
+		lt.bounds = (float*)dtAlloc(sizeof(float)*lt.polyCount*stride, DT_ALLOC_PERM);
+		if (lt.bounds)
+		{
+			for (int j = 0; j < lt.polyCount*m_maxLandmarks; ++j)
+			{
+				lt.bounds[j*4+0] = DT_LANDMARK_UNREACHABLE;
+				lt.bounds[j*4+1] = 0;
+				lt.bounds[j*4+2] = DT_LANDMARK_UNREACHABLE;
+				lt.bounds[j*4+3] = 0;
+			}
+		}
+		else
+		{
+			lt.polyCount = 0;
+		}
+	}
+}
+
+// Extends the changed area of all landmarks by the bounds of a changed tile.
+void dtNavMeshLandmarks::markChanged(const float* bmin, const float* bmax)
+{
+	for (int i = 0; i < m_nlandmarks; ++i)
+	{
+		dtLandmark& landmark = m_landmarks[i];
+		if (!landmark.stale)
+		{
+			landmark.stale = true;
+			dtVcopy(landmark.changeMin, bmin);
+			dtVcopy(landmark.changeMax, bmax);
+		}
+		else
+		{
+			dtVmin(landmark.changeMin, bmin);
+			dtVmax(landmark.changeMax, bmax);
+		}
+	}
+}
+
+void dtNavMeshLandmarks::updateActive()
+{
+	m_nactive = 0;
+	for (int i = 0; i < m_nlandmarks; ++i)
+	{
+		if (m_landmarks[i].valid)
+			m_active[m_nactive++] = i;
+	}
+}
+
+void dtNavMeshLandmarks::invalidate()
+{
+	for (int i = 0; i < m_nlandmarks; ++i)
+		m_landmarks[i].valid = false;
+	m_nactive = 0;
+}
+
+void dtNavMeshLandmarks::invalidateTile(dtTileRef ref)
+{
+	if (!m_nav)
+		return;
+	const dtMeshTile* tile = m_nav->getTileByRef(ref);
+	if (tile && tile->header)
+		markChanged(tile->header->bmin, tile->header->bmax);
+}
+
+// Finds the polygon a landmark position lies on, so landmarks survive rebuilds of their tile.
+dtPolyRef dtNavMeshLandmarks::findPolyAt(const float* pos) const
+{
+	static const int MAX_LAYERS = 32;
+	const dtMeshTile* tiles[MAX_LAYERS];
+	int tx, ty;
+	m_nav->calcTileLoc(pos, &tx, &ty);
+	const int ntiles = m_nav->getTilesAt(tx, ty, tiles, MAX_LAYERS);
+
+	dtPolyRef best = 0;
+	float bestDist = FLT_MAX;
+	float verts[DT_VERTS_PER_POLYGON*3];
+
+	for (int i = 0; i < ntiles; ++i)
+	{
+		const dtMeshTile* tile = tiles[i];
+		const dtPolyRef base = m_nav->getPolyRefBase(tile);
+		for (int j = 0; j < tile->header->polyCount; ++j)
+		{
+			const dtPoly* poly = &tile->polys[j];
+			if (poly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+				continue;
+			if (!m_filter->passFilter(base | (dtPolyRef)j, tile, poly))
+				continue;
+
+			const int nv = (int)poly->vertCount;
+			for (int k = 0; k < nv; ++k)
+				dtVcopy(&verts[k*3], &tile->verts[poly->verts[k]*3]);
+			if (!dtPointInPolygon(pos, verts, nv))
+				continue;
+
+			float center[3];
+			getPolyCenter(tile, poly, center);
+			const float d = dtAbs(center[1] - pos[1]);
+			if (d < bestDist)
+			{
+				bestDist = d;
+				best = base | (dtPolyRef)j;
+			}
+		}
+	}
+
+	return best;
+}
+
+// Records the distances from or to a landmark into the tables of the polygons the search reaches.
+class dtNavMeshLandmarks::dtLandmarkVisitor : public dtPortalSearchVisitor
+{
+public:
+	dtLandmarkVisitor(dtNavMeshLandmarks* landmarks, const int idx, const int offset) :
+		m_landmarks(landmarks),
+		m_idx(idx),
+		m_offset(offset)
+	{
+	}
+
+	virtual void visit(dtPolyRef ref, dtPolyRef /*fromRef*/, float cost)
+	{
+		const dtNavMesh* nav = m_landmarks->m_nav;
+		const dtLandmarkTile& lt = m_landmarks->m_tiles[nav->decodePolyIdTile(ref)];
+		const unsigned int ip = nav->decodePolyIdPoly(ref);
+		float* b = &lt.bounds[(ip*m_landmarks->m_maxLandmarks + m_idx)*4 + m_offset];
+		b[0] = dtMin(b[0], cost);
+		b[1] = dtMax(b[1], cost);
+	}
+
+private:
+	dtNavMeshLandmarks* m_landmarks;
+	int m_idx;
+	int m_offset;		///< 0 for the costs from the landmark, 2 for the costs to it.
+};
+
+dtStatus dtNavMeshLandmarks::computeLandmark(const int idx)
+{
+	dtLandmark& landmark = m_landmarks[idx];
+	landmark.valid = false;
+	landmark.stale = false;
+	if (!landmark.ref || !m_nav->isValidPolyRef(landmark.ref))
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	// Reset the tables of the landmark.
+	for (int i = 0; i < m_ntiles; ++i)
+	{
+		dtLandmarkTile& lt = m_tiles[i];
+		if (!lt.bounds)
+			continue;
+
+		for (int j = 0; j < lt.polyCount; ++j)
+		{
+			float* b = &lt.bounds[(j*m_maxLandmarks + idx)*4];
+			b[0] = DT_LANDMARK_UNREACHABLE;
+			b[1] = 0;
+			b[2] = DT_LANDMARK_UNREACHABLE;
+			b[3] = 0;
+		}
+	}
+
+	const unsigned int startTileIdx = m_nav->decodePolyIdTile(landmark.ref);
+	const unsigned int startPolyIdx = m_nav->decodePolyIdPoly(landmark.ref);
+	if (!m_tiles[startTileIdx].bounds)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	float* start = &m_tiles[startTileIdx].bounds[(startPolyIdx*m_maxLandmarks + idx)*4];
+	start[0] = 0;
+	start[2] = 0;
+
+	dtLandmarkVisitor fromVisitor(this, idx, 0);
+	dtStatus status = m_search.search(landmark.ref, landmark.pos, m_filter, FLT_MAX, &fromVisitor);
+
+	// A landmark with missing distances would overestimate, so it is only used if complete.
+	if (dtStatusFailed(status))
+		return status;
+
+	dtLandmarkVisitor toVisitor(this, idx, 2);
+	status = m_search.searchBackward(landmark.ref, landmark.pos, m_filter, FLT_MAX, &toVisitor);
+	if (dtStatusFailed(status))
+		return status;
+
+	landmark.valid = true;
+	return DT_SUCCESS;
+}
+
+dtStatus dtNavMeshLandmarks::build(const int landmarkCount)
+{
+	if (!m_nav || !m_tiles)
+		return DT_FAILURE;
+
+	refreshTiles();
+	m_nlandmarks = 0;
+	m_nactive = 0;
+	m_nextUpdate = 0;
+
+	const int count = dtMin(landmarkCount, m_maxLandmarks);
+	if (count < 1)
+		return DT_SUCCESS;
+
+	// Seed the selection with the first polygon passing the filter.
+	dtPolyRef seed = 0;
+	for (int i = 0; i < m_ntiles && !seed; ++i)
+	{
+		const dtMeshTile* tile = m_nav->getTile(i);
+		if (!tile->header)
+			continue;
+		const dtPolyRef base = m_nav->getPolyRefBase(tile);
+		for (int j = 0; j < tile->header->polyCount; ++j)
+		{
+			const dtPoly* poly = &tile->polys[j];
+			if (poly->getType() != DT_POLYTYPE_OFFMESH_CONNECTION &&
+				m_filter->passFilter(base | (dtPolyRef)j, tile, poly))
+			{
+				seed = base | (dtPolyRef)j;
+				break;
+			}
+		}
+	}
+	if (!seed)
+		return DT_FAILURE;
+
+	// The first landmark goes to the polygon farthest from the seed, each following one to the
+	// polygon farthest from all landmarks placed so far.
+	dtLandmark& first = m_landmarks[0];
+	first.ref = seed;
+	{
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		m_nav->getTileAndPolyByRefUnsafe(seed, &tile, &poly);
+		getPolyCenter(tile, poly, first.pos);
+	}
+	dtStatus status = computeLandmark(0);
+	if (dtStatusFailed(status))
+		return status;
+
+	for (int n = 0; n < count; ++n)
+	{
+		// While the first landmark is placed slot 0 still holds the distances from the seed.
+		const int placed = n == 0 ? 1 : n;
+		dtPolyRef best = 0;
+		float bestDist = -1.0f;
+		float bestPos[3] = { 0, 0, 0 };
+
+		for (int i = 0; i < m_ntiles; ++i)
+		{
+			const dtMeshTile* tile = m_nav->getTile(i);
+			const dtLandmarkTile& lt = m_tiles[i];
+			if (!tile->header || !lt.bounds)
+				continue;
+			const dtPolyRef base = m_nav->getPolyRefBase(tile);
+
+			for (int j = 0; j < lt.polyCount; ++j)
+			{
+				const dtPoly* poly = &tile->polys[j];
+				if (poly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+					continue;
+
+				float d = FLT_MAX;
+				for (int k = 0; k < placed; ++k)
+					d = dtMin(d, lt.bounds[(j*m_maxLandmarks + k)*4]);
+				if (d == DT_LANDMARK_UNREACHABLE || d <= bestDist)
+					continue;
+
+				bestDist = d;
+				best = base | (dtPolyRef)j;
+				getPolyCenter(tile, poly, bestPos);
+			}
+		}
+
+		if (!best)
+			break;
+
+		dtLandmark& landmark = m_landmarks[n];
+		landmark.ref = best;
+		dtVcopy(landmark.pos, bestPos);
+		m_nlandmarks = n+1;
+
+		status = computeLandmark(n);
+		if (dtStatusFailed(status))
+			break;
+	}
+
+	updateActive();
+	return status;
+}
+
+dtStatus dtNavMeshLandmarks::update(const int maxLandmarks, bool* upToDate)
+{
+	if (upToDate)
+		*upToDate = false;
+	if (!m_nav || !m_tiles)
+		return DT_FAILURE;
+
+	// Changed tiles lose their tables. Any change can alter the distances elsewhere too, but
+	// the old tables stay in use away from the changes until their landmark is recomputed.
+	refreshTiles();
+
+	dtStatus status = DT_SUCCESS;
+	int n = 0;
+	bool done = true;
+
+	// Start after the landmark recomputed last, so a mesh that changes on every call cannot
+	// keep the later landmarks waiting.
+	for (int j = 0; j < m_nlandmarks; ++j)
+	{
+		const int i = (m_nextUpdate + j) % m_nlandmarks;
+		dtLandmark& landmark = m_landmarks[i];
+		if (landmark.valid && !landmark.stale)
+			continue;
+		if (n >= maxLandmarks)
+		{
+			done = false;
+			break;
+		}
+
+		if (!landmark.ref || !m_nav->isValidPolyRef(landmark.ref))
+			landmark.ref = findPolyAt(landmark.pos);
+		if (!landmark.ref)
+		{
+			// The ground under the landmark is gone, leave it unused.
+			landmark.valid = false;
+			continue;
+		}
+
+		status |= computeLandmark(i);
+		m_nextUpdate = (i+1) % m_nlandmarks;
+		n++;
+	}
+
+	updateActive();
+	if (upToDate)
+		*upToDate = done;
+
+	return status;
+}
+
+// The distance on the xz-plane from a position to a box, zero inside it.
+static float distToBox2D(const float* pos, const float* bmin, const float* bmax)
+{
+	const float dx = dtMax(0.0f, dtMax(bmin[0] - pos[0], pos[0] - bmax[0]));
+	const float dz = dtMax(0.0f, dtMax(bmin[2] - pos[2], pos[2] - bmax[2]));
+	return dtMathSqrtf(dx*dx + dz*dz);
+}
+
+bool dtNavMeshLandmarks::getGoalBounds(dtPolyRef ref, const float* pos, dtLandmarkGoal* goal) const
+{
+	if (!m_nactive || !ref)
+		return false;
+
+	const unsigned int it = m_nav->decodePolyIdTile(ref);
+	if ((int)it >= m_ntiles)
+		return false;
+	const dtLandmarkTile& lt = m_tiles[it];
+	const unsigned int ip = m_nav->decodePolyIdPoly(ref);
+	if (!lt.bounds || lt.salt != m_nav->decodePolyIdSalt(ref) || (int)ip >= lt.polyCount)
+		return false;
+
+	memcpy(goal->bounds, &lt.bounds[ip*m_maxLandmarks*4], sizeof(float)*m_maxLandmarks*4);
+
+	// The costs to the landmarks are known from the portals of the goal polygon, the goal position
+	// can be up to the farthest vertex away from them.
+	const dtMeshTile* tile = 0;
+	const dtPoly* poly = 0;
+	m_nav->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+	float cross = 0;
+	for (int i = 0; i < (int)poly->vertCount; ++i)
+	{
+		const float* v = &tile->verts[poly->verts[i]*3];
+		cross = dtMax(cross, m_filter->getCost(pos, v, 0, 0, 0, ref, tile, poly, 0, 0, 0));
+	}
+	for (int i = 0; i < m_maxLandmarks; ++i)
+		goal->bounds[i*4+3] += cross;
+
+	goal->minCost = FLT_MAX;
+	for (int i = 0; i < DT_MAX_AREAS; ++i)
+		goal->minCost = dtMin(goal->minCost, m_filter->getAreaCost(i));
+	goal->minCost = dtMax(goal->minCost, 0.0f);
+
+	for (int i = 0; i < m_nactive; ++i)
+	{
+		const dtLandmark& landmark = m_landmarks[m_active[i]];
+		if (landmark.stale)
+			goal->changeCost[m_active[i]] = distToBox2D(pos, landmark.changeMin, landmark.changeMax)*goal->minCost;
+	}
+	return true;
+}
+
+float dtNavMeshLandmarks::getLowerBound(dtPolyRef ref, const float* pos, const dtLandmarkGoal* goal) const
+{
+	const unsigned int it = m_nav->decodePolyIdTile(ref);
+	const dtLandmarkTile& lt = m_tiles[it];
+	if (!lt.bounds || lt.salt != m_nav->decodePolyIdSalt(ref))
+		return 0;
+
+	const float* b = &lt.bounds[m_nav->decodePolyIdPoly(ref)*m_maxLandmarks*4];
+	float h = 0;
+	for (int i = 0; i < m_nactive; ++i)
+	{
+		const int idx = m_active[i];
+		const float* lb = &b[idx*4];
+		const float* gb = &goal->bounds[idx*4];
+
+		// Costs from the landmark bound the path from below by how much farther the goal is, costs
+		// to it by how much closer. One-way links make the two differ.
+		float hl = 0;
+		if (lb[0] != DT_LANDMARK_UNREACHABLE && gb[0] != DT_LANDMARK_UNREACHABLE)
+			hl = gb[0] - lb[1];
+		if (lb[2] != DT_LANDMARK_UNREACHABLE && gb[2] != DT_LANDMARK_UNREACHABLE)
+			hl = dtMax(hl, lb[2] - gb[3]);
+
+		const dtLandmark& landmark = m_landmarks[idx];
+		if (landmark.stale && hl > h)
+			hl = dtMin(hl, distToBox2D(pos, landmark.changeMin, landmark.changeMax)*goal->minCost + goal->changeCost[idx]);
+
+		h = dtMax(h, hl);
+	}
+	return h;
+}
+
+int dtNavMeshLandmarks::getDataSize() const
+{
+	int size = sizeof(dtLandmarksHeader) + sizeof(float)*3*m_nlandmarks;
+	for (int i = 0; i < m_ntiles; ++i)
+	{
+		if (!m_tiles[i].bounds)
+			continue;
+		size += sizeof(dtLandmarksTileHeader) + sizeof(float)*m_tiles[i].polyCount*m_maxLandmarks*4;
+	}
+	return size;
+}
+
+dtStatus dtNavMeshLandmarks::storeData(unsigned char* data, const int maxDataSize) const
+{
+	if (!m_nav || !m_tiles)
+		return DT_FAILURE;
+	if (maxDataSize < getDataSize())
+		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+
+	dtLandmarksHeader header;
+	header.magic = DT_LANDMARKS_MAGIC;
+	header.version = DT_LANDMARKS_VERSION;
+	header.maxLandmarks = m_maxLandmarks;
+	header.landmarkCount = m_nlandmarks;
+	header.tileCount = 0;
+	for (int i = 0; i < m_ntiles; ++i)
+	{
+		if (m_tiles[i].bounds)
+			header.tileCount++;
+	}
+
+	memcpy(data, &header, sizeof(header));
+	data += sizeof(header);
+
+	for (int i = 0; i < m_nlandmarks; ++i)
+	{
+		memcpy(data, m_landmarks[i].pos, sizeof(float)*3);
+		data += sizeof(float)*3;
+	}
+
+	for (int i = 0; i < m_ntiles; ++i)
+	{
+		const dtLandmarkTile& lt = m_tiles[i];
+		if (!lt.bounds)
+			continue;
+
+		const dtMeshTile* tile = m_nav->getTile(i);
+		dtLandmarksTileHeader tileHeader;
+		tileHeader.x = tile->header->x;
+		tileHeader.y = tile->header->y;
+		tileHeader.layer = tile->header->layer;
+		tileHeader.polyCount = lt.polyCount;
+		tileHeader.hash = hashTile(tile);
+		memcpy(data, &tileHeader, sizeof(tileHeader));
+		data += sizeof(tileHeader);
+
+		const int size = sizeof(float)*lt.polyCount*m_maxLandmarks*4;
+		memcpy(data, lt.bounds, size);
+		data += size;
+	}
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtNavMeshLandmarks::restoreData(const unsigned char* data, const int dataSize)
+{
+	if (!m_nav || !m_tiles)
+		return DT_FAILURE;
+	if (dataSize < (int)sizeof(dtLandmarksHeader))
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	dtLandmarksHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != DT_LANDMARKS_MAGIC)
+		return DT_FAILURE | DT_WRONG_MAGIC;
+	if (header.version != DT_LANDMARKS_VERSION)
+		return DT_FAILURE | DT_WRONG_VERSION;
+	if (header.maxLandmarks != m_maxLandmarks || header.landmarkCount > m_maxLandmarks || header.landmarkCount < 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const unsigned char* end = data + dataSize;
+	data += sizeof(header);
+
+	if (end - data < (int)sizeof(float)*3*header.landmarkCount)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	refreshTiles();
+
+	m_nlandmarks = header.landmarkCount;
+	m_nextUpdate = 0;
+	for (int i = 0; i < m_nlandmarks; ++i)
+	{
+		memcpy(m_landmarks[i].pos, data, sizeof(float)*3);
+		data += sizeof(float)*3;
+		m_landmarks[i].ref = findPolyAt(m_landmarks[i].pos);
+		m_landmarks[i].valid = false;
+		m_landmarks[i].stale = false;
+	}
+
+	// The tables are only trusted if they cover exactly the tiles of the current mesh.
+	bool complete = true;
+	int restored = 0;
+
+	for (int i = 0; i < header.tileCount; ++i)
+	{
+		if (end - data < (int)sizeof(dtLandmarksTileHeader))
+			return DT_FAILURE | DT_INVALID_PARAM;
+
+		dtLandmarksTileHeader tileHeader;
+		memcpy(&tileHeader, data, sizeof(tileHeader));
+		data += sizeof(tileHeader);
+
+		const int size = sizeof(float)*tileHeader.polyCount*m_maxLandmarks*4;
+		if (tileHeader.polyCount < 0 || end - data < size)
+			return DT_FAILURE | DT_INVALID_PARAM;
+
+		const dtMeshTile* tile = m_nav->getTileAt(tileHeader.x, tileHeader.y, tileHeader.layer);
+		if (tile && tile->header->polyCount == tileHeader.polyCount && hashTile(tile) == tileHeader.hash)
+		{
+			dtLandmarkTile& lt = m_tiles[m_nav->decodePolyIdTile(m_nav->getPolyRefBase(tile))];
+			if (lt.bounds && lt.polyCount == tileHeader.polyCount)
+			{
+				memcpy(lt.bounds, data, size);
+				restored++;
+			}
+			else
+			{
+				complete = false;
+			}
+		}
+		else
+		{
+			complete = false;
+		}
+
+		data += size;
+	}
+
+	int tileCount = 0;
+	for (int i = 0; i < m_ntiles; ++i)
+	{
+		if (m_tiles[i].bounds)
+			tileCount++;
+	}
+
+	if (complete && restored == tileCount)
+	{
+		for (int i = 0; i < m_nlandmarks; ++i)
+			m_landmarks[i].valid = m_landmarks[i].ref != 0;
+	}
+
+	updateActive();
+	return DT_SUCCESS;
+}
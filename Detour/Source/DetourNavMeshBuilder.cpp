@@ -37,37 +37,38 @@ struct BVItem
 	int i;
 };
 
-static int compareItemX(const void* va, const void* vb)
+// Reorders items[imin..imax) along an axis so that the item at k is the one that would be there
+// if the range was sorted, with no larger items before it and no smaller items after it. The
+// subdivision only needs the two halves, which this finds in linear time instead of sorting.
+static void selectItems(BVItem* items, const int imin, const int imax, const int k, const int axis)
 {
-	const BVItem* a = (const BVItem*)va;
-	const BVItem* b = (const BVItem*)vb;
-	if (a->bmin[0] < b->bmin[0])
-		return -1;
-	if (a->bmin[0] > b->bmin[0])
-		return 1;
-	return 0;
-}
-
-static int compareItemY(const void* va, const void* vb)
-{
-	const BVItem* a = (const BVItem*)va;
-	const BVItem* b = (const BVItem*)vb;
-	if (a->bmin[1] < b->bmin[1])
-		return -1;
-	if (a->bmin[1] > b->bmin[1])
-		return 1;
-	return 0;
-}
-
-static int compareItemZ(const void* va, const void* vb)
-{
-	const BVItem* a = (const BVItem*)va;
-	const BVItem* b = (const BVItem*)vb;
-	if (a->bmin[2] < b->bmin[2])
-		return -1;
-	if (a->bmin[2] > b->bmin[2])
-		return 1;
-	return 0;
+	int lo = imin;
+	int hi = imax-1;
+	while (lo < hi)
+	{
+		const unsigned short pivot = items[lo + (hi-lo)/2].bmin[axis];
+		int i = lo;
+		int j = hi;
+		while (i <= j)
+		{
+			while (items[i].bmin[axis] < pivot) i++;
+			while (items[j].bmin[axis] > pivot) j--;
+			if (i <= j)
+			{
+				const BVItem tmp = items[i];
+				items[i] = items[j];
+				items[j] = tmp;
+				i++;
+				j--;
+			}
+		}
+		if (k <= j)
+			hi = j;
+		else if (k >= i)
+			lo = i;
+		else
+			break;
+	}
 }
 
 static void calcExtends(BVItem* items, const int /*nitems*/, const int imin, const int imax,
@@ -139,24 +140,12 @@ static void subdivide(BVItem* items, int nitems, int imin, int imax, int& curNod
 							   node.bmax[1] - node.bmin[1],
 							   node.bmax[2] - node.bmin[2]);
 		
-		if (axis == 0)
-		{
-			// Sort along x-axis
-			qsort(items+imin, inum, sizeof(BVItem), compareItemX);
-		}
-		else if (axis == 1)
-		{
-			// Sort along y-axis
-			qsort(items+imin, inum, sizeof(BVItem), compareItemY);
-		}
-		else
-		{
-			// Sort along z-axis
-			qsort(items+imin, inum, sizeof(BVItem), compareItemZ);
-		}
-		
 		int isplit = imin+inum/2;
 		
+		// Split at the median along the axis.
+		selectItems(items, imin, imax, isplit, axis);
+		
+		
 		// Left
 		subdivide(items, nitems, imin, isplit, curNode, nodes);
 		// Right
@@ -17,6 +17,7 @@
 //
 
 #include <float.h>
+#include <stdlib.h>
 #include <string.h>
 #include "DetourNavMeshQuery.h"
 #include "DetourNavMesh.h"
@@ -25,6 +26,7 @@
 #include "DetourMath.h"
 #include "DetourAlloc.h"
 #include "DetourAssert.h"
+#include "DetourPolyMask.h"
 #include <new>
 
 /// @class dtQueryFilter
@@ -102,6 +104,36 @@ inline float dtQueryFilter::getCost(const float* pa, const float* pb,
 	
 static const float H_SCALE = 0.999f; // Search heuristic scale.
 
+// Filter calls of the queries that are implemented for both dtQueryFilter and dtPolyMaskFilter.
+// Generic filters are called through their virtual functions, mask filters are inlined.
+static inline bool dtPassFilter(const dtQueryFilter* filter,
+								const dtPolyRef ref, const dtMeshTile* tile, const dtPoly* poly)
+{
+	return filter->passFilter(ref, tile, poly);
+}
+
+static inline bool dtPassFilter(const dtPolyMaskFilter* filter,
+								const dtPolyRef ref, const dtMeshTile* tile, const dtPoly* poly)
+{
+	return filter->passMask(ref, tile, poly);
+}
+
+static inline float dtFilterCost(const dtQueryFilter* filter, const float* pa, const float* pb,
+								 const dtPolyRef prevRef, const dtMeshTile* prevTile, const dtPoly* prevPoly,
+								 const dtPolyRef curRef, const dtMeshTile* curTile, const dtPoly* curPoly,
+								 const dtPolyRef nextRef, const dtMeshTile* nextTile, const dtPoly* nextPoly)
+{
+	return filter->getCost(pa, pb, prevRef, prevTile, prevPoly, curRef, curTile, curPoly, nextRef, nextTile, nextPoly);
+}
+
+static inline float dtFilterCost(const dtPolyMaskFilter* filter, const float* pa, const float* pb,
+								 const dtPolyRef /*prevRef*/, const dtMeshTile* /*prevTile*/, const dtPoly* /*prevPoly*/,
+								 const dtPolyRef /*curRef*/, const dtMeshTile* curTile, const dtPoly* curPoly,
+								 const dtPolyRef /*nextRef*/, const dtMeshTile* /*nextTile*/, const dtPoly* /*nextPoly*/)
+{
+	return filter->getMaskCost(pa, pb, curTile, curPoly);
+}
+
 
 dtNavMeshQuery* dtAllocNavMeshQuery()
 {
@@ -762,6 +794,21 @@ public:
 dtStatus dtNavMeshQuery::findNearestPoly(const float* center, const float* halfExtents,
 										 const dtQueryFilter* filter,
 										 dtPolyRef* nearestRef, float* nearestPt) const
+{
+	return findNearestPolyT(center, halfExtents, filter, nearestRef, nearestPt);
+}
+
+dtStatus dtNavMeshQuery::findNearestPoly(const float* center, const float* halfExtents,
+										 const dtPolyMaskFilter* filter,
+										 dtPolyRef* nearestRef, float* nearestPt) const
+{
+	return findNearestPolyT(center, halfExtents, filter, nearestRef, nearestPt);
+}
+
+template <class TFilter>
+dtStatus dtNavMeshQuery::findNearestPolyT(const float* center, const float* halfExtents,
+										  const TFilter* filter,
+										  dtPolyRef* nearestRef, float* nearestPt) const
 {
 	dtAssert(m_nav);
 
@@ -783,8 +830,446 @@ dtStatus dtNavMeshQuery::findNearestPoly(const float* center, const float* halfE
 	return DT_SUCCESS;
 }
 
+// A polygon gathered by findNearestPolys() for a group of nearby points.
+struct dtBatchPoly
+{
+	dtPolyRef ref;
+	unsigned short qmin[3], qmax[3];	///< Bounds of the BV tree leaf, if the tile has a tree.
+	float bmin[3], bmax[3];				///< Bounds of the polygon vertices, if the tile has no tree.
+};
+
+// The polygons of one tile gathered for a group of points.
+struct dtBatchTile
+{
+	const dtMeshTile* tile;
+	int first;
+	int count;
+};
+
+// A point of findNearestPolys(), the tile it lies in and the cell of the tile.
+struct dtBatchPoint
+{
+	int tx, ty;
+	int cx, cy;
+	int idx;
+};
+
+static int compareBatchPoints(const void* va, const void* vb)
+{
+	const dtBatchPoint* a = (const dtBatchPoint*)va;
+	const dtBatchPoint* b = (const dtBatchPoint*)vb;
+	if (a->ty != b->ty)
+		return a->ty < b->ty ? -1 : 1;
+	if (a->tx != b->tx)
+		return a->tx < b->tx ? -1 : 1;
+	if (a->cy != b->cy)
+		return a->cy < b->cy ? -1 : 1;
+	if (a->cx != b->cx)
+		return a->cx < b->cx ? -1 : 1;
+	return a->idx < b->idx ? -1 : (a->idx > b->idx ? 1 : 0);
+}
+
+// Quantizes a query box into the BV tree space of a tile, the same way queryPolygonsInTile() does.
+static void quantizeQueryBox(const dtMeshTile* tile, const float* qmin, const float* qmax,
+							 unsigned short* bmin, unsigned short* bmax)
+{
+	const float* tbmin = tile->header->bmin;
+	const float* tbmax = tile->header->bmax;
+	const float qfac = tile->header->bvQuantFactor;
+	for (int i = 0; i < 3; ++i)
+	{
+		const float minv = dtClamp(qmin[i], tbmin[i], tbmax[i]) - tbmin[i];
+		const float maxv = dtClamp(qmax[i], tbmin[i], tbmax[i]) - tbmin[i];
+		bmin[i] = (unsigned short)(qfac * minv) & 0xfffe;
+		bmax[i] = (unsigned short)(qfac * maxv + 1) | 1;
+	}
+}
+
+// Scratch storage of findNearestPolys(). The candidate polygons are gathered once per group of
+// points, and the xz-bounds are kept in separate arrays so the distance bounds of all candidates
+// of a tile are computed in one loop the compiler can vectorize.
+class dtNearestPolyBatch
+{
+public:
+	dtBatchPoint* points;
+	dtBatchTile* tiles;
+	int ntiles, maxTiles;
+	dtBatchPoly* polys;
+	float* xmin;
+	float* xmax;
+	float* zmin;
+	float* zmax;
+	float* lowerBound;
+	int npolys, maxPolys;
+
+	dtNearestPolyBatch() :
+		points(0), tiles(0), ntiles(0), maxTiles(0), polys(0),
+		xmin(0), xmax(0), zmin(0), zmax(0), lowerBound(0), npolys(0), maxPolys(0)
+	{
+	}
+
+	~dtNearestPolyBatch()
+	{
+		dtFree(points);
+		dtFree(tiles);
+		freePolys();
+	}
+
+	bool init(const int npoints)
+	{
+		points = (dtBatchPoint*)dtAlloc(sizeof(dtBatchPoint)*npoints, DT_ALLOC_TEMP);
+		return points != 0;
+	}
+
+	dtBatchTile* addTile(const dtMeshTile* tile)
+	{
+		if (ntiles >= maxTiles)
+		{
+			const int n = maxTiles ? maxTiles*2 : 16;
+			dtBatchTile* t = (dtBatchTile*)dtAlloc(sizeof(dtBatchTile)*n, DT_ALLOC_TEMP);
+			if (!t)
+				return 0;
+			if (ntiles)
+				memcpy(t, tiles, sizeof(dtBatchTile)*ntiles);
+			dtFree(tiles);
+			tiles = t;
+			maxTiles = n;
+		}
+		dtBatchTile* t = &tiles[ntiles++];
+		t->tile = tile;
+		t->first = npolys;
+		t->count = 0;
+		return t;
+	}
+
+	dtBatchPoly* addPoly(const dtMeshTile* tile, const dtPoly* poly, dtPolyRef ref)
+	{
+		if (npolys >= maxPolys && !growPolys())
+			return 0;
+
+		const int i = npolys++;
+		const float* v = &tile->verts[poly->verts[0]*3];
+		float bmin[3], bmax[3];
+		dtVcopy(bmin, v);
+		dtVcopy(bmax, v);
+		for (int j = 1; j < poly->vertCount; ++j)
+		{
+			v = &tile->verts[poly->verts[j]*3];
+			dtVmin(bmin, v);
+			dtVmax(bmax, v);
+		}
+		// The nearest point found on a polygon never leaves its xz-bounds.
+		xmin[i] = bmin[0];
+		xmax[i] = bmax[0];
+		zmin[i] = bmin[2];
+		zmax[i] = bmax[2];
+
+		dtBatchPoly* p = &polys[i];
+		p->ref = ref;
+		dtVcopy(p->bmin, bmin);
+		dtVcopy(p->bmax, bmax);
+		return p;
+	}
+
+private:
+	void freePolys()
+	{
+		dtFree(polys);
+		dtFree(xmin);
+		dtFree(xmax);
+		dtFree(zmin);
+		dtFree(zmax);
+		dtFree(lowerBound);
+	}
+
+	bool growPolys()
+	{
+		const int n = maxPolys ? maxPolys*2 : 256;
+		dtBatchPoly* p = (dtBatchPoly*)dtAlloc(sizeof(dtBatchPoly)*n, DT_ALLOC_TEMP);
+		float* x0 = (float*)dtAlloc(sizeof(float)*n, DT_ALLOC_TEMP);
+		float* x1 = (float*)dtAlloc(sizeof(float)*n, DT_ALLOC_TEMP);
+		float* z0 = (float*)dtAlloc(sizeof(float)*n, DT_ALLOC_TEMP);
+		float* z1 = (float*)dtAlloc(sizeof(float)*n, DT_ALLOC_TEMP);
+		float* lb = (float*)dtAlloc(sizeof(float)*n, DT_ALLOC_TEMP);
+		if (!p || !x0 || !x1 || !z0 || !z1 || !lb)
+		{
+			dtFree(p); dtFree(x0); dtFree(x1); dtFree(z0); dtFree(z1); dtFree(lb);
+			return false;
+		}
+		if (npolys)
+		{
+			memcpy(p, polys, sizeof(dtBatchPoly)*npolys);
+			memcpy(x0, xmin, sizeof(float)*npolys);
+			memcpy(x1, xmax, sizeof(float)*npolys);
+			memcpy(z0, zmin, sizeof(float)*npolys);
+			memcpy(z1, zmax, sizeof(float)*npolys);
+		}
+		freePolys();
+		polys = p;
+		xmin = x0;
+		xmax = x1;
+		zmin = z0;
+		zmax = z1;
+		lowerBound = lb;
+		maxPolys = n;
+		return true;
+	}
+};
+
+// Gathers the polygons of a tile that overlap a query box, in the order queryPolygonsInTile()
+// visits them.
+static bool collectBatchPolys(const dtNavMesh* nav, const dtMeshTile* tile, const float* qmin, const float* qmax,
+							  const dtQueryFilter* filter, dtNearestPolyBatch& batch)
+{
+	dtBatchTile* bt = batch.addTile(tile);
+	if (!bt)
+		return false;
+
+	const dtPolyRef base = nav->getPolyRefBase(tile);
+
+	if (tile->bvTree)
+	{
+		unsigned short bmin[3], bmax[3];
+		quantizeQueryBox(tile, qmin, qmax, bmin, bmax);
+
+		const dtBVNode* node = &tile->bvTree[0];
+		const dtBVNode* end = &tile->bvTree[tile->header->bvNodeCount];
+		while (node < end)
+		{
+			const bool overlap = dtOverlapQuantBounds(bmin, bmax, node->bmin, node->bmax);
+			const bool isLeafNode = node->i >= 0;
+
+			if (isLeafNode && overlap)
+			{
+				const dtPolyRef ref = base | (dtPolyRef)node->i;
+				const dtPoly* poly = &tile->polys[node->i];
+				if (filter->passFilter(ref, tile, poly))
+				{
+					dtBatchPoly* p = batch.addPoly(tile, poly, ref);
+					if (!p)
+						return false;
+					for (int i = 0; i < 3; ++i)
+					{
+						p->qmin[i] = node->bmin[i];
+						p->qmax[i] = node->bmax[i];
+					}
+				}
+			}
+
+			if (overlap || isLeafNode)
+				node++;
+			else
+				node += -node->i;
+		}
+	}
+	else
+	{
+		for (int i = 0; i < tile->header->polyCount; ++i)
+		{
+			const dtPoly* poly = &tile->polys[i];
+			if (poly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+				continue;
+			const dtPolyRef ref = base | (dtPolyRef)i;
+			if (!filter->passFilter(ref, tile, poly))
+				continue;
+			dtBatchPoly* p = batch.addPoly(tile, poly, ref);
+			if (!p)
+				return false;
+			if (!dtOverlapBounds(qmin, qmax, p->bmin, p->bmax))
+				batch.npolys--;
+		}
+	}
+
+	bt = &batch.tiles[batch.ntiles-1];
+	bt->count = batch.npolys - bt->first;
+	return true;
+}
+
+/// @par
+///
+/// Gives the same results as calling findNearestPoly() for each point, but the points are sorted
+/// by the tile they lie in and grouped by cells of a few search boxes in size. The polygons around
+/// each group are gathered and filtered once.
+/// Polygons whose xz-bounds are further away than the nearest polygon found so far are skipped
+/// without computing the nearest point on them, which saves most of the work with large
+/// search boxes.
+///
+/// @note Points whose search box does not overlap any polygon get a zero @p nearestRefs entry,
+/// and their @p nearestPts entry is left unchanged.
+///
+dtStatus dtNavMeshQuery::findNearestPolys(const float* centers, const int count, const float* halfExtents,
+										  const dtQueryFilter* filter,
+										  dtPolyRef* nearestRefs, float* nearestPts) const
+{
+	dtAssert(m_nav);
+
+	if (!centers || count < 0 || !halfExtents || !filter || !nearestRefs)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (!count)
+		return DT_SUCCESS;
+
+	dtNearestPolyBatch batch;
+	if (!batch.init(count))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+	// Sort the points by the tile they lie in, then by cell. Cells a few times the size of the
+	// search box keep the gathered polygons close to the points of the group.
+	const dtNavMeshParams* params = m_nav->getParams();
+	const float cellw = dtMin(dtMax(halfExtents[0]*8.0f, 1.0f), params->tileWidth);
+	const float cellh = dtMin(dtMax(halfExtents[2]*8.0f, 1.0f), params->tileHeight);
+	for (int i = 0; i < count; ++i)
+	{
+		dtBatchPoint& pt = batch.points[i];
+		const float* pos = &centers[i*3];
+		m_nav->calcTileLoc(pos, &pt.tx, &pt.ty);
+		pt.cx = (int)dtMathFloorf((pos[0] - params->orig[0] - pt.tx*params->tileWidth) / cellw);
+		pt.cy = (int)dtMathFloorf((pos[2] - params->orig[2] - pt.ty*params->tileHeight) / cellh);
+		pt.idx = i;
+	}
+	qsort(batch.points, count, sizeof(dtBatchPoint), compareBatchPoints);
+
+	static const int MAX_NEIS = 32;
+	const dtMeshTile* neis[MAX_NEIS];
+
+	int group = 0;
+	while (group < count)
+	{
+		int groupEnd = group+1;
+		while (groupEnd < count &&
+			   batch.points[groupEnd].tx == batch.points[group].tx &&
+			   batch.points[groupEnd].ty == batch.points[group].ty &&
+			   batch.points[groupEnd].cx == batch.points[group].cx &&
+			   batch.points[groupEnd].cy == batch.points[group].cy)
+			groupEnd++;
+
+		// Gather the polygons in the union of the search boxes of the group.
+		float bmin[3], bmax[3];
+		dtVsub(bmin, &centers[batch.points[group].idx*3], halfExtents);
+		dtVadd(bmax, &centers[batch.points[group].idx*3], halfExtents);
+		for (int i = group+1; i < groupEnd; ++i)
+		{
+			float pmin[3], pmax[3];
+			dtVsub(pmin, &centers[batch.points[i].idx*3], halfExtents);
+			dtVadd(pmax, &centers[batch.points[i].idx*3], halfExtents);
+			dtVmin(bmin, pmin);
+			dtVmax(bmax, pmax);
+		}
+
+		int minx, miny, maxx, maxy;
+		m_nav->calcTileLoc(bmin, &minx, &miny);
+		m_nav->calcTileLoc(bmax, &maxx, &maxy);
+
+		batch.ntiles = 0;
+		batch.npolys = 0;
+		for (int y = miny; y <= maxy; ++y)
+		{
+			for (int x = minx; x <= maxx; ++x)
+			{
+				const int nneis = m_nav->getTilesAt(x, y, neis, MAX_NEIS);
+				for (int j = 0; j < nneis; ++j)
+				{
+					if (!collectBatchPolys(m_nav, neis[j], bmin, bmax, filter, batch))
+						return DT_FAILURE | DT_OUT_OF_MEMORY;
+				}
+			}
+		}
+
+		// Find the nearest polygon of each point among the gathered ones.
+		for (int i = group; i < groupEnd; ++i)
+		{
+			const int idx = batch.points[i].idx;
+			const float* center = &centers[idx*3];
+
+			float qmin[3], qmax[3];
+			dtVsub(qmin, center, halfExtents);
+			dtVadd(qmax, center, halfExtents);
+			int tminx, tminy, tmaxx, tmaxy;
+			m_nav->calcTileLoc(qmin, &tminx, &tminy);
+			m_nav->calcTileLoc(qmax, &tmaxx, &tmaxy);
+
+			float nearestDistanceSqr = FLT_MAX;
+			dtPolyRef nearestRef = 0;
+			float nearestPoint[3];
+			dtVcopy(nearestPoint, center);
+
+			for (int t = 0; t < batch.ntiles; ++t)
+			{
+				const dtBatchTile& bt = batch.tiles[t];
+				const dtMeshTile* tile = bt.tile;
+
+				// Only tiles findNearestPoly() would search for this point.
+				if (tile->header->x < tminx || tile->header->x > tmaxx ||
+					tile->header->y < tminy || tile->header->y > tmaxy)
+					continue;
+
+				const int first = bt.first;
+				const int last = bt.first + bt.count;
+
+				// Lower bounds of the distance to each polygon from its xz-bounds.
+				const float cx = center[0];
+				const float cz = center[2];
+				for (int k = first; k < last; ++k)
+				{
+					const float dx = dtMax(dtMax(batch.xmin[k] - cx, cx - batch.xmax[k]), 0.0f);
+					const float dz = dtMax(dtMax(batch.zmin[k] - cz, cz - batch.zmax[k]), 0.0f);
+					batch.lowerBound[k] = dx*dx + dz*dz;
+				}
+
+				unsigned short qbmin[3], qbmax[3];
+				if (tile->bvTree)
+					quantizeQueryBox(tile, qmin, qmax, qbmin, qbmax);
+
+				for (int k = first; k < last; ++k)
+				{
+					if (batch.lowerBound[k] >= nearestDistanceSqr)
+						continue;
+
+					const dtBatchPoly& p = batch.polys[k];
+					if (tile->bvTree ? !dtOverlapQuantBounds(qbmin, qbmax, p.qmin, p.qmax)
+									 : !dtOverlapBounds(qmin, qmax, p.bmin, p.bmax))
+						continue;
+
+					float closestPtPoly[3];
+					float diff[3];
+					bool posOverPoly = false;
+					float d;
+					closestPointOnPoly(p.ref, center, closestPtPoly, &posOverPoly);
+
+					// Same measure as findNearestPoly(), favouring polygons right below the point.
+					dtVsub(diff, center, closestPtPoly);
+					if (posOverPoly)
+					{
+						d = dtAbs(diff[1]) - tile->header->walkableClimb;
+						d = d > 0 ? d*d : 0;
+					}
+					else
+					{
+						d = dtVlenSqr(diff);
+					}
+
+					if (d < nearestDistanceSqr)
+					{
+						dtVcopy(nearestPoint, closestPtPoly);
+						nearestDistanceSqr = d;
+						nearestRef = p.ref;
+					}
+				}
+			}
+
+			nearestRefs[idx] = nearestRef;
+			if (nearestPts && nearestRef)
+				dtVcopy(&nearestPts[idx*3], nearestPoint);
+		}
+
+		group = groupEnd;
+	}
+
+	return DT_SUCCESS;
+}
+
+template <class TFilter>
 void dtNavMeshQuery::queryPolygonsInTile(const dtMeshTile* tile, const float* qmin, const float* qmax,
-										 const dtQueryFilter* filter, dtPolyQuery* query) const
+										 const TFilter* filter, dtPolyQuery* query) const
 {
 	dtAssert(m_nav);
 	static const int batchSize = 32;
@@ -827,7 +1312,7 @@ void dtNavMeshQuery::queryPolygonsInTile(const dtMeshTile* tile, const float* qm
 			if (isLeafNode && overlap)
 			{
 				dtPolyRef ref = base | (dtPolyRef)node->i;
-				if (filter->passFilter(ref, tile, &tile->polys[node->i]))
+				if (dtPassFilter(filter, ref, tile, &tile->polys[node->i]))
 				{
 					polyRefs[n] = ref;
 					polys[n] = &tile->polys[node->i];
@@ -865,7 +1350,7 @@ void dtNavMeshQuery::queryPolygonsInTile(const dtMeshTile* tile, const float* qm
 				continue;
 			// Must pass filter
 			const dtPolyRef ref = base | (dtPolyRef)i;
-			if (!filter->passFilter(ref, tile, p))
+			if (!dtPassFilter(filter, ref, tile, p))
 				continue;
 			// Calc polygon bounds.
 			const float* v = &tile->verts[p->verts[0]*3];
@@ -969,6 +1454,19 @@ dtStatus dtNavMeshQuery::queryPolygons(const float* center, const float* halfExt
 ///
 dtStatus dtNavMeshQuery::queryPolygons(const float* center, const float* halfExtents,
 									   const dtQueryFilter* filter, dtPolyQuery* query) const
+{
+	return queryPolygonsT(center, halfExtents, filter, query);
+}
+
+dtStatus dtNavMeshQuery::queryPolygons(const float* center, const float* halfExtents,
+									   const dtPolyMaskFilter* filter, dtPolyQuery* query) const
+{
+	return queryPolygonsT(center, halfExtents, filter, query);
+}
+
+template <class TFilter>
+dtStatus dtNavMeshQuery::queryPolygonsT(const float* center, const float* halfExtents,
+										const TFilter* filter, dtPolyQuery* query) const
 {
 	dtAssert(m_nav);
 
@@ -1013,10 +1511,34 @@ dtStatus dtNavMeshQuery::queryPolygons(const float* center, const float* halfExt
 /// The start and end positions are used to calculate traversal costs. 
 /// (The y-values impact the result.)
 ///
+/// When landmarks are given, the straight line distance heuristic is raised to the landmark
+/// lower bound, which makes the search expand far fewer nodes around obstacles. The landmarks
+/// must have been built with a filter giving the same costs as @p filter.
+///
 dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 								  const float* startPos, const float* endPos,
 								  const dtQueryFilter* filter,
-								  dtPolyRef* path, int* pathCount, const int maxPath) const
+								  dtPolyRef* path, int* pathCount, const int maxPath,
+								  const dtNavMeshLandmarks* landmarks) const
+{
+	return findPathT(startRef, endRef, startPos, endPos, filter, path, pathCount, maxPath, landmarks);
+}
+
+dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
+								  const float* startPos, const float* endPos,
+								  const dtPolyMaskFilter* filter,
+								  dtPolyRef* path, int* pathCount, const int maxPath,
+								  const dtNavMeshLandmarks* landmarks) const
+{
+	return findPathT(startRef, endRef, startPos, endPos, filter, path, pathCount, maxPath, landmarks);
+}
+
+template <class TFilter>
+dtStatus dtNavMeshQuery::findPathT(dtPolyRef startRef, dtPolyRef endRef,
+								   const float* startPos, const float* endPos,
+								   const TFilter* filter,
+								   dtPolyRef* path, int* pathCount, const int maxPath,
+								   const dtNavMeshLandmarks* landmarks) const
 {
 	dtAssert(m_nav);
 	dtAssert(m_nodePool);
@@ -1037,6 +1559,10 @@ dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 		return DT_SUCCESS;
 	}
 	
+	dtLandmarkGoal goal;
+	if (landmarks && !landmarks->getGoalBounds(endRef, endPos, &goal))
+		landmarks = 0;
+	
 	m_nodePool->clear();
 	m_openList->clear();
 	
@@ -1098,7 +1624,7 @@ dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 			const dtPoly* neighbourPoly = 0;
 			m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);			
 			
-			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
+			if (!dtPassFilter(filter, neighbourRef, neighbourTile, neighbourPoly))
 				continue;
 
 			// deal explicitly with crossing tile boundaries
@@ -1130,11 +1656,11 @@ dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 			if (neighbourRef == endRef)
 			{
 				// Cost
-				const float curCost = filter->getCost(bestNode->pos, neighbourNode->pos,
+				const float curCost = dtFilterCost(filter, bestNode->pos, neighbourNode->pos,
 													  parentRef, parentTile, parentPoly,
 													  bestRef, bestTile, bestPoly,
 													  neighbourRef, neighbourTile, neighbourPoly);
-				const float endCost = filter->getCost(neighbourNode->pos, endPos,
+				const float endCost = dtFilterCost(filter, neighbourNode->pos, endPos,
 													  bestRef, bestTile, bestPoly,
 													  neighbourRef, neighbourTile, neighbourPoly,
 													  0, 0, 0);
@@ -1145,12 +1671,14 @@ dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 			else
 			{
 				// Cost
-				const float curCost = filter->getCost(bestNode->pos, neighbourNode->pos,
+				const float curCost = dtFilterCost(filter, bestNode->pos, neighbourNode->pos,
 													  parentRef, parentTile, parentPoly,
 													  bestRef, bestTile, bestPoly,
 													  neighbourRef, neighbourTile, neighbourPoly);
 				cost = bestNode->cost + curCost;
 				heuristic = dtVdist(neighbourNode->pos, endPos)*H_SCALE;
+				if (landmarks)
+					heuristic = dtMax(heuristic, landmarks->getLowerBound(neighbourRef, neighbourNode->pos, &goal));
 			}
 
 			const float total = cost + heuristic;
@@ -2482,6 +3010,21 @@ dtStatus dtNavMeshQuery::raycast(dtPolyRef startRef, const float* startPos, cons
 dtStatus dtNavMeshQuery::raycast(dtPolyRef startRef, const float* startPos, const float* endPos,
 								 const dtQueryFilter* filter, const unsigned int options,
 								 dtRaycastHit* hit, dtPolyRef prevRef) const
+{
+	return raycastT(startRef, startPos, endPos, filter, options, hit, prevRef);
+}
+
+dtStatus dtNavMeshQuery::raycast(dtPolyRef startRef, const float* startPos, const float* endPos,
+								 const dtPolyMaskFilter* filter, const unsigned int options,
+								 dtRaycastHit* hit, dtPolyRef prevRef) const
+{
+	return raycastT(startRef, startPos, endPos, filter, options, hit, prevRef);
+}
+
+template <class TFilter>
+dtStatus dtNavMeshQuery::raycastT(dtPolyRef startRef, const float* startPos, const float* endPos,
+								  const TFilter* filter, const unsigned int options,
+								  dtRaycastHit* hit, dtPolyRef prevRef) const
 {
 	dtAssert(m_nav);
 	
@@ -2560,7 +3103,7 @@ dtStatus dtNavMeshQuery::raycast(dtPolyRef startRef, const float* startPos, cons
 			
 			// add the cost
 			if (options & DT_RAYCAST_USE_COSTS)
-				hit->pathCost += filter->getCost(curPos, endPos, prevRef, prevTile, prevPoly, curRef, tile, poly, curRef, tile, poly);
+				hit->pathCost += dtFilterCost(filter, curPos, endPos, prevRef, prevTile, prevPoly, curRef, tile, poly, curRef, tile, poly);
 			return status;
 		}
 
@@ -2585,7 +3128,7 @@ dtStatus dtNavMeshQuery::raycast(dtPolyRef startRef, const float* startPos, cons
 				continue;
 			
 			// Skip links based on filter.
-			if (!filter->passFilter(link->ref, nextTile, nextPoly))
+			if (!dtPassFilter(filter, link->ref, nextTile, nextPoly))
 				continue;
 			
 			// If the link is internal, just return the ref.
@@ -2660,7 +3203,7 @@ dtStatus dtNavMeshQuery::raycast(dtPolyRef startRef, const float* startPos, cons
 			float s = dtSqr(eDir[0]) > dtSqr(eDir[2]) ? diff[0] / eDir[0] : diff[2] / eDir[2];
 			curPos[1] = e1[1] + eDir[1] * s;
 
-			hit->pathCost += filter->getCost(lastPos, curPos, prevRef, prevTile, prevPoly, curRef, tile, poly, nextRef, nextTile, nextPoly);
+			hit->pathCost += dtFilterCost(filter, lastPos, curPos, prevRef, prevTile, prevPoly, curRef, tile, poly, nextRef, nextTile, nextPoly);
 		}
 
 		if (!nextRef)
@@ -0,0 +1,190 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <string.h>
+#include "DetourPolyMask.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+#include <new>
+
+dtPolyMask* dtAllocPolyMask()
+{
+	void* mem = dtAlloc(sizeof(dtPolyMask), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtPolyMask;
+}
+
+void dtFreePolyMask(dtPolyMask* mask)
+{
+	if (!mask) return;
+	mask->~dtPolyMask();
+	dtFree(mask);
+}
+
+/// @class dtPolyMask
+///
+/// The mask is always consistent with the filter: polygons of tiles without up to date bits are
+/// passed to the filter. Calling update() after the navigation mesh changes only makes the
+/// lookups fast again.
+///
+/// @see dtPolyMaskFilter
+
+dtPolyMask::dtPolyMask() :
+	m_nav(0),
+	m_filter(0),
+	m_firstTile(0),
+	m_ntiles(0),
+	m_tiles(0)
+{
+}
+
+dtPolyMask::~dtPolyMask()
+{
+	for (int i = 0; i < m_ntiles; ++i)
+		dtFree(m_tiles[i].bits);
+	dtFree(m_tiles);
+}
+
+dtStatus dtPolyMask::init(const dtNavMesh* nav, const dtQueryFilter* filter)
+{
+	if (!nav || !filter)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	for (int i = 0; i < m_ntiles; ++i)
+		dtFree(m_tiles[i].bits);
+	dtFree(m_tiles);
+
+	m_nav = nav;
+	m_filter = filter;
+	m_firstTile = nav->getTile(0);
+
+	m_ntiles = nav->getMaxTiles();
+	m_tiles = (dtPolyMaskTile*)dtAlloc(sizeof(dtPolyMaskTile)*m_ntiles, DT_ALLOC_PERM);
+	if (!m_tiles)
+	{
+		m_ntiles = 0;
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	memset(m_tiles, 0, sizeof(dtPolyMaskTile)*m_ntiles);
+
+	return DT_SUCCESS;
+}
+
+void dtPolyMask::invalidate()
+{
+	for (int i = 0; i < m_ntiles; ++i)
+		m_tiles[i].salt = 0;
+}
+
+void dtPolyMask::invalidateTile(dtTileRef ref)
+{
+	if (!m_nav)
+		return;
+	const int it = (int)m_nav->decodePolyIdTile((dtPolyRef)ref);
+	if (it >= m_ntiles)
+		return;
+	m_tiles[it].salt = 0;
+}
+
+dtStatus dtPolyMask::update(bool* changed)
+{
+	if (changed)
+		*changed = false;
+	if (!m_nav)
+		return DT_FAILURE;
+
+	for (int i = 0; i < m_ntiles; ++i)
+	{
+		const dtMeshTile* tile = m_nav->getTile(i);
+		// The salt of a tile is never zero, so tiles marked out of date never match.
+		if (!tile->header || m_tiles[i].salt == tile->salt)
+			continue;
+
+		dtStatus status = computeTile(i);
+		if (dtStatusFailed(status))
+			return status;
+		if (changed)
+			*changed = true;
+	}
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtPolyMask::computeTile(const int idx)
+{
+	const dtMeshTile* tile = m_nav->getTile(idx);
+	dtPolyMaskTile& mt = m_tiles[idx];
+	const int polyCount = tile->header->polyCount;
+	const int nwords = (polyCount + 31) / 32;
+
+	if (mt.maxPolys < polyCount)
+	{
+		dtFree(mt.bits);
+		mt.maxPolys = 0;
+		mt.bits = (unsigned int*)dtAlloc(sizeof(unsigned int)*nwords, DT_ALLOC_PERM);
+		if (!mt.bits)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		mt.maxPolys = nwords * 32;
+	}
+	memset(mt.bits, 0, sizeof(unsigned int)*nwords);
+
+	const dtPolyRef base = m_nav->getPolyRefBase(tile);
+	for (int i = 0; i < polyCount; ++i)
+	{
+		if (m_filter->passFilter(base | (dtPolyRef)i, tile, &tile->polys[i]))
+			mt.bits[i >> 5] |= 1u << (i & 31);
+	}
+
+	mt.salt = tile->salt;
+
+	return DT_SUCCESS;
+}
+
+dtPolyMaskFilter::dtPolyMaskFilter() :
+	m_mask(0),
+	m_overlay(0)
+{
+}
+
+void dtPolyMaskFilter::setMask(const dtPolyMask* mask)
+{
+	dtAssert(mask && mask->getFilter());
+
+	m_mask = mask;
+
+	const dtQueryFilter* filter = mask->getFilter();
+	for (int i = 0; i < DT_MAX_AREAS; ++i)
+		setAreaCost(i, filter->getAreaCost(i));
+	setIncludeFlags(filter->getIncludeFlags());
+	setExcludeFlags(filter->getExcludeFlags());
+}
+
+bool dtPolyMaskFilter::passFilter(const dtPolyRef ref,
+								  const dtMeshTile* tile,
+								  const dtPoly* poly) const
+{
+	return passMask(ref, tile, poly);
+}
+
+float dtPolyMaskFilter::getCost(const float* pa, const float* pb,
+								const dtPolyRef /*prevRef*/, const dtMeshTile* /*prevTile*/, const dtPoly* /*prevPoly*/,
+								const dtPolyRef /*curRef*/, const dtMeshTile* curTile, const dtPoly* curPoly,
+								const dtPolyRef /*nextRef*/, const dtMeshTile* /*nextTile*/, const dtPoly* /*nextPoly*/) const
+{
+	return getMaskCost(pa, pb, curTile, curPoly);
+}
@@ -0,0 +1,516 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <float.h>
+#include <string.h>
+#include "DetourPortalSearch.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourCommon.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+
+// Returns the point the path query places a node at when it enters the polygon the link
+// points to, which is the middle of the shared portal edge.
+static void getLinkPortalMid(const dtNavMesh* nav, dtPolyRef fromRef, const dtMeshTile* fromTile,
+							 const dtPoly* fromPoly, const dtLink* link, float* mid)
+{
+	if (fromPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+	{
+		dtVcopy(mid, &fromTile->verts[fromPoly->verts[link->edge]*3]);
+		return;
+	}
+
+	const dtMeshTile* toTile = 0;
+	const dtPoly* toPoly = 0;
+	nav->getTileAndPolyByRefUnsafe(link->ref, &toTile, &toPoly);
+	if (toPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+	{
+		for (unsigned int i = toPoly->firstLink; i != DT_NULL_LINK; i = toTile->links[i].next)
+		{
+			if (toTile->links[i].ref == fromRef)
+			{
+				dtVcopy(mid, &toTile->verts[toPoly->verts[toTile->links[i].edge]*3]);
+				return;
+			}
+		}
+		dtVcopy(mid, &toTile->verts[toPoly->verts[0]*3]);
+		return;
+	}
+
+	const float* v0 = &fromTile->verts[fromPoly->verts[link->edge]*3];
+	const float* v1 = &fromTile->verts[fromPoly->verts[(link->edge+1) % (int)fromPoly->vertCount]*3];
+
+	// Portals on tile borders only cover the part of the edge shared with the neighbour.
+	if (link->side != 0xff && (link->bmin != 0 || link->bmax != 255))
+	{
+		const float s = 1.0f/255.0f;
+		const float tmin = link->bmin*s;
+		const float tmax = link->bmax*s;
+		dtVlerp(mid, v0, v1, (tmin+tmax)*0.5f);
+	}
+	else
+	{
+		dtVlerp(mid, v0, v1, 0.5f);
+	}
+}
+
+// Returns the index of the link of a polygon to another polygon, or DT_NULL_LINK if it has none.
+static unsigned int findLink(const dtMeshTile* tile, const dtPoly* poly, dtPolyRef ref)
+{
+	for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+	{
+		if (tile->links[i].ref == ref)
+			return i;
+	}
+	return DT_NULL_LINK;
+}
+
+// Returns true if the polygon the link points to links back to the polygon the link belongs to.
+// Links between polygons always come in pairs, only one-way off-mesh connections lack the link
+// from their end point back to the connection.
+static bool hasLinkBack(dtPolyRef fromRef, const dtPoly* fromPoly,
+						const dtMeshTile* toTile, const dtPoly* toPoly)
+{
+	if (fromPoly->getType() != DT_POLYTYPE_OFFMESH_CONNECTION &&
+		toPoly->getType() != DT_POLYTYPE_OFFMESH_CONNECTION)
+		return true;
+
+	return findLink(toTile, toPoly, fromRef) != DT_NULL_LINK;
+}
+
+dtPortalSearch::dtPortalSearch() :
+	m_nav(0),
+	m_ntiles(0),
+	m_tiles(0),
+	m_heap(0),
+	m_heapSize(0),
+	m_heapCapacity(0),
+	m_oneWay(0),
+	m_oneWayCount(0),
+	m_oneWayCapacity(0)
+{
+}
+
+dtPortalSearch::~dtPortalSearch()
+{
+	for (int i = 0; i < m_ntiles; ++i)
+		dtFree(m_tiles[i].linkCost);
+	dtFree(m_tiles);
+	dtFree(m_heap);
+	dtFree(m_oneWay);
+}
+
+dtStatus dtPortalSearch::init(const dtNavMesh* nav)
+{
+	if (!nav)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	for (int i = 0; i < m_ntiles; ++i)
+		dtFree(m_tiles[i].linkCost);
+	dtFree(m_tiles);
+
+	m_nav = nav;
+	m_ntiles = nav->getMaxTiles();
+	m_tiles = (dtPortalTile*)dtAlloc(sizeof(dtPortalTile)*m_ntiles, DT_ALLOC_PERM);
+	if (!m_tiles)
+	{
+		m_ntiles = 0;
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	memset(m_tiles, 0, sizeof(dtPortalTile)*m_ntiles);
+
+	return DT_SUCCESS;
+}
+
+bool dtPortalSearch::push(const dtPortalHeapItem& item)
+{
+	if (m_heapSize >= m_heapCapacity)
+	{
+		const int capacity = m_heapCapacity ? m_heapCapacity*2 : 1024;
+		dtPortalHeapItem* heap = (dtPortalHeapItem*)dtAlloc(sizeof(dtPortalHeapItem)*capacity, DT_ALLOC_PERM);
+		if (!heap)
+			return false;
+		if (m_heapSize)
+			memcpy(heap, m_heap, sizeof(dtPortalHeapItem)*m_heapSize);
+		dtFree(m_heap);
+		m_heap = heap;
+		m_heapCapacity = capacity;
+	}
+
+	int i = m_heapSize++;
+	while (i > 0)
+	{
+		const int parent = (i-1)/2;
+		if (m_heap[parent].cost <= item.cost)
+			break;
+		m_heap[i] = m_heap[parent];
+		i = parent;
+	}
+	m_heap[i] = item;
+	return true;
+}
+
+dtPortalSearch::dtPortalHeapItem dtPortalSearch::pop()
+{
+	const dtPortalHeapItem result = m_heap[0];
+	const dtPortalHeapItem last = m_heap[--m_heapSize];
+
+	int i = 0;
+	for (;;)
+	{
+		int child = i*2+1;
+		if (child >= m_heapSize)
+			break;
+		if (child+1 < m_heapSize && m_heap[child+1].cost < m_heap[child].cost)
+			child++;
+		if (last.cost <= m_heap[child].cost)
+			break;
+		m_heap[i] = m_heap[child];
+		i = child;
+	}
+	if (m_heapSize)
+		m_heap[i] = last;
+
+	return result;
+}
+
+// Clears the link costs and the heap for a new search.
+dtStatus dtPortalSearch::reset()
+{
+	for (int i = 0; i < m_ntiles; ++i)
+	{
+		const dtMeshTile* tile = m_nav->getTile(i);
+		if (!tile->header)
+			continue;
+
+		dtPortalTile& pt = m_tiles[i];
+		const int maxLinkCount = tile->header->maxLinkCount;
+		if (pt.maxLinkCount < maxLinkCount)
+		{
+			dtFree(pt.linkCost);
+			pt.linkCost = (float*)dtAlloc(sizeof(float)*maxLinkCount, DT_ALLOC_PERM);
+			pt.maxLinkCount = pt.linkCost ? maxLinkCount : 0;
+			if (!pt.linkCost)
+				return DT_FAILURE | DT_OUT_OF_MEMORY;
+		}
+		for (int j = 0; j < maxLinkCount; ++j)
+			pt.linkCost[j] = FLT_MAX;
+	}
+
+	m_heapSize = 0;
+	return DT_SUCCESS;
+}
+
+// Collects the links of one-way off-mesh connections, which a backward search cannot find from
+// the polygon they point to.
+dtStatus dtPortalSearch::collectOneWayLinks()
+{
+	m_oneWayCount = 0;
+
+	for (int i = 0; i < m_ntiles; ++i)
+	{
+		const dtMeshTile* tile = m_nav->getTile(i);
+		if (!tile->header)
+			continue;
+		const dtPolyRef base = m_nav->getPolyRefBase(tile);
+
+		for (int j = tile->header->offMeshBase; j < tile->header->polyCount; ++j)
+		{
+			const dtPoly* poly = &tile->polys[j];
+			for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+			{
+				const dtPolyRef ref = tile->links[k].ref;
+				if (!ref)
+					continue;
+
+				const dtMeshTile* toTile = 0;
+				const dtPoly* toPoly = 0;
+				m_nav->getTileAndPolyByRefUnsafe(ref, &toTile, &toPoly);
+				if (findLink(toTile, toPoly, base | (dtPolyRef)j) != DT_NULL_LINK)
+					continue;
+
+				if (m_oneWayCount >= m_oneWayCapacity)
+				{
+					const int capacity = m_oneWayCapacity ? m_oneWayCapacity*2 : 64;
+					dtPortalOneWayLink* oneWay = (dtPortalOneWayLink*)dtAlloc(sizeof(dtPortalOneWayLink)*capacity, DT_ALLOC_PERM);
+					if (!oneWay)
+						return DT_FAILURE | DT_OUT_OF_MEMORY;
+					if (m_oneWayCount)
+						memcpy(oneWay, m_oneWay, sizeof(dtPortalOneWayLink)*m_oneWayCount);
+					dtFree(m_oneWay);
+					m_oneWay = oneWay;
+					m_oneWayCapacity = capacity;
+				}
+
+				// Insertion sort, there are few one-way connections.
+				int n = m_oneWayCount++;
+				while (n > 0 && m_oneWay[n-1].ref > ref)
+				{
+					m_oneWay[n] = m_oneWay[n-1];
+					n--;
+				}
+				dtPortalOneWayLink& link = m_oneWay[n];
+				link.ref = ref;
+				link.tile = (unsigned int)i;
+				link.poly = (unsigned int)j;
+				link.link = k;
+			}
+		}
+	}
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtPortalSearch::search(dtPolyRef startRef, const float* startPos, const dtQueryFilter* filter,
+								const float maxCost, dtPortalSearchVisitor* visitor, const bool reverse)
+{
+	if (!m_nav || !m_tiles)
+		return DT_FAILURE;
+	if (!m_nav->isValidPolyRef(startRef) || !startPos || !filter || !visitor)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	dtStatus status = reset();
+	if (dtStatusFailed(status))
+		return status;
+
+	const dtMeshTile* startTile = 0;
+	const dtPoly* startPoly = 0;
+	m_nav->getTileAndPolyByRefUnsafe(startRef, &startTile, &startPoly);
+	const unsigned int startTileIdx = m_nav->decodePolyIdTile(startRef);
+	const unsigned int startPolyIdx = m_nav->decodePolyIdPoly(startRef);
+
+	for (unsigned int i = startPoly->firstLink; i != DT_NULL_LINK; i = startTile->links[i].next)
+	{
+		const dtLink* link = &startTile->links[i];
+		if (!link->ref)
+			continue;
+
+		const dtMeshTile* nextTile = 0;
+		const dtPoly* nextPoly = 0;
+		m_nav->getTileAndPolyByRefUnsafe(link->ref, &nextTile, &nextPoly);
+		if (!filter->passFilter(link->ref, nextTile, nextPoly))
+			continue;
+		if (reverse && !hasLinkBack(startRef, startPoly, nextTile, nextPoly))
+			continue;
+
+		float mid[3];
+		getLinkPortalMid(m_nav, startRef, startTile, startPoly, link, mid);
+		const float cost = filter->getCost(startPos, mid,
+										   0, 0, 0,
+										   startRef, startTile, startPoly,
+										   link->ref, nextTile, nextPoly);
+
+		if (cost <= maxCost && cost < m_tiles[startTileIdx].linkCost[i])
+		{
+			m_tiles[startTileIdx].linkCost[i] = cost;
+			dtPortalHeapItem item = { cost, startTileIdx, startPolyIdx, i };
+			if (!push(item))
+				status |= DT_OUT_OF_MEMORY;
+		}
+	}
+
+	while (m_heapSize)
+	{
+		const dtPortalHeapItem item = pop();
+		if (item.cost > m_tiles[item.tile].linkCost[item.link])
+			continue;
+
+		// The portal from the previous polygon into the current one.
+		const dtMeshTile* prevTile = m_nav->getTile(item.tile);
+		const dtPoly* prevPoly = &prevTile->polys[item.poly];
+		const dtPolyRef prevRef = m_nav->getPolyRefBase(prevTile) | (dtPolyRef)item.poly;
+		const dtLink* portal = &prevTile->links[item.link];
+
+		const dtPolyRef curRef = portal->ref;
+		const dtMeshTile* curTile = 0;
+		const dtPoly* curPoly = 0;
+		m_nav->getTileAndPolyByRefUnsafe(curRef, &curTile, &curPoly);
+		const unsigned int curTileIdx = m_nav->decodePolyIdTile(curRef);
+		const unsigned int curPolyIdx = m_nav->decodePolyIdPoly(curRef);
+		dtPortalTile& pt = m_tiles[curTileIdx];
+
+		visitor->visit(curRef, prevRef, item.cost);
+
+		float pa[3];
+		getLinkPortalMid(m_nav, prevRef, prevTile, prevPoly, portal, pa);
+
+		for (unsigned int i = curPoly->firstLink; i != DT_NULL_LINK; i = curTile->links[i].next)
+		{
+			const dtLink* link = &curTile->links[i];
+			if (!link->ref)
+				continue;
+
+			const dtMeshTile* nextTile = 0;
+			const dtPoly* nextPoly = 0;
+			m_nav->getTileAndPolyByRefUnsafe(link->ref, &nextTile, &nextPoly);
+			if (!filter->passFilter(link->ref, nextTile, nextPoly))
+				continue;
+			if (reverse && !hasLinkBack(curRef, curPoly, nextTile, nextPoly))
+				continue;
+
+			float pb[3];
+			getLinkPortalMid(m_nav, curRef, curTile, curPoly, link, pb);
+			const float cost = item.cost + filter->getCost(pa, pb,
+														   prevRef, prevTile, prevPoly,
+														   curRef, curTile, curPoly,
+														   link->ref, nextTile, nextPoly);
+
+			if (cost <= maxCost && cost < pt.linkCost[i])
+			{
+				pt.linkCost[i] = cost;
+				dtPortalHeapItem next = { cost, curTileIdx, curPolyIdx, i };
+				if (!push(next))
+					status |= DT_OUT_OF_MEMORY;
+			}
+		}
+	}
+
+	if (dtStatusDetail(status, DT_OUT_OF_MEMORY))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+	return DT_SUCCESS;
+}
+
+// Pushes the portals into a polygon, continuing through the polygon to a position at the given
+// cost. Returns false if the heap could not grow.
+bool dtPortalSearch::pushPredecessors(dtPolyRef ref, const float* pos, dtPolyRef nextRef, const float cost,
+									  const dtQueryFilter* filter, const float maxCost)
+{
+	const dtMeshTile* curTile = 0;
+	const dtPoly* curPoly = 0;
+	m_nav->getTileAndPolyByRefUnsafe(ref, &curTile, &curPoly);
+	const dtMeshTile* nextTile = 0;
+	const dtPoly* nextPoly = 0;
+	if (nextRef)
+		m_nav->getTileAndPolyByRefUnsafe(nextRef, &nextTile, &nextPoly);
+
+	// The polygons linking to this one are its neighbours with a link back, and the one-way
+	// off-mesh connections ending on it.
+	int oneWay = 0;
+	int oneWayEnd = m_oneWayCount;
+	while (oneWay < oneWayEnd)
+	{
+		const int mid = (oneWay + oneWayEnd)/2;
+		if (m_oneWay[mid].ref < ref)
+			oneWay = mid+1;
+		else
+			oneWayEnd = mid;
+	}
+
+	bool ok = true;
+	unsigned int i = curPoly->firstLink;
+	for (;;)
+	{
+		unsigned int prevTileIdx, prevPolyIdx, prevLinkIdx;
+		if (i != DT_NULL_LINK)
+		{
+			const dtLink* link = &curTile->links[i];
+			i = link->next;
+			if (!link->ref)
+				continue;
+
+			const dtMeshTile* tile = 0;
+			const dtPoly* poly = 0;
+			m_nav->getTileAndPolyByRefUnsafe(link->ref, &tile, &poly);
+			prevLinkIdx = findLink(tile, poly, ref);
+			if (prevLinkIdx == DT_NULL_LINK)
+				continue;
+			prevTileIdx = m_nav->decodePolyIdTile(link->ref);
+			prevPolyIdx = m_nav->decodePolyIdPoly(link->ref);
+		}
+		else if (oneWay < m_oneWayCount && m_oneWay[oneWay].ref == ref)
+		{
+			const dtPortalOneWayLink& link = m_oneWay[oneWay++];
+			prevTileIdx = link.tile;
+			prevPolyIdx = link.poly;
+			prevLinkIdx = link.link;
+		}
+		else
+		{
+			break;
+		}
+
+		const dtMeshTile* prevTile = m_nav->getTile(prevTileIdx);
+		const dtPoly* prevPoly = &prevTile->polys[prevPolyIdx];
+		const dtPolyRef prevRef = m_nav->getPolyRefBase(prevTile) | (dtPolyRef)prevPolyIdx;
+		if (!filter->passFilter(prevRef, prevTile, prevPoly))
+			continue;
+
+		float mid[3];
+		getLinkPortalMid(m_nav, prevRef, prevTile, prevPoly, &prevTile->links[prevLinkIdx], mid);
+		const float total = cost + filter->getCost(mid, pos,
+												   prevRef, prevTile, prevPoly,
+												   ref, curTile, curPoly,
+												   nextRef, nextTile, nextPoly);
+
+		float& linkCost = m_tiles[prevTileIdx].linkCost[prevLinkIdx];
+		if (total <= maxCost && total < linkCost)
+		{
+			linkCost = total;
+			dtPortalHeapItem item = { total, prevTileIdx, prevPolyIdx, prevLinkIdx };
+			if (!push(item))
+				ok = false;
+		}
+	}
+
+	return ok;
+}
+
+dtStatus dtPortalSearch::searchBackward(dtPolyRef targetRef, const float* targetPos, const dtQueryFilter* filter,
+										const float maxCost, dtPortalSearchVisitor* visitor)
+{
+	if (!m_nav || !m_tiles)
+		return DT_FAILURE;
+	if (!m_nav->isValidPolyRef(targetRef) || !targetPos || !filter || !visitor)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	dtStatus status = reset();
+	if (dtStatusFailed(status))
+		return status;
+	status = collectOneWayLinks();
+	if (dtStatusFailed(status))
+		return status;
+
+	if (!pushPredecessors(targetRef, targetPos, 0, 0, filter, maxCost))
+		status |= DT_OUT_OF_MEMORY;
+
+	while (m_heapSize)
+	{
+		const dtPortalHeapItem item = pop();
+		if (item.cost > m_tiles[item.tile].linkCost[item.link])
+			continue;
+
+		// The portal from the current polygon into the next one on the way to the target.
+		const dtMeshTile* curTile = m_nav->getTile(item.tile);
+		const dtPoly* curPoly = &curTile->polys[item.poly];
+		const dtPolyRef curRef = m_nav->getPolyRefBase(curTile) | (dtPolyRef)item.poly;
+		const dtLink* portal = &curTile->links[item.link];
+
+		visitor->visit(portal->ref, curRef, item.cost);
+
+		float pa[3];
+		getLinkPortalMid(m_nav, curRef, curTile, curPoly, portal, pa);
+		if (!pushPredecessors(curRef, pa, portal->ref, item.cost, filter, maxCost))
+			status |= DT_OUT_OF_MEMORY;
+	}
+
+	if (dtStatusDetail(status, DT_OUT_OF_MEMORY))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+	return DT_SUCCESS;
+}
@@ -0,0 +1,209 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+// Checks that dtNavMeshIslands never rejects a path that dtNavMeshQuery::findPath finds, on meshes
+// whose only connection between two regions is an off-mesh connection, one-way or two-way, inside
+// a tile and across tiles. Returns non-zero if a path is rejected.
+//
+// Build and run from the repository root:
+//   c++ -O2 -IDetour/Include Detour/Tests/CheckIslands.cpp Detour/Source/*.cpp -o checkislands
+//   ./checkislands
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include "DetourNavMesh.h"
+#include "DetourNavMeshBuilder.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourIslands.h"
+#include "DetourAlloc.h"
+
+namespace
+{
+
+const int TILE_CELLS = 8;
+
+// A row of unit square polygons along x, with the cells at blockedX left out. With reversed set the
+// polygons are stored from high to low x, which changes the order in which the islands are filled.
+bool buildTile(const int tx, const int blockedX, const bool reversed,
+			   const float* conVerts, const unsigned char conDir, const int conCount,
+			   unsigned char** data, int* dataSize)
+{
+	std::vector<unsigned short> verts;
+	for (int x = 0; x <= TILE_CELLS; ++x)
+	{
+		const unsigned short v[6] = { (unsigned short)x, 0, 0, (unsigned short)x, 0, 1 };
+		verts.insert(verts.end(), v, v+6);
+	}
+
+	const int nvp = 4;
+	std::vector<int> cells;
+	for (int x = 0; x < TILE_CELLS; ++x)
+	{
+		if (tx*TILE_CELLS + x != blockedX)
+			cells.push_back(x);
+	}
+	if (reversed)
+		std::vector<int>(cells.rbegin(), cells.rend()).swap(cells);
+
+	std::vector<unsigned short> polys;
+	for (size_t i = 0; i < cells.size(); ++i)
+	{
+		const int x = cells[i];
+		const unsigned short v[4] = { (unsigned short)(x*2), (unsigned short)(x*2+1), (unsigned short)(x*2+3), (unsigned short)(x*2+2) };
+		// Edges 0 and 2 face the neighbouring cells, x- and x+.
+		unsigned short nei[4] = { 0xffff, 0xffff, 0xffff, 0xffff };
+		for (int side = 0; side < 2; ++side)
+		{
+			const int nx = side == 0 ? x-1 : x+1;
+			const int gx = tx*TILE_CELLS + nx;
+			unsigned short& n = nei[side == 0 ? 0 : 2];
+			if (gx == blockedX)
+				n = 0xffff;
+			else if (nx < 0 || nx >= TILE_CELLS)
+				n = (unsigned short)(DT_EXT_LINK | (side == 0 ? 0 : 2));
+			else
+				n = (unsigned short)(std::find(cells.begin(), cells.end(), nx) - cells.begin());
+		}
+		polys.insert(polys.end(), v, v+4);
+		polys.insert(polys.end(), nei, nei+4);
+	}
+
+	std::vector<unsigned short> flags(cells.size(), 1);
+	std::vector<unsigned char> areas(cells.size(), 0);
+	const float conRad[2] = { 0.4f, 0.4f };
+	const unsigned short conFlags[2] = { 1, 1 };
+	const unsigned char conAreas[2] = { 0, 0 };
+	const unsigned char conDirs[2] = { conDir, conDir };
+	const unsigned int conIds[2] = { 1, 2 };
+
+	dtNavMeshCreateParams params;
+	memset(&params, 0, sizeof(params));
+	params.verts = &verts[0];
+	params.vertCount = (int)verts.size()/3;
+	params.polys = &polys[0];
+	params.polyAreas = &areas[0];
+	params.polyFlags = &flags[0];
+	params.polyCount = (int)cells.size();
+	params.nvp = nvp;
+	params.offMeshConVerts = conVerts;
+	params.offMeshConRad = conRad;
+	params.offMeshConFlags = conFlags;
+	params.offMeshConAreas = conAreas;
+	params.offMeshConDir = conDirs;
+	params.offMeshConUserID = conIds;
+	params.offMeshConCount = conCount;
+	params.walkableHeight = 2;
+	params.walkableRadius = 0.5f;
+	params.walkableClimb = 1;
+	params.tileX = tx;
+	params.tileY = 0;
+	params.bmin[0] = (float)(tx*TILE_CELLS); params.bmin[1] = -1; params.bmin[2] = 0;
+	params.bmax[0] = (float)(tx*TILE_CELLS + TILE_CELLS); params.bmax[1] = 1; params.bmax[2] = 1;
+	params.cs = 1;
+	params.ch = 1;
+	params.buildBvTree = true;
+	return dtCreateNavMeshData(&params, data, dataSize);
+}
+
+dtPolyRef findPoly(const dtNavMeshQuery* query, const dtQueryFilter* filter, const float x)
+{
+	const float pos[3] = { x, 0, 0.5f };
+	const float ext[3] = { 0.1f, 1, 0.1f };
+	dtPolyRef ref = 0;
+	query->findNearestPoly(pos, ext, filter, &ref, 0);
+	return ref;
+}
+
+// The mesh is a row of tileCount tiles with the cell at blockedX left out, so the only way past it
+// is an off-mesh connection from x = from to x = to. Checks both directions between the two sides.
+bool check(const char* name, const int tileCount, const int blockedX, const bool reversed,
+		   const float from, const float to, const unsigned char conDir)
+{
+	dtNavMeshParams navParams;
+	memset(&navParams, 0, sizeof(navParams));
+	navParams.tileWidth = TILE_CELLS;
+	navParams.tileHeight = 1;
+	navParams.maxTiles = tileCount;
+	navParams.maxPolys = TILE_CELLS*2;
+
+	dtNavMesh* nav = dtAllocNavMesh();
+	nav->init(&navParams);
+	const float conVerts[6] = { from, 0, 0.5f, to, 0, 0.5f };
+	for (int tx = 0; tx < tileCount; ++tx)
+	{
+		// The connection belongs to the tile of its start.
+		const bool hasCon = (int)from/TILE_CELLS == tx;
+		unsigned char* data = 0;
+		int dataSize = 0;
+		if (buildTile(tx, blockedX, reversed, conVerts, conDir, hasCon ? 1 : 0, &data, &dataSize))
+			nav->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0);
+	}
+
+	dtQueryFilter filter;
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	query->init(nav, 256);
+
+	dtNavMeshIslands* islands = dtAllocNavMeshIslands();
+	islands->init(nav, &filter);
+	islands->update();
+
+	bool ok = true;
+	const float sides[2] = { from, to };
+	for (int dir = 0; dir < 2; ++dir)
+	{
+		const float startPos[3] = { sides[dir], 0, 0.5f };
+		const float endPos[3] = { sides[1-dir], 0, 0.5f };
+		const dtPolyRef startRef = findPoly(query, &filter, startPos[0]);
+		const dtPolyRef endRef = findPoly(query, &filter, endPos[0]);
+
+		dtPolyRef path[64];
+		int npath = 0;
+		query->findPath(startRef, endRef, startPos, endPos, &filter, path, &npath, 64);
+		const bool found = npath > 0 && path[npath-1] == endRef;
+		const bool reachable = islands->isReachable(startRef, endRef);
+
+		printf("%-28s %s  path %-3s  islands %-11s  %s\n", name, dir == 0 ? "forward " : "backward",
+			   found ? "yes" : "no", reachable ? "reachable" : "unreachable",
+			   found && !reachable ? "REJECTED" : "ok");
+		ok &= !found || reachable;
+	}
+
+	dtFreeNavMeshIslands(islands);
+	dtFreeNavMeshQuery(query);
+	dtFreeNavMesh(nav);
+	return ok;
+}
+
+}
+
+int main()
+{
+	bool ok = true;
+
+	// The end of the connection comes first in the tile, so its island is filled before the
+	// connection is reached.
+	ok &= check("one-way in tile", 1, 3, false, 5.5f, 1.5f, 0);
+	ok &= check("one-way in tile, reversed", 1, 3, true, 1.5f, 5.5f, 0);
+	ok &= check("two-way in tile", 1, 3, false, 5.5f, 1.5f, DT_OFFMESH_CON_BIDIR);
+	ok &= check("one-way across tiles", 2, 8, false, 10.5f, 5.5f, 0);
+	ok &= check("one-way across tiles, back", 2, 8, false, 5.5f, 10.5f, 0);
+
+	return ok ? 0 : 1;
+}
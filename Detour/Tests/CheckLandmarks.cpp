@@ -0,0 +1,499 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+// Compares the cost of the paths dtNavMeshQuery::findPath finds with and without landmarks, on a
+// tiled grid with walls, expensive areas and one-way off-mesh connections. A lower bound that
+// overestimates makes the landmark search return longer paths. The mesh is checked as built, and
+// while obstacles are added and removed and gates close and open every frame with one landmark
+// recomputed per frame. Returns non-zero if a landmark path is noticeably longer.
+//
+// Build and run from the repository root:
+//   c++ -O2 -IDetour/Include Detour/Tests/CheckLandmarks.cpp Detour/Source/*.cpp -o checklandmarks
+//   ./checklandmarks
+
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "DetourNavMesh.h"
+#include "DetourNavMeshBuilder.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourNode.h"
+#include "DetourLandmarks.h"
+#include "DetourPortalSearch.h"
+#include "DetourCommon.h"
+#include "DetourAlloc.h"
+
+namespace
+{
+
+const int TILE_CELLS = 16;
+const int TILES = 6;
+const int CELLS = TILE_CELLS*TILES;
+const int MAX_PATH = 4096;
+const unsigned short GATE_CLOSED = 2;
+
+// How much more the landmark paths may cost in total than the plain ones.
+const float TOLERANCE = 1.02f;
+
+unsigned int s_seed = 1;
+
+int rnd(const int n)
+{
+	s_seed = s_seed*1103515245u + 12345u;
+	return (int)((s_seed >> 16) % (unsigned int)n);
+}
+
+struct Grid
+{
+	unsigned char walls[CELLS*CELLS];
+	unsigned char areas[CELLS*CELLS];
+	unsigned char obstacles[CELLS*CELLS];
+	std::vector<float> conVerts;
+
+	bool walkable(const int x, const int z) const
+	{
+		if (x < 0 || z < 0 || x >= CELLS || z >= CELLS)
+			return false;
+		return !walls[z*CELLS + x] && !obstacles[z*CELLS + x];
+	}
+};
+
+// Long walls with a few gaps make the straight line distance a poor estimate, the one-way
+// connections jump across them.
+void buildGrid(Grid& grid)
+{
+	memset(grid.obstacles, 0, sizeof(grid.obstacles));
+	for (int z = 0; z < CELLS; ++z)
+	{
+		for (int x = 0; x < CELLS; ++x)
+		{
+			grid.walls[z*CELLS + x] = (x % 24 == 12 && z % 40 > 4) || (z % 30 == 15 && x % 36 > 5);
+			grid.areas[z*CELLS + x] = (x/8 + z/8) % 5 == 0 ? 1 : 0;
+		}
+	}
+
+	while ((int)grid.conVerts.size() < 64*6)
+	{
+		const int x = 1 + rnd(CELLS-2);
+		const int z = 1 + rnd(CELLS-2);
+		const bool alongX = rnd(2) == 0;
+		const int ex = alongX ? x + (rnd(2) ? 3 : -3) : x;
+		const int ez = alongX ? z : z + (rnd(2) ? 3 : -3);
+		if (!grid.walkable(x, z) || !grid.walkable(ex, ez))
+			continue;
+		const float v[6] = { x + 0.5f, 0, z + 0.5f, ex + 0.5f, 0, ez + 0.5f };
+		grid.conVerts.insert(grid.conVerts.end(), v, v+6);
+	}
+}
+
+bool buildTile(const Grid& grid, const int tx, const int tz, unsigned char** data, int* dataSize)
+{
+	std::vector<unsigned short> verts;
+	for (int x = 0; x <= TILE_CELLS; ++x)
+	{
+		for (int z = 0; z <= TILE_CELLS; ++z)
+		{
+			const unsigned short v[3] = { (unsigned short)x, 0, (unsigned short)z };
+			verts.insert(verts.end(), v, v+3);
+		}
+	}
+
+	std::vector<int> index(TILE_CELLS*TILE_CELLS, -1);
+	int polyCount = 0;
+	for (int z = 0; z < TILE_CELLS; ++z)
+	{
+		for (int x = 0; x < TILE_CELLS; ++x)
+		{
+			if (grid.walkable(tx*TILE_CELLS + x, tz*TILE_CELLS + z))
+				index[z*TILE_CELLS + x] = polyCount++;
+		}
+	}
+	if (!polyCount)
+		return false;
+
+	// Edges 0 to 3 face x-, z+, x+ and z-, the directions of the external links.
+	static const int dx[4] = { -1, 0, 1, 0 };
+	static const int dz[4] = { 0, 1, 0, -1 };
+	const int nvp = 4;
+	std::vector<unsigned short> polys;
+	std::vector<unsigned short> flags;
+	std::vector<unsigned char> areas;
+	for (int z = 0; z < TILE_CELLS; ++z)
+	{
+		for (int x = 0; x < TILE_CELLS; ++x)
+		{
+			if (index[z*TILE_CELLS + x] < 0)
+				continue;
+
+			const int stride = TILE_CELLS+1;
+			const unsigned short v[4] = { (unsigned short)(x*stride + z), (unsigned short)(x*stride + z+1),
+										  (unsigned short)((x+1)*stride + z+1), (unsigned short)((x+1)*stride + z) };
+			unsigned short nei[4];
+			for (int dir = 0; dir < 4; ++dir)
+			{
+				const int nx = x + dx[dir];
+				const int nz = z + dz[dir];
+				if (!grid.walkable(tx*TILE_CELLS + nx, tz*TILE_CELLS + nz))
+					nei[dir] = 0xffff;
+				else if (nx < 0 || nz < 0 || nx >= TILE_CELLS || nz >= TILE_CELLS)
+					nei[dir] = (unsigned short)(DT_EXT_LINK | dir);
+				else
+					nei[dir] = (unsigned short)index[nz*TILE_CELLS + nx];
+			}
+			polys.insert(polys.end(), v, v+4);
+			polys.insert(polys.end(), nei, nei+4);
+			flags.push_back(1);
+			areas.push_back(grid.areas[(tz*TILE_CELLS + z)*CELLS + tx*TILE_CELLS + x]);
+		}
+	}
+
+	// Connections whose start lies outside the tile are left out by dtCreateNavMeshData.
+	const int conCount = (int)grid.conVerts.size()/6;
+	std::vector<float> conRad(conCount, 0.4f);
+	std::vector<unsigned short> conFlags(conCount, 1);
+	std::vector<unsigned char> conAreas(conCount, 0);
+	std::vector<unsigned char> conDirs(conCount, 0);
+	std::vector<unsigned int> conIds(conCount);
+	for (int i = 0; i < conCount; ++i)
+		conIds[i] = i+1;
+
+	dtNavMeshCreateParams params;
+	memset(&params, 0, sizeof(params));
+	params.verts = &verts[0];
+	params.vertCount = (int)verts.size()/3;
+	params.polys = &polys[0];
+	params.polyAreas = &areas[0];
+	params.polyFlags = &flags[0];
+	params.polyCount = polyCount;
+	params.nvp = nvp;
+	params.offMeshConVerts = &grid.conVerts[0];
+	params.offMeshConRad = &conRad[0];
+	params.offMeshConFlags = &conFlags[0];
+	params.offMeshConAreas = &conAreas[0];
+	params.offMeshConDir = &conDirs[0];
+	params.offMeshConUserID = &conIds[0];
+	params.offMeshConCount = conCount;
+	params.walkableHeight = 2;
+	params.walkableRadius = 0.5f;
+	params.walkableClimb = 1;
+	params.tileX = tx;
+	params.tileY = tz;
+	params.bmin[0] = (float)(tx*TILE_CELLS); params.bmin[1] = -1; params.bmin[2] = (float)(tz*TILE_CELLS);
+	params.bmax[0] = (float)((tx+1)*TILE_CELLS); params.bmax[1] = 1; params.bmax[2] = (float)((tz+1)*TILE_CELLS);
+	params.cs = 1;
+	params.ch = 1;
+	params.buildBvTree = true;
+	return dtCreateNavMeshData(&params, data, dataSize);
+}
+
+void setTile(dtNavMesh* nav, const Grid& grid, const int tx, const int tz)
+{
+	nav->removeTile(nav->getTileRefAt(tx, tz, 0), 0, 0);
+	unsigned char* data = 0;
+	int dataSize = 0;
+	if (buildTile(grid, tx, tz, &data, &dataSize))
+		nav->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0);
+}
+
+// The middle of the portal from one polygon to the next, where findPath places its nodes.
+void getPortalMid(const dtNavMesh* nav, const dtPolyRef from, const dtPolyRef to, float* mid)
+{
+	const dtMeshTile* fromTile = 0;
+	const dtPoly* fromPoly = 0;
+	const dtMeshTile* toTile = 0;
+	const dtPoly* toPoly = 0;
+	nav->getTileAndPolyByRefUnsafe(from, &fromTile, &fromPoly);
+	nav->getTileAndPolyByRefUnsafe(to, &toTile, &toPoly);
+
+	const dtLink* link = 0;
+	for (unsigned int i = fromPoly->firstLink; i != DT_NULL_LINK; i = fromTile->links[i].next)
+	{
+		if (fromTile->links[i].ref == to)
+			link = &fromTile->links[i];
+	}
+
+	if (fromPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+	{
+		dtVcopy(mid, &fromTile->verts[fromPoly->verts[link->edge]*3]);
+		return;
+	}
+	if (toPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+	{
+		for (unsigned int i = toPoly->firstLink; i != DT_NULL_LINK; i = toTile->links[i].next)
+		{
+			if (toTile->links[i].ref == from)
+				dtVcopy(mid, &toTile->verts[toPoly->verts[toTile->links[i].edge]*3]);
+		}
+		return;
+	}
+
+	const float* v0 = &fromTile->verts[fromPoly->verts[link->edge]*3];
+	const float* v1 = &fromTile->verts[fromPoly->verts[(link->edge+1) % (int)fromPoly->vertCount]*3];
+	dtVlerp(mid, v0, v1, 0.5f);
+}
+
+// The cost findPath assigns to a path: from portal middle to portal middle at the cost of the
+// polygon in between.
+float pathCost(const dtNavMesh* nav, const dtQueryFilter* filter,
+			   const dtPolyRef* path, const int npath, const float* startPos, const float* endPos)
+{
+	float prev[3];
+	dtVcopy(prev, startPos);
+	float cost = 0;
+	for (int i = 0; i < npath; ++i)
+	{
+		float mid[3];
+		if (i+1 < npath)
+			getPortalMid(nav, path[i], path[i+1], mid);
+		else
+			dtVcopy(mid, endPos);
+
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		nav->getTileAndPolyByRefUnsafe(path[i], &tile, &poly);
+		cost += filter->getCost(prev, mid, 0, 0, 0, path[i], tile, poly, 0, 0, 0);
+		dtVcopy(prev, mid);
+	}
+	return cost;
+}
+
+// Records the cheapest cost to the goal position over the portals of the goal polygon.
+class CheapestVisitor : public dtPortalSearchVisitor
+{
+public:
+	CheapestVisitor(const dtNavMesh* nav, const dtQueryFilter* filter, const dtPolyRef endRef, const float* endPos) :
+		m_nav(nav), m_filter(filter), m_endRef(endRef), m_endPos(endPos), cost(FLT_MAX)
+	{
+	}
+
+	virtual void visit(dtPolyRef ref, dtPolyRef fromRef, float portalCost)
+	{
+		if (ref != m_endRef)
+			return;
+		float mid[3];
+		getPortalMid(m_nav, fromRef, ref, mid);
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		m_nav->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+		cost = dtMin(cost, portalCost + m_filter->getCost(mid, m_endPos, 0, 0, 0, ref, tile, poly, 0, 0, 0));
+	}
+
+private:
+	const dtNavMesh* m_nav;
+	const dtQueryFilter* m_filter;
+	dtPolyRef m_endRef;
+	const float* m_endPos;
+
+public:
+	float cost;
+};
+
+struct Stats
+{
+	int queries;
+	int overestimates;
+	double cheapestCost;
+	double plainCost;
+	double landmarkCost;
+	double plainNodes;
+	double landmarkNodes;
+};
+
+// Finds paths with and without landmarks from a random portal to a random point, and compares
+// their costs and the lower bound at the start with the cheapest cost found by a full search.
+void compare(const dtNavMesh* nav, dtNavMeshQuery* query, dtPortalSearch* search, const dtQueryFilter* filter,
+			 const dtNavMeshLandmarks* landmarks, const int count, Stats& stats)
+{
+	static dtPolyRef plainPath[MAX_PATH];
+	static dtPolyRef landmarkPath[MAX_PATH];
+	const float ext[3] = { 0.5f, 1, 0.5f };
+
+	for (int i = 0; i < count; )
+	{
+		const float a[3] = { rnd(CELLS) + 0.5f, 0, rnd(CELLS) + 0.5f };
+		const float b[3] = { rnd(CELLS) + 0.5f, 0, rnd(CELLS) + 0.5f };
+		float endPos[3];
+		dtPolyRef startRef = 0, endRef = 0;
+		query->findNearestPoly(a, ext, filter, &startRef, 0);
+		query->findNearestPoly(b, ext, filter, &endRef, endPos);
+		if (!startRef || !endRef || startRef == endRef)
+			continue;
+
+		// Start where findPath places its nodes, on a portal the start polygon is entered through.
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		nav->getTileAndPolyByRefUnsafe(startRef, &tile, &poly);
+		if (poly->firstLink == DT_NULL_LINK)
+			continue;
+		const dtPolyRef fromRef = tile->links[poly->firstLink].ref;
+		float startPos[3];
+		getPortalMid(nav, fromRef, startRef, startPos);
+
+		int nplain = 0;
+		query->findPath(startRef, endRef, startPos, endPos, filter, plainPath, &nplain, MAX_PATH);
+		if (!nplain || plainPath[nplain-1] != endRef)
+			continue;
+		const int plainNodes = query->getNodePool()->getNodeCount();
+		const float plainCost = pathCost(nav, filter, plainPath, nplain, startPos, endPos);
+
+		// The cheapest path costs no more than the plain one, which limits the search.
+		CheapestVisitor cheapest(nav, filter, endRef, endPos);
+		search->search(startRef, startPos, filter, plainCost*1.001f, &cheapest);
+		if (cheapest.cost == FLT_MAX)
+			continue;
+		stats.plainNodes += plainNodes;
+
+		int nlandmark = 0;
+		query->findPath(startRef, endRef, startPos, endPos, filter, landmarkPath, &nlandmark, MAX_PATH, landmarks);
+		stats.landmarkNodes += query->getNodePool()->getNodeCount();
+
+		dtLandmarkGoal goal;
+		if (landmarks->getGoalBounds(endRef, endPos, &goal) &&
+			landmarks->getLowerBound(startRef, startPos, &goal) > cheapest.cost*1.0001f + 0.001f)
+			stats.overestimates++;
+
+		stats.cheapestCost += cheapest.cost;
+		stats.plainCost += plainCost;
+		stats.landmarkCost += pathCost(nav, filter, landmarkPath, nlandmark, startPos, endPos);
+		stats.queries++;
+		++i;
+	}
+}
+
+// Both searches place their nodes at the first portal they reach a polygon through, so neither
+// finds the cheapest path every time, but with a lower bound that never overestimates the
+// landmark paths must not be longer on the whole.
+bool report(const char* name, const Stats& stats)
+{
+	const bool ok = !stats.overestimates && stats.landmarkCost <= stats.plainCost*TOLERANCE;
+	printf("%-8s queries %5d  bound above cheapest %4d  cost over cheapest plain %5.2f%% landmarks %5.2f%%  nodes plain %5.0f landmarks %5.0f (%3.0f%%)  %s\n",
+		   name, stats.queries, stats.overestimates,
+		   100.0*(stats.plainCost/stats.cheapestCost - 1), 100.0*(stats.landmarkCost/stats.cheapestCost - 1),
+		   stats.plainNodes/stats.queries, stats.landmarkNodes/stats.queries,
+		   100.0*stats.landmarkNodes/stats.plainNodes, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+}
+
+int main()
+{
+	static Grid grid;
+	buildGrid(grid);
+
+	dtNavMeshParams navParams;
+	memset(&navParams, 0, sizeof(navParams));
+	navParams.tileWidth = TILE_CELLS;
+	navParams.tileHeight = TILE_CELLS;
+	navParams.maxTiles = TILES*TILES;
+	navParams.maxPolys = TILE_CELLS*TILE_CELLS + (int)grid.conVerts.size()/6;
+
+	dtNavMesh* nav = dtAllocNavMesh();
+	nav->init(&navParams);
+	for (int tz = 0; tz < TILES; ++tz)
+	{
+		for (int tx = 0; tx < TILES; ++tx)
+			setTile(nav, grid, tx, tz);
+	}
+
+	dtQueryFilter filter;
+	filter.setAreaCost(0, 1.0f);
+	filter.setAreaCost(1, 4.0f);
+	filter.setExcludeFlags(GATE_CLOSED);
+
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	query->init(nav, 65535);
+
+	dtPortalSearch search;
+	search.init(nav);
+
+	dtNavMeshLandmarks* landmarks = dtAllocNavMeshLandmarks();
+	landmarks->init(nav, &filter, 8);
+	landmarks->build(8);
+
+	bool ok = true;
+
+	Stats stats;
+	memset(&stats, 0, sizeof(stats));
+	compare(nav, query, &search, &filter, landmarks, 500, stats);
+	ok &= report("built", stats);
+
+	// Obstacles of 3x3 cells rebuild their tiles. Gates are cells whose polygon flags are cleared
+	// and set again without a rebuild, which opens shorter routes the landmarks do not know yet.
+	struct Obstacle { int x, z; };
+	std::vector<Obstacle> obstacles;
+	memset(&stats, 0, sizeof(stats));
+	for (int frame = 0; frame < 300; ++frame)
+	{
+		const bool add = obstacles.size() < 6 || (obstacles.size() < 14 && rnd(2) == 0);
+		Obstacle ob;
+		if (add)
+		{
+			ob.x = rnd(CELLS-3);
+			ob.z = rnd(CELLS-3);
+			obstacles.push_back(ob);
+		}
+		else
+		{
+			const int i = rnd((int)obstacles.size());
+			ob = obstacles[i];
+			obstacles.erase(obstacles.begin() + i);
+		}
+
+		memset(grid.obstacles, 0, sizeof(grid.obstacles));
+		for (size_t i = 0; i < obstacles.size(); ++i)
+		{
+			for (int z = 0; z < 3; ++z)
+			{
+				for (int x = 0; x < 3; ++x)
+					grid.obstacles[(obstacles[i].z + z)*CELLS + obstacles[i].x + x] = 1;
+			}
+		}
+		for (int tz = ob.z/TILE_CELLS; tz <= (ob.z+2)/TILE_CELLS; ++tz)
+		{
+			for (int tx = ob.x/TILE_CELLS; tx <= (ob.x+2)/TILE_CELLS; ++tx)
+				setTile(nav, grid, tx, tz);
+		}
+
+		// Close or open a gate in a gap of a wall.
+		const float gatePos[3] = { 12.5f + 24*rnd(4), 0, 2.5f };
+		const float ext[3] = { 0.1f, 1, 0.1f };
+		const dtQueryFilter any;
+		dtPolyRef gate = 0;
+		query->findNearestPoly(gatePos, ext, &any, &gate, 0);
+		unsigned short gateFlags = 0;
+		if (gate && dtStatusSucceed(nav->getPolyFlags(gate, &gateFlags)))
+		{
+			nav->setPolyFlags(gate, gateFlags ^ GATE_CLOSED);
+			const dtMeshTile* tile = 0;
+			const dtPoly* poly = 0;
+			nav->getTileAndPolyByRefUnsafe(gate, &tile, &poly);
+			landmarks->invalidateTile(nav->getTileRef(tile));
+		}
+
+		landmarks->update(1);
+		compare(nav, query, &search, &filter, landmarks, 4, stats);
+	}
+	ok &= report("changing", stats);
+
+	dtFreeNavMeshLandmarks(landmarks);
+	dtFreeNavMeshQuery(query);
+	dtFreeNavMesh(nav);
+	return ok ? 0 : 1;
+}
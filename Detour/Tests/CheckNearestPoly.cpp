@@ -0,0 +1,280 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+// Times dtNavMeshQuery::findNearestPoly on tiles built with and without a BV tree, as the tile
+// cache builds them, and checks that the BV tree finds a nearest point at least as near as the
+// linear scan. Returns non-zero if the BV tree misses a polygon the linear scan finds.
+//
+// The BV tree tests the query box against polygon bounds quantized outwards, so near the edge of
+// the box it may also find a polygon the linear scan skips and return a nearer point. Those
+// queries are counted as widened, not as failures.
+//
+// The mesh is 4x4 tiles of 16x16 square polygons of 4 units, with a fifth of the squares left
+// out. It is queried at random points with the half extents of a close search, a medium one and
+// the default PolySearchBox of the wrapper.
+//
+// Build and run from the repository root:
+//   c++ -O2 -IDetour/Include Detour/Tests/CheckNearestPoly.cpp Detour/Source/*.cpp -o checknearestpoly
+//   ./checknearestpoly
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+#include "DetourNavMesh.h"
+#include "DetourNavMeshBuilder.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourCommon.h"
+#include "DetourAlloc.h"
+
+namespace
+{
+
+const int TILES = 4;
+const int TILE_CELLS = 16;
+const int CELL_SIZE = 4;
+const int CELLS = TILES*TILE_CELLS;
+const int QUERY_COUNT = 100000;
+// Times each tile is built when timing the builds.
+const int BUILD_REPEATS = 20;
+
+typedef std::chrono::steady_clock Clock;
+
+double msSince(const Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+unsigned int g_seed = 1;
+
+float frand()
+{
+	g_seed = g_seed*1103515245u + 12345u;
+	return ((g_seed >> 8) & 0xffff) / 65535.0f;
+}
+
+bool g_hole[CELLS][CELLS];
+
+// Encodes the neighbour of a cell across one of its edges: a polygon index, a portal to the
+// next tile, or 0xffff for a wall.
+unsigned short neighbour(const std::vector<int>& polyAt, const int x, const int z, const int dir)
+{
+	static const int dx[4] = { -1, 0, 1, 0 };
+	static const int dz[4] = { 0, 1, 0, -1 };
+	const int nx = x + dx[dir], nz = z + dz[dir];
+	if (nx < 0 || nz < 0 || nx >= TILE_CELLS || nz >= TILE_CELLS)
+		return (unsigned short)(DT_EXT_LINK | dir);
+	const int p = polyAt[nz*TILE_CELLS + nx];
+	return p < 0 ? 0xffff : (unsigned short)p;
+}
+
+bool buildTile(const int tx, const int tz, const bool bvTree, unsigned char** data, int* dataSize)
+{
+	std::vector<unsigned short> verts;
+	for (int z = 0; z <= TILE_CELLS; ++z)
+	{
+		for (int x = 0; x <= TILE_CELLS; ++x)
+		{
+			const unsigned short v[3] = { (unsigned short)(x*CELL_SIZE), 0, (unsigned short)(z*CELL_SIZE) };
+			verts.insert(verts.end(), v, v+3);
+		}
+	}
+
+	std::vector<int> polyAt(TILE_CELLS*TILE_CELLS, -1);
+	int npolys = 0;
+	for (int z = 0; z < TILE_CELLS; ++z)
+	{
+		for (int x = 0; x < TILE_CELLS; ++x)
+		{
+			if (!g_hole[tx*TILE_CELLS + x][tz*TILE_CELLS + z])
+				polyAt[z*TILE_CELLS + x] = npolys++;
+		}
+	}
+
+	const int nvp = 6;
+	std::vector<unsigned short> polys;
+	for (int z = 0; z < TILE_CELLS; ++z)
+	{
+		for (int x = 0; x < TILE_CELLS; ++x)
+		{
+			if (polyAt[z*TILE_CELLS + x] < 0)
+				continue;
+			const int row = TILE_CELLS+1;
+			// Edges 0 to 3 face x-, z+, x+ and z-.
+			const unsigned short p[nvp*2] = {
+				(unsigned short)(z*row + x), (unsigned short)((z+1)*row + x),
+				(unsigned short)((z+1)*row + x+1), (unsigned short)(z*row + x+1), 0xffff, 0xffff,
+				neighbour(polyAt, x, z, 0), neighbour(polyAt, x, z, 1),
+				neighbour(polyAt, x, z, 2), neighbour(polyAt, x, z, 3), 0xffff, 0xffff,
+			};
+			polys.insert(polys.end(), p, p+nvp*2);
+		}
+	}
+
+	std::vector<unsigned char> areas(npolys, 0);
+	std::vector<unsigned short> flags(npolys, 1);
+
+	dtNavMeshCreateParams params;
+	memset(&params, 0, sizeof(params));
+	params.verts = &verts[0];
+	params.vertCount = (int)verts.size()/3;
+	params.polys = &polys[0];
+	params.polyAreas = &areas[0];
+	params.polyFlags = &flags[0];
+	params.polyCount = npolys;
+	params.nvp = nvp;
+	params.walkableHeight = 2;
+	params.walkableRadius = 0.5f;
+	params.walkableClimb = 1;
+	params.tileX = tx;
+	params.tileY = tz;
+	params.bmin[0] = (float)(tx*TILE_CELLS*CELL_SIZE); params.bmin[1] = -1; params.bmin[2] = (float)(tz*TILE_CELLS*CELL_SIZE);
+	params.bmax[0] = (float)((tx+1)*TILE_CELLS*CELL_SIZE); params.bmax[1] = 1; params.bmax[2] = (float)((tz+1)*TILE_CELLS*CELL_SIZE);
+	params.cs = 1;
+	params.ch = 1;
+	params.buildBvTree = bvTree;
+	return dtCreateNavMeshData(&params, data, dataSize);
+}
+
+// Builds the mesh and returns the time it took to build its tiles once, in milliseconds.
+dtNavMesh* buildMesh(const bool bvTree, double* buildMs)
+{
+	dtNavMeshParams navParams;
+	memset(&navParams, 0, sizeof(navParams));
+	navParams.tileWidth = (float)(TILE_CELLS*CELL_SIZE);
+	navParams.tileHeight = (float)(TILE_CELLS*CELL_SIZE);
+	navParams.maxTiles = TILES*TILES;
+	navParams.maxPolys = TILE_CELLS*TILE_CELLS;
+
+	const Clock::time_point start = Clock::now();
+	for (int r = 0; r < BUILD_REPEATS; ++r)
+	{
+		for (int tz = 0; tz < TILES; ++tz)
+		{
+			for (int tx = 0; tx < TILES; ++tx)
+			{
+				unsigned char* data = 0;
+				int dataSize = 0;
+				if (buildTile(tx, tz, bvTree, &data, &dataSize))
+					dtFree(data);
+			}
+		}
+	}
+	*buildMs = msSince(start) / BUILD_REPEATS;
+
+	dtNavMesh* nav = dtAllocNavMesh();
+	nav->init(&navParams);
+	for (int tz = 0; tz < TILES; ++tz)
+	{
+		for (int tx = 0; tx < TILES; ++tx)
+		{
+			unsigned char* data = 0;
+			int dataSize = 0;
+			if (buildTile(tx, tz, bvTree, &data, &dataSize))
+				nav->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0);
+		}
+	}
+	return nav;
+}
+
+struct Result
+{
+	bool found;
+	float dist;
+};
+
+// Runs the queries and returns the time they took, in milliseconds.
+double runQueries(const dtNavMesh* nav, const std::vector<float>& points, const float halfExtent,
+				  std::vector<Result>& results)
+{
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	query->init(nav, 2048);
+	const dtQueryFilter filter;
+	const float ext[3] = { halfExtent, halfExtent, halfExtent };
+
+	results.resize(QUERY_COUNT);
+	const Clock::time_point start = Clock::now();
+	for (int i = 0; i < QUERY_COUNT; ++i)
+	{
+		const float* pos = &points[i*3];
+		dtPolyRef ref = 0;
+		float nearest[3];
+		query->findNearestPoly(pos, ext, &filter, &ref, nearest);
+		results[i].found = ref != 0;
+		results[i].dist = ref ? dtVdist(pos, nearest) : 0;
+	}
+	const double ms = msSince(start);
+
+	dtFreeNavMeshQuery(query);
+	return ms;
+}
+
+}
+
+int main()
+{
+	for (int x = 0; x < CELLS; ++x)
+	{
+		for (int z = 0; z < CELLS; ++z)
+			g_hole[x][z] = frand() < 0.2f;
+	}
+
+	double linearBuildMs, bvBuildMs;
+	dtNavMesh* linearMesh = buildMesh(false, &linearBuildMs);
+	dtNavMesh* bvMesh = buildMesh(true, &bvBuildMs);
+	printf("build %d tiles      linear %8.2f ms  BV tree %8.2f ms\n", TILES*TILES, linearBuildMs, bvBuildMs);
+
+	std::vector<float> points(QUERY_COUNT*3);
+	for (int i = 0; i < QUERY_COUNT; ++i)
+	{
+		points[i*3+0] = frand()*CELLS*CELL_SIZE;
+		points[i*3+1] = 0.5f;
+		points[i*3+2] = frand()*CELLS*CELL_SIZE;
+	}
+
+	bool ok = true;
+	static const float halfExtents[] = { 2, 8, 32 };
+	for (int e = 0; e < (int)(sizeof(halfExtents)/sizeof(halfExtents[0])); ++e)
+	{
+		std::vector<Result> linearResults, bvResults;
+		const double linearMs = runQueries(linearMesh, points, halfExtents[e], linearResults);
+		const double bvMs = runQueries(bvMesh, points, halfExtents[e], bvResults);
+
+		// Polygons at the same distance may be found in another order, so only the distance is compared.
+		int missed = 0, widened = 0;
+		for (int i = 0; i < QUERY_COUNT; ++i)
+		{
+			const Result& lin = linearResults[i];
+			const Result& bv = bvResults[i];
+			if (lin.found && (!bv.found || bv.dist > lin.dist + 1e-4f))
+				missed++;
+			else if (bv.found && (!lin.found || bv.dist < lin.dist - 1e-4f))
+				widened++;
+		}
+
+		printf("%dk queries, %2.0f    linear %8.1f ms  BV tree %8.1f ms  %5.2fx  %d missed  %d widened\n",
+			   QUERY_COUNT/1000, halfExtents[e], linearMs, bvMs, linearMs/bvMs, missed, widened);
+		ok &= missed == 0;
+	}
+
+	dtFreeNavMesh(linearMesh);
+	dtFreeNavMesh(bvMesh);
+
+	return ok ? 0 : 1;
+}
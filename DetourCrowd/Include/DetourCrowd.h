@@ -0,0 +1,346 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+
+#ifndef DETOURCROWD_H
+#define DETOURCROWD_H
+
+#include "DetourNavMeshQuery.h"
+#include "DetourPathCorridor.h"
+#include "DetourProximityGrid.h"
+#include "DetourOrcaSolver.h"
+#include "DetourCommon.h"
+
+/// The maximum number of neighbors that a crowd agent can take into account
+/// for steering decisions.
+/// @ingroup crowd
+static const int DT_CROWDAGENT_MAX_NEIGHBOURS = 6;
+
+/// The maximum number of corners a crowd agent will look ahead in the path.
+/// @ingroup crowd
+static const int DT_CROWDAGENT_MAX_CORNERS = 4;
+
+/// The maximum number of wall segments a crowd agent avoids.
+/// @ingroup crowd
+static const int DT_CROWDAGENT_MAX_LOCAL_SEGS = 8;
+
+/// The maximum number of query filter types supported by the crowd manager.
+/// @ingroup crowd
+static const int DT_CROWD_MAX_QUERY_FILTER_TYPE = 16;
+
+/// The type of navigation mesh polygon the agent is currently traversing.
+/// @ingroup crowd
+enum CrowdAgentState
+{
+	DT_CROWDAGENT_STATE_INVALID,		///< The agent is not in a valid state.
+	DT_CROWDAGENT_STATE_WALKING		///< The agent is traversing a normal navigation mesh polygon.
+};
+
+/// The state of the move request of an agent.
+/// @ingroup crowd
+enum MoveRequestState
+{
+	DT_CROWDAGENT_TARGET_NONE = 0,		///< The agent has no target.
+	DT_CROWDAGENT_TARGET_FAILED,		///< The target can not be reached.
+	DT_CROWDAGENT_TARGET_REQUESTING,	///< The corridor is being searched towards the target.
+	DT_CROWDAGENT_TARGET_VALID			///< The corridor reaches the target.
+};
+
+/// Crowd agent update flags.
+/// @ingroup crowd
+/// @see dtCrowdAgentParams::updateFlags
+enum UpdateFlags
+{
+	DT_CROWD_OBSTACLE_AVOIDANCE = 1		///< Avoid neighbours and walls with velocity obstacles. (See: #dtOrcaSolver)
+};
+
+/// The steps of a crowd update. All agents must have finished a step before the next
+/// step starts, but the agents of a step can be split over any number of workers.
+/// @ingroup crowd
+enum dtCrowdUpdatePhase
+{
+	DT_CROWD_PHASE_STEER = 0,		///< Corridor upkeep, path search, neighbour search and steering.
+	DT_CROWD_PHASE_INTEGRATE,		///< Acceleration and the tentative move.
+	DT_CROWD_PHASE_COLLIDE,			///< Separation of overlapping agents.
+	DT_CROWD_PHASE_MOVE,			///< Moving the corridors to the new positions.
+	DT_CROWD_PHASE_COUNT			///< The number of steps.
+};
+
+/// Configuration parameters for a crowd agent.
+/// @ingroup crowd
+struct dtCrowdAgentParams
+{
+	float radius;						///< Agent radius. [Limit: >= 0]
+	float height;						///< Agent height. [Limit: > 0]
+	float maxAcceleration;				///< Maximum allowed acceleration. [Limit: >= 0]
+	float maxSpeed;						///< Maximum allowed speed. [Limit: >= 0]
+
+	/// Defines how close a collision element must be before it is considered for steering behaviors. [Limits: > 0]
+	float collisionQueryRange;
+
+	float pathOptimizationRange;		///< The path visibility optimization range. [Limit: > 0]
+
+	/// How aggresive the agent manager should be at avoiding collisions with this agent. [Limit: >= 0]
+	float separationWeight;
+
+	/// Flags that impact steering behavior. (See: #UpdateFlags)
+	unsigned char updateFlags;
+
+	/// The index of the query filter used by this agent.
+	unsigned char queryFilterType;
+};
+
+/// Moves many agents along the navigation mesh at the same time.
+///
+/// The agent data is stored as separate arrays per attribute, indexed by agent, so each
+/// step of the update streams through the few attributes it needs. An update is split into
+/// the steps of #dtCrowdUpdatePhase. Every step only writes the data of the agents it is run
+/// for, and reads the data of other agents that the previous steps wrote, so the agents of
+/// a step can be divided over worker threads. Each worker uses a query object of its own.
+///
+/// Paths are planned with the corridor of each agent: a new target starts an empty
+/// corridor that is extended by a limited number of search iterations per update until it
+/// reaches the target, and corridors cut by navigation mesh changes are only searched again
+/// from the cut onwards.
+/// @ingroup crowd
+class dtCrowd
+{
+public:
+	dtCrowd();
+	~dtCrowd();
+
+	/// Initializes the crowd.
+	///  @param[in]		maxAgents		The maximum number of agents the crowd can manage. [Limit: >= 1]
+	///  @param[in]		maxAgentRadius	The maximum radius of any agent that will be added to the crowd. [Limit: > 0]
+	///  @param[in]		nav				The navigation mesh to use for planning.
+	///  @param[in]		maxWorkers		The maximum number of workers an update is split over. [Limit: >= 1]
+	/// @return True if the initialization succeeded.
+	bool init(const int maxAgents, const float maxAgentRadius, dtNavMesh* nav, const int maxWorkers = 1);
+
+	/// Sets the filter for the specified index.
+	///  @param[in]		idx		The index. [Limits: 0 <= value < #DT_CROWD_MAX_QUERY_FILTER_TYPE]
+	///  @param[in]		filter	The filter. Must stay alive as long as the crowd uses it.
+	void setFilter(const int idx, const dtQueryFilter* filter);
+
+	/// Gets the filter used by the crowd.
+	/// @return The filter used by the crowd.
+	inline const dtQueryFilter* getFilter(const int i) const { return (i >= 0 && i < DT_CROWD_MAX_QUERY_FILTER_TYPE) ? m_filters[i] : 0; }
+
+	/// Adds a new agent to the crowd.
+	///  @param[in]		pos		The requested position of the agent. [(x, y, z)]
+	///  @param[in]		params	The configutation of the agent.
+	/// @return The index of the agent in the agent pool. Or -1 if the agent could not be added.
+	int addAgent(const float* pos, const dtCrowdAgentParams* params);
+
+	/// Updates the specified agent's configuration.
+	///  @param[in]		idx		The agent index. [Limits: 0 <= value < #getAgentCount()]
+	///  @param[in]		params	The new agent configuration.
+	void updateAgentParameters(const int idx, const dtCrowdAgentParams* params);
+
+	/// Removes the agent from the crowd.
+	///  @param[in]		idx		The agent index. [Limits: 0 <= value < #getAgentCount()]
+	void removeAgent(const int idx);
+
+	/// Submits a new move request for the specified agent.
+	///  @param[in]		idx		The agent index. [Limits: 0 <= value < #getAgentCount()]
+	///  @param[in]		ref		The position's polygon reference.
+	///  @param[in]		pos		The position within the polygon. [(x, y, z)]
+	/// @return True if the request was successfully submitted.
+	bool requestMoveTarget(const int idx, dtPolyRef ref, const float* pos);
+
+	/// Moves the target of the current request of the specified agent. Unlike requestMoveTarget(),
+	/// the corridor is kept and only its end is moved, or searched again if the target left it.
+	/// Meant for targets that move a little every update, e.g. when following another agent.
+	///  @param[in]		idx		The agent index. [Limits: 0 <= value < #getAgentCount()]
+	///  @param[in]		ref		The position's polygon reference.
+	///  @param[in]		pos		The position within the polygon. [(x, y, z)]
+	/// @return True if the request was successfully submitted.
+	bool adjustMoveTarget(const int idx, dtPolyRef ref, const float* pos);
+
+	/// Resets any request for the specified agent.
+	///  @param[in]		idx		The agent index. [Limits: 0 <= value < #getAgentCount()]
+	/// @return True if the request was successfully reseted.
+	bool resetMoveTarget(const int idx);
+
+	/// Updates the steering and positions of all agents on a single thread.
+	///  @param[in]		dt		The time, in seconds, to update the simulation. [Limit: > 0]
+	void update(const float dt);
+
+	/// Prepares an update that is run step by step with updatePhase().
+	///  @param[in]		dt		The time, in seconds, to update the simulation. [Limit: > 0]
+	/// @return The number of active agents the steps are run for.
+	int beginUpdate(const float dt);
+
+	/// Runs one step of the update prepared by beginUpdate() for a range of the active agents.
+	/// Calls for disjoint ranges of the same step can run at the same time if they use
+	/// different workers.
+	///  @param[in]		phase	The step to run. (See: #dtCrowdUpdatePhase)
+	///  @param[in]		begin	The first active agent to update.
+	///  @param[in]		end		One past the last active agent to update. [Limit: <= beginUpdate()]
+	///  @param[in]		worker	The worker running the call. [Limit: 0 <= value < maxWorkers]
+	void updatePhase(const int phase, const int begin, const int end, const int worker);
+
+	/// Sets the number of path search iterations an agent may use per update.
+	///  @param[in]		maxIter		The maximum number of iterations. [Limit: >= 1]
+	inline void setMaxPathIterations(const int maxIter) { m_maxPathIter = dtMax(maxIter, 1); }
+
+	/// Sets how far ahead agents with #DT_CROWD_OBSTACLE_AVOIDANCE avoid collisions.
+	///  @param[in]		agentHorizon		The time, in seconds, collisions with other agents are avoided for. [Limit: > 0]
+	///  @param[in]		obstacleHorizon		The time, in seconds, collisions with walls are avoided for. [Limit: > 0]
+	void setAvoidanceHorizons(const float agentHorizon, const float obstacleHorizon);
+
+	/// Gets the size of the agent pool.
+	/// @return The size of the agent pool.
+	inline int getAgentCount() const { return m_maxAgents; }
+
+	/// Gets the number of agents updated by the last update.
+	inline int getActiveAgentCount() const { return m_nactive; }
+
+	/// True if the agent index is in use.
+	inline bool isAgentActive(const int idx) const { return idx >= 0 && idx < m_maxAgents && m_active[idx] != 0; }
+
+	/// The position of the agent. [(x, y, z)]
+	inline const float* getAgentPosition(const int idx) const { return &m_pos[idx*3]; }
+
+	/// The actual velocity of the agent. [(x, y, z)]
+	inline const float* getAgentVelocity(const int idx) const { return &m_vel[idx*3]; }
+
+	/// The velocity the agent steers towards before collisions are resolved. [(x, y, z)]
+	inline const float* getAgentDesiredVelocity(const int idx) const { return &m_dvel[idx*3]; }
+
+	/// The state of the agent. (See: #CrowdAgentState)
+	inline unsigned char getAgentState(const int idx) const { return m_state[idx]; }
+
+	/// The state of the move request of the agent. (See: #MoveRequestState)
+	inline unsigned char getAgentTargetState(const int idx) const { return m_targetState[idx]; }
+
+	/// The configuration of the agent.
+	inline const dtCrowdAgentParams* getAgentParams(const int idx) const { return &m_params[idx]; }
+
+	/// The path corridor of the agent.
+	inline const dtPathCorridor* getAgentCorridor(const int idx) const { return &m_corridors[idx]; }
+
+	/// The corners the agent steers along. [(x, y, z) * @p count]
+	inline const float* getAgentCorners(const int idx, int* count) const
+	{
+		*count = m_ncorners[idx];
+		return &m_cornerVerts[idx*DT_CROWDAGENT_MAX_CORNERS*3];
+	}
+
+	/// The neighbours the agent considered during the last update. [(agent index) * @p count]
+	inline const int* getAgentNeighbours(const int idx, int* count) const
+	{
+		*count = m_nneis[idx];
+		return &m_neis[idx*DT_CROWDAGENT_MAX_NEIGHBOURS];
+	}
+
+	/// The wall segments the agent avoided during the last update. [(ax, ay, az, bx, by, bz) * @p count]
+	inline const float* getAgentBoundary(const int idx, int* count) const
+	{
+		*count = m_nsegs[idx];
+		return &m_segs[idx*DT_CROWDAGENT_MAX_LOCAL_SEGS*6];
+	}
+
+	/// Gets the search halfExtents [(x, y, z)] used by the crowd for query operations.
+	/// @return The search halfExtents used by the crowd. [(x, y, z)]
+	inline const float* getQueryHalfExtents() const { return m_agentPlacementHalfExtents; }
+
+	/// Sets the search halfExtents used to place agents and targets on the navigation mesh.
+	inline void setQueryHalfExtents(const float* halfExtents) { dtVcopy(m_agentPlacementHalfExtents, halfExtents); }
+
+	/// Gets the query object of a worker.
+	inline const dtNavMeshQuery* getNavMeshQuery(const int worker = 0) const { return m_navqueries[worker]; }
+
+	/// Gets the grid the neighbours of the last update were found with.
+	inline const dtProximityGrid* getGrid() const { return &m_grid; }
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtCrowd(const dtCrowd&);
+	dtCrowd& operator=(const dtCrowd&);
+
+	void purge();
+
+	void updatePlanning(const int idx, dtNavMeshQuery* navquery, const dtQueryFilter* filter);
+	void findNeighbours(const int idx);
+	void updateBoundary(const int idx, dtNavMeshQuery* navquery, const dtQueryFilter* filter);
+	void steer(const int idx, dtNavMeshQuery* navquery, const dtQueryFilter* filter, dtOrcaSolver* orca);
+	void integrate(const int idx);
+	void collide(const int idx);
+	void move(const int idx, dtNavMeshQuery* navquery, const dtQueryFilter* filter);
+
+	int m_maxAgents;
+	float m_maxAgentRadius;
+	int m_maxPathResult;
+	int m_maxPathIter;
+	float m_dt;
+
+	// Per agent data.
+	unsigned char* m_active;
+	unsigned char* m_state;
+	unsigned char* m_targetState;
+	dtCrowdAgentParams* m_params;
+	dtPathCorridor* m_corridors;
+	float* m_pos;				///< Current position. [(x, y, z) * m_maxAgents]
+	float* m_npos;				///< Position after the tentative move. [(x, y, z) * m_maxAgents]
+	float* m_disp;				///< Displacement resolving collisions. [(x, y, z) * m_maxAgents]
+	float* m_vel;				///< Actual velocity. [(x, y, z) * m_maxAgents]
+	float* m_dvel;				///< Desired velocity. [(x, y, z) * m_maxAgents]
+	float* m_nvel;				///< Velocity after local steering. [(x, y, z) * m_maxAgents]
+	float* m_targetPos;			///< The requested target. [(x, y, z) * m_maxAgents]
+	dtPolyRef* m_targetRef;
+	unsigned char* m_targetAdjust;	///< True if the target was moved by adjustMoveTarget().
+	int* m_searchIter;			///< The path search iterations for the next update.
+	float* m_topologyOptTime;
+	float* m_cornerVerts;		///< [(x, y, z) * DT_CROWDAGENT_MAX_CORNERS * m_maxAgents]
+	unsigned char* m_cornerFlags;
+	dtPolyRef* m_cornerPolys;
+	int* m_ncorners;
+	int* m_neis;				///< [DT_CROWDAGENT_MAX_NEIGHBOURS * m_maxAgents]
+	int* m_nneis;
+	float* m_boundaryCenter;	///< The position the wall segments were collected at. [(x, y, z) * m_maxAgents]
+	dtPolyRef* m_boundaryRef;	///< The polygon the wall segments were collected from.
+	float* m_segs;				///< [(ax, ay, az, bx, by, bz) * DT_CROWDAGENT_MAX_LOCAL_SEGS * m_maxAgents]
+	int* m_nsegs;
+
+	int* m_activeList;
+	int m_nactive;
+
+	dtProximityGrid m_grid;
+
+	dtNavMeshQuery** m_navqueries;
+	dtOrcaSolver* m_orca;
+	int m_maxWorkers;
+
+	const dtQueryFilter* m_filters[DT_CROWD_MAX_QUERY_FILTER_TYPE];
+	dtQueryFilter m_defaultFilter;
+
+	float m_agentPlacementHalfExtents[3];
+};
+
+/// Allocates a crowd object using the Detour allocator.
+/// @return A crowd object that is ready for initialization, or null on failure.
+///  @ingroup crowd
+dtCrowd* dtAllocCrowd();
+
+/// Frees the specified crowd object using the Detour allocator.
+///  @param[in]		ptr		A crowd object allocated using #dtAllocCrowd
+///  @ingroup crowd
+void dtFreeCrowd(dtCrowd* ptr);
+
+#endif // DETOURCROWD_H
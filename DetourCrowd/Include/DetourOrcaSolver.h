@@ -0,0 +1,139 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+
+#ifndef DETOURORCASOLVER_H
+#define DETOURORCASOLVER_H
+
+/// The maximum number of neighbour agents a solve takes into account.
+/// @ingroup crowd
+static const int DT_ORCA_MAX_NEIGHBOURS = 16;
+
+/// The maximum number of wall segments a solve takes into account.
+/// @ingroup crowd
+static const int DT_ORCA_MAX_SEGMENTS = 16;
+
+/// The maximum number of constraints of a solve.
+/// @ingroup crowd
+static const int DT_ORCA_MAX_LINES = DT_ORCA_MAX_NEIGHBOURS + DT_ORCA_MAX_SEGMENTS;
+
+/// A constraint of the velocity solve on the xz-plane. The velocities allowed by the line
+/// lie on its left side, looking along the direction. The solver loads four lines at a time
+/// as four floats each.
+/// @ingroup crowd
+struct dtOrcaLine
+{
+	float point[2];		///< A velocity on the line. [(x, z)]
+	float dir[2];		///< The unit direction of the line. [(x, z)]
+};
+
+/// Finds collision free velocities with optimal reciprocal collision avoidance (ORCA).
+///
+/// Every neighbour and every wall segment of an agent limits the velocities the agent may
+/// take to a half-plane, and the velocity closest to the desired velocity that satisfies all
+/// of them is found with a small linear program. Neighbours are assumed to avoid the agent
+/// just as well, so each agent takes half of the avoidance of a neighbour. Walls are hard
+/// constraints, the constraints of neighbours are relaxed first when no velocity satisfies
+/// all of them.
+///
+/// The neighbours and segments of an agent are collected with reset(), addNeighbour() and
+/// addSegment(). The linear program checks a constraint against the ones before it four at a
+/// time with SSE, or with plain code where SSE is not available or DT_ORCA_NO_SIMD is defined.
+/// The solver does not allocate, so a batch of agents is solved by reusing one solver per
+/// thread for all of them.
+/// @ingroup crowd
+class dtOrcaSolver
+{
+public:
+	dtOrcaSolver();
+
+	/// Sets how far ahead collisions are avoided.
+	///  @param[in]		agentHorizon		The time, in seconds, collisions with other agents are avoided for. [Limit: > 0]
+	///  @param[in]		obstacleHorizon		The time, in seconds, collisions with walls are avoided for. [Limit: > 0]
+	void setTimeHorizons(const float agentHorizon, const float obstacleHorizon);
+
+	/// Starts the solve of an agent and removes the neighbours and segments of the previous one.
+	///  @param[in]		pos			The position of the agent. [(x, y, z)]
+	///  @param[in]		vel			The current velocity of the agent. [(x, y, z)]
+	///  @param[in]		radius		The radius of the agent. [Limit: >= 0]
+	///  @param[in]		wallRadius	The distance the agent keeps to wall segments. Usually the radius minus the
+	///  							radius the navigation mesh was eroded by. [Limit: >= 0]
+	///  @param[in]		maxSpeed	The maximum speed of the agent. [Limit: >= 0]
+	void reset(const float* pos, const float* vel, const float radius,
+			   const float wallRadius, const float maxSpeed);
+
+	/// Adds a neighbour agent to avoid. Neighbours past #DT_ORCA_MAX_NEIGHBOURS are ignored.
+	///  @param[in]		pos			The position of the neighbour. [(x, y, z)]
+	///  @param[in]		vel			The current velocity of the neighbour. [(x, y, z)]
+	///  @param[in]		radius		The radius of the neighbour. [Limit: >= 0]
+	void addNeighbour(const float* pos, const float* vel, const float radius);
+
+	/// Adds a wall segment to avoid. Segments past #DT_ORCA_MAX_SEGMENTS are ignored.
+	///  @param[in]		p			The start of the segment. [(x, y, z)]
+	///  @param[in]		q			The end of the segment. [(x, y, z)]
+	void addSegment(const float* p, const float* q);
+
+	/// Finds the velocity closest to the desired velocity that avoids the neighbours and segments.
+	///  @param[in]		dvel		The desired velocity. [(x, y, z)]
+	///  @param[in]		dt			The time step, in seconds, overlaps are resolved in. [Limit: > 0]
+	///  @param[out]	nvel		The new velocity. Its height is the one of @p dvel. [(x, y, z)]
+	/// @return True if the velocity satisfies all constraints, false if some neighbour
+	///  constraints had to be relaxed.
+	bool solve(const float* dvel, const float dt, float* nvel);
+
+	/// The number of constraints of the last solve.
+	inline int getLineCount() const { return m_nlines; }
+
+	/// The constraints of the last solve, the ones of wall segments first.
+	inline const dtOrcaLine* getLines() const { return m_lines; }
+
+private:
+	void buildSegmentLines(const float invDt);
+	void buildNeighbourLines(const float invDt);
+
+	float m_agentHorizon;
+	float m_obstacleHorizon;
+
+	float m_pos[2];
+	float m_vel[2];
+	float m_radius;
+	float m_wallRadius;
+	float m_maxSpeed;
+
+	// Neighbours relative to the agent.
+	float m_relPosX[DT_ORCA_MAX_NEIGHBOURS];
+	float m_relPosZ[DT_ORCA_MAX_NEIGHBOURS];
+	float m_relVelX[DT_ORCA_MAX_NEIGHBOURS];
+	float m_relVelZ[DT_ORCA_MAX_NEIGHBOURS];
+	float m_combinedRadius[DT_ORCA_MAX_NEIGHBOURS];
+	int m_nneis;
+
+	// Segment end points.
+	float m_segPX[DT_ORCA_MAX_SEGMENTS];
+	float m_segPZ[DT_ORCA_MAX_SEGMENTS];
+	float m_segQX[DT_ORCA_MAX_SEGMENTS];
+	float m_segQZ[DT_ORCA_MAX_SEGMENTS];
+	int m_nsegs;
+
+	dtOrcaLine m_lines[DT_ORCA_MAX_LINES];
+	int m_nlines;
+	int m_nobstacleLines;
+	dtOrcaLine m_projLines[DT_ORCA_MAX_LINES];
+};
+
+#endif // DETOURORCASOLVER_H
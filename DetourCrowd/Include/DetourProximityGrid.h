@@ -0,0 +1,87 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+
+#ifndef DETOURPROXIMITYGRID_H
+#define DETOURPROXIMITYGRID_H
+
+/// A spatial hash of items on the xz-plane, rebuilt from scratch for every query round.
+///
+/// The items are counting sorted by hash bucket into flat arrays, so building the grid does
+/// not allocate and the items of a cell are stored next to each other. Queries only read
+/// the grid and can run on several threads at the same time.
+/// @ingroup crowd
+class dtProximityGrid
+{
+public:
+	dtProximityGrid();
+	~dtProximityGrid();
+
+	/// Allocates the grid.
+	///  @param[in]		maxItems	The maximum number of items the grid can hold.
+	///  @param[in]		cellSize	The size of a grid cell on the xz-plane. [Limit: > 0]
+	/// @return True if the initialization succeeded.
+	bool init(const int maxItems, const float cellSize);
+
+	/// Rebuilds the grid.
+	///  @param[in]		ids			The ids of the items. [(id) * @p nitems]
+	///  @param[in]		nitems		The number of items. [Limit: <= maxItems]
+	///  @param[in]		pos			The positions of the items, indexed by item id. [(x, y, z) * (max id + 1)]
+	void build(const int* ids, const int nitems, const float* pos);
+
+	/// Finds the items in the cells overlapping a rectangle on the xz-plane. The items
+	/// are returned once each, but can lie outside the rectangle within their cell.
+	///  @param[in]		minx		The minimum x of the rectangle.
+	///  @param[in]		minz		The minimum z of the rectangle.
+	///  @param[in]		maxx		The maximum x of the rectangle.
+	///  @param[in]		maxz		The maximum z of the rectangle.
+	///  @param[out]	ids			The ids of the items found. [(id) * result]
+	///  @param[in]		maxIds		The maximum number of ids the buffer can hold.
+	/// @return The number of items found.
+	int queryItems(const float minx, const float minz, const float maxx, const float maxz,
+				   int* ids, const int maxIds) const;
+
+	/// The number of items in the grid.
+	inline int getItemCount() const { return m_nitems; }
+
+	/// The size of a grid cell.
+	inline float getCellSize() const { return m_cellSize; }
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtProximityGrid(const dtProximityGrid&);
+	dtProximityGrid& operator=(const dtProximityGrid&);
+
+	void purge();
+
+	float m_cellSize;
+	float m_invCellSize;
+
+	int m_maxItems;
+	int m_nitems;
+
+	int m_bucketsSize;		///< The number of hash buckets, a power of two.
+	int* m_buckets;			///< The first item of each bucket. [Size: m_bucketsSize + 1]
+
+	int* m_ids;				///< The item ids, sorted by bucket. [Size: m_maxItems]
+	int* m_cellx;			///< The cell of each sorted item. [Size: m_maxItems]
+	int* m_cellz;			///< The cell of each sorted item. [Size: m_maxItems]
+	int* m_itemBucket;		///< The bucket of each item in build order. [Size: m_maxItems]
+};
+
+#endif // DETOURPROXIMITYGRID_H
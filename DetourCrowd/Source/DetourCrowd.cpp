@@ -0,0 +1,1030 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+
+#include <string.h>
+#include <float.h>
+#include <new>
+#include "DetourCrowd.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourCommon.h"
+#include "DetourMath.h"
+#include "DetourAssert.h"
+#include "DetourAlloc.h"
+
+
+dtCrowd* dtAllocCrowd()
+{
+	void* mem = dtAlloc(sizeof(dtCrowd), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtCrowd;
+}
+
+void dtFreeCrowd(dtCrowd* ptr)
+{
+	if (!ptr) return;
+	ptr->~dtCrowd();
+	dtFree(ptr);
+}
+
+
+static const int MAX_PATHRESULT = 256;
+static const int MAX_COMMON_NODES = 2048;
+static const int MAX_ITERS_PER_UPDATE = 100;
+static const int MAX_NEIGHBOUR_CANDIDATES = 64;
+static const int MAX_LOCAL_POLYS = 16;
+static const int MAX_SEGS_PER_POLY = DT_VERTS_PER_POLYGON*3;
+
+static const float OPT_TIME_THR = 0.5f; // seconds
+static const float COLLISION_RESOLVE_FACTOR = 0.7f;
+
+
+template<class T> static bool allocArray(T*& arr, const int n)
+{
+	arr = (T*)dtAlloc(sizeof(T)*n, DT_ALLOC_PERM);
+	if (!arr)
+		return false;
+	memset(arr, 0, sizeof(T)*n);
+	return true;
+}
+
+static int addNeighbour(const int idx, const float dist,
+						int* neis, float* dists, const int nneis, const int maxNeis)
+{
+	// Insert neighbour based on the distance.
+	int i;
+	if (!nneis)
+	{
+		i = 0;
+	}
+	else if (dist >= dists[nneis-1])
+	{
+		if (nneis >= maxNeis)
+			return nneis;
+		i = nneis;
+	}
+	else
+	{
+		for (i = 0; i < nneis; ++i)
+			if (dist <= dists[i])
+				break;
+	}
+
+	const int tgt = i+1;
+	const int n = dtMin(nneis-i, maxNeis-tgt);
+
+	dtAssert(tgt+n <= maxNeis);
+
+	if (n > 0)
+	{
+		memmove(&neis[tgt], &neis[i], sizeof(int)*n);
+		memmove(&dists[tgt], &dists[i], sizeof(float)*n);
+	}
+	neis[i] = idx;
+	dists[i] = dist;
+
+	return dtMin(nneis+1, maxNeis);
+}
+
+static int addSegment(const float* seg, const float dist,
+					  float* segs, float* dists, const int nsegs, const int maxSegs)
+{
+	// Insert segment based on the distance, as the neighbours.
+	int i;
+	if (!nsegs)
+	{
+		i = 0;
+	}
+	else if (dist >= dists[nsegs-1])
+	{
+		if (nsegs >= maxSegs)
+			return nsegs;
+		i = nsegs;
+	}
+	else
+	{
+		for (i = 0; i < nsegs; ++i)
+			if (dist <= dists[i])
+				break;
+	}
+
+	const int tgt = i+1;
+	const int n = dtMin(nsegs-i, maxSegs-tgt);
+
+	if (n > 0)
+	{
+		memmove(&segs[tgt*6], &segs[i*6], sizeof(float)*6*n);
+		memmove(&dists[tgt], &dists[i], sizeof(float)*n);
+	}
+	memcpy(&segs[i*6], seg, sizeof(float)*6);
+	dists[i] = dist;
+
+	return dtMin(nsegs+1, maxSegs);
+}
+
+
+/**
+@class dtCrowd
+@par
+
+This is the core class of the @ref crowd module. See the @ref crowd documentation for a summary
+of the crowd features.
+
+A common method for setting up the crowd is as follows:
+
+-# Allocate the crowd using #dtAllocCrowd.
+-# Initialize the crowd using #init(), with one worker per thread that will run updates.
+-# Set the query filters using #setFilter().
+-# Add agents using #addAgent() and make requests using #requestMoveTarget().
+
+A common process for managing the crowd is as follows:
+
+-# Call #update() to allow the crowd to manage its agents, or call #beginUpdate() and then
+   #updatePhase() for every step of #dtCrowdUpdatePhase, splitting the active agents of each
+   step over the worker threads.
+-# Retrieve agent information using #getAgentPosition() and the other agent accessors.
+-# Make movement requests using #requestMoveTarget() when movement goal changes.
+-# Repeat every frame.
+
+Agents are never moved while an update is running, so adding and removing agents and making
+requests must not happen at the same time as an update. The same holds for changes of the
+navigation mesh, e.g. tile cache updates.
+
+@note This is a per-agent simulation; its cost grows linearly with the number of active
+agents, split over the workers.
+*/
+
+dtCrowd::dtCrowd() :
+	m_maxAgents(0),
+	m_maxAgentRadius(0),
+	m_maxPathResult(0),
+	m_maxPathIter(MAX_ITERS_PER_UPDATE),
+	m_dt(0),
+	m_active(0),
+	m_state(0),
+	m_targetState(0),
+	m_params(0),
+	m_corridors(0),
+	m_pos(0),
+	m_npos(0),
+	m_disp(0),
+	m_vel(0),
+	m_dvel(0),
+	m_nvel(0),
+	m_targetPos(0),
+	m_targetRef(0),
+	m_targetAdjust(0),
+	m_searchIter(0),
+	m_topologyOptTime(0),
+	m_cornerVerts(0),
+	m_cornerFlags(0),
+	m_cornerPolys(0),
+	m_ncorners(0),
+	m_neis(0),
+	m_nneis(0),
+	m_boundaryCenter(0),
+	m_boundaryRef(0),
+	m_segs(0),
+	m_nsegs(0),
+	m_activeList(0),
+	m_nactive(0),
+	m_navqueries(0),
+	m_orca(0),
+	m_maxWorkers(0)
+{
+	for (int i = 0; i < DT_CROWD_MAX_QUERY_FILTER_TYPE; ++i)
+		m_filters[i] = &m_defaultFilter;
+	dtVset(m_agentPlacementHalfExtents, 0, 0, 0);
+}
+
+dtCrowd::~dtCrowd()
+{
+	purge();
+}
+
+void dtCrowd::purge()
+{
+	if (m_corridors)
+	{
+		for (int i = 0; i < m_maxAgents; ++i)
+			m_corridors[i].~dtPathCorridor();
+	}
+	dtFree(m_corridors);
+	m_corridors = 0;
+
+	if (m_navqueries)
+	{
+		for (int i = 0; i < m_maxWorkers; ++i)
+			dtFreeNavMeshQuery(m_navqueries[i]);
+	}
+	dtFree(m_navqueries);
+	m_navqueries = 0;
+
+	if (m_orca)
+	{
+		for (int i = 0; i < m_maxWorkers; ++i)
+			m_orca[i].~dtOrcaSolver();
+	}
+	dtFree(m_orca);
+	m_orca = 0;
+	m_maxWorkers = 0;
+
+	dtFree(m_active);
+	dtFree(m_state);
+	dtFree(m_targetState);
+	dtFree(m_params);
+	dtFree(m_pos);
+	dtFree(m_npos);
+	dtFree(m_disp);
+	dtFree(m_vel);
+	dtFree(m_dvel);
+	dtFree(m_nvel);
+	dtFree(m_targetPos);
+	dtFree(m_targetRef);
+	dtFree(m_targetAdjust);
+	dtFree(m_searchIter);
+	dtFree(m_topologyOptTime);
+	dtFree(m_cornerVerts);
+	dtFree(m_cornerFlags);
+	dtFree(m_cornerPolys);
+	dtFree(m_ncorners);
+	dtFree(m_neis);
+	dtFree(m_nneis);
+	dtFree(m_boundaryCenter);
+	dtFree(m_boundaryRef);
+	dtFree(m_segs);
+	dtFree(m_nsegs);
+	dtFree(m_activeList);
+	m_active = 0;
+	m_state = 0;
+	m_targetState = 0;
+	m_params = 0;
+	m_pos = 0;
+	m_npos = 0;
+	m_disp = 0;
+	m_vel = 0;
+	m_dvel = 0;
+	m_nvel = 0;
+	m_targetPos = 0;
+	m_targetRef = 0;
+	m_targetAdjust = 0;
+	m_searchIter = 0;
+	m_topologyOptTime = 0;
+	m_cornerVerts = 0;
+	m_cornerFlags = 0;
+	m_cornerPolys = 0;
+	m_ncorners = 0;
+	m_neis = 0;
+	m_nneis = 0;
+	m_boundaryCenter = 0;
+	m_boundaryRef = 0;
+	m_segs = 0;
+	m_nsegs = 0;
+	m_activeList = 0;
+
+	m_maxAgents = 0;
+	m_nactive = 0;
+}
+
+/// @par
+///
+/// May be called more than once to purge and re-initialize the crowd.
+bool dtCrowd::init(const int maxAgents, const float maxAgentRadius, dtNavMesh* nav, const int maxWorkers)
+{
+	dtAssert(maxAgents > 0);
+	dtAssert(maxWorkers > 0);
+
+	purge();
+
+	m_maxAgentRadius = maxAgentRadius;
+
+	// Larger than agent radius because it is also used for agent recovery.
+	dtVset(m_agentPlacementHalfExtents, m_maxAgentRadius*2.0f, m_maxAgentRadius*1.5f, m_maxAgentRadius*2.0f);
+
+	if (!m_grid.init(maxAgents, m_maxAgentRadius*3))
+		return false;
+
+	m_maxWorkers = maxWorkers;
+	m_navqueries = (dtNavMeshQuery**)dtAlloc(sizeof(dtNavMeshQuery*)*m_maxWorkers, DT_ALLOC_PERM);
+	if (!m_navqueries)
+		return false;
+	memset(m_navqueries, 0, sizeof(dtNavMeshQuery*)*m_maxWorkers);
+	for (int i = 0; i < m_maxWorkers; ++i)
+	{
+		m_navqueries[i] = dtAllocNavMeshQuery();
+		if (!m_navqueries[i])
+			return false;
+		if (dtStatusFailed(m_navqueries[i]->init(nav, MAX_COMMON_NODES)))
+			return false;
+	}
+
+	m_orca = (dtOrcaSolver*)dtAlloc(sizeof(dtOrcaSolver)*m_maxWorkers, DT_ALLOC_PERM);
+	if (!m_orca)
+		return false;
+	for (int i = 0; i < m_maxWorkers; ++i)
+		new(&m_orca[i]) dtOrcaSolver();
+
+	m_maxAgents = maxAgents;
+	if (!allocArray(m_active, m_maxAgents) ||
+		!allocArray(m_state, m_maxAgents) ||
+		!allocArray(m_targetState, m_maxAgents) ||
+		!allocArray(m_params, m_maxAgents) ||
+		!allocArray(m_pos, m_maxAgents*3) ||
+		!allocArray(m_npos, m_maxAgents*3) ||
+		!allocArray(m_disp, m_maxAgents*3) ||
+		!allocArray(m_vel, m_maxAgents*3) ||
+		!allocArray(m_dvel, m_maxAgents*3) ||
+		!allocArray(m_nvel, m_maxAgents*3) ||
+		!allocArray(m_targetPos, m_maxAgents*3) ||
+		!allocArray(m_targetRef, m_maxAgents) ||
+		!allocArray(m_targetAdjust, m_maxAgents) ||
+		!allocArray(m_searchIter, m_maxAgents) ||
+		!allocArray(m_topologyOptTime, m_maxAgents) ||
+		!allocArray(m_cornerVerts, m_maxAgents*DT_CROWDAGENT_MAX_CORNERS*3) ||
+		!allocArray(m_cornerFlags, m_maxAgents*DT_CROWDAGENT_MAX_CORNERS) ||
+		!allocArray(m_cornerPolys, m_maxAgents*DT_CROWDAGENT_MAX_CORNERS) ||
+		!allocArray(m_ncorners, m_maxAgents) ||
+		!allocArray(m_neis, m_maxAgents*DT_CROWDAGENT_MAX_NEIGHBOURS) ||
+		!allocArray(m_nneis, m_maxAgents) ||
+		!allocArray(m_boundaryCenter, m_maxAgents*3) ||
+		!allocArray(m_boundaryRef, m_maxAgents) ||
+		!allocArray(m_segs, m_maxAgents*DT_CROWDAGENT_MAX_LOCAL_SEGS*6) ||
+		!allocArray(m_nsegs, m_maxAgents) ||
+		!allocArray(m_activeList, m_maxAgents))
+	{
+		m_maxAgents = 0;
+		return false;
+	}
+
+	m_corridors = (dtPathCorridor*)dtAlloc(sizeof(dtPathCorridor)*maxAgents, DT_ALLOC_PERM);
+	if (!m_corridors)
+	{
+		m_maxAgents = 0;
+		return false;
+	}
+	for (int i = 0; i < m_maxAgents; ++i)
+	{
+		new(&m_corridors[i]) dtPathCorridor();
+		if (!m_corridors[i].init(MAX_PATHRESULT))
+			return false;
+	}
+	m_maxPathResult = MAX_PATHRESULT;
+
+	return true;
+}
+
+void dtCrowd::setFilter(const int idx, const dtQueryFilter* filter)
+{
+	if (idx >= 0 && idx < DT_CROWD_MAX_QUERY_FILTER_TYPE)
+		m_filters[idx] = filter ? filter : &m_defaultFilter;
+}
+
+void dtCrowd::setAvoidanceHorizons(const float agentHorizon, const float obstacleHorizon)
+{
+	for (int i = 0; i < m_maxWorkers; ++i)
+		m_orca[i].setTimeHorizons(agentHorizon, obstacleHorizon);
+}
+
+void dtCrowd::updateAgentParameters(const int idx, const dtCrowdAgentParams* params)
+{
+	if (idx < 0 || idx >= m_maxAgents)
+		return;
+	memcpy(&m_params[idx], params, sizeof(dtCrowdAgentParams));
+	if (m_params[idx].queryFilterType >= DT_CROWD_MAX_QUERY_FILTER_TYPE)
+		m_params[idx].queryFilterType = 0;
+}
+
+/// @par
+///
+/// The agent's position will be constrained to the surface of the navigation mesh.
+int dtCrowd::addAgent(const float* pos, const dtCrowdAgentParams* params)
+{
+	// Find empty slot.
+	int idx = -1;
+	for (int i = 0; i < m_maxAgents; ++i)
+	{
+		if (!m_active[i])
+		{
+			idx = i;
+			break;
+		}
+	}
+	if (idx == -1)
+		return -1;
+
+	updateAgentParameters(idx, params);
+
+	// Find nearest position on navmesh and place the agent there.
+	float nearest[3];
+	dtPolyRef ref = 0;
+	dtVcopy(nearest, pos);
+	dtStatus status = m_navqueries[0]->findNearestPoly(pos, m_agentPlacementHalfExtents, m_filters[m_params[idx].queryFilterType], &ref, nearest);
+	if (dtStatusFailed(status))
+	{
+		dtVcopy(nearest, pos);
+		ref = 0;
+	}
+
+	m_corridors[idx].reset(ref, nearest);
+
+	m_topologyOptTime[idx] = 0;
+	m_nneis[idx] = 0;
+	m_ncorners[idx] = 0;
+	m_nsegs[idx] = 0;
+	m_boundaryRef[idx] = 0;
+
+	dtVcopy(&m_pos[idx*3], nearest);
+	dtVcopy(&m_npos[idx*3], nearest);
+	dtVset(&m_disp[idx*3], 0, 0, 0);
+	dtVset(&m_vel[idx*3], 0, 0, 0);
+	dtVset(&m_dvel[idx*3], 0, 0, 0);
+	dtVset(&m_nvel[idx*3], 0, 0, 0);
+
+	m_state[idx] = ref ? (unsigned char)DT_CROWDAGENT_STATE_WALKING : (unsigned char)DT_CROWDAGENT_STATE_INVALID;
+	m_targetState[idx] = DT_CROWDAGENT_TARGET_NONE;
+	m_targetRef[idx] = 0;
+	m_targetAdjust[idx] = 0;
+	m_searchIter[idx] = m_maxPathIter;
+
+	m_active[idx] = 1;
+
+	return idx;
+}
+
+/// @par
+///
+/// The agent is deactivated and will no longer be processed. Its index is marked as
+/// inactive so that it is available for reuse.
+void dtCrowd::removeAgent(const int idx)
+{
+	if (idx >= 0 && idx < m_maxAgents)
+		m_active[idx] = 0;
+}
+
+/// @par
+///
+/// This method is used when a new target is set. The corridor is emptied and searched
+/// towards the target over the following updates.
+///
+/// The position will be constrained to the surface of the navigation mesh.
+bool dtCrowd::requestMoveTarget(const int idx, dtPolyRef ref, const float* pos)
+{
+	if (idx < 0 || idx >= m_maxAgents)
+		return false;
+	if (!ref)
+		return false;
+
+	// Initialize request.
+	m_targetRef[idx] = ref;
+	dtVcopy(&m_targetPos[idx*3], pos);
+	m_targetAdjust[idx] = 0;
+	m_targetState[idx] = DT_CROWDAGENT_TARGET_REQUESTING;
+	m_searchIter[idx] = m_maxPathIter;
+
+	// The search starts from the agent.
+	dtPathCorridor& corridor = m_corridors[idx];
+	corridor.reset(corridor.getFirstPoly(), &m_pos[idx*3]);
+
+	return true;
+}
+
+bool dtCrowd::adjustMoveTarget(const int idx, dtPolyRef ref, const float* pos)
+{
+	if (idx < 0 || idx >= m_maxAgents)
+		return false;
+	if (!ref)
+		return false;
+
+	// Without a corridor to adjust this is a new request.
+	if (m_targetState[idx] != DT_CROWDAGENT_TARGET_VALID &&
+		m_targetState[idx] != DT_CROWDAGENT_TARGET_REQUESTING)
+		return requestMoveTarget(idx, ref, pos);
+
+	m_targetRef[idx] = ref;
+	dtVcopy(&m_targetPos[idx*3], pos);
+	m_targetAdjust[idx] = 1;
+
+	return true;
+}
+
+bool dtCrowd::resetMoveTarget(const int idx)
+{
+	if (idx < 0 || idx >= m_maxAgents)
+		return false;
+
+	// Initialize request.
+	m_targetRef[idx] = 0;
+	dtVset(&m_targetPos[idx*3], 0, 0, 0);
+	dtVset(&m_dvel[idx*3], 0, 0, 0);
+	m_targetAdjust[idx] = 0;
+	m_targetState[idx] = DT_CROWDAGENT_TARGET_NONE;
+
+	dtPathCorridor& corridor = m_corridors[idx];
+	corridor.reset(corridor.getFirstPoly(), &m_pos[idx*3]);
+
+	return true;
+}
+
+void dtCrowd::update(const float dt)
+{
+	const int nactive = beginUpdate(dt);
+	for (int phase = 0; phase < DT_CROWD_PHASE_COUNT; ++phase)
+		updatePhase(phase, 0, nactive, 0);
+}
+
+int dtCrowd::beginUpdate(const float dt)
+{
+	m_dt = dt;
+
+	m_nactive = 0;
+	for (int i = 0; i < m_maxAgents; ++i)
+	{
+		if (m_active[i] && m_state[i] == DT_CROWDAGENT_STATE_WALKING)
+			m_activeList[m_nactive++] = i;
+	}
+
+	// Neighbours are searched from the positions at the start of the update.
+	m_grid.build(m_activeList, m_nactive, m_pos);
+
+	return m_nactive;
+}
+
+void dtCrowd::updatePhase(const int phase, const int begin, const int end, const int worker)
+{
+	dtAssert(worker >= 0 && worker < m_maxWorkers);
+
+	dtNavMeshQuery* navquery = m_navqueries[worker];
+	dtOrcaSolver* orca = &m_orca[worker];
+	const int last = dtMin(end, m_nactive);
+
+	for (int i = dtMax(begin, 0); i < last; ++i)
+	{
+		const int idx = m_activeList[i];
+		const dtQueryFilter* filter = m_filters[m_params[idx].queryFilterType];
+
+		switch (phase)
+		{
+		case DT_CROWD_PHASE_STEER:
+			updatePlanning(idx, navquery, filter);
+			if (m_state[idx] != DT_CROWDAGENT_STATE_WALKING)
+			{
+				dtVset(&m_dvel[idx*3], 0, 0, 0);
+				dtVset(&m_nvel[idx*3], 0, 0, 0);
+				m_nneis[idx] = 0;
+				m_ncorners[idx] = 0;
+				m_nsegs[idx] = 0;
+				break;
+			}
+			steer(idx, navquery, filter, orca);
+			break;
+		case DT_CROWD_PHASE_INTEGRATE:
+			integrate(idx);
+			break;
+		case DT_CROWD_PHASE_COLLIDE:
+			collide(idx);
+			break;
+		case DT_CROWD_PHASE_MOVE:
+			move(idx, navquery, filter);
+			break;
+		}
+	}
+}
+
+void dtCrowd::updatePlanning(const int idx, dtNavMeshQuery* navquery, const dtQueryFilter* filter)
+{
+	dtPathCorridor& corridor = m_corridors[idx];
+	const float* pos = &m_pos[idx*3];
+	unsigned char& targetState = m_targetState[idx];
+	const bool hasTarget = targetState == DT_CROWDAGENT_TARGET_VALID ||
+						   targetState == DT_CROWDAGENT_TARGET_REQUESTING;
+
+	// Tiles rebuilt under the agent replace its polygon, find it again.
+	dtPolyRef agentRef = corridor.getFirstPoly();
+	if (!navquery->isValidPolyRef(agentRef, filter))
+	{
+		float nearest[3];
+		dtVcopy(nearest, pos);
+		agentRef = 0;
+		navquery->findNearestPoly(pos, m_agentPlacementHalfExtents, filter, &agentRef, nearest);
+		if (!agentRef)
+		{
+			// Could not find location in navmesh, set state to invalid.
+			corridor.reset(0, pos);
+			m_state[idx] = DT_CROWDAGENT_STATE_INVALID;
+			targetState = DT_CROWDAGENT_TARGET_NONE;
+			return;
+		}
+
+		// Only the corridor is moved, other agents may be reading the position. The
+		// position follows the corridor at the end of the update.
+		if (!corridor.fixPathStart(agentRef, nearest) && hasTarget)
+			targetState = DT_CROWDAGENT_TARGET_REQUESTING;
+	}
+
+	if (!hasTarget)
+		return;
+
+	// The target polygon can be replaced the same way.
+	float* targetPos = &m_targetPos[idx*3];
+	if (!navquery->isValidPolyRef(m_targetRef[idx], filter))
+	{
+		float nearest[3];
+		dtPolyRef ref = 0;
+		dtVcopy(nearest, targetPos);
+		navquery->findNearestPoly(targetPos, m_agentPlacementHalfExtents, filter, &ref, nearest);
+		if (!ref)
+		{
+			corridor.reset(agentRef, corridor.getPos());
+			targetState = DT_CROWDAGENT_TARGET_FAILED;
+			return;
+		}
+		m_targetRef[idx] = ref;
+		dtVcopy(targetPos, nearest);
+	}
+
+	// Cut the corridor at polygons that were removed or closed, the part before them is kept.
+	if (corridor.trimInvalidPath(agentRef, corridor.getPos(), navquery, filter))
+		targetState = DT_CROWDAGENT_TARGET_REQUESTING;
+
+	// Move the end of the corridor along with an adjusted target.
+	if (m_targetAdjust[idx])
+	{
+		m_targetAdjust[idx] = 0;
+		if (!corridor.moveTargetPosition(targetPos, navquery, filter) ||
+			corridor.getLastPoly() != m_targetRef[idx])
+			targetState = DT_CROWDAGENT_TARGET_REQUESTING;
+	}
+	else if (targetState == DT_CROWDAGENT_TARGET_VALID && corridor.getLastPoly() != m_targetRef[idx])
+	{
+		targetState = DT_CROWDAGENT_TARGET_REQUESTING;
+	}
+
+	if (targetState == DT_CROWDAGENT_TARGET_REQUESTING)
+	{
+		// Extend the corridor towards the target, a limited number of iterations per update.
+		const dtPolyRef lastRef = corridor.getLastPoly();
+		const int npath = corridor.getPathCount();
+		const dtStatus status = corridor.replanPathEnd(m_targetRef[idx], targetPos, m_searchIter[idx], navquery, filter);
+
+		if (dtStatusFailed(status))
+		{
+			targetState = DT_CROWDAGENT_TARGET_FAILED;
+		}
+		else if (!dtStatusDetail(status, DT_PARTIAL_RESULT))
+		{
+			targetState = DT_CROWDAGENT_TARGET_VALID;
+			m_searchIter[idx] = m_maxPathIter;
+		}
+		else if (corridor.getLastPoly() != lastRef || corridor.getPathCount() != npath)
+		{
+			m_searchIter[idx] = m_maxPathIter;
+		}
+		else if (m_searchIter[idx] < MAX_COMMON_NODES && corridor.getPathCount() < m_maxPathResult)
+		{
+			// The search could not get closer to the target, e.g. behind a wall. Search
+			// further next time, as the search is started from scratch every update.
+			m_searchIter[idx] = dtMin(m_searchIter[idx]*2, MAX_COMMON_NODES);
+		}
+		else
+		{
+			targetState = DT_CROWDAGENT_TARGET_FAILED;
+		}
+		m_topologyOptTime[idx] = 0;
+	}
+	else
+	{
+		// Look for a shorter way near the agent now and then.
+		m_topologyOptTime[idx] += m_dt;
+		if (m_topologyOptTime[idx] >= OPT_TIME_THR)
+		{
+			corridor.optimizePathTopology(navquery, filter);
+			m_topologyOptTime[idx] = 0;
+		}
+	}
+}
+
+void dtCrowd::findNeighbours(const int idx)
+{
+	const dtCrowdAgentParams& params = m_params[idx];
+	const float* pos = &m_pos[idx*3];
+	const float range = params.collisionQueryRange;
+
+	int ids[MAX_NEIGHBOUR_CANDIDATES];
+	const int nids = m_grid.queryItems(pos[0]-range, pos[2]-range,
+									   pos[0]+range, pos[2]+range,
+									   ids, MAX_NEIGHBOUR_CANDIDATES);
+
+	int* neis = &m_neis[idx*DT_CROWDAGENT_MAX_NEIGHBOURS];
+	float dists[DT_CROWDAGENT_MAX_NEIGHBOURS];
+	int nneis = 0;
+
+	for (int i = 0; i < nids; ++i)
+	{
+		const int nei = ids[i];
+		if (nei == idx)
+			continue;
+
+		// Check for overlap.
+		float diff[3];
+		dtVsub(diff, pos, &m_pos[nei*3]);
+		if (dtMathFabsf(diff[1]) >= (params.height + m_params[nei].height)/2.0f)
+			continue;
+		diff[1] = 0;
+		const float distSqr = dtVlenSqr(diff);
+		if (distSqr > dtSqr(range))
+			continue;
+
+		nneis = addNeighbour(nei, distSqr, neis, dists, nneis, DT_CROWDAGENT_MAX_NEIGHBOURS);
+	}
+
+	m_nneis[idx] = nneis;
+}
+
+void dtCrowd::updateBoundary(const int idx, dtNavMeshQuery* navquery, const dtQueryFilter* filter)
+{
+	const dtPathCorridor& corridor = m_corridors[idx];
+	const dtCrowdAgentParams& params = m_params[idx];
+	const float* pos = corridor.getPos();
+	const dtPolyRef ref = corridor.getFirstPoly();
+	float* center = &m_boundaryCenter[idx*3];
+
+	// The walls are collected again when the agent moved a quarter of the query range or
+	// entered another polygon, which also happens when its tile was rebuilt.
+	const float updateThr = params.collisionQueryRange*0.25f;
+	if (ref == m_boundaryRef[idx] && dtVdist2DSqr(pos, center) < dtSqr(updateThr))
+		return;
+
+	dtVcopy(center, pos);
+	m_boundaryRef[idx] = ref;
+
+	float* segs = &m_segs[idx*DT_CROWDAGENT_MAX_LOCAL_SEGS*6];
+	float dists[DT_CROWDAGENT_MAX_LOCAL_SEGS];
+	int nsegs = 0;
+
+	dtPolyRef polys[MAX_LOCAL_POLYS];
+	int npolys = 0;
+	navquery->findLocalNeighbourhood(ref, pos, params.collisionQueryRange, filter,
+									 polys, 0, &npolys, MAX_LOCAL_POLYS);
+
+	for (int j = 0; j < npolys; ++j)
+	{
+		float polySegs[MAX_SEGS_PER_POLY*6];
+		int npolySegs = 0;
+		navquery->getPolyWallSegments(polys[j], filter, polySegs, 0, &npolySegs, MAX_SEGS_PER_POLY);
+		for (int k = 0; k < npolySegs; ++k)
+		{
+			const float* s = &polySegs[k*6];
+			float tseg;
+			const float distSqr = dtDistancePtSegSqr2D(pos, s, s+3, tseg);
+			if (distSqr > dtSqr(params.collisionQueryRange))
+				continue;
+			nsegs = addSegment(s, distSqr, segs, dists, nsegs, DT_CROWDAGENT_MAX_LOCAL_SEGS);
+		}
+	}
+
+	m_nsegs[idx] = nsegs;
+}
+
+void dtCrowd::steer(const int idx, dtNavMeshQuery* navquery, const dtQueryFilter* filter, dtOrcaSolver* orca)
+{
+	dtPathCorridor& corridor = m_corridors[idx];
+	const dtCrowdAgentParams& params = m_params[idx];
+	const float* pos = corridor.getPos();
+	float* cornerVerts = &m_cornerVerts[idx*DT_CROWDAGENT_MAX_CORNERS*3];
+	unsigned char* cornerFlags = &m_cornerFlags[idx*DT_CROWDAGENT_MAX_CORNERS];
+	dtPolyRef* cornerPolys = &m_cornerPolys[idx*DT_CROWDAGENT_MAX_CORNERS];
+	const unsigned char targetState = m_targetState[idx];
+	const bool hasTarget = targetState == DT_CROWDAGENT_TARGET_VALID ||
+						   targetState == DT_CROWDAGENT_TARGET_REQUESTING;
+
+	// Find the corners to steer along.
+	int ncorners = 0;
+	if (hasTarget)
+	{
+		ncorners = corridor.findCorners(cornerVerts, cornerFlags, cornerPolys,
+										DT_CROWDAGENT_MAX_CORNERS, navquery);
+
+		// Check to see if the corner after the next corner is directly visible,
+		// and short cut to there.
+		if (ncorners > 0)
+		{
+			const float* target = &cornerVerts[dtMin(1, ncorners-1)*3];
+			corridor.optimizePathVisibility(target, params.pathOptimizationRange, navquery, filter);
+		}
+
+		// The crowd has no animation for off-mesh connections, so agents close enough
+		// to the start of one are moved to its end right away.
+		if (ncorners > 0 && (cornerFlags[ncorners-1] & DT_STRAIGHTPATH_OFFMESH_CONNECTION))
+		{
+			const float triggerRadius = params.radius*2.25f;
+			if (dtVdist2DSqr(pos, &cornerVerts[(ncorners-1)*3]) < dtSqr(triggerRadius))
+			{
+				dtPolyRef refs[2];
+				float startPos[3], endPos[3];
+				if (corridor.moveOverOffmeshConnection(cornerPolys[ncorners-1], refs, startPos, endPos, navquery))
+				{
+					ncorners = corridor.findCorners(cornerVerts, cornerFlags, cornerPolys,
+													DT_CROWDAGENT_MAX_CORNERS, navquery);
+				}
+			}
+		}
+	}
+	m_ncorners[idx] = ncorners;
+
+	findNeighbours(idx);
+
+	// Calculate steering.
+	float dvel[3] = {0,0,0};
+
+	if (hasTarget && ncorners > 0)
+	{
+		float dir[3];
+		dtVsub(dir, &cornerVerts[0], pos);
+		dir[1] = 0;
+		const float dist = dtVlen(dir);
+
+		// Slow down when the end of the corridor is close.
+		float speedScale = 1.0f;
+		if (cornerFlags[ncorners-1] & DT_STRAIGHTPATH_END)
+		{
+			const float slowDownRadius = params.radius*2;
+			const float distToGoal = dtVdist2D(pos, &cornerVerts[(ncorners-1)*3]);
+			speedScale = dtMin(distToGoal, slowDownRadius) / slowDownRadius;
+		}
+
+		if (dist > 0.0001f)
+			dtVscale(dvel, dir, params.maxSpeed*speedScale/dist);
+	}
+
+	// Separation
+	if (params.separationWeight > 0.001f)
+	{
+		const float separationDist = params.collisionQueryRange;
+		const float invSeparationDist = 1.0f / separationDist;
+		const int* neis = &m_neis[idx*DT_CROWDAGENT_MAX_NEIGHBOURS];
+
+		float w = 0;
+		float disp[3] = {0,0,0};
+
+		for (int j = 0; j < m_nneis[idx]; ++j)
+		{
+			float diff[3];
+			dtVsub(diff, pos, &m_pos[neis[j]*3]);
+			diff[1] = 0;
+
+			const float distSqr = dtVlenSqr(diff);
+			if (distSqr < 0.00001f)
+				continue;
+			if (distSqr > dtSqr(separationDist))
+				continue;
+			const float dist = dtMathSqrtf(distSqr);
+			const float weight = params.separationWeight * (1.0f - dtSqr(dist*invSeparationDist));
+
+			dtVmad(disp, disp, diff, weight/dist);
+			w += 1.0f;
+		}
+
+		if (w > 0.0001f)
+		{
+			// Adjust desired velocity.
+			dtVmad(dvel, dvel, disp, 1.0f/w);
+			// Clamp desired velocity to desired speed.
+			const float speedSqr = dtVlenSqr(dvel);
+			const float desiredSqr = dtSqr(params.maxSpeed);
+			if (speedSqr > desiredSqr)
+				dtVscale(dvel, dvel, dtMathSqrtf(desiredSqr/speedSqr));
+		}
+	}
+
+	dtVcopy(&m_dvel[idx*3], dvel);
+
+	// Velocity planning.
+	if (params.updateFlags & DT_CROWD_OBSTACLE_AVOIDANCE)
+	{
+		updateBoundary(idx, navquery, filter);
+
+		// The navigation mesh is already shrunk by the radius its tiles were built for.
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		navquery->getAttachedNavMesh()->getTileAndPolyByRefUnsafe(corridor.getFirstPoly(), &tile, &poly);
+		const float wallRadius = dtMax(params.radius - tile->header->walkableRadius, 0.0f);
+
+		orca->reset(pos, &m_vel[idx*3], params.radius, wallRadius, params.maxSpeed);
+
+		const int* neis = &m_neis[idx*DT_CROWDAGENT_MAX_NEIGHBOURS];
+		for (int j = 0; j < m_nneis[idx]; ++j)
+			orca->addNeighbour(&m_pos[neis[j]*3], &m_vel[neis[j]*3], m_params[neis[j]].radius);
+
+		const float* segs = &m_segs[idx*DT_CROWDAGENT_MAX_LOCAL_SEGS*6];
+		for (int j = 0; j < m_nsegs[idx]; ++j)
+			orca->addSegment(&segs[j*6], &segs[j*6+3]);
+
+		orca->solve(dvel, m_dt, &m_nvel[idx*3]);
+	}
+	else
+	{
+		// If not using velocity planning, new velocity is directly the desired velocity.
+		m_nsegs[idx] = 0;
+		dtVcopy(&m_nvel[idx*3], dvel);
+	}
+}
+
+void dtCrowd::integrate(const int idx)
+{
+	const dtCrowdAgentParams& params = m_params[idx];
+	const float* pos = m_corridors[idx].getPos();
+	float* vel = &m_vel[idx*3];
+
+	// Fake dynamic constraint.
+	const float maxDelta = params.maxAcceleration * m_dt;
+	float dv[3];
+	dtVsub(dv, &m_nvel[idx*3], vel);
+	const float ds = dtVlen(dv);
+	if (ds > maxDelta)
+		dtVscale(dv, dv, maxDelta/ds);
+	dtVadd(vel, vel, dv);
+
+	// Integrate
+	if (dtVlen(vel) > 0.0001f)
+		dtVmad(&m_npos[idx*3], pos, vel, m_dt);
+	else
+	{
+		dtVset(vel, 0, 0, 0);
+		dtVcopy(&m_npos[idx*3], pos);
+	}
+}
+
+void dtCrowd::collide(const int idx)
+{
+	const dtCrowdAgentParams& params = m_params[idx];
+	const float* npos = &m_npos[idx*3];
+	const int* neis = &m_neis[idx*DT_CROWDAGENT_MAX_NEIGHBOURS];
+	float* disp = &m_disp[idx*3];
+
+	dtVset(disp, 0, 0, 0);
+	float w = 0;
+
+	for (int j = 0; j < m_nneis[idx]; ++j)
+	{
+		const int nei = neis[j];
+
+		float diff[3];
+		dtVsub(diff, npos, &m_npos[nei*3]);
+		diff[1] = 0;
+
+		float dist = dtVlenSqr(diff);
+		if (dist > dtSqr(params.radius + m_params[nei].radius))
+			continue;
+		dist = dtMathSqrtf(dist);
+		float pen = (params.radius + m_params[nei].radius) - dist;
+		if (dist < 0.0001f)
+		{
+			// Agents on top of each other, try to choose diverging separation directions.
+			const float* dvel = &m_dvel[idx*3];
+			if (idx > nei)
+				dtVset(diff, -dvel[2], 0, dvel[0]);
+			else
+				dtVset(diff, dvel[2], 0, -dvel[0]);
+			pen = 0.01f;
+		}
+		else
+		{
+			pen = (1.0f/dist) * (pen*0.5f) * COLLISION_RESOLVE_FACTOR;
+		}
+
+		dtVmad(disp, disp, diff, pen);
+		w += 1.0f;
+	}
+
+	if (w > 0.0001f)
+		dtVscale(disp, disp, 1.0f/w);
+}
+
+void dtCrowd::move(const int idx, dtNavMeshQuery* navquery, const dtQueryFilter* filter)
+{
+	dtPathCorridor& corridor = m_corridors[idx];
+	float* npos = &m_npos[idx*3];
+
+	dtVadd(npos, npos, &m_disp[idx*3]);
+
+	// Move along navmesh.
+	if (!corridor.movePosition(npos, navquery, filter))
+		dtVset(&m_vel[idx*3], 0, 0, 0);
+	dtVcopy(&m_pos[idx*3], corridor.getPos());
+}
@@ -0,0 +1,453 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+
+#include <float.h>
+#include <string.h>
+#include "DetourOrcaSolver.h"
+#include "DetourCommon.h"
+#include "DetourMath.h"
+
+#if !defined(DT_ORCA_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define DT_ORCA_SSE
+#include <xmmintrin.h>
+#endif
+
+
+static const float ORCA_EPSILON = 0.00001f;
+
+inline float orcaDet(const float* a, const float* b) { return a[0]*b[1] - a[1]*b[0]; }
+
+inline float orcaDot(const float* a, const float* b) { return a[0]*b[0] + a[1]*b[1]; }
+
+// Positive if the velocity is on the right side of the line, outside the half-plane it allows.
+inline float orcaViolation(const dtOrcaLine& line, const float* v)
+{
+	const float d[2] = { line.point[0] - v[0], line.point[1] - v[1] };
+	return orcaDet(line.dir, d);
+}
+
+// Solves the program on line lineNo, subject to the lines before it and the speed circle.
+static bool linearProgram1(const dtOrcaLine* lines, const int lineNo, const float radius,
+						   const float* optVel, const bool dirOpt, float* result)
+{
+	const dtOrcaLine& line = lines[lineNo];
+	const float dot = orcaDot(line.point, line.dir);
+	const float discriminant = dtSqr(dot) + dtSqr(radius) - orcaDot(line.point, line.point);
+
+	// The speed circle does not reach the line.
+	if (discriminant < 0.0f)
+		return false;
+
+	const float sqrtDiscriminant = dtMathSqrtf(discriminant);
+	float tLeft = -dot - sqrtDiscriminant;
+	float tRight = -dot + sqrtDiscriminant;
+	int i = 0;
+
+#ifdef DT_ORCA_SSE
+	// This loop is where most of a solve is spent. A line is four floats, so four lines
+	// transposed give their point and direction components. The interval only shrinks, so
+	// checking it once after the loop gives the same result as checking it on every line.
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 eps = _mm_set1_ps(ORCA_EPSILON);
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 inf = _mm_set1_ps(FLT_MAX);
+	const __m128 ldx = _mm_set1_ps(line.dir[0]);
+	const __m128 ldz = _mm_set1_ps(line.dir[1]);
+	const __m128 lpx = _mm_set1_ps(line.point[0]);
+	const __m128 lpz = _mm_set1_ps(line.point[1]);
+	__m128 vLeft = _mm_set1_ps(tLeft);
+	__m128 vRight = _mm_set1_ps(tRight);
+	__m128 blocked = zero;
+
+	for (; i + 4 <= lineNo; i += 4)
+	{
+		__m128 px = _mm_loadu_ps(lines[i].point);
+		__m128 pz = _mm_loadu_ps(lines[i+1].point);
+		__m128 dx = _mm_loadu_ps(lines[i+2].point);
+		__m128 dz = _mm_loadu_ps(lines[i+3].point);
+		_MM_TRANSPOSE4_PS(px, pz, dx, dz);
+
+		const __m128 denominator = _mm_sub_ps(_mm_mul_ps(ldx, dz), _mm_mul_ps(ldz, dx));
+		const __m128 numerator = _mm_sub_ps(_mm_mul_ps(dx, _mm_sub_ps(lpz, pz)), _mm_mul_ps(dz, _mm_sub_ps(lpx, px)));
+		const __m128 parallel = _mm_cmple_ps(_mm_andnot_ps(signMask, denominator), eps);
+		blocked = _mm_or_ps(blocked, _mm_and_ps(parallel, _mm_cmplt_ps(numerator, zero)));
+
+		const __m128 t = _mm_div_ps(numerator, denominator);
+		const __m128 right = _mm_andnot_ps(parallel, _mm_cmpge_ps(denominator, zero));
+		const __m128 left = _mm_andnot_ps(parallel, _mm_cmplt_ps(denominator, zero));
+		vRight = _mm_min_ps(vRight, _mm_or_ps(_mm_and_ps(right, t), _mm_andnot_ps(right, inf)));
+		vLeft = _mm_max_ps(vLeft, _mm_or_ps(_mm_and_ps(left, t), _mm_andnot_ps(left, _mm_sub_ps(zero, inf))));
+	}
+
+	if (_mm_movemask_ps(blocked))
+		return false;
+	vRight = _mm_min_ps(vRight, _mm_shuffle_ps(vRight, vRight, _MM_SHUFFLE(1, 0, 3, 2)));
+	vRight = _mm_min_ps(vRight, _mm_shuffle_ps(vRight, vRight, _MM_SHUFFLE(2, 3, 0, 1)));
+	vLeft = _mm_max_ps(vLeft, _mm_shuffle_ps(vLeft, vLeft, _MM_SHUFFLE(1, 0, 3, 2)));
+	vLeft = _mm_max_ps(vLeft, _mm_shuffle_ps(vLeft, vLeft, _MM_SHUFFLE(2, 3, 0, 1)));
+	tRight = _mm_cvtss_f32(vRight);
+	tLeft = _mm_cvtss_f32(vLeft);
+	if (tLeft > tRight)
+		return false;
+#endif
+
+	for (; i < lineNo; ++i)
+	{
+		const float denominator = orcaDet(line.dir, lines[i].dir);
+		const float d[2] = { line.point[0] - lines[i].point[0], line.point[1] - lines[i].point[1] };
+		const float numerator = orcaDet(lines[i].dir, d);
+
+		if (dtMathFabsf(denominator) <= ORCA_EPSILON)
+		{
+			// Parallel lines, either line i allows all of line lineNo or none of it.
+			if (numerator < 0.0f)
+				return false;
+			continue;
+		}
+
+		const float t = numerator / denominator;
+		if (denominator >= 0.0f)
+			tRight = dtMin(tRight, t);
+		else
+			tLeft = dtMax(tLeft, t);
+
+		if (tLeft > tRight)
+			return false;
+	}
+
+	float t;
+	if (dirOpt)
+	{
+		// Take the end furthest in the optimization direction.
+		t = orcaDot(optVel, line.dir) > 0.0f ? tRight : tLeft;
+	}
+	else
+	{
+		// Take the point closest to the optimization velocity.
+		t = dtClamp(orcaDot(line.dir, optVel) - dot, tLeft, tRight);
+	}
+	result[0] = line.point[0] + t*line.dir[0];
+	result[1] = line.point[1] + t*line.dir[1];
+
+	return true;
+}
+
+// Solves the program over all lines. Returns the number of lines satisfied, the index of the
+// line that failed if it is less than nlines.
+static int linearProgram2(const dtOrcaLine* lines, const int nlines, const float radius,
+						  const float* optVel, const bool dirOpt, float* result)
+{
+	if (dirOpt)
+	{
+		// The optimization velocity is a unit direction.
+		result[0] = optVel[0]*radius;
+		result[1] = optVel[1]*radius;
+	}
+	else if (orcaDot(optVel, optVel) > dtSqr(radius))
+	{
+		const float s = radius / dtMathSqrtf(orcaDot(optVel, optVel));
+		result[0] = optVel[0]*s;
+		result[1] = optVel[1]*s;
+	}
+	else
+	{
+		result[0] = optVel[0];
+		result[1] = optVel[1];
+	}
+
+	for (int i = 0; i < nlines; ++i)
+	{
+		if (orcaViolation(lines[i], result) > 0.0f)
+		{
+			const float prev[2] = { result[0], result[1] };
+			if (!linearProgram1(lines, i, radius, optVel, dirOpt, result))
+			{
+				result[0] = prev[0];
+				result[1] = prev[1];
+				return i;
+			}
+		}
+	}
+
+	return nlines;
+}
+
+// Finds the velocity that violates the lines from beginLine on the least, keeping the first
+// nobstacle lines satisfied.
+static void linearProgram3(const dtOrcaLine* lines, const int nlines, const int nobstacle,
+						   const int beginLine, const float radius, dtOrcaLine* projLines,
+						   float* result)
+{
+	float distance = 0.0f;
+
+	for (int i = beginLine; i < nlines; ++i)
+	{
+		if (orcaViolation(lines[i], result) <= distance)
+			continue;
+
+		// The lines that bound the violation of line i.
+		memcpy(projLines, lines, sizeof(dtOrcaLine)*nobstacle);
+		int nproj = nobstacle;
+
+		for (int j = nobstacle; j < i; ++j)
+		{
+			dtOrcaLine& line = projLines[nproj];
+			const float determinant = orcaDet(lines[i].dir, lines[j].dir);
+
+			if (dtMathFabsf(determinant) <= ORCA_EPSILON)
+			{
+				// Parallel lines pointing the same way do not bound line i.
+				if (orcaDot(lines[i].dir, lines[j].dir) > 0.0f)
+					continue;
+				line.point[0] = 0.5f*(lines[i].point[0] + lines[j].point[0]);
+				line.point[1] = 0.5f*(lines[i].point[1] + lines[j].point[1]);
+			}
+			else
+			{
+				const float d[2] = { lines[i].point[0] - lines[j].point[0], lines[i].point[1] - lines[j].point[1] };
+				const float t = orcaDet(lines[j].dir, d) / determinant;
+				line.point[0] = lines[i].point[0] + t*lines[i].dir[0];
+				line.point[1] = lines[i].point[1] + t*lines[i].dir[1];
+			}
+
+			line.dir[0] = lines[j].dir[0] - lines[i].dir[0];
+			line.dir[1] = lines[j].dir[1] - lines[i].dir[1];
+			const float len = dtMathSqrtf(orcaDot(line.dir, line.dir));
+			if (len <= ORCA_EPSILON)
+				continue;
+			line.dir[0] /= len;
+			line.dir[1] /= len;
+			nproj++;
+		}
+
+		const float prev[2] = { result[0], result[1] };
+		const float optDir[2] = { -lines[i].dir[1], lines[i].dir[0] };
+		if (linearProgram2(projLines, nproj, radius, optDir, true, result) < nproj)
+		{
+			// The result is feasible by definition, this only fails because of rounding.
+			result[0] = prev[0];
+			result[1] = prev[1];
+		}
+
+		distance = orcaViolation(lines[i], result);
+	}
+}
+
+
+dtOrcaSolver::dtOrcaSolver() :
+	m_agentHorizon(2.0f),
+	m_obstacleHorizon(1.0f),
+	m_radius(0),
+	m_wallRadius(0),
+	m_maxSpeed(0),
+	m_nneis(0),
+	m_nsegs(0),
+	m_nlines(0),
+	m_nobstacleLines(0)
+{
+	m_pos[0] = m_pos[1] = 0;
+	m_vel[0] = m_vel[1] = 0;
+}
+
+void dtOrcaSolver::setTimeHorizons(const float agentHorizon, const float obstacleHorizon)
+{
+	m_agentHorizon = dtMax(agentHorizon, ORCA_EPSILON);
+	m_obstacleHorizon = dtMax(obstacleHorizon, ORCA_EPSILON);
+}
+
+void dtOrcaSolver::reset(const float* pos, const float* vel, const float radius,
+						 const float wallRadius, const float maxSpeed)
+{
+	m_pos[0] = pos[0];
+	m_pos[1] = pos[2];
+	m_vel[0] = vel[0];
+	m_vel[1] = vel[2];
+	m_radius = radius;
+	m_wallRadius = wallRadius;
+	m_maxSpeed = maxSpeed;
+	m_nneis = 0;
+	m_nsegs = 0;
+	m_nlines = 0;
+	m_nobstacleLines = 0;
+}
+
+void dtOrcaSolver::addNeighbour(const float* pos, const float* vel, const float radius)
+{
+	if (m_nneis >= DT_ORCA_MAX_NEIGHBOURS)
+		return;
+	m_relPosX[m_nneis] = pos[0] - m_pos[0];
+	m_relPosZ[m_nneis] = pos[2] - m_pos[1];
+	m_relVelX[m_nneis] = m_vel[0] - vel[0];
+	m_relVelZ[m_nneis] = m_vel[1] - vel[2];
+	m_combinedRadius[m_nneis] = m_radius + radius;
+	m_nneis++;
+}
+
+void dtOrcaSolver::addSegment(const float* p, const float* q)
+{
+	if (m_nsegs >= DT_ORCA_MAX_SEGMENTS)
+		return;
+	m_segPX[m_nsegs] = p[0];
+	m_segPZ[m_nsegs] = p[2];
+	m_segQX[m_nsegs] = q[0];
+	m_segQZ[m_nsegs] = q[2];
+	m_nsegs++;
+}
+
+/// @par
+///
+/// A wall limits the speed of the agents beside it towards it to what brings them in contact
+/// within the obstacle time horizon, and pushes agents that already overlap it out within @p dt.
+/// Agents beyond the ends of a segment are left alone: the corners of the navigation mesh are
+/// where paths turn, and a constraint facing the corner would stop the agent that steers to it.
+void dtOrcaSolver::buildSegmentLines(const float invDt)
+{
+	const float invHorizon = 1.0f / m_obstacleHorizon;
+
+	for (int i = 0; i < m_nsegs; ++i)
+	{
+		const float dx = m_segQX[i] - m_segPX[i];
+		const float dz = m_segQZ[i] - m_segPZ[i];
+		const float apx = m_pos[0] - m_segPX[i];
+		const float apz = m_pos[1] - m_segPZ[i];
+		const float t = (apx*dx + apz*dz) / dtMax(dx*dx + dz*dz, ORCA_EPSILON);
+		if (t < 0.0f || t > 1.0f)
+			continue;
+		const float cx = t*dx - apx;
+		const float cz = t*dz - apz;
+
+		const float distSqr = cx*cx + cz*cz;
+		if (distSqr <= ORCA_EPSILON)
+			continue;
+		const float dist = dtMathSqrtf(distSqr);
+		const float nx = cx / dist;
+		const float nz = cz / dist;
+		const float speed = (dist - m_wallRadius) * (dist < m_wallRadius ? invDt : invHorizon);
+
+		dtOrcaLine& line = m_lines[m_nlines++];
+		line.point[0] = nx*speed;
+		line.point[1] = nz*speed;
+		line.dir[0] = -nz;
+		line.dir[1] = nx;
+	}
+}
+
+/// @par
+///
+/// The velocity obstacle of a neighbour is the truncated cone of relative velocities that
+/// collide within the agent time horizon. Its closest boundary is either the cut-off circle
+/// or one of the legs of the cone; overlapping agents use the cut-off circle of @p dt instead.
+/// The line is moved half way to that boundary.
+void dtOrcaSolver::buildNeighbourLines(const float invDt)
+{
+	const float invHorizon = 1.0f / m_agentHorizon;
+
+	for (int i = 0; i < m_nneis; ++i)
+	{
+		const float rp[2] = { m_relPosX[i], m_relPosZ[i] };
+		const float rv[2] = { m_relVelX[i], m_relVelZ[i] };
+		const float cr = m_combinedRadius[i];
+		const float distSqr = orcaDot(rp, rp);
+		const float crSqr = dtSqr(cr);
+
+		dtOrcaLine& line = m_lines[m_nlines++];
+		float u[2];
+
+		if (distSqr > crSqr)
+		{
+			const float w[2] = { rv[0] - invHorizon*rp[0], rv[1] - invHorizon*rp[1] };
+			const float wLenSqr = orcaDot(w, w);
+			const float dot1 = orcaDot(w, rp);
+
+			if (dot1 < 0.0f && dtSqr(dot1) > crSqr*wLenSqr)
+			{
+				// Closest to the cut-off circle.
+				const float wLen = dtMathSqrtf(wLenSqr);
+				const float uw[2] = { w[0]/wLen, w[1]/wLen };
+				line.dir[0] = uw[1];
+				line.dir[1] = -uw[0];
+				u[0] = (cr*invHorizon - wLen)*uw[0];
+				u[1] = (cr*invHorizon - wLen)*uw[1];
+			}
+			else
+			{
+				// Closest to one of the legs.
+				const float leg = dtMathSqrtf(distSqr - crSqr);
+				if (orcaDet(rp, w) > 0.0f)
+				{
+					line.dir[0] = (rp[0]*leg - rp[1]*cr) / distSqr;
+					line.dir[1] = (rp[0]*cr + rp[1]*leg) / distSqr;
+				}
+				else
+				{
+					line.dir[0] = -(rp[0]*leg + rp[1]*cr) / distSqr;
+					line.dir[1] = (rp[0]*cr - rp[1]*leg) / distSqr;
+				}
+				const float dot2 = orcaDot(rv, line.dir);
+				u[0] = dot2*line.dir[0] - rv[0];
+				u[1] = dot2*line.dir[1] - rv[1];
+			}
+		}
+		else
+		{
+			// Overlapping, separate within the time step.
+			const float w[2] = { rv[0] - invDt*rp[0], rv[1] - invDt*rp[1] };
+			const float wLen = dtMathSqrtf(dtMax(orcaDot(w, w), ORCA_EPSILON));
+			const float uw[2] = { w[0]/wLen, w[1]/wLen };
+			line.dir[0] = uw[1];
+			line.dir[1] = -uw[0];
+			u[0] = (cr*invDt - wLen)*uw[0];
+			u[1] = (cr*invDt - wLen)*uw[1];
+		}
+
+		line.point[0] = m_vel[0] + 0.5f*u[0];
+		line.point[1] = m_vel[1] + 0.5f*u[1];
+	}
+}
+
+bool dtOrcaSolver::solve(const float* dvel, const float dt, float* nvel)
+{
+	const float invDt = 1.0f / dtMax(dt, ORCA_EPSILON);
+
+	m_nlines = 0;
+	buildSegmentLines(invDt);
+	m_nobstacleLines = m_nlines;
+	buildNeighbourLines(invDt);
+
+	const float optVel[2] = { dvel[0], dvel[2] };
+	float result[2];
+	const int lineFail = linearProgram2(m_lines, m_nlines, m_maxSpeed, optVel, false, result);
+	if (lineFail < m_nlines)
+		linearProgram3(m_lines, m_nlines, m_nobstacleLines, lineFail, m_maxSpeed, m_projLines, result);
+
+	// Walls that can not all be kept to leave the result where the last of them put it.
+	const float speedSqr = orcaDot(result, result);
+	if (speedSqr > dtSqr(m_maxSpeed))
+	{
+		const float s = m_maxSpeed / dtMathSqrtf(speedSqr);
+		result[0] *= s;
+		result[1] *= s;
+	}
+
+	nvel[0] = result[0];
+	nvel[1] = dvel[1];
+	nvel[2] = result[1];
+
+	return lineFail >= m_nlines;
+}
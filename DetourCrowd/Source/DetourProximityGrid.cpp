@@ -0,0 +1,165 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+
+#include <string.h>
+#include "DetourProximityGrid.h"
+#include "DetourCommon.h"
+#include "DetourMath.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+
+
+static inline int hashPos2(int x, int y, int n)
+{
+	return (int)((((unsigned int)x*73856093u) ^ ((unsigned int)y*19349663u)) & (unsigned int)(n-1));
+}
+
+
+dtProximityGrid::dtProximityGrid() :
+	m_cellSize(0),
+	m_invCellSize(0),
+	m_maxItems(0),
+	m_nitems(0),
+	m_bucketsSize(0),
+	m_buckets(0),
+	m_ids(0),
+	m_cellx(0),
+	m_cellz(0),
+	m_itemBucket(0)
+{
+}
+
+dtProximityGrid::~dtProximityGrid()
+{
+	purge();
+}
+
+void dtProximityGrid::purge()
+{
+	dtFree(m_buckets);
+	dtFree(m_ids);
+	dtFree(m_cellx);
+	dtFree(m_cellz);
+	dtFree(m_itemBucket);
+	m_buckets = 0;
+	m_ids = 0;
+	m_cellx = 0;
+	m_cellz = 0;
+	m_itemBucket = 0;
+	m_maxItems = 0;
+	m_nitems = 0;
+	m_bucketsSize = 0;
+}
+
+bool dtProximityGrid::init(const int maxItems, const float cellSize)
+{
+	dtAssert(maxItems > 0);
+	dtAssert(cellSize > 0.0f);
+
+	purge();
+
+	m_cellSize = cellSize;
+	m_invCellSize = 1.0f / m_cellSize;
+
+	// Allocate hash buckets, about two per item so that most cells get a bucket of their own.
+	m_bucketsSize = (int)dtNextPow2((unsigned int)maxItems*2);
+	m_buckets = (int*)dtAlloc(sizeof(int)*(m_bucketsSize+1), DT_ALLOC_PERM);
+	if (!m_buckets)
+		return false;
+
+	m_maxItems = maxItems;
+	m_ids = (int*)dtAlloc(sizeof(int)*m_maxItems, DT_ALLOC_PERM);
+	m_cellx = (int*)dtAlloc(sizeof(int)*m_maxItems, DT_ALLOC_PERM);
+	m_cellz = (int*)dtAlloc(sizeof(int)*m_maxItems, DT_ALLOC_PERM);
+	m_itemBucket = (int*)dtAlloc(sizeof(int)*m_maxItems, DT_ALLOC_PERM);
+	if (!m_ids || !m_cellx || !m_cellz || !m_itemBucket)
+		return false;
+
+	memset(m_buckets, 0, sizeof(int)*(m_bucketsSize+1));
+	m_nitems = 0;
+
+	return true;
+}
+
+void dtProximityGrid::build(const int* ids, const int nitems, const float* pos)
+{
+	dtAssert(m_buckets);
+	dtAssert(nitems <= m_maxItems);
+
+	m_nitems = dtMin(nitems, m_maxItems);
+
+	// Count the items per bucket.
+	memset(m_buckets, 0, sizeof(int)*(m_bucketsSize+1));
+	for (int i = 0; i < m_nitems; ++i)
+	{
+		const float* p = &pos[ids[i]*3];
+		const int x = (int)dtMathFloorf(p[0] * m_invCellSize);
+		const int z = (int)dtMathFloorf(p[2] * m_invCellSize);
+		const int b = hashPos2(x, z, m_bucketsSize);
+		m_itemBucket[i] = b;
+		m_buckets[b+1]++;
+	}
+
+	// Turn the counts into the first item of each bucket.
+	for (int i = 0; i < m_bucketsSize; ++i)
+		m_buckets[i+1] += m_buckets[i];
+
+	// Scatter the items to their buckets, using the start of the following bucket as
+	// insertion point and moving it back to the start of the bucket it belongs to.
+	for (int i = m_nitems-1; i >= 0; --i)
+	{
+		const int b = m_itemBucket[i];
+		const int dst = --m_buckets[b+1];
+		const float* p = &pos[ids[i]*3];
+		m_ids[dst] = ids[i];
+		m_cellx[dst] = (int)dtMathFloorf(p[0] * m_invCellSize);
+		m_cellz[dst] = (int)dtMathFloorf(p[2] * m_invCellSize);
+	}
+}
+
+int dtProximityGrid::queryItems(const float minx, const float minz, const float maxx, const float maxz,
+								int* ids, const int maxIds) const
+{
+	const int iminx = (int)dtMathFloorf(minx * m_invCellSize);
+	const int iminz = (int)dtMathFloorf(minz * m_invCellSize);
+	const int imaxx = (int)dtMathFloorf(maxx * m_invCellSize);
+	const int imaxz = (int)dtMathFloorf(maxz * m_invCellSize);
+
+	int n = 0;
+
+	for (int z = iminz; z <= imaxz; ++z)
+	{
+		for (int x = iminx; x <= imaxx; ++x)
+		{
+			const int b = hashPos2(x, z, m_bucketsSize);
+			for (int i = m_buckets[b]; i < m_buckets[b+1]; ++i)
+			{
+				// Buckets are shared by cells with the same hash, only take the items of this
+				// cell. This also means every item is returned once.
+				if (m_cellx[i] != x || m_cellz[i] != z)
+					continue;
+				if (n >= maxIds)
+					return n;
+				ids[n++] = m_ids[i];
+			}
+		}
+	}
+
+	return n;
+}
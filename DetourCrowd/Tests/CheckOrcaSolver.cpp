@@ -0,0 +1,182 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+// Checks that the SSE path of dtOrcaSolver finds exactly the velocities of the scalar path,
+// and times both on random crowds of 4, 8 and 16 neighbours and segments. Returns non-zero if
+// any velocity differs.
+//
+// DetourOrcaSolver.cpp is compiled twice into this program, once with DT_ORCA_NO_SIMD into
+// namespace scalar and once without into namespace simd, so both paths run side by side.
+//
+// Build and run from the repository root:
+//   c++ -O2 -IDetour/Include -IDetourCrowd/Include DetourCrowd/Tests/CheckOrcaSolver.cpp Detour/Source/DetourCommon.cpp -o checkorcasolver
+//   ./checkorcasolver
+
+#include <math.h>
+#include <float.h>
+#include <string.h>
+#include <stdio.h>
+#include <vector>
+#include <chrono>
+#include "DetourCommon.h"
+#include "DetourMath.h"
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#endif
+
+// The scalar copy must come first, DT_ORCA_SSE stays defined once the SSE copy has set it.
+#define DT_ORCA_NO_SIMD
+namespace scalar
+{
+#include "../Source/DetourOrcaSolver.cpp"
+}
+#undef DT_ORCA_NO_SIMD
+#undef DETOURORCASOLVER_H
+namespace simd
+{
+#include "../Source/DetourOrcaSolver.cpp"
+}
+
+namespace
+{
+
+const int SCENARIO_COUNT = 4096;
+const int SOLVE_COUNT = 1000000;
+const float AGENT_RADIUS = 0.6f;
+const float WALL_RADIUS = 0.3f;
+const float MAX_SPEED = 3.5f;
+const float DT = 0.1f;
+const float TWO_PI = 6.2831853f;
+const int MAX_NEIGHBOURS = simd::DT_ORCA_MAX_NEIGHBOURS;
+const int MAX_SEGMENTS = simd::DT_ORCA_MAX_SEGMENTS;
+
+unsigned int g_seed = 1;
+
+float frand()
+{
+	g_seed = g_seed*1103515245u + 12345u;
+	return ((g_seed >> 8) & 0xffff) / 65535.0f;
+}
+
+// An agent at the origin with neighbours around it and wall segments passing by it.
+struct Scenario
+{
+	float vel[3];
+	float dvel[3];
+	float neiPos[MAX_NEIGHBOURS][3];
+	float neiVel[MAX_NEIGHBOURS][3];
+	float segP[MAX_SEGMENTS][3];
+	float segQ[MAX_SEGMENTS][3];
+};
+
+void buildScenarios(std::vector<Scenario>& scenarios)
+{
+	scenarios.resize(SCENARIO_COUNT);
+	for (int k = 0; k < SCENARIO_COUNT; ++k)
+	{
+		Scenario& sc = scenarios[k];
+		const float a = frand()*TWO_PI;
+		dtVset(sc.dvel, cosf(a)*MAX_SPEED, 0, sinf(a)*MAX_SPEED);
+		dtVset(sc.vel, sc.dvel[0]*frand(), 0, sc.dvel[2]*frand());
+		for (int i = 0; i < MAX_NEIGHBOURS; ++i)
+		{
+			const float pa = frand()*TWO_PI, d = 1.0f + frand()*3.0f;
+			const float va = frand()*TWO_PI, speed = frand()*MAX_SPEED;
+			dtVset(sc.neiPos[i], cosf(pa)*d, 0, sinf(pa)*d);
+			dtVset(sc.neiVel[i], cosf(va)*speed, 0, sinf(va)*speed);
+		}
+		for (int i = 0; i < MAX_SEGMENTS; ++i)
+		{
+			const float sa = frand()*TWO_PI, d = 0.7f + frand()*2.5f;
+			const float cx = cosf(sa)*d, cz = sinf(sa)*d;
+			const float tx = -sinf(sa), tz = cosf(sa), len = 0.5f + frand()*2.0f;
+			dtVset(sc.segP[i], cx - tx*len, 0, cz - tz*len);
+			dtVset(sc.segQ[i], cx + tx*len, 0, cz + tz*len);
+		}
+	}
+}
+
+template<class Solver>
+void solve(Solver& solver, const Scenario& sc, const int nneis, const int nsegs, float* nvel)
+{
+	static const float pos[3] = { 0, 0, 0 };
+	solver.reset(pos, sc.vel, AGENT_RADIUS, WALL_RADIUS, MAX_SPEED);
+	for (int i = 0; i < nneis; ++i)
+		solver.addNeighbour(sc.neiPos[i], sc.neiVel[i], AGENT_RADIUS);
+	for (int i = 0; i < nsegs; ++i)
+		solver.addSegment(sc.segP[i], sc.segQ[i]);
+	solver.solve(sc.dvel, DT, nvel);
+}
+
+// Microseconds per solve.
+template<class Solver>
+double timeSolves(const std::vector<Scenario>& scenarios, const int nneis, const int nsegs, float* sum)
+{
+	Solver solver;
+	float nvel[3];
+	*sum = 0;
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int k = 0; k < SOLVE_COUNT; ++k)
+	{
+		solve(solver, scenarios[k % SCENARIO_COUNT], nneis, nsegs, nvel);
+		*sum += nvel[0] + nvel[2];
+	}
+	const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::micro>(end - start).count() / SOLVE_COUNT;
+}
+
+int countDifferences(const std::vector<Scenario>& scenarios, const int nneis, const int nsegs)
+{
+	scalar::dtOrcaSolver scalarSolver;
+	simd::dtOrcaSolver simdSolver;
+	int diffs = 0;
+	for (int k = 0; k < SCENARIO_COUNT; ++k)
+	{
+		float a[3], b[3];
+		solve(scalarSolver, scenarios[k], nneis, nsegs, a);
+		solve(simdSolver, scenarios[k], nneis, nsegs, b);
+		if (memcmp(a, b, sizeof(a)) != 0)
+			diffs++;
+	}
+	return diffs;
+}
+
+}
+
+int main()
+{
+	std::vector<Scenario> scenarios;
+	buildScenarios(scenarios);
+
+	static const int counts[] = { 4, 8, 16 };
+	bool ok = true;
+
+	printf("neighbours  segments   scalar us    simd us  speedup  diffs\n");
+	for (int i = 0; i < (int)(sizeof(counts)/sizeof(counts[0])); ++i)
+	{
+		const int n = counts[i];
+		const int diffs = countDifferences(scenarios, n, n);
+		float scalarSum, simdSum;
+		const double scalarUs = timeSolves<scalar::dtOrcaSolver>(scenarios, n, n, &scalarSum);
+		const double simdUs = timeSolves<simd::dtOrcaSolver>(scenarios, n, n, &simdSum);
+		printf("%10d  %8d  %10.3f  %9.3f  %6.2fx  %5d\n", n, n, scalarUs, simdUs, scalarUs/simdUs, diffs);
+		ok &= diffs == 0 && scalarSum == simdSum;
+	}
+
+	return ok ? 0 : 1;
+}
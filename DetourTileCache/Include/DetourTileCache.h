@@ -190,12 +190,21 @@ public:
    ///  @param[out]	upToDate	Whether the tile cache is fully up to date with obstacle requests and tile rebuilds.
    ///  							If the tile cache is up to date another (immediate) call to update will have no effect;
    ///  							otherwise another call will continue processing obstacle requests and tile rebuilds.
-   dtStatus update(const float dt, class dtNavMesh* navmesh, bool* upToDate = 0);
+   ///  @param[out]	rebuiltTile	The tile rebuilt by this call, or zero if no tile was rebuilt. [opt]
+   dtStatus update(const float dt, class dtNavMesh* navmesh, bool* upToDate = 0,
+                   dtCompressedTileRef* rebuiltTile = 0);
 
    dtStatus buildNavMeshTilesAt(const int tx, const int ty, class dtNavMesh* navmesh);
 
    dtStatus buildNavMeshTile(const dtCompressedTileRef ref, class dtNavMesh* navmesh);
 
+   /// Updates the tiles touched by the obstacles after the tiles at a location were removed and
+   /// added again, so the obstacles are marked on the new tiles when they are built.
+   /// Tiles that were queued for rebuilding before they were removed are skipped by update().
+   ///  @param[in]		tx			The x location of the replaced tiles.
+   ///  @param[in]		ty			The y location of the replaced tiles.
+   void updateObstacleTiles(const int tx, const int ty);
+
    void calcTightTileBounds(const struct dtTileCacheLayerHeader* header, float* bmin, float* bmax) const;
 
    void getObstacleBounds(const struct dtTileCacheObstacle* ob, float* bmin, float* bmax) const;
@@ -105,12 +105,15 @@ struct dtTileCacheCompressor
 };
 
 
+/// Compresses a layer into @p outData, which is allocated with dtAlloc. The grids are gathered
+/// for compression in a buffer from @p alloc, or from dtAlloc if it is null.
 dtStatus dtBuildTileCacheLayer(dtTileCacheCompressor* comp,
                         dtTileCacheLayerHeader* header,
                         const unsigned char* heights,
                         const unsigned char* areas,
                         const unsigned char* cons,
-                        unsigned char** outData, int* outDataSize);
+                        unsigned char** outData, int* outDataSize,
+                        dtTileCacheAlloc* alloc = 0);
 
 void dtFreeTileCacheLayer(dtTileCacheAlloc* alloc, dtTileCacheLayer* layer);
 
@@ -637,8 +637,11 @@ dtStatus dtTileCache::queryTiles(const float* bmin, const float* bmax,
 }
 
 dtStatus dtTileCache::update(const float /*dt*/, dtNavMesh* navmesh,
-                      bool* upToDate)
+                      bool* upToDate, dtCompressedTileRef* rebuiltTile)
 {
+   if (rebuiltTile)
+      *rebuiltTile = 0;
+
    if (m_nupdate == 0)
    {
       // Process requests.
@@ -703,6 +706,8 @@ dtStatus dtTileCache::update(const float /*dt*/, dtNavMesh* navmesh,
       // Build mesh
       const dtCompressedTileRef ref = m_update[0];
       status = buildNavMeshTile(ref, navmesh);
+      if (rebuiltTile)
+         *rebuiltTile = ref;
       m_nupdate--;
       if (m_nupdate > 0)
          memmove(m_update, m_update+1, m_nupdate*sizeof(dtCompressedTileRef));
@@ -877,7 +882,9 @@ dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh*
    params.tileLayer = tile->header->tlayer;
    params.cs = m_params.cs;
    params.ch = m_params.ch;
-   params.buildBvTree = false;
+   // Without a BV tree every poly query tests all polys of each tile it overlaps. The tree is
+   // cheap to build next to the rest of the tile and pays off after a few queries.
+   params.buildBvTree = true;
    dtVcopy(params.bmin, tile->header->bmin);
    dtVcopy(params.bmax, tile->header->bmax);
 
@@ -909,6 +916,50 @@ dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh*
    return DT_SUCCESS;
 }
 
+void dtTileCache::updateObstacleTiles(const int tx, const int ty)
+{
+   const int MAX_TILES = 32;
+   dtCompressedTileRef tiles[MAX_TILES];
+   const int ntiles = getTilesAt(tx,ty,tiles,MAX_TILES);
+
+   for (int i = 0; i < m_params.maxObstacles; ++i)
+   {
+      dtTileCacheObstacle* ob = &m_obstacles[i];
+      if (ob->state == DT_OBSTACLE_EMPTY)
+         continue;
+
+      // Forget the removed tiles. Pending tiles are left alone, update() skips them and still
+      // finishes the obstacle when they are the last ones.
+      int n = 0;
+      for (int j = 0; j < (int)ob->ntouched; ++j)
+      {
+         if (getTileByRef(ob->touched[j]))
+            ob->touched[n++] = ob->touched[j];
+      }
+      ob->ntouched = (unsigned char)n;
+
+      if (ob->state == DT_OBSTACLE_REMOVING)
+         continue;
+
+      float bmin[3], bmax[3];
+      getObstacleBounds(ob, bmin, bmax);
+
+      for (int j = 0; j < ntiles; ++j)
+      {
+         const dtCompressedTile* tile = &m_tiles[decodeTileIdTile(tiles[j])];
+         float tbmin[3], tbmax[3];
+         calcTightTileBounds(tile->header, tbmin, tbmax);
+
+         if (dtOverlapBounds(bmin,bmax, tbmin,tbmax) &&
+             !contains(ob->touched, ob->ntouched, tiles[j]) &&
+             ob->ntouched < DT_MAX_TOUCHED_TILES)
+         {
+            ob->touched[ob->ntouched++] = tiles[j];
+         }
+      }
+   }
+}
+
 void dtTileCache::calcTightTileBounds(const dtTileCacheLayerHeader* header, float* bmin, float* bmax) const
 {
    const float cs = m_params.cs;
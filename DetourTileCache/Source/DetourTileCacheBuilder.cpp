@@ -2178,8 +2178,13 @@ dtStatus dtBuildTileCacheLayer(dtTileCacheCompressor* comp,
                         const unsigned char* heights,
                         const unsigned char* areas,
                         const unsigned char* cons,
-                        unsigned char** outData, int* outDataSize)
+                        unsigned char** outData, int* outDataSize,
+                        dtTileCacheAlloc* alloc)
 {
+   dtTileCacheAlloc defaultAlloc;
+   if (!alloc)
+      alloc = &defaultAlloc;
+
    const int headerSize = dtAlign4(sizeof(dtTileCacheLayerHeader));
    const int gridSize = (int)header->width * (int)header->height;
    const int maxDataSize = headerSize + comp->maxCompressedSize(gridSize*3);
@@ -2193,7 +2198,7 @@ dtStatus dtBuildTileCacheLayer(dtTileCacheCompressor* comp,
 
    // Concatenate grid data for compression.
    const int bufferSize = gridSize*3;
-   unsigned char* buffer = (unsigned char*)dtAlloc(bufferSize, DT_ALLOC_TEMP);
+   unsigned char* buffer = (unsigned char*)alloc->alloc(bufferSize);
    if (!buffer)
    {
       dtFree(data);
@@ -2211,7 +2216,7 @@ dtStatus dtBuildTileCacheLayer(dtTileCacheCompressor* comp,
    dtStatus status = comp->compress(buffer, bufferSize, compressed, maxCompressedSize, &compressedSize);
    if (dtStatusFailed(status))
    {
-      dtFree(buffer);
+      alloc->free(buffer);
       dtFree(data);
       return status;
    }
@@ -2219,7 +2224,7 @@ dtStatus dtBuildTileCacheLayer(dtTileCacheCompressor* comp,
    *outData = data;
    *outDataSize = headerSize + compressedSize;
 
-   dtFree(buffer);
+   alloc->free(buffer);
 
    return DT_SUCCESS;
 }
@@ -91,6 +91,8 @@ enum rcTimerLabel
 	RC_TIMER_BUILD_POLYMESHDETAIL,
 	/// The time to merge polygon mesh details. (See: #rcMergePolyMeshDetails)
 	RC_TIMER_MERGE_POLYMESHDETAIL,
+	/// The time to apply the span filters in one pass. (See: #rcFilterSpans)
+	RC_TIMER_FILTER_SPANS,
 	/// The maximum number of timers.  (Used for iterating timers.)
 	RC_MAX_TIMERS
 };
@@ -350,6 +352,7 @@ struct rcCompactHeightfield
 	rcCompactSpan* spans;		///< Array of spans. [Size: #spanCount]
 	unsigned short* dist;		///< Array containing border distance data. [Size: #spanCount]
 	unsigned char* areas;		///< Array containing area id data. [Size: #spanCount]
+	int maxSpans;				///< The number of spans #spans and #areas are allocated for.
 };
 
 /// Represents a heightfield layer within a layer set.
@@ -382,6 +385,7 @@ struct rcHeightfieldLayerSet
 	~rcHeightfieldLayerSet();
 	rcHeightfieldLayer* layers;			///< The layers in the set. [Size: #nlayers]
 	int nlayers;						///< The number of layers in the set.
+	int maxlayers;						///< The number of allocated layers.
 };
 
 /// Represents a simple, non-overlapping contour in field space.
@@ -784,6 +788,8 @@ void rcCalcBounds(const float* verts, int nv, float* bmin, float* bmax);
 void rcCalcGridSize(const float* bmin, const float* bmax, float cs, int* w, int* h);
 
 /// Initializes a new heightfield.
+/// A heightfield that was initialized before is emptied, but keeps its span pools, and its columns
+/// if the size is the same.
 ///  @ingroup recast
 ///  @param[in,out]	ctx		The build context to use during the operation.
 ///  @param[in,out]	hf		The allocated heightfield to initialize.
@@ -929,6 +935,17 @@ void rcFilterLedgeSpans(rcContext* ctx, const int walkableHeight,
 ///  @param[in,out]	solid			A fully built heightfield.  (All spans have been added.)
 void rcFilterWalkableLowHeightSpans(rcContext* ctx, int walkableHeight, rcHeightfield& solid);
 
+/// Applies #rcFilterLowHangingWalkableObstacles, #rcFilterLedgeSpans and #rcFilterWalkableLowHeightSpans
+/// in that order, in a single pass over the heightfield.
+///  @ingroup recast
+///  @param[in,out]	ctx				The build context to use during the operation.
+///  @param[in]		walkableHeight	Minimum floor to 'ceiling' height that will still allow the floor area to 
+///  								be considered walkable. [Limit: >= 3] [Units: vx]
+///  @param[in]		walkableClimb	Maximum ledge height that is considered to still be traversable. 
+///  								[Limit: >=0] [Units: vx]
+///  @param[in,out]	solid			A fully built heightfield.  (All spans have been added.)
+void rcFilterSpans(rcContext* ctx, const int walkableHeight, const int walkableClimb, rcHeightfield& solid);
+
 /// Returns the number of spans contained in the specified heightfield.
 ///  @ingroup recast
 ///  @param[in,out]	ctx		The build context to use during the operation.
@@ -942,6 +959,7 @@ int rcGetHeightFieldSpanCount(rcContext* ctx, rcHeightfield& hf);
 /// @{
 
 /// Builds a compact heightfield representing open space, from a heightfield representing solid space.
+/// A compact heightfield that was built before keeps its arrays if they are large enough.
 ///  @ingroup recast
 ///  @param[in,out]	ctx				The build context to use during the operation.
 ///  @param[in]		walkableHeight	Minimum floor to 'ceiling' height that will still allow the floor area 
@@ -1119,6 +1137,7 @@ inline int rcGetDirForOffset(int x, int y)
 /// @{
 
 /// Builds a layer set from the specified compact heightfield.
+/// A layer set that was built before keeps its layers, and their grids if the size is the same.
 ///  @ingroup recast
 ///  @param[in,out]	ctx			The build context to use during the operation.
 ///  @param[in]		chf			A fully built compact heightfield.
@@ -61,6 +61,53 @@ void* rcAlloc(size_t size, rcAllocHint hint);
 /// @see rcAlloc
 void rcFree(void* ptr);
 
+/// Serves the #RC_ALLOC_TEMP allocations of a thread from one block of memory that it keeps
+/// between builds. The block grows to the most temporary memory that was in use at once, so
+/// repeated builds of about the same size, such as the tiles of a tile cache, stop allocating.
+/// Recast frees its temporary memory before returning, which makes the block empty again.
+/// @see rcTempAllocScope
+class rcTempAllocator
+{
+public:
+	rcTempAllocator();
+	~rcTempAllocator();
+
+	/// Allocates from the block, or with #rcAllocFunc if the block is too small. The block is
+	/// replaced by a larger one the next time it is empty.
+	void* alloc(size_t size);
+
+	/// Returns false if @p ptr was not allocated from the block.
+	bool free(void* ptr);
+
+private:
+	unsigned char* m_block;
+	size_t m_capacity;
+	size_t m_top;		///< The end of the memory allocated from the block.
+	size_t m_overflow;	///< The memory allocated with #rcAllocFunc since the block was empty.
+	size_t m_high;		///< The most memory that was in use at once.
+	int m_count;		///< The number of allocations from the block that were not freed yet.
+
+	// Explicitly-disabled copy constructor and copy assignment operator.
+	rcTempAllocator(const rcTempAllocator&);
+	rcTempAllocator& operator=(const rcTempAllocator&);
+};
+
+/// Makes #rcAlloc serve the #RC_ALLOC_TEMP allocations of the calling thread from @p allocator
+/// while in scope. Nothing allocated temporarily in the scope may be freed after it.
+class rcTempAllocScope
+{
+public:
+	explicit rcTempAllocScope(rcTempAllocator& allocator);
+	~rcTempAllocScope();
+
+private:
+	rcTempAllocator* m_previous;
+
+	// Explicitly-disabled copy constructor and copy assignment operator.
+	rcTempAllocScope(const rcTempAllocScope&);
+	rcTempAllocScope& operator=(const rcTempAllocScope&);
+};
+
 /// An implementation of operator new usable for placement new. The default one is part of STL (which we don't use).
 /// rcNewTag is a dummy type used to differentiate our operator from the STL one, in case users import both Recast
 /// and STL.
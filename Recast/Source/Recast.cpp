@@ -155,7 +155,8 @@ rcCompactHeightfield::rcCompactHeightfield()
    cells(),
    spans(),
    dist(),
-   areas()
+   areas(),
+   maxSpans()
 {
 }
 rcCompactHeightfield::~rcCompactHeightfield()
@@ -176,10 +177,10 @@ void rcFreeHeightfieldLayerSet(rcHeightfieldLayerSet* lset)
 }
 
 rcHeightfieldLayerSet::rcHeightfieldLayerSet()
-   : layers(),	nlayers() {}
+   : layers(),	nlayers(), maxlayers() {}
 rcHeightfieldLayerSet::~rcHeightfieldLayerSet()
 {
-   for (int i = 0; i < nlayers; ++i)
+   for (int i = 0; i < maxlayers; ++i)
    {
       rcFree(layers[i].heights);
       rcFree(layers[i].areas);
@@ -301,16 +302,34 @@ bool rcCreateHeightfield(rcContext* ctx, rcHeightfield& hf, int width, int heigh
 {
    rcIgnoreUnused(ctx);
 
+   if (hf.spans && hf.width*hf.height != width*height)
+   {
+      rcFree(hf.spans);
+      hf.spans = 0;
+   }
+
    hf.width = width;
    hf.height = height;
    rcVcopy(hf.bmin, bmin);
    rcVcopy(hf.bmax, bmax);
    hf.cs = cs;
    hf.ch = ch;
-   hf.spans = (rcSpan**)rcAlloc(sizeof(rcSpan*)*hf.width*hf.height, RC_ALLOC_PERM);
+   if (!hf.spans)
+      hf.spans = (rcSpan**)rcAlloc(sizeof(rcSpan*)*hf.width*hf.height, RC_ALLOC_PERM);
    if (!hf.spans)
       return false;
    memset(hf.spans, 0, sizeof(rcSpan*)*hf.width*hf.height);
+
+   // Return the spans of a previous build to the free list, in the order allocSpan hands them out.
+   hf.freelist = 0;
+   for (rcSpanPool* pool = hf.pools; pool; pool = pool->next)
+   {
+      for (int i = RC_SPANS_PER_POOL-1; i >= 0; --i)
+      {
+         pool->items[i].next = hf.freelist;
+         hf.freelist = &pool->items[i];
+      }
+   }
    return true;
 }
 
@@ -423,6 +442,21 @@ bool rcBuildCompactHeightfield(rcContext* ctx, const int walkableHeight, const i
    const int h = hf.height;
    const int spanCount = rcGetHeightFieldSpanCount(ctx, hf);
 
+   // A compact heightfield that is built again keeps the arrays that are large enough.
+   if (chf.cells && chf.width*chf.height != w*h)
+   {
+      rcFree(chf.cells);
+      chf.cells = 0;
+   }
+   if (spanCount > chf.maxSpans)
+   {
+      rcFree(chf.spans);
+      rcFree(chf.areas);
+      chf.spans = 0;
+      chf.areas = 0;
+      chf.maxSpans = 0;
+   }
+
    // Fill in header.
    chf.width = w;
    chf.height = h;
@@ -435,26 +469,30 @@ bool rcBuildCompactHeightfield(rcContext* ctx, const int walkableHeight, const i
    chf.bmax[1] += walkableHeight*hf.ch;
    chf.cs = hf.cs;
    chf.ch = hf.ch;
-   chf.cells = (rcCompactCell*)rcAlloc(sizeof(rcCompactCell)*w*h, RC_ALLOC_PERM);
+   if (!chf.cells)
+      chf.cells = (rcCompactCell*)rcAlloc(sizeof(rcCompactCell)*w*h, RC_ALLOC_PERM);
    if (!chf.cells)
    {
       ctx->log(RC_LOG_ERROR, "rcBuildCompactHeightfield: Out of memory 'chf.cells' (%d)", w*h);
       return false;
    }
    memset(chf.cells, 0, sizeof(rcCompactCell)*w*h);
-   chf.spans = (rcCompactSpan*)rcAlloc(sizeof(rcCompactSpan)*spanCount, RC_ALLOC_PERM);
+   if (!chf.spans)
+      chf.spans = (rcCompactSpan*)rcAlloc(sizeof(rcCompactSpan)*spanCount, RC_ALLOC_PERM);
    if (!chf.spans)
    {
       ctx->log(RC_LOG_ERROR, "rcBuildCompactHeightfield: Out of memory 'chf.spans' (%d)", spanCount);
       return false;
    }
    memset(chf.spans, 0, sizeof(rcCompactSpan)*spanCount);
-   chf.areas = (unsigned char*)rcAlloc(sizeof(unsigned char)*spanCount, RC_ALLOC_PERM);
+   if (!chf.areas)
+      chf.areas = (unsigned char*)rcAlloc(sizeof(unsigned char)*spanCount, RC_ALLOC_PERM);
    if (!chf.areas)
    {
       ctx->log(RC_LOG_ERROR, "rcBuildCompactHeightfield: Out of memory 'chf.areas' (%d)", spanCount);
       return false;
    }
+   chf.maxSpans = rcMax(chf.maxSpans, spanCount);
    memset(chf.areas, RC_NULL_AREA, sizeof(unsigned char)*spanCount);
 
    const int MAX_HEIGHT = 0xffff;
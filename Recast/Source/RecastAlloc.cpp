@@ -34,6 +34,9 @@ static void rcFreeDefault(void *ptr)
 static rcAllocFunc* sRecastAllocFunc = rcAllocDefault;
 static rcFreeFunc* sRecastFreeFunc = rcFreeDefault;
 
+// The allocator bound by the innermost rcTempAllocScope of each thread.
+static thread_local rcTempAllocator* sTempAllocator = 0;
+
 /// @see rcAlloc, rcFree
 void rcAllocSetCustom(rcAllocFunc *allocFunc, rcFreeFunc *freeFunc)
 {
@@ -44,6 +47,8 @@ void rcAllocSetCustom(rcAllocFunc *allocFunc, rcFreeFunc *freeFunc)
 /// @see rcAllocSetCustom
 void* rcAlloc(size_t size, rcAllocHint hint)
 {
+	if (hint == RC_ALLOC_TEMP && sTempAllocator)
+		return sTempAllocator->alloc(size);
 	return sRecastAllocFunc(size, hint);
 }
 
@@ -55,6 +60,81 @@ void* rcAlloc(size_t size, rcAllocHint hint)
 /// @see rcAllocSetCustom
 void rcFree(void* ptr)
 {
-	if (ptr)
-		sRecastFreeFunc(ptr);
+	if (!ptr)
+		return;
+	if (sTempAllocator && sTempAllocator->free(ptr))
+		return;
+	sRecastFreeFunc(ptr);
+}
+
+rcTempAllocator::rcTempAllocator()
+	: m_block(0)
+	, m_capacity(0)
+	, m_top(0)
+	, m_overflow(0)
+	, m_high(0)
+	, m_count(0)
+{
+}
+
+rcTempAllocator::~rcTempAllocator()
+{
+	rcAssert(m_count == 0);
+	if (m_block)
+		sRecastFreeFunc(m_block);
+}
+
+void* rcTempAllocator::alloc(size_t size)
+{
+	// Keep the allocations aligned like malloc does.
+	size = (size + 15) & ~(size_t)15;
+
+	if (m_count == 0 && m_high > m_capacity)
+	{
+		if (m_block)
+			sRecastFreeFunc(m_block);
+		m_block = (unsigned char*)sRecastAllocFunc(m_high, RC_ALLOC_PERM);
+		m_capacity = m_block ? m_high : 0;
+		m_overflow = 0;
+	}
+
+	if (m_top + m_overflow + size > m_high)
+		m_high = m_top + m_overflow + size;
+
+	if (m_top + size > m_capacity)
+	{
+		m_overflow += size;
+		return sRecastAllocFunc(size, RC_ALLOC_TEMP);
+	}
+
+	void* ptr = m_block + m_top;
+	m_top += size;
+	m_count++;
+	return ptr;
+}
+
+bool rcTempAllocator::free(void* ptr)
+{
+	if (ptr < m_block || ptr >= m_block + m_capacity)
+		return false;
+
+	// The memory is reused once everything allocated from the block is freed.
+	rcAssert(m_count > 0);
+	if (--m_count == 0)
+	{
+		m_top = 0;
+		m_overflow = 0;
+	}
+	return true;
+}
+
+rcTempAllocScope::rcTempAllocScope(rcTempAllocator& allocator)
+	: m_previous(sTempAllocator)
+{
+	sTempAllocator = &allocator;
+}
+
+rcTempAllocScope::~rcTempAllocScope()
+{
+	sTempAllocator = m_previous;
 }
@@ -200,3 +200,121 @@ void rcFilterWalkableLowHeightSpans(rcContext* ctx, int walkableHeight, rcHeight
 		}
 	}
 }
+
+// The ledge test of rcFilterLedgeSpans for a span from bot to top that has more than walkableHeight
+// of room above it. It stops as soon as the span is known to be a ledge.
+static bool isLedgeSpan(const rcHeightfield& solid, const int x, const int y, const int bot, const int top,
+						const int walkableHeight, const int walkableClimb)
+{
+	const int w = solid.width;
+	const int h = solid.height;
+	const int MAX_HEIGHT = 0xffff;
+	
+	// Min and max height of accessible neighbours.
+	int asmin = bot;
+	int asmax = bot;
+	
+	for (int dir = 0; dir < 4; ++dir)
+	{
+		int dx = x + rcGetDirOffsetX(dir);
+		int dy = y + rcGetDirOffsetY(dir);
+		// The drop to a neighbour out of bounds is the height of the span.
+		if (dx < 0 || dy < 0 || dx >= w || dy >= h)
+		{
+			if (bot > 0)
+				return true;
+			continue;
+		}
+		
+		// From minus infinity to the first span.
+		const rcSpan* ns = solid.spans[dx + dy*w];
+		int ntop = ns ? (int)ns->smin : MAX_HEIGHT;
+		if (rcMin(top,ntop) - bot > walkableHeight && bot > 0)
+			return true;
+		
+		// Rest of the spans.
+		for (; ns; ns = ns->next)
+		{
+			const int nbot = (int)ns->smax;
+			// The spans are sorted, so the gap of this span and of all spans above it is too small.
+			if (nbot >= top - walkableHeight)
+				break;
+			ntop = ns->next ? (int)ns->next->smin : MAX_HEIGHT;
+			// Skip neightbour if the gap between the spans is too small.
+			if (rcMin(top,ntop) - rcMax(bot,nbot) > walkableHeight)
+			{
+				// The drop to the neighbour is too large.
+				if (nbot - bot < -walkableClimb)
+					return true;
+				
+				// Find min/max accessible neighbour height. 
+				if (rcAbs(nbot - bot) <= walkableClimb)
+				{
+					if (nbot < asmin) asmin = nbot;
+					if (nbot > asmax) asmax = nbot;
+				}
+			}
+		}
+	}
+	
+	// If the difference between all neighbours is too large,
+	// we are at steep slope, mark the span as ledge.
+	return (asmax - asmin) > walkableClimb;
+}
+
+/// @par
+///
+/// Each of the three filters only changes the area of the span it looks at, and the ledge filter
+/// only looks at the heights of the neighbour spans, not at their areas. So all three are applied
+/// to a span before moving on to the next one, which gives the same areas as the separate filters.
+/// Spans without enough room above them are removed before their neighbours are looked at.
+///
+/// @see rcHeightfield, rcConfig
+void rcFilterSpans(rcContext* ctx, const int walkableHeight, const int walkableClimb, rcHeightfield& solid)
+{
+	rcAssert(ctx);
+	
+	rcScopedTimer timer(ctx, RC_TIMER_FILTER_SPANS);
+	
+	const int w = solid.width;
+	const int h = solid.height;
+	const int MAX_HEIGHT = 0xffff;
+	
+	for (int y = 0; y < h; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			// The walkable flag of the span below, before this pass changed it.
+			bool previousWalkable = false;
+			unsigned char previousArea = RC_NULL_AREA;
+			int previousMax = 0;
+			
+			for (rcSpan* s = solid.spans[x + y*w]; s; s = s->next)
+			{
+				const bool walkable = s->area != RC_NULL_AREA;
+				unsigned char area = (unsigned char)s->area;
+				
+				// Low hanging obstacle, see rcFilterLowHangingWalkableObstacles.
+				if (!walkable && previousWalkable)
+				{
+					if (rcAbs((int)s->smax - previousMax) <= walkableClimb)
+						area = previousArea;
+				}
+				previousWalkable = walkable;
+				previousArea = area;
+				previousMax = (int)s->smax;
+				
+				if (area == RC_NULL_AREA)
+					continue;
+				
+				// Low height span, see rcFilterWalkableLowHeightSpans, or ledge, see rcFilterLedgeSpans.
+				const int bot = (int)(s->smax);
+				const int top = s->next ? (int)(s->next->smin) : MAX_HEIGHT;
+				if ((top - bot) <= walkableHeight || isLedgeSpan(solid, x, y, bot, top, walkableHeight, walkableClimb))
+					area = RC_NULL_AREA;
+				
+				s->area = area;
+			}
+		}
+	}
+}
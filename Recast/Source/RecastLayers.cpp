@@ -97,6 +97,9 @@ bool rcBuildHeightfieldLayers(rcContext* ctx, rcCompactHeightfield& chf,
 	
 	rcScopedTimer timer(ctx, RC_TIMER_BUILD_LAYERS);
 	
+	// A layer set that is built again keeps its layers, see below.
+	lset.nlayers = 0;
+	
 	const int w = chf.width;
 	const int h = chf.height;
 	
@@ -480,8 +483,6 @@ bool rcBuildHeightfieldLayers(rcContext* ctx, rcCompactHeightfield& chf,
 		return true;
 	
 	// Create layers.
-	rcAssert(lset.layers == 0);
-	
 	const int lw = w - borderSize*2;
 	const int lh = h - borderSize*2;
 
@@ -494,15 +495,24 @@ bool rcBuildHeightfieldLayers(rcContext* ctx, rcCompactHeightfield& chf,
 	bmax[0] -= borderSize*chf.cs;
 	bmax[2] -= borderSize*chf.cs;
 	
-	lset.nlayers = (int)layerId;
-	
-	lset.layers = (rcHeightfieldLayer*)rcAlloc(sizeof(rcHeightfieldLayer)*lset.nlayers, RC_ALLOC_PERM);
-	if (!lset.layers)
+	// The layers of a previous build are kept, along with their grids.
+	if ((int)layerId > lset.maxlayers)
 	{
-		ctx->log(RC_LOG_ERROR, "rcBuildHeightfieldLayers: Out of memory 'layers' (%d).", lset.nlayers);
-		return false;
+		rcHeightfieldLayer* layers = (rcHeightfieldLayer*)rcAlloc(sizeof(rcHeightfieldLayer)*layerId, RC_ALLOC_PERM);
+		if (!layers)
+		{
+			ctx->log(RC_LOG_ERROR, "rcBuildHeightfieldLayers: Out of memory 'layers' (%d).", (int)layerId);
+			return false;
+		}
+		if (lset.maxlayers)
+			memcpy(layers, lset.layers, sizeof(rcHeightfieldLayer)*lset.maxlayers);
+		memset(&layers[lset.maxlayers], 0, sizeof(rcHeightfieldLayer)*(layerId - lset.maxlayers));
+		rcFree(lset.layers);
+		lset.layers = layers;
+		lset.maxlayers = (int)layerId;
 	}
-	memset(lset.layers, 0, sizeof(rcHeightfieldLayer)*lset.nlayers);
+	
+	lset.nlayers = (int)layerId;
 
 	
 	// Store layers.
@@ -514,7 +524,20 @@ bool rcBuildHeightfieldLayers(rcContext* ctx, rcCompactHeightfield& chf,
 
 		const int gridSize = sizeof(unsigned char)*lw*lh;
 
-		layer->heights = (unsigned char*)rcAlloc(gridSize, RC_ALLOC_PERM);
+		if (layer->width*layer->height != gridSize)
+		{
+			rcFree(layer->heights);
+			rcFree(layer->areas);
+			rcFree(layer->cons);
+			layer->heights = 0;
+			layer->areas = 0;
+			layer->cons = 0;
+		}
+		layer->width = lw;
+		layer->height = lh;
+
+		if (!layer->heights)
+			layer->heights = (unsigned char*)rcAlloc(gridSize, RC_ALLOC_PERM);
 		if (!layer->heights)
 		{
 			ctx->log(RC_LOG_ERROR, "rcBuildHeightfieldLayers: Out of memory 'heights' (%d).", gridSize);
@@ -522,7 +545,8 @@ bool rcBuildHeightfieldLayers(rcContext* ctx, rcCompactHeightfield& chf,
 		}
 		memset(layer->heights, 0xff, gridSize);
 
-		layer->areas = (unsigned char*)rcAlloc(gridSize, RC_ALLOC_PERM);
+		if (!layer->areas)
+			layer->areas = (unsigned char*)rcAlloc(gridSize, RC_ALLOC_PERM);
 		if (!layer->areas)
 		{
 			ctx->log(RC_LOG_ERROR, "rcBuildHeightfieldLayers: Out of memory 'areas' (%d).", gridSize);
@@ -530,7 +554,8 @@ bool rcBuildHeightfieldLayers(rcContext* ctx, rcCompactHeightfield& chf,
 		}
 		memset(layer->areas, 0, gridSize);
 
-		layer->cons = (unsigned char*)rcAlloc(gridSize, RC_ALLOC_PERM);
+		if (!layer->cons)
+			layer->cons = (unsigned char*)rcAlloc(gridSize, RC_ALLOC_PERM);
 		if (!layer->cons)
 		{
 			ctx->log(RC_LOG_ERROR, "rcBuildHeightfieldLayers: Out of memory 'cons' (%d).", gridSize);
@@ -549,8 +574,6 @@ bool rcBuildHeightfieldLayers(rcContext* ctx, rcCompactHeightfield& chf,
 			}
 		}
 
-		layer->width = lw;
-		layer->height = lh;
 		layer->cs = chf.cs;
 		layer->ch = chf.ch;
 		
@@ -23,6 +23,11 @@
 #include "RecastAlloc.h"
 #include "RecastAssert.h"
 
+#if !defined(RC_RASTER_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define RC_RASTER_SSE
+#include <xmmintrin.h>
+#endif
+
 inline bool overlapBounds(const float* amin, const float* amax, const float* bmin, const float* bmax)
 {
 	bool overlap = true;
@@ -89,71 +94,63 @@ static bool addSpan(rcHeightfield& hf, const int x, const int y,
 	
 	int idx = x + y*hf.width;
 	
-	rcSpan* s = allocSpan(hf);
-	if (!s)
-		return false;
-	s->smin = smin;
-	s->smax = smax;
-	s->area = area;
-	s->next = 0;
+	rcSpan* prev = 0;
+	rcSpan* cur = hf.spans[idx];
 	
-	// Empty cell, add the first span.
-	if (!hf.spans[idx])
+	// Skip the spans before the new span.
+	while (cur && cur->smax < smin)
 	{
-		hf.spans[idx] = s;
-		return true;
+		prev = cur;
+		cur = cur->next;
 	}
-	rcSpan* prev = 0;
-	rcSpan* cur = hf.spans[idx];
 	
-	// Insert and merge spans.
-	while (cur)
+	// Most spans of detailed geometry overlap a span that is already there. The new span is merged
+	// into that span instead of allocating it and freeing the spans it replaces.
+	if (cur && cur->smin <= smax)
 	{
-		if (cur->smin > s->smax)
-		{
-			// Current span is further than the new span, break.
-			break;
-		}
-		else if (cur->smax < s->smin)
-		{
-			// Current span is before the new span advance.
-			prev = cur;
-			cur = cur->next;
-		}
-		else
+		unsigned int nmin = smin, nmax = smax;
+		unsigned char narea = area;
+		rcSpan* merged = cur;
+		
+		// Merge spans.
+		while (cur && cur->smin <= nmax)
 		{
-			// Merge spans.
-			if (cur->smin < s->smin)
-				s->smin = cur->smin;
-			if (cur->smax > s->smax)
-				s->smax = cur->smax;
+			if (cur->smin < nmin)
+				nmin = cur->smin;
+			if (cur->smax > nmax)
+				nmax = cur->smax;
 			
 			// Merge flags.
-			if (rcAbs((int)s->smax - (int)cur->smax) <= flagMergeThr)
-				s->area = rcMax(s->area, cur->area);
+			if (rcAbs((int)nmax - (int)cur->smax) <= flagMergeThr)
+				narea = rcMax(narea, (unsigned char)cur->area);
 			
-			// Remove current span.
+			// Remove current span, except the one that is kept.
 			rcSpan* next = cur->next;
-			freeSpan(hf, cur);
-			if (prev)
-				prev->next = next;
-			else
-				hf.spans[idx] = next;
+			if (cur != merged)
+				freeSpan(hf, cur);
 			cur = next;
 		}
+		
+		merged->smin = nmin;
+		merged->smax = nmax;
+		merged->area = narea;
+		merged->next = cur;
+		return true;
 	}
 	
+	rcSpan* s = allocSpan(hf);
+	if (!s)
+		return false;
+	s->smin = smin;
+	s->smax = smax;
+	s->area = area;
+	
 	// Insert new span.
+	s->next = cur;
 	if (prev)
-	{
-		s->next = prev->next;
 		prev->next = s;
-	}
 	else
-	{
-		s->next = hf.spans[idx];
 		hf.spans[idx] = s;
-	}
 
 	return true;
 }
@@ -180,6 +177,7 @@ bool rcAddSpan(rcContext* ctx, rcHeightfield& hf, const int x, const int y,
 	return true;
 }
 
+#ifndef RC_RASTER_SSE
 // divides a convex polygons into two convex polygons on both sides of a line
 static void dividePoly(const float* in, int nin,
 					  float* out1, int* nout1,
@@ -235,8 +233,87 @@ static void dividePoly(const float* in, int nin,
 	*nout1 = m;
 	*nout2 = n;
 }
+#else
+// dividePoly with each vertex padded to four floats, so that it is copied and clipped with one
+// instruction. The lanes do the same operations on x, y and z as dividePoly, so the polygons are
+// exactly the same.
+static void dividePoly4(const float* in, int nin,
+					   float* out1, int* nout1,
+					   float* out2, int* nout2,
+					   float x, int axis)
+{
+	float d[12];
+	for (int i = 0; i < nin; ++i)
+		d[i] = x - in[i*4+axis];
 
+	int m = 0, n = 0;
+	for (int i = 0, j = nin-1; i < nin; j=i, ++i)
+	{
+		const __m128 vi = _mm_load_ps(in + i*4);
+		bool ina = d[j] >= 0;
+		bool inb = d[i] >= 0;
+		if (ina != inb)
+		{
+			const __m128 vj = _mm_load_ps(in + j*4);
+			const __m128 s = _mm_set1_ps(d[j] / (d[j] - d[i]));
+			const __m128 v = _mm_add_ps(vj, _mm_mul_ps(_mm_sub_ps(vi, vj), s));
+			_mm_store_ps(out1 + m*4, v);
+			_mm_store_ps(out2 + n*4, v);
+			m++;
+			n++;
+			// add the i'th point to the right polygon. Do NOT add points that are on the dividing line
+			// since these were already added above
+			if (d[i] > 0)
+			{
+				_mm_store_ps(out1 + m*4, vi);
+				m++;
+			}
+			else if (d[i] < 0)
+			{
+				_mm_store_ps(out2 + n*4, vi);
+				n++;
+			}
+		}
+		else // same side
+		{
+			// add the i'th point to the right polygon. Addition is done even for points on the dividing line
+			if (d[i] >= 0)
+			{
+				_mm_store_ps(out1 + m*4, vi);
+				m++;
+				if (d[i] != 0)
+					continue;
+			}
+			_mm_store_ps(out2 + n*4, vi);
+			n++;
+		}
+	}
 
+	*nout1 = m;
+	*nout2 = n;
+}
+#endif
+
+// Snaps the height range of the triangle in cell x, y to the height grid and adds it as a span.
+inline bool addTriSpan(rcHeightfield& hf, const int x, const int y,
+					   float smin, float smax, const float* bmin, const float by, const float ich,
+					   const unsigned char area, const int flagMergeThr)
+{
+	smin -= bmin[1];
+	smax -= bmin[1];
+	// Skip the span if it is outside the heightfield bbox
+	if (smax < 0.0f) return true;
+	if (smin > by) return true;
+	// Clamp the span to the heightfield bbox.
+	if (smin < 0.0f) smin = 0;
+	if (smax > by) smax = by;
+
+	// Snap the span to the heightfield height grid.
+	unsigned short ismin = (unsigned short)rcClamp((int)floorf(smin * ich), 0, RC_SPAN_MAX_HEIGHT);
+	unsigned short ismax = (unsigned short)rcClamp((int)ceilf(smax * ich), (int)ismin+1, RC_SPAN_MAX_HEIGHT);
+
+	return addSpan(hf, x, y, ismin, ismax, area, flagMergeThr);
+}
 
 static bool rasterizeTri(const float* v0, const float* v1, const float* v2,
 						 const unsigned char area, rcHeightfield& hf,
@@ -266,7 +343,75 @@ static bool rasterizeTri(const float* v0, const float* v1, const float* v2,
 	int y1 = (int)((tmax[2] - bmin[2])*ics);
 	y0 = rcClamp(y0, 0, h-1);
 	y1 = rcClamp(y1, 0, h-1);
+
+	// Triangles of detailed meshes are often smaller than a cell. If the triangle lies on the near
+	// side of the far edges of its first row and column, clipping would give back the triangle
+	// itself, so its height range is the span.
+	if (y0 == y1 && bmin[2] + y0*cs + cs - tmax[2] >= 0)
+	{
+		int x0 = (int)((tmin[0] - bmin[0])*ics);
+		int x1 = (int)((tmax[0] - bmin[0])*ics);
+		x0 = rcClamp(x0, 0, w-1);
+		x1 = rcClamp(x1, 0, w-1);
+		if (x0 == x1 && bmin[0] + x0*cs + cs - tmax[0] >= 0)
+			return addTriSpan(hf, x0, y0, tmin[1], tmax[1], bmin, by, ich, area, flagMergeThr);
+	}
+
+#ifdef RC_RASTER_SSE
+	// Clip the triangle into all grid cells it touches.
+	__m128 buf[7*4];
+	float *in = (float*)buf, *inrow = in+7*4, *p1 = inrow+7*4, *p2 = p1+7*4;
+
+	_mm_store_ps(&in[0], _mm_setr_ps(v0[0], v0[1], v0[2], 0));
+	_mm_store_ps(&in[1*4], _mm_setr_ps(v1[0], v1[1], v1[2], 0));
+	_mm_store_ps(&in[2*4], _mm_setr_ps(v2[0], v2[1], v2[2], 0));
+	int nvrow, nvIn = 3;
 	
+	for (int y = y0; y <= y1; ++y)
+	{
+		// Clip polygon to row. Store the remaining polygon as well
+		const float cz = bmin[2] + y*cs;
+		dividePoly4(in, nvIn, inrow, &nvrow, p1, &nvIn, cz+cs, 2);
+		rcSwap(in, p1);
+		if (nvrow < 3) continue;
+		
+		// find the horizontal bounds in the row
+		__m128 rowMin = _mm_load_ps(inrow), rowMax = rowMin;
+		for (int i=1; i<nvrow; ++i)
+		{
+			rowMin = _mm_min_ps(rowMin, _mm_load_ps(inrow + i*4));
+			rowMax = _mm_max_ps(rowMax, _mm_load_ps(inrow + i*4));
+		}
+		int x0 = (int)((_mm_cvtss_f32(rowMin) - bmin[0])*ics);
+		int x1 = (int)((_mm_cvtss_f32(rowMax) - bmin[0])*ics);
+		x0 = rcClamp(x0, 0, w-1);
+		x1 = rcClamp(x1, 0, w-1);
+
+		int nv, nv2 = nvrow;
+
+		for (int x = x0; x <= x1; ++x)
+		{
+			// Clip polygon to column. store the remaining polygon as well
+			const float cx = bmin[0] + x*cs;
+			dividePoly4(inrow, nv2, p1, &nv, p2, &nv2, cx+cs, 0);
+			rcSwap(inrow, p2);
+			if (nv < 3) continue;
+			
+			// Calculate min and max of the span.
+			__m128 smin = _mm_load_ps(p1), smax = smin;
+			for (int i = 1; i < nv; ++i)
+			{
+				smin = _mm_min_ps(smin, _mm_load_ps(p1 + i*4));
+				smax = _mm_max_ps(smax, _mm_load_ps(p1 + i*4));
+			}
+			smin = _mm_shuffle_ps(smin, smin, _MM_SHUFFLE(1,1,1,1));
+			smax = _mm_shuffle_ps(smax, smax, _MM_SHUFFLE(1,1,1,1));
+
+			if (!addTriSpan(hf, x, y, _mm_cvtss_f32(smin), _mm_cvtss_f32(smax), bmin, by, ich, area, flagMergeThr))
+				return false;
+		}
+	}
+#else
 	// Clip the triangle into all grid cells it touches.
 	float buf[7*3*4];
 	float *in = buf, *inrow = buf+7*3, *p1 = inrow+7*3, *p2 = p1+7*3;
@@ -313,23 +458,12 @@ static bool rasterizeTri(const float* v0, const float* v1, const float* v2,
 				smin = rcMin(smin, p1[i*3+1]);
 				smax = rcMax(smax, p1[i*3+1]);
 			}
-			smin -= bmin[1];
-			smax -= bmin[1];
-			// Skip the span if it is outside the heightfield bbox
-			if (smax < 0.0f) continue;
-			if (smin > by) continue;
-			// Clamp the span to the heightfield bbox.
-			if (smin < 0.0f) smin = 0;
-			if (smax > by) smax = by;
-			
-			// Snap the span to the heightfield height grid.
-			unsigned short ismin = (unsigned short)rcClamp((int)floorf(smin * ich), 0, RC_SPAN_MAX_HEIGHT);
-			unsigned short ismax = (unsigned short)rcClamp((int)ceilf(smax * ich), (int)ismin+1, RC_SPAN_MAX_HEIGHT);
-			
-			if (!addSpan(hf, x, y, ismin, ismax, area, flagMergeThr))
+
+			if (!addTriSpan(hf, x, y, smin, smax, bmin, by, ich, area, flagMergeThr))
 				return false;
 		}
 	}
+#endif
 
 	return true;
 }
@@ -0,0 +1,462 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+// Checks that rcForEachChunkOverlappingRect visits every triangle whose bounds overlap a
+// rectangle, and times the build and the queries of rcChunkyTriMesh against the median split
+// tree it replaced, which is kept below in namespace old. Returns non-zero if a triangle is
+// missed, or if the tree does not hold every triangle exactly once.
+//
+// The scene is a grid of ground triangles with dense clusters of clutter on it, queried with
+// rectangles of the size of a tile and of a large obstacle.
+//
+// Build and run from the repository root:
+//   c++ -O2 -pthread -IRecast/Include -Iinclude Recast/Tests/CheckChunkyTriMesh.cpp source/ChunkyTriMesh.cpp source/WorkerPool.cpp -o checkchunkytrimesh
+//   ./checkchunkytrimesh
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include "ChunkyTriMesh.h"
+
+namespace old
+{
+
+struct rcChunkyTriMeshNode
+{
+	float bmin[2], bmax[2];
+	int i, n;
+};
+
+struct rcChunkyTriMesh
+{
+	inline rcChunkyTriMesh() : nodes(0), nnodes(0), tris(0), ntris(0), maxTrisPerChunk(0) {};
+	inline ~rcChunkyTriMesh() { delete [] nodes; delete [] tris; }
+
+	rcChunkyTriMeshNode* nodes;
+	int nnodes;
+	int* tris;
+	int ntris;
+	int maxTrisPerChunk;
+};
+
+struct BoundsItem
+{
+	float bmin[2];
+	float bmax[2];
+	int i;
+};
+
+static int compareItemX(const void* va, const void* vb)
+{
+	const BoundsItem* a = (const BoundsItem*)va;
+	const BoundsItem* b = (const BoundsItem*)vb;
+	if (a->bmin[0] < b->bmin[0])
+		return -1;
+	if (a->bmin[0] > b->bmin[0])
+		return 1;
+	return 0;
+}
+
+static int compareItemY(const void* va, const void* vb)
+{
+	const BoundsItem* a = (const BoundsItem*)va;
+	const BoundsItem* b = (const BoundsItem*)vb;
+	if (a->bmin[1] < b->bmin[1])
+		return -1;
+	if (a->bmin[1] > b->bmin[1])
+		return 1;
+	return 0;
+}
+
+static void calcExtends(const BoundsItem* items, const int imin, const int imax, float* bmin, float* bmax)
+{
+	bmin[0] = items[imin].bmin[0];
+	bmin[1] = items[imin].bmin[1];
+
+	bmax[0] = items[imin].bmax[0];
+	bmax[1] = items[imin].bmax[1];
+
+	for (int i = imin+1; i < imax; ++i)
+	{
+		const BoundsItem& it = items[i];
+		if (it.bmin[0] < bmin[0]) bmin[0] = it.bmin[0];
+		if (it.bmin[1] < bmin[1]) bmin[1] = it.bmin[1];
+
+		if (it.bmax[0] > bmax[0]) bmax[0] = it.bmax[0];
+		if (it.bmax[1] > bmax[1]) bmax[1] = it.bmax[1];
+	}
+}
+
+static void subdivide(BoundsItem* items, int imin, int imax, int trisPerChunk,
+					  int& curNode, rcChunkyTriMeshNode* nodes, const int maxNodes,
+					  int& curTri, int* outTris, const int* inTris)
+{
+	int inum = imax - imin;
+	int icur = curNode;
+
+	if (curNode > maxNodes)
+		return;
+
+	rcChunkyTriMeshNode& node = nodes[curNode++];
+
+	if (inum <= trisPerChunk)
+	{
+		// Leaf
+		calcExtends(items, imin, imax, node.bmin, node.bmax);
+
+		// Copy triangles.
+		node.i = curTri;
+		node.n = inum;
+
+		for (int i = imin; i < imax; ++i)
+		{
+			const int* src = &inTris[items[i].i*3];
+			int* dst = &outTris[curTri*3];
+			curTri++;
+			dst[0] = src[0];
+			dst[1] = src[1];
+			dst[2] = src[2];
+		}
+	}
+	else
+	{
+		// Split
+		calcExtends(items, imin, imax, node.bmin, node.bmax);
+
+		const int axis = node.bmax[1] - node.bmin[1] > node.bmax[0] - node.bmin[0] ? 1 : 0;
+		if (axis == 0)
+			qsort(items+imin, inum, sizeof(BoundsItem), compareItemX);
+		else
+			qsort(items+imin, inum, sizeof(BoundsItem), compareItemY);
+
+		int isplit = imin+inum/2;
+
+		// Left
+		subdivide(items, imin, isplit, trisPerChunk, curNode, nodes, maxNodes, curTri, outTris, inTris);
+		// Right
+		subdivide(items, isplit, imax, trisPerChunk, curNode, nodes, maxNodes, curTri, outTris, inTris);
+
+		int iescape = curNode - icur;
+		// Negative index means escape.
+		node.i = -iescape;
+	}
+}
+
+bool rcCreateChunkyTriMesh(const float* verts, const int* tris, int ntris,
+						   int trisPerChunk, rcChunkyTriMesh* cm)
+{
+	int nchunks = (ntris + trisPerChunk-1) / trisPerChunk;
+
+	cm->nodes = new rcChunkyTriMeshNode[nchunks*4];
+	cm->tris = new int[ntris*3];
+	cm->ntris = ntris;
+
+	// Build tree
+	BoundsItem* items = new BoundsItem[ntris];
+	for (int i = 0; i < ntris; i++)
+	{
+		const int* t = &tris[i*3];
+		BoundsItem& it = items[i];
+		it.i = i;
+		// Calc triangle XZ bounds.
+		it.bmin[0] = it.bmax[0] = verts[t[0]*3+0];
+		it.bmin[1] = it.bmax[1] = verts[t[0]*3+2];
+		for (int j = 1; j < 3; ++j)
+		{
+			const float* v = &verts[t[j]*3];
+			if (v[0] < it.bmin[0]) it.bmin[0] = v[0];
+			if (v[2] < it.bmin[1]) it.bmin[1] = v[2];
+
+			if (v[0] > it.bmax[0]) it.bmax[0] = v[0];
+			if (v[2] > it.bmax[1]) it.bmax[1] = v[2];
+		}
+	}
+
+	int curTri = 0;
+	int curNode = 0;
+	subdivide(items, 0, ntris, trisPerChunk, curNode, cm->nodes, nchunks*4, curTri, cm->tris, tris);
+
+	delete [] items;
+
+	cm->nnodes = curNode;
+
+	// Calc max tris per node.
+	cm->maxTrisPerChunk = 0;
+	for (int i = 0; i < cm->nnodes; ++i)
+	{
+		rcChunkyTriMeshNode& node = cm->nodes[i];
+		const bool isLeaf = node.i >= 0;
+		if (!isLeaf) continue;
+		if (node.n > cm->maxTrisPerChunk)
+			cm->maxTrisPerChunk = node.n;
+	}
+
+	return true;
+}
+
+inline bool checkOverlapRect(const float amin[2], const float amax[2],
+							 const float bmin[2], const float bmax[2])
+{
+	bool overlap = true;
+	overlap = (amin[0] > bmax[0] || amax[0] < bmin[0]) ? false : overlap;
+	overlap = (amin[1] > bmax[1] || amax[1] < bmin[1]) ? false : overlap;
+	return overlap;
+}
+
+int rcGetChunksOverlappingRect(const rcChunkyTriMesh* cm,
+							   float bmin[2], float bmax[2],
+							   int* ids, const int maxIds)
+{
+	// Traverse tree
+	int i = 0;
+	int n = 0;
+	while (i < cm->nnodes)
+	{
+		const rcChunkyTriMeshNode* node = &cm->nodes[i];
+		const bool overlap = checkOverlapRect(bmin, bmax, node->bmin, node->bmax);
+		const bool isLeafNode = node->i >= 0;
+
+		if (isLeafNode && overlap)
+		{
+			if (n < maxIds)
+			{
+				ids[n] = i;
+				n++;
+			}
+		}
+
+		if (overlap || isLeafNode)
+			i++;
+		else
+		{
+			const int escapeIndex = -node->i;
+			i += escapeIndex;
+		}
+	}
+
+	return n;
+}
+
+}
+
+namespace
+{
+
+const int GRID_SIZE = 700;
+const int CLUSTER_COUNT = 200;
+const int CLUSTER_TRIS = 2000;
+const int TRIS_PER_CHUNK = 256;
+const int QUERY_COUNT = 20000;
+// Queries checked against every triangle of the scene.
+const int CHECKED_QUERY_COUNT = 200;
+
+typedef std::chrono::steady_clock Clock;
+
+double msSince(const Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+unsigned int g_seed = 1;
+
+float frand()
+{
+	g_seed = g_seed*1103515245u + 12345u;
+	return ((g_seed >> 8) & 0xffff) / 65535.0f;
+}
+
+void buildScene(std::vector<float>& verts, std::vector<int>& tris)
+{
+	for (int z = 0; z <= GRID_SIZE; ++z)
+	{
+		for (int x = 0; x <= GRID_SIZE; ++x)
+		{
+			verts.push_back((float)x);
+			verts.push_back(frand());
+			verts.push_back((float)z);
+		}
+	}
+	for (int z = 0; z < GRID_SIZE; ++z)
+	{
+		for (int x = 0; x < GRID_SIZE; ++x)
+		{
+			const int i = z*(GRID_SIZE+1) + x;
+			const int quad[6] = { i, i+GRID_SIZE+1, i+1, i+1, i+GRID_SIZE+1, i+GRID_SIZE+2 };
+			tris.insert(tris.end(), quad, quad+6);
+		}
+	}
+
+	for (int c = 0; c < CLUSTER_COUNT; ++c)
+	{
+		const float cx = frand()*GRID_SIZE, cz = frand()*GRID_SIZE;
+		for (int k = 0; k < CLUSTER_TRIS; ++k)
+		{
+			const int base = (int)verts.size()/3;
+			for (int j = 0; j < 3; ++j)
+			{
+				verts.push_back(cx + frand()*3);
+				verts.push_back(frand()*5);
+				verts.push_back(cz + frand()*3);
+			}
+			tris.push_back(base);
+			tris.push_back(base+1);
+			tris.push_back(base+2);
+		}
+	}
+}
+
+// Triangles are told apart by their first two vertices, which no two triangles of the scene share.
+long long triKey(const int* t)
+{
+	return (long long)t[0]<<32 | (unsigned int)t[1];
+}
+
+// Counts the triangles overlapping [bmin, bmax] that the tree does not visit.
+int countMissed(const std::vector<float>& verts, const std::vector<int>& tris, const rcChunkyTriMesh& cm,
+				const float* bmin, const float* bmax)
+{
+	std::vector<long long> keys;
+	rcForEachChunkOverlappingRect(&cm, bmin, bmax, [&keys] (const int* t, const int n)
+	{
+		for (int i = 0; i < n; ++i)
+			keys.push_back(triKey(&t[i*3]));
+	});
+	std::sort(keys.begin(), keys.end());
+
+	int missed = 0;
+	const int ntris = (int)tris.size()/3;
+	for (int i = 0; i < ntris; ++i)
+	{
+		const int* t = &tris[i*3];
+		float tmin[2] = { verts[t[0]*3], verts[t[0]*3+2] };
+		float tmax[2] = { tmin[0], tmin[1] };
+		for (int j = 1; j < 3; ++j)
+		{
+			tmin[0] = std::min(tmin[0], verts[t[j]*3]);
+			tmin[1] = std::min(tmin[1], verts[t[j]*3+2]);
+			tmax[0] = std::max(tmax[0], verts[t[j]*3]);
+			tmax[1] = std::max(tmax[1], verts[t[j]*3+2]);
+		}
+		if (tmin[0] > bmax[0] || tmax[0] < bmin[0] || tmin[1] > bmax[1] || tmax[1] < bmin[1])
+			continue;
+		if (!std::binary_search(keys.begin(), keys.end(), triKey(t)))
+			missed++;
+	}
+	return missed;
+}
+
+// Checks that the leaves hold every triangle of the scene exactly once.
+bool isPermutation(const std::vector<int>& tris, const rcChunkyTriMesh& cm)
+{
+	if (cm.ntris*3 != (int)tris.size())
+		return false;
+	std::vector<long long> a, b;
+	for (int i = 0; i < cm.ntris; ++i)
+	{
+		a.push_back(triKey(&tris[i*3]));
+		b.push_back(triKey(&cm.tris[i*3]));
+	}
+	std::sort(a.begin(), a.end());
+	std::sort(b.begin(), b.end());
+	return a == b;
+}
+
+}
+
+int main()
+{
+	std::vector<float> verts;
+	std::vector<int> tris;
+	buildScene(verts, tris);
+	const int ntris = (int)tris.size()/3;
+	printf("%d triangles, %d per chunk\n\n", ntris, TRIS_PER_CHUNK);
+
+	Clock::time_point start = Clock::now();
+	old::rcChunkyTriMesh oldMesh;
+	old::rcCreateChunkyTriMesh(&verts[0], &tris[0], ntris, TRIS_PER_CHUNK, &oldMesh);
+	const double oldBuildMs = msSince(start);
+
+	start = Clock::now();
+	rcChunkyTriMesh mesh;
+	const bool built = rcCreateChunkyTriMesh(&verts[0], &tris[0], ntris, TRIS_PER_CHUNK, &mesh);
+	const double buildMs = msSince(start);
+
+	printf("build                old %8.1f ms  %6d nodes     new %8.1f ms  %6d nodes\n",
+		   oldBuildMs, oldMesh.nnodes, buildMs, mesh.nnodes);
+
+	bool ok = built && isPermutation(tris, mesh) && mesh.maxTrisPerChunk <= TRIS_PER_CHUNK;
+
+	std::vector<float> corners(QUERY_COUNT*2);
+	for (int i = 0; i < QUERY_COUNT*2; ++i)
+		corners[i] = frand()*GRID_SIZE;
+
+	static const float sizes[] = { 24, 160 };
+	for (int s = 0; s < (int)(sizeof(sizes)/sizeof(sizes[0])); ++s)
+	{
+		const float size = sizes[s];
+
+		// The old query stops at the number of ids it is given, 512 like its caller used.
+		long long oldVisited = 0;
+		int truncated = 0;
+		int ids[512];
+		start = Clock::now();
+		for (int q = 0; q < QUERY_COUNT; ++q)
+		{
+			float bmin[2] = { corners[q*2], corners[q*2+1] };
+			float bmax[2] = { bmin[0] + size, bmin[1] + size };
+			const int n = old::rcGetChunksOverlappingRect(&oldMesh, bmin, bmax, ids, 512);
+			for (int i = 0; i < n; ++i)
+				oldVisited += oldMesh.nodes[ids[i]].n;
+			truncated += n == 512 ? 1 : 0;
+		}
+		const double oldQueryMs = msSince(start);
+
+		long long visited = 0;
+		start = Clock::now();
+		for (int q = 0; q < QUERY_COUNT; ++q)
+		{
+			const float bmin[2] = { corners[q*2], corners[q*2+1] };
+			const float bmax[2] = { bmin[0] + size, bmin[1] + size };
+			rcForEachChunkOverlappingRect(&mesh, bmin, bmax, [&visited] (const int*, const int n)
+			{
+				visited += n;
+			});
+		}
+		const double queryMs = msSince(start);
+
+		int missed = 0;
+		for (int q = 0; q < CHECKED_QUERY_COUNT; ++q)
+		{
+			const float bmin[2] = { corners[q*2], corners[q*2+1] };
+			const float bmax[2] = { bmin[0] + size, bmin[1] + size };
+			missed += countMissed(verts, tris, mesh, bmin, bmax);
+		}
+
+		printf("%dk %3.0fx%-3.0f queries  old %8.1f ms  %6.0f tris/q    new %8.1f ms  %6.0f tris/q  %d missed",
+			   QUERY_COUNT/1000, size, size, oldQueryMs, (double)oldVisited/QUERY_COUNT,
+			   queryMs, (double)visited/QUERY_COUNT, missed);
+		if (truncated)
+			printf(", old truncated %d", truncated);
+		printf("\n");
+		ok &= missed == 0;
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,265 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+// Checks that the SSE path of rcRasterizeTriangles produces exactly the spans of the scalar
+// path, and times both. Returns non-zero if any span differs.
+//
+// RecastRasterization.cpp is compiled twice into this program, once with RC_RASTER_NO_SIMD
+// into namespace scalar and once without into namespace simd, so both paths run side by side.
+//
+// Build and run from the repository root:
+//   c++ -O2 -IRecast/Include Recast/Tests/CheckRasterization.cpp Recast/Source/*.cpp -o checkrasterization
+//   ./checkrasterization
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include <chrono>
+#include "Recast.h"
+#include "RecastAlloc.h"
+#include "RecastAssert.h"
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#endif
+
+// The scalar copy must come first, RC_RASTER_SSE stays defined once the SSE copy has set it.
+#define RC_RASTER_NO_SIMD
+namespace scalar
+{
+#include "../Source/RecastRasterization.cpp"
+}
+#undef RC_RASTER_NO_SIMD
+namespace simd
+{
+#include "../Source/RecastRasterization.cpp"
+}
+
+namespace
+{
+
+struct Geometry
+{
+	const char* name;
+	std::vector<float> verts;
+	std::vector<int> tris;
+	std::vector<unsigned char> areas;
+};
+
+// Small deterministic generator, so every run checks the same data.
+struct Random
+{
+	unsigned int state;
+	explicit Random(unsigned int seed) : state(seed) {}
+	unsigned int next() { state = state*1664525u + 1013904223u; return state >> 8; }
+	float range(float lo, float hi) { return lo + (hi - lo)*(next() & 0xffff)/65535.0f; }
+};
+
+Geometry makeTerrain(const char* name, const float step, const float size)
+{
+	Geometry geom;
+	geom.name = name;
+	const int n = (int)(size/step) + 1;
+	for (int j = 0; j < n; ++j)
+	{
+		for (int i = 0; i < n; ++i)
+		{
+			const float x = i*step - 1.5f;
+			const float z = j*step - 1.5f;
+			geom.verts.push_back(x);
+			geom.verts.push_back(2.0f*sinf(x*0.37f)*cosf(z*0.23f) + 0.5f*sinf(x*2.1f + z*1.3f));
+			geom.verts.push_back(z);
+		}
+	}
+	for (int j = 0; j < n-1; ++j)
+	{
+		for (int i = 0; i < n-1; ++i)
+		{
+			const int a = j*n + i;
+			const int t[6] = { a, a+n, a+1, a+1, a+n, a+n+1 };
+			geom.tris.insert(geom.tris.end(), t, t+6);
+		}
+	}
+	return geom;
+}
+
+// Randomly placed triangles. With snapping, about half of the vertices are moved onto cell
+// borders and some onto height steps, where rounding differences would show first.
+Geometry makeSoup(const char* name, const int count, const float maxSize, const unsigned int seed, const bool snap)
+{
+	Geometry geom;
+	geom.name = name;
+	Random rand(seed);
+	for (int i = 0; i < count; ++i)
+	{
+		const float cx = rand.range(-2, 15);
+		const float cy = rand.range(-2, 15)*0.5f;
+		const float cz = rand.range(-2, 15);
+		for (int k = 0; k < 3; ++k)
+		{
+			float x = cx + rand.range(-maxSize, maxSize);
+			float y = cy + rand.range(-maxSize, maxSize);
+			float z = cz + rand.range(-maxSize, maxSize);
+			if (snap && (rand.next() & 1))
+			{
+				x = floorf(x/0.3f + 0.5f)*0.3f;
+				z = floorf(z/0.3f + 0.5f)*0.3f;
+			}
+			if (snap && rand.next() % 5 == 0)
+				y = floorf(y/0.2f + 0.5f)*0.2f;
+			geom.verts.push_back(x);
+			geom.verts.push_back(y);
+			geom.verts.push_back(z);
+			geom.tris.push_back(i*3 + k);
+		}
+	}
+	return geom;
+}
+
+// Mixes unwalkable and several walkable areas, so the area merge of addSpan is exercised.
+void assignAreas(Geometry& geom)
+{
+	Random rand(7);
+	geom.areas.resize(geom.tris.size()/3);
+	for (size_t i = 0; i < geom.areas.size(); ++i)
+		geom.areas[i] = (rand.next() % 3 == 0) ? RC_NULL_AREA : (unsigned char)(RC_WALKABLE_AREA - rand.next() % 3);
+}
+
+rcHeightfield* createHeightfield(const float ox, const float oz)
+{
+	rcHeightfield* hf = rcAllocHeightfield();
+	const float bmin[3] = { ox, -3.0f, oz };
+	const float bmax[3] = { ox + 40*0.3f, 8.0f, oz + 40*0.3f };
+	if (!hf || !rcCreateHeightfield(0, *hf, 40, 40, bmin, bmax, 0.3f, 0.2f))
+	{
+		rcFreeHeightField(hf);
+		return 0;
+	}
+	return hf;
+}
+
+// Compares two heightfields span by span and counts the spans compared.
+bool compareSpans(const rcHeightfield& a, const rcHeightfield& b, long& spanCount)
+{
+	for (int i = 0; i < a.width*a.height; ++i)
+	{
+		const rcSpan* sa = a.spans[i];
+		const rcSpan* sb = b.spans[i];
+		for (; sa && sb; sa = sa->next, sb = sb->next, ++spanCount)
+		{
+			if (sa->smin != sb->smin || sa->smax != sb->smax || sa->area != sb->area)
+				return false;
+		}
+		if (sa || sb)
+			return false;
+	}
+	return true;
+}
+
+double elapsedMilliseconds(const std::chrono::steady_clock::time_point& start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Rasterizes the geometry into 12 tiles with both paths, through the indexed and the unindexed
+// entry points, and reports the best of 7 runs over all tiles.
+bool checkGeometry(rcContext* ctx, const Geometry& geom, const int flagMergeThr)
+{
+	const int nverts = (int)geom.verts.size()/3;
+	const int ntris = (int)geom.tris.size()/3;
+
+	// The soups do not share vertices, so their vertex array is also the unindexed triangle list.
+	const bool unindexed = nverts == ntris*3;
+
+	long spanCount = 0;
+	bool same = true;
+	double scalarTime = 1e30;
+	double simdTime = 1e30;
+	for (int rep = 0; rep < 7; ++rep)
+	{
+		double scalarSum = 0;
+		double simdSum = 0;
+		for (float ox = -2.0f; ox < 10.0f; ox += 4.1f)
+		{
+			for (float oz = -2.0f; oz < 10.0f; oz += 3.7f)
+			{
+				rcHeightfield* a = createHeightfield(ox, oz);
+				rcHeightfield* b = createHeightfield(ox, oz);
+
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				scalar::rcRasterizeTriangles(ctx, &geom.verts[0], nverts, &geom.tris[0], &geom.areas[0], ntris, *a, flagMergeThr);
+				scalarSum += elapsedMilliseconds(start);
+
+				start = std::chrono::steady_clock::now();
+				simd::rcRasterizeTriangles(ctx, &geom.verts[0], nverts, &geom.tris[0], &geom.areas[0], ntris, *b, flagMergeThr);
+				simdSum += elapsedMilliseconds(start);
+
+				if (rep == 0)
+				{
+					same &= compareSpans(*a, *b, spanCount);
+
+					if (unindexed)
+					{
+						rcHeightfield* c = createHeightfield(ox, oz);
+						simd::rcRasterizeTriangles(ctx, &geom.verts[0], &geom.areas[0], ntris, *c, flagMergeThr);
+						long unindexedCount = 0;
+						same &= compareSpans(*a, *c, unindexedCount);
+						rcFreeHeightField(c);
+					}
+				}
+
+				rcFreeHeightField(a);
+				rcFreeHeightField(b);
+			}
+		}
+		scalarTime = rcMin(scalarTime, scalarSum);
+		simdTime = rcMin(simdTime, simdSum);
+	}
+
+	printf("%-12s merge %d  tris %6d  spans %8ld  scalar %7.1f ms  simd %7.1f ms  %s\n",
+		   geom.name, flagMergeThr, ntris, spanCount, scalarTime, simdTime, same ? "identical" : "MISMATCH");
+	return same;
+}
+
+}
+
+int main()
+{
+	rcContext ctx(false);
+
+#ifndef RC_RASTER_SSE
+	printf("SSE is not available, both paths are scalar.\n");
+#endif
+
+	std::vector<Geometry> geoms;
+	geoms.push_back(makeTerrain("terrain 0.1", 0.1f, 14.0f));
+	geoms.push_back(makeTerrain("terrain 0.7", 0.7f, 14.0f));
+	geoms.push_back(makeSoup("small soup", 40000, 0.15f, 1, true));
+	geoms.push_back(makeSoup("medium soup", 20000, 1.5f, 2, true));
+	geoms.push_back(makeSoup("large soup", 5000, 6.0f, 3, false));
+
+	bool same = true;
+	for (size_t i = 0; i < geoms.size(); ++i)
+	{
+		assignAreas(geoms[i]);
+		same &= checkGeometry(&ctx, geoms[i], 1);
+		same &= checkGeometry(&ctx, geoms[i], 3);
+	}
+
+	return same ? 0 : 1;
+}
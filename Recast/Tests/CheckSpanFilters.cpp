@@ -0,0 +1,304 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+// Checks that rcFilterSpans marks exactly the spans the three separate filters
+// rcFilterLowHangingWalkableObstacles, rcFilterLedgeSpans and rcFilterWalkableLowHeightSpans
+// mark, and times both. Returns non-zero if any span differs.
+//
+// Build and run from the repository root:
+//   c++ -O2 -IRecast/Include Recast/Tests/CheckSpanFilters.cpp Recast/Source/*.cpp -o checkspanfilters
+//   ./checkspanfilters
+
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include <chrono>
+#include "Recast.h"
+
+namespace
+{
+
+struct Geometry
+{
+	const char* name;
+	std::vector<float> verts;
+	std::vector<int> tris;
+	std::vector<unsigned char> areas;
+};
+
+// Small deterministic generator, so every run checks the same data.
+struct Random
+{
+	unsigned int state;
+	explicit Random(unsigned int seed) : state(seed) {}
+	unsigned int next() { state = state*1664525u + 1013904223u; return state >> 8; }
+	float range(float lo, float hi) { return lo + (hi - lo)*(next() & 0xffff)/65535.0f; }
+};
+
+float terrainHeight(float x, float z)
+{
+	return 2.0f*sinf(x*0.37f)*cosf(z*0.23f) + 0.5f*sinf(x*2.1f + z*1.3f);
+}
+
+Geometry makeTerrain(const char* name, const float step, const float size)
+{
+	Geometry geom;
+	geom.name = name;
+	const int n = (int)(size/step) + 1;
+	for (int j = 0; j < n; ++j)
+	{
+		for (int i = 0; i < n; ++i)
+		{
+			const float x = i*step - 1.5f;
+			const float z = j*step - 1.5f;
+			geom.verts.push_back(x);
+			geom.verts.push_back(terrainHeight(x, z));
+			geom.verts.push_back(z);
+		}
+	}
+	for (int j = 0; j < n-1; ++j)
+	{
+		for (int i = 0; i < n-1; ++i)
+		{
+			const int a = j*n + i;
+			const int t[6] = { a, a+n, a+1, a+1, a+n, a+n+1 };
+			geom.tris.insert(geom.tris.end(), t, t+6);
+		}
+	}
+	return geom;
+}
+
+// Randomly placed triangles, which give many overlapping spans per column.
+Geometry makeSoup(const char* name, const int count, const float maxSize, const unsigned int seed)
+{
+	Geometry geom;
+	geom.name = name;
+	Random rand(seed);
+	for (int i = 0; i < count; ++i)
+	{
+		const float cx = rand.range(-2, 30);
+		const float cy = rand.range(-2, 30)*0.3f;
+		const float cz = rand.range(-2, 30);
+		for (int k = 0; k < 3; ++k)
+		{
+			geom.verts.push_back(cx + rand.range(-maxSize, maxSize));
+			geom.verts.push_back(cy + rand.range(-maxSize, maxSize)*0.5f);
+			geom.verts.push_back(cz + rand.range(-maxSize, maxSize));
+			geom.tris.push_back(i*3 + k);
+		}
+	}
+	return geom;
+}
+
+rcHeightfield* createHeightfield(const int size, const float ox, const float oz)
+{
+	rcHeightfield* hf = rcAllocHeightfield();
+	const float bmin[3] = { ox, -8.0f, oz };
+	const float bmax[3] = { ox + size*0.3f, 12.0f, oz + size*0.3f };
+	if (!hf || !rcCreateHeightfield(0, *hf, size, size, bmin, bmax, 0.3f, 0.2f))
+	{
+		rcFreeHeightField(hf);
+		return 0;
+	}
+	return hf;
+}
+
+// Fills the columns with random spans, gaps and areas, including unwalkable ones.
+void fillRandom(rcContext* ctx, rcHeightfield& hf, const unsigned int seed)
+{
+	Random rand(seed);
+	for (int y = 0; y < hf.height; ++y)
+	{
+		for (int x = 0; x < hf.width; ++x)
+		{
+			const int n = rand.next() % 6;
+			int top = rand.next() % 20;
+			for (int k = 0; k < n; ++k)
+			{
+				const int smin = top + rand.next() % 3;
+				const int smax = smin + 1 + rand.next() % 8;
+				top = smax + rand.next() % 14;
+				const unsigned char area = (rand.next() % 3 == 0) ? RC_NULL_AREA
+										 : (rand.next() % 4 == 0) ? 7 : RC_WALKABLE_AREA;
+				rcAddSpan(ctx, hf, x, y, (unsigned short)smin, (unsigned short)smax, area, 1);
+			}
+		}
+	}
+}
+
+void filterSeparately(rcContext* ctx, const int walkableHeight, const int walkableClimb, rcHeightfield& hf)
+{
+	rcFilterLowHangingWalkableObstacles(ctx, walkableClimb, hf);
+	rcFilterLedgeSpans(ctx, walkableHeight, walkableClimb, hf);
+	rcFilterWalkableLowHeightSpans(ctx, walkableHeight, hf);
+}
+
+// Compares two heightfields span by span and counts the spans compared.
+bool compareSpans(const rcHeightfield& a, const rcHeightfield& b, long& spanCount)
+{
+	for (int i = 0; i < a.width*a.height; ++i)
+	{
+		const rcSpan* sa = a.spans[i];
+		const rcSpan* sb = b.spans[i];
+		for (; sa && sb; sa = sa->next, sb = sb->next, ++spanCount)
+		{
+			if (sa->smin != sb->smin || sa->smax != sb->smax || sa->area != sb->area)
+				return false;
+		}
+		if (sa || sb)
+			return false;
+	}
+	return true;
+}
+
+const int filterParams[][2] =
+{
+	// walkableHeight, walkableClimb
+	{ 10, 4 },
+	{ 3, 0 },
+	{ 6, 2 },
+	{ 20, 9 },
+};
+const int filterParamCount = sizeof(filterParams)/sizeof(filterParams[0]);
+
+bool checkGeometry(rcContext* ctx, Geometry& geom)
+{
+	geom.areas.assign(geom.tris.size()/3, 0);
+	const int nverts = (int)geom.verts.size()/3;
+	const int ntris = (int)geom.tris.size()/3;
+	rcMarkWalkableTriangles(ctx, 45.0f, &geom.verts[0], nverts, &geom.tris[0], ntris, &geom.areas[0]);
+
+	long spanCount = 0;
+	bool same = true;
+	for (int p = 0; p < filterParamCount; ++p)
+	{
+		const int walkableHeight = filterParams[p][0];
+		const int walkableClimb = filterParams[p][1];
+		for (float ox = -2.0f; ox < 25.0f; ox += 9.1f)
+		{
+			for (float oz = -2.0f; oz < 25.0f; oz += 9.3f)
+			{
+				rcHeightfield* a = createHeightfield(56, ox, oz);
+				rcHeightfield* b = createHeightfield(56, ox, oz);
+				rcRasterizeTriangles(ctx, &geom.verts[0], nverts, &geom.tris[0], &geom.areas[0], ntris, *a, walkableClimb);
+				rcRasterizeTriangles(ctx, &geom.verts[0], nverts, &geom.tris[0], &geom.areas[0], ntris, *b, walkableClimb);
+				filterSeparately(ctx, walkableHeight, walkableClimb, *a);
+				rcFilterSpans(ctx, walkableHeight, walkableClimb, *b);
+				same &= compareSpans(*a, *b, spanCount);
+				rcFreeHeightField(a);
+				rcFreeHeightField(b);
+			}
+		}
+	}
+
+	printf("%-14s %9ld spans  %s\n", geom.name, spanCount, same ? "identical" : "MISMATCH");
+	return same;
+}
+
+bool checkRandom(rcContext* ctx)
+{
+	long spanCount = 0;
+	bool same = true;
+	for (unsigned int seed = 1; seed <= 200; ++seed)
+	{
+		for (int p = 0; p < filterParamCount; ++p)
+		{
+			rcHeightfield* a = createHeightfield(24, 0, 0);
+			rcHeightfield* b = createHeightfield(24, 0, 0);
+			fillRandom(ctx, *a, seed);
+			fillRandom(ctx, *b, seed);
+			filterSeparately(ctx, filterParams[p][0], filterParams[p][1], *a);
+			rcFilterSpans(ctx, filterParams[p][0], filterParams[p][1], *b);
+			same &= compareSpans(*a, *b, spanCount);
+			rcFreeHeightField(a);
+			rcFreeHeightField(b);
+		}
+	}
+
+	printf("%-14s %9ld spans  %s\n", "random spans", spanCount, same ? "identical" : "MISMATCH");
+	return same;
+}
+
+double elapsedMicroseconds(const std::chrono::steady_clock::time_point& start)
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Times the filters alone on one heightfield, restoring the unfiltered areas before each run.
+void timeGeometry(rcContext* ctx, const Geometry& geom)
+{
+	const int nverts = (int)geom.verts.size()/3;
+	const int ntris = (int)geom.tris.size()/3;
+	rcHeightfield* hf = createHeightfield(100, -1, -1);
+	rcRasterizeTriangles(ctx, &geom.verts[0], nverts, &geom.tris[0], &geom.areas[0], ntris, *hf, 4);
+
+	std::vector<rcSpan*> spans;
+	std::vector<unsigned char> areas;
+	for (int i = 0; i < hf->width*hf->height; ++i)
+	{
+		for (rcSpan* s = hf->spans[i]; s; s = s->next)
+		{
+			spans.push_back(s);
+			areas.push_back((unsigned char)s->area);
+		}
+	}
+
+	double separate = 1e30;
+	double single = 1e30;
+	for (int rep = 0; rep < 30; ++rep)
+	{
+		for (size_t i = 0; i < spans.size(); ++i)
+			spans[i]->area = areas[i];
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		filterSeparately(ctx, 10, 4, *hf);
+		separate = rcMin(separate, elapsedMicroseconds(start));
+
+		for (size_t i = 0; i < spans.size(); ++i)
+			spans[i]->area = areas[i];
+		start = std::chrono::steady_clock::now();
+		rcFilterSpans(ctx, 10, 4, *hf);
+		single = rcMin(single, elapsedMicroseconds(start));
+	}
+
+	printf("%-14s %9d spans  three filters %8.0f us  rcFilterSpans %8.0f us\n",
+		   geom.name, (int)spans.size(), separate, single);
+	rcFreeHeightField(hf);
+}
+
+}
+
+int main()
+{
+	rcContext ctx(false);
+
+	std::vector<Geometry> geoms;
+	geoms.push_back(makeTerrain("terrain 0.3", 0.3f, 32.0f));
+	geoms.push_back(makeTerrain("terrain 1.0", 1.0f, 32.0f));
+	geoms.push_back(makeSoup("small soup", 30000, 0.4f, 1));
+	geoms.push_back(makeSoup("large soup", 8000, 3.0f, 2));
+
+	bool same = true;
+	for (size_t i = 0; i < geoms.size(); ++i)
+		same &= checkGeometry(&ctx, geoms[i]);
+	same &= checkRandom(&ctx);
+
+	for (size_t i = 0; i < geoms.size(); ++i)
+		timeGeometry(&ctx, geoms[i]);
+
+	return same ? 0 : 1;
+}
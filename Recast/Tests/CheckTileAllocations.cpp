@@ -0,0 +1,427 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+// Checks that rebuilding the tiles of a tile cache allocates nothing once the build context has
+// grown to the largest tile, apart from the compressed layers the tile cache takes ownership of.
+// Returns non-zero if a rebuild allocates anything else.
+//
+// The tiles are built the way OgreDetourTileCache::TileCacheBuild builds them, which needs Ogre:
+// one context with a heightfield, a compact heightfield, a layer set and an rcTempAllocator is
+// reused for every tile, and the layers of every tile are built for two agent radii. The Recast
+// and Detour allocations are counted with rcAllocSetCustom and dtAllocSetCustom, and those of
+// the standard library with a replaced operator new.
+//
+// Build and run from the repository root:
+//   c++ -O2 -pthread -IRecast/Include -IDetour/Include -IDetourTileCache/Include -IRecastContrib/fastlz -Iinclude Recast/Tests/CheckTileAllocations.cpp Recast/Source/*.cpp Detour/Source/*.cpp DetourTileCache/Source/*.cpp source/ChunkyTriMesh.cpp source/WorkerPool.cpp -x c RecastContrib/fastlz/fastlz.c -o checktileallocations
+//   ./checktileallocations
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <vector>
+#include "Recast.h"
+#include "RecastAlloc.h"
+#include "DetourAlloc.h"
+#include "DetourCommon.h"
+#include "DetourTileCache.h"
+#include "DetourTileCacheBuilder.h"
+#include "ChunkyTriMesh.h"
+#include "fastlz.h"
+
+namespace
+{
+
+int g_rcAllocs = 0;
+int g_dtPermAllocs = 0;
+int g_dtTempAllocs = 0;
+int g_newAllocs = 0;
+
+void* countingRcAlloc(size_t size, rcAllocHint /*hint*/)
+{
+	g_rcAllocs++;
+	return malloc(size);
+}
+
+void* countingDtAlloc(size_t size, dtAllocHint hint)
+{
+	if (hint == DT_ALLOC_PERM)
+		g_dtPermAllocs++;
+	else
+		g_dtTempAllocs++;
+	return malloc(size);
+}
+
+void resetCounts()
+{
+	g_rcAllocs = 0;
+	g_dtPermAllocs = 0;
+	g_dtTempAllocs = 0;
+	g_newAllocs = 0;
+}
+
+}
+
+void* operator new(size_t size)
+{
+	g_newAllocs++;
+	if (void* ptr = malloc(size ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+namespace
+{
+
+const float WORLD_SIZE = 96.0f;
+const int BOX_COUNT = 120;
+const int TILE_SIZE = 48;
+const float CELL_SIZE = 0.3f;
+const float CELL_HEIGHT = 0.2f;
+const int WALKABLE_HEIGHT = 10;
+const int WALKABLE_CLIMB = 4;
+const int AGENT_RADII[] = { 2, 4 };
+const int AGENT_COUNT = sizeof(AGENT_RADII)/sizeof(AGENT_RADII[0]);
+const int BORDER_SIZE = 4 + 3;
+const int MAX_LAYERS = 8;
+
+struct FastLZCompressor : public dtTileCacheCompressor
+{
+	virtual int maxCompressedSize(const int bufferSize)
+	{
+		return (int)(bufferSize*1.05f);
+	}
+
+	virtual dtStatus compress(const unsigned char* buffer, const int bufferSize,
+							  unsigned char* compressed, const int /*maxCompressedSize*/, int* compressedSize)
+	{
+		*compressedSize = fastlz_compress((const void*)buffer, bufferSize, compressed);
+		return DT_SUCCESS;
+	}
+
+	virtual dtStatus decompress(const unsigned char* compressed, const int compressedSize,
+								unsigned char* buffer, const int maxBufferSize, int* bufferSize)
+	{
+		*bufferSize = fastlz_decompress(compressed, compressedSize, buffer, maxBufferSize);
+		return *bufferSize < 0 ? DT_FAILURE : DT_SUCCESS;
+	}
+};
+
+// As RecastTempAlloc in OgreDetourTileCache.h.
+struct RecastTempAlloc : public dtTileCacheAlloc
+{
+	virtual void* alloc(const size_t size)
+	{
+		return rcAlloc(size, RC_ALLOC_TEMP);
+	}
+
+	virtual void free(void* ptr)
+	{
+		rcFree(ptr);
+	}
+};
+
+// As RasterizationContext in OgreDetourTileCache.h.
+struct TileContext
+{
+	TileContext() : solid(0), chf(0), lset(0) {}
+	~TileContext()
+	{
+		rcFreeHeightField(solid);
+		rcFreeCompactHeightfield(chf);
+		rcFreeHeightfieldLayerSet(lset);
+	}
+
+	rcHeightfield* solid;
+	rcCompactHeightfield* chf;
+	rcHeightfieldLayerSet* lset;
+	std::vector<unsigned char> triareas;
+	std::vector<unsigned char> walkableAreas;
+	rcTempAllocator tempAlloc;
+};
+
+struct Scene
+{
+	std::vector<float> verts;
+	std::vector<int> tris;
+	rcChunkyTriMesh chunkyMesh;
+	float bmin[3];
+	float bmax[3];
+};
+
+unsigned int g_seed = 1;
+
+float frand()
+{
+	g_seed = g_seed*1103515245u + 12345u;
+	return ((g_seed >> 8) & 0xffff) / 65535.0f;
+}
+
+void addQuad(Scene& scene, const float* a, const float* b, const float* c, const float* d)
+{
+	const int base = (int)scene.verts.size()/3;
+	scene.verts.insert(scene.verts.end(), a, a+3);
+	scene.verts.insert(scene.verts.end(), b, b+3);
+	scene.verts.insert(scene.verts.end(), c, c+3);
+	scene.verts.insert(scene.verts.end(), d, d+3);
+	const int quad[6] = { base, base+1, base+2, base, base+2, base+3 };
+	scene.tris.insert(scene.tris.end(), quad, quad+6);
+}
+
+// A sloped ground of one unit quads with boxes of different heights standing on it.
+void buildScene(Scene& scene)
+{
+	const int n = (int)WORLD_SIZE;
+	for (int z = 0; z < n; ++z)
+	{
+		for (int x = 0; x < n; ++x)
+		{
+			const float h0 = x*0.05f, h1 = (x+1)*0.05f;
+			const float a[3] = { (float)x, h0, (float)z }, b[3] = { (float)x, h0, (float)(z+1) };
+			const float c[3] = { (float)(x+1), h1, (float)(z+1) }, d[3] = { (float)(x+1), h1, (float)z };
+			addQuad(scene, a, b, c, d);
+		}
+	}
+
+	for (int i = 0; i < BOX_COUNT; ++i)
+	{
+		const float x0 = frand()*(WORLD_SIZE-6), z0 = frand()*(WORLD_SIZE-6);
+		const float x1 = x0 + 1 + frand()*5, z1 = z0 + 1 + frand()*5;
+		const float y0 = x0*0.05f - 1, y1 = x1*0.05f + 0.5f + frand()*3;
+		const float p[8][3] = {
+			{ x0, y0, z0 }, { x0, y0, z1 }, { x1, y0, z1 }, { x1, y0, z0 },
+			{ x0, y1, z0 }, { x0, y1, z1 }, { x1, y1, z1 }, { x1, y1, z0 },
+		};
+		addQuad(scene, p[4], p[5], p[6], p[7]);
+		addQuad(scene, p[0], p[4], p[7], p[3]);
+		addQuad(scene, p[3], p[7], p[6], p[2]);
+		addQuad(scene, p[2], p[6], p[5], p[1]);
+		addQuad(scene, p[1], p[5], p[4], p[0]);
+	}
+
+	rcCalcBounds(&scene.verts[0], (int)scene.verts.size()/3, scene.bmin, scene.bmax);
+	rcCreateChunkyTriMesh(&scene.verts[0], &scene.tris[0], (int)scene.tris.size()/3, 256, &scene.chunkyMesh);
+}
+
+// Rasterizes the tile into the compact heightfield of the context, as RasterizeTile does.
+bool rasterizeTile(rcContext* ctx, const Scene& scene, const int tx, const int ty, TileContext& tc)
+{
+	const float tcs = TILE_SIZE*CELL_SIZE;
+	const int size = TILE_SIZE + BORDER_SIZE*2;
+	const float bmin[3] = { scene.bmin[0] + tx*tcs - BORDER_SIZE*CELL_SIZE, scene.bmin[1],
+							scene.bmin[2] + ty*tcs - BORDER_SIZE*CELL_SIZE };
+	const float bmax[3] = { scene.bmin[0] + (tx+1)*tcs + BORDER_SIZE*CELL_SIZE, scene.bmax[1],
+							scene.bmin[2] + (ty+1)*tcs + BORDER_SIZE*CELL_SIZE };
+
+	if (!tc.solid)
+		tc.solid = rcAllocHeightfield();
+	if (!tc.solid || !rcCreateHeightfield(ctx, *tc.solid, size, size, bmin, bmax, CELL_SIZE, CELL_HEIGHT))
+		return false;
+
+	tc.triareas.resize(scene.chunkyMesh.maxTrisPerChunk);
+	const float tbmin[2] = { bmin[0], bmin[2] };
+	const float tbmax[2] = { bmax[0], bmax[2] };
+	const float* verts = &scene.verts[0];
+	const int nverts = (int)scene.verts.size()/3;
+	bool empty = true;
+	rcForEachChunkOverlappingRect(&scene.chunkyMesh, tbmin, tbmax, [&] (const int* tris, const int ntris)
+	{
+		empty = false;
+		memset(&tc.triareas[0], 0, ntris);
+		rcMarkWalkableTriangles(ctx, 45.0f, verts, nverts, tris, ntris, &tc.triareas[0]);
+		rcRasterizeTriangles(ctx, verts, nverts, tris, &tc.triareas[0], ntris, *tc.solid, WALKABLE_CLIMB);
+	});
+	if (empty)
+		return false;
+
+	rcFilterSpans(ctx, WALKABLE_HEIGHT, WALKABLE_CLIMB, *tc.solid);
+
+	if (!tc.chf)
+		tc.chf = rcAllocCompactHeightfield();
+	return tc.chf && rcBuildCompactHeightfield(ctx, WALKABLE_HEIGHT, WALKABLE_CLIMB, *tc.solid, *tc.chf);
+}
+
+// Builds the layers of the rasterized tile for one agent radius and hands them to the tile cache,
+// as AddTileLayers does. Returns the number of layers added, or -1 on failure.
+int addTileLayers(rcContext* ctx, const int tx, const int ty, const int radius, TileContext& tc, dtTileCache* cache)
+{
+	FastLZCompressor comp;
+	RecastTempAlloc tempAlloc;
+
+	if (!rcErodeWalkableArea(ctx, radius, *tc.chf))
+		return -1;
+
+	if (!tc.lset)
+		tc.lset = rcAllocHeightfieldLayerSet();
+	if (!tc.lset || !rcBuildHeightfieldLayers(ctx, *tc.chf, BORDER_SIZE, WALKABLE_HEIGHT, *tc.lset))
+		return -1;
+
+	int n = 0;
+	for (int i = 0; i < rcMin(tc.lset->nlayers, MAX_LAYERS); ++i)
+	{
+		const rcHeightfieldLayer* layer = &tc.lset->layers[i];
+
+		dtTileCacheLayerHeader header;
+		header.magic = DT_TILECACHE_MAGIC;
+		header.version = DT_TILECACHE_VERSION;
+		header.tx = tx;
+		header.ty = ty;
+		header.tlayer = i;
+		dtVcopy(header.bmin, layer->bmin);
+		dtVcopy(header.bmax, layer->bmax);
+		header.width = (unsigned char)layer->width;
+		header.height = (unsigned char)layer->height;
+		header.minx = (unsigned char)layer->minx;
+		header.maxx = (unsigned char)layer->maxx;
+		header.miny = (unsigned char)layer->miny;
+		header.maxy = (unsigned char)layer->maxy;
+		header.hmin = (unsigned short)layer->hmin;
+		header.hmax = (unsigned short)layer->hmax;
+
+		unsigned char* data = 0;
+		int dataSize = 0;
+		if (dtStatusFailed(dtBuildTileCacheLayer(&comp, &header, layer->heights, layer->areas, layer->cons,
+												 &data, &dataSize, &tempAlloc)))
+			return -1;
+		if (dtStatusFailed(cache->addTile(data, dataSize, DT_COMPRESSEDTILE_FREE_DATA, 0)))
+		{
+			dtFree(data);
+			return -1;
+		}
+		n++;
+	}
+	return n;
+}
+
+void removeTileLayers(const int tx, const int ty, dtTileCache* cache)
+{
+	dtCompressedTileRef tiles[MAX_LAYERS];
+	const int n = cache->getTilesAt(tx, ty, tiles, MAX_LAYERS);
+	for (int i = 0; i < n; ++i)
+		cache->removeTile(tiles[i], 0, 0);
+}
+
+// Builds every tile for every agent radius, replacing the layers already in the caches. Returns the
+// number of layers added, or -1 on failure.
+int buildAllTiles(rcContext* ctx, const Scene& scene, const int tw, const int th, TileContext& tc,
+				  dtTileCache** caches)
+{
+	rcTempAllocScope tempAllocScope(tc.tempAlloc);
+
+	int layers = 0;
+	for (int ty = 0; ty < th; ++ty)
+	{
+		for (int tx = 0; tx < tw; ++tx)
+		{
+			for (int a = 0; a < AGENT_COUNT; ++a)
+				removeTileLayers(tx, ty, caches[a]);
+
+			if (!rasterizeTile(ctx, scene, tx, ty, tc))
+				continue;
+
+			tc.walkableAreas.assign(tc.chf->areas, tc.chf->areas + tc.chf->spanCount);
+			for (int a = 0; a < AGENT_COUNT; ++a)
+			{
+				memcpy(tc.chf->areas, &tc.walkableAreas[0], tc.walkableAreas.size());
+				const int n = addTileLayers(ctx, tx, ty, AGENT_RADII[a], tc, caches[a]);
+				if (n < 0)
+					return -1;
+				layers += n;
+			}
+		}
+	}
+	return layers;
+}
+
+}
+
+int main()
+{
+	Scene scene;
+	buildScene(scene);
+
+	const float tcs = TILE_SIZE*CELL_SIZE;
+	const int tw = (int)ceilf((scene.bmax[0] - scene.bmin[0]) / tcs);
+	const int th = (int)ceilf((scene.bmax[2] - scene.bmin[2]) / tcs);
+
+	rcAllocSetCustom(countingRcAlloc, free);
+	dtAllocSetCustom(countingDtAlloc, free);
+
+	rcContext ctx(false);
+	FastLZCompressor comp;
+	dtTileCacheAlloc talloc;
+	dtTileCache* caches[AGENT_COUNT];
+	for (int a = 0; a < AGENT_COUNT; ++a)
+	{
+		dtTileCacheParams params;
+		memset(&params, 0, sizeof(params));
+		rcVcopy(params.orig, scene.bmin);
+		params.cs = CELL_SIZE;
+		params.ch = CELL_HEIGHT;
+		params.width = TILE_SIZE;
+		params.height = TILE_SIZE;
+		params.walkableHeight = WALKABLE_HEIGHT*CELL_HEIGHT;
+		params.walkableRadius = AGENT_RADII[a]*CELL_SIZE;
+		params.walkableClimb = WALKABLE_CLIMB*CELL_HEIGHT;
+		params.maxSimplificationError = 1.3f;
+		params.maxTiles = tw*th*MAX_LAYERS;
+		params.maxObstacles = 16;
+		caches[a] = dtAllocTileCache();
+		if (!caches[a] || dtStatusFailed(caches[a]->init(&params, &talloc, &comp, 0)))
+		{
+			printf("Could not init the tile cache.\n");
+			return 1;
+		}
+	}
+
+	printf("%d triangles, %dx%d tiles, %d agent radii\n\n", (int)scene.tris.size()/3, tw, th, AGENT_COUNT);
+	printf("pass        layers  recast  detour temp  detour perm  operator new\n");
+
+	TileContext tc;
+	bool ok = true;
+	static const char* names[] = { "build", "rebuild 1", "rebuild 2" };
+	for (int pass = 0; pass < 3; ++pass)
+	{
+		resetCounts();
+		const int layers = buildAllTiles(&ctx, scene, tw, th, tc, caches);
+		printf("%-10s  %6d  %6d  %11d  %11d  %12d\n", names[pass], layers,
+			   g_rcAllocs, g_dtTempAllocs, g_dtPermAllocs, g_newAllocs);
+
+		// Once every tile has been built, only the layers handed to the tile caches are allocated.
+		if (layers < 0)
+			ok = false;
+		else if (pass > 0)
+			ok &= g_rcAllocs == 0 && g_dtTempAllocs == 0 && g_newAllocs == 0 && g_dtPermAllocs == layers;
+	}
+
+	for (int a = 0; a < AGENT_COUNT; ++a)
+		dtFreeTileCache(caches[a]);
+
+	return ok ? 0 : 1;
+}
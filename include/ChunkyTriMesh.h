@@ -0,0 +1,99 @@
+/*
+    OgreCrowd
+    ---------
+
+    Copyright (c) 2012 Jonas Hauquier
+
+    Additional contributions by:
+
+    - mkultra333
+    - Paul Wilson
+
+    Sincere thanks and to:
+
+    - Mikko Mononen (developer of Recast navigation libraries)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+
+*/
+
+#ifndef CHUNKYTRIMESH_H
+#define CHUNKYTRIMESH_H
+
+/**
+  * Bounding volume hierarchy over the triangles of an inputGeom, on the 2D xz plane.
+  * This allows to quickly retrieve the triangles in a specific box,
+  * at the cost of a small pre-process step and extra memory usage.
+  * The nodes are stored depth first as a structure of arrays, so that a query only
+  * reads the bounds of the nodes it visits. A node with first >= 0 is a leaf whose
+  * count tris start at tris[first*3], in the order of the leaves. Any other node is
+  * followed by its children, and -first is the number of nodes to skip past them.
+  * The four bounds arrays share one allocation starting at minX, and first and count
+  * share one starting at first.
+  **/
+struct rcChunkyTriMesh
+{
+        inline rcChunkyTriMesh() : minX(0), minZ(0), maxX(0), maxZ(0), first(0), count(0), nnodes(0), tris(0), ntris(0), maxTrisPerChunk(0) {};
+        inline ~rcChunkyTriMesh() { delete [] minX; delete [] first; delete [] tris; }
+
+        float* minX;
+        float* minZ;
+        float* maxX;
+        float* maxZ;
+        int* first;
+        int* count;
+        int nnodes;
+        int* tris;
+        int ntris;
+        int maxTrisPerChunk;
+};
+
+/// Allocates the node arrays of cm for nnodes nodes, for a hierarchy that is read back
+/// rather than built.
+void rcAllocChunkyTriMeshNodes(rcChunkyTriMesh* cm, int nnodes);
+
+/// Creates the hierarchy, where each leaf contains at max trisPerChunk triangles.
+/// Nodes are split where the binned surface area heuristic is lowest, and the subtrees
+/// below the top of the tree are built in parallel.
+bool rcCreateChunkyTriMesh(const float* verts, const int* tris, int ntris,
+                                                   int trisPerChunk, rcChunkyTriMesh* cm);
+
+/// Calls visit(const int* tris, int ntris) for every leaf that overlaps the rectangle.
+template <typename Visitor>
+inline void rcForEachChunkOverlappingRect(const rcChunkyTriMesh* cm, const float bmin[2], const float bmax[2], Visitor visit)
+{
+        int i = 0;
+        while (i < cm->nnodes)
+        {
+                const bool overlap = cm->minX[i] <= bmax[0] && cm->maxX[i] >= bmin[0] &&
+                                     cm->minZ[i] <= bmax[1] && cm->maxZ[i] >= bmin[1];
+                const int first = cm->first[i];
+                const bool isLeafNode = first >= 0;
+
+                if (isLeafNode && overlap)
+                        visit(&cm->tris[first*3], cm->count[i]);
+
+                if (overlap || isLeafNode)
+                        i++;
+                else
+                        i += -first; // Escape
+        }
+}
+
+#endif // CHUNKYTRIMESH_H
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "PlayerFlagQueryFilter.h"
+#include "DetourFlowField.h"
+
+#include <Ogre.h>
+
+// Caller owned path costs and directions from every navmesh polygon to a single goal, built by
+// OgreRecast::BuildFlowField. Any number of units heading to the same goal can follow the field
+// with OgreRecast::FindPath, which only straightens the corridor the field already holds instead
+// of searching the navmesh again for every unit.
+// The field notices tiles rebuilt by the tile cache. Lookups into a rebuilt tile fail, and
+// FindPath builds the field again before using it.
+class FlowField
+{
+public:
+   FlowField () ;
+
+   const Ogre::Vector3 &
+   GetGoal () const ;
+
+   // True if the field has been built and no navmesh tile changed since.
+   bool
+   IsUpToDate () const ;
+
+   // The path cost from poly to the goal. Returns false if the goal cannot be reached from poly
+   // or the tile of poly changed since the field was built.
+   bool
+   GetCost ( const dtPolyRef poly,
+             float           &cost ) const ;
+
+   // The polygon to move into from poly to get closer to the goal, 0 if poly is the goal polygon.
+   // Returns false if the goal cannot be reached from poly or the tile of poly changed.
+   bool
+   GetNext ( const dtPolyRef poly,
+             dtPolyRef       &next ) const ;
+
+private:
+   friend class OgreRecast ;
+
+   dtFlowField           Field ;
+   PlayerFlagQueryFilter Filter ;
+   Ogre::Vector3         Goal ;
+   float                 MaxCost ;
+   bool                  HasGoal ;
+} ;
@@ -40,48 +40,12 @@
 #include <OgreTerrain.h>
 #include <OgreTerrainGroup.h>
 #include "ConvexVolume.h"
+#include "ChunkyTriMesh.h"
+#include <cstdint>
+#include <cfloat>
 
-
-/**
-  * One node or chunk of the chunky tri mesh.
-  * Contains a 2D xz plane bounding box.
-  * n is the number of tris contained in this chunk.
-  * i is the starting index of the tris contained in this chunk.
-  * The actual tris are in the chunkyMesh object itself, in linear
-  * order per node, so that each node only needs the begin position
-  * and tri count to reference its tris.
-  **/
-struct rcChunkyTriMeshNode
-{
-        float bmin[2], bmax[2];
-        int i, n;
-};
-
-/**
-  * Spatial subdivision structure that structures triangles
-  * in axis-aligned boxes of a fixed size.
-  * This allows to quickly retrieve the triangles in a specific box,
-  * at the cost of a small pre-process step and extra memory usage.
-  **/
-struct rcChunkyTriMesh
-{
-        inline rcChunkyTriMesh() : nodes(0), tris(0) {};
-        inline ~rcChunkyTriMesh() { if(nodes) delete [] nodes; if(tris) delete [] tris; }
-
-        rcChunkyTriMeshNode* nodes;
-        int nnodes;
-        int* tris;
-        int ntris;
-        int maxTrisPerChunk;
-};
-
-/// Creates partitioned triangle mesh (AABB tree),
-/// where each node contains at max trisPerChunk triangles.
-bool rcCreateChunkyTriMesh(const float* verts, const int* tris, int ntris,
-                                                   int trisPerChunk, rcChunkyTriMesh* cm);
-
-/// Returns the chunk indices which overlap the input rectable.
-int rcGetChunksOverlappingRect(const rcChunkyTriMesh* cm, float bmin[2], float bmax[2], int* ids, const int maxIds);
+class rcContext;
+struct rcHeightfield;
 
 /**
   * Helper class to manage input geometry used as input for recast
@@ -103,8 +67,10 @@ public:
       * scene before this call, as we need to calculate the world coordinates of the entity.
       * Vertices and faces of the specified source entities are stored in this inputGeom, individual entity
       * grouping and origin points are lost.
+      * The pages of terrainGroup are not converted to triangles, their heights are sampled straight
+      * into the heightfield of each tile by rasterizeTerrain(). Only pages that are loaded are used.
       **/
-    InputGeom(std::vector<Ogre::Entity*> srcMeshes);
+    InputGeom(std::vector<Ogre::Entity*> srcMeshes, Ogre::TerrainGroup* terrainGroup = 0);
     ~InputGeom();
 
     /**
@@ -148,6 +114,51 @@ public:
       **/
     const float* getMeshBoundsMax(void) const;
 
+    /**
+      * Optional clean up of the converted geometry before it is used for a build.
+      * Vertices within weldDistance of each other are merged into one, after which triangles are
+      * dropped if two of their corners were merged, if they are narrower than minTriangleWidth across
+      * their longest edge (zero area slivers always are), or if they lie fully below minY or above maxY.
+      * Vertices no triangle uses any more are removed, and normals and the chunky tri mesh are rebuilt.
+      * The vertex and triangle counts before and after are written to the log.
+      **/
+    void cleanGeometry(float weldDistance, float minTriangleWidth = 0, float minY = -FLT_MAX, float maxY = FLT_MAX);
+
+    /**
+      * Whether this inputGeom was created with terrain, which is not part of getVerts() and getTris().
+      **/
+    bool hasTerrain(void) const;
+
+    /**
+      * Rasterize the terrain into solid, in place of the triangles a terrain entity would have.
+      * The terrain height is sampled at the corners of the cells of solid, and each cell gets one
+      * span from its lowest to its highest corner, walkable if the slope across the cell is below
+      * walkableSlopeAngle (in degrees). Cells not fully on a loaded page get no span.
+      **/
+    void rasterizeTerrain(rcContext* ctx, rcHeightfield& solid, float walkableSlopeAngle, int flagMergeThr) const;
+
+    /**
+      * Hash of the vertex positions and indices of the meshes of the specified entities and of their
+      * world transforms, which identifies the geometry they convert to. Terrain is not included.
+      * Each distinct mesh is read from its buffers once.
+      **/
+    static uint64_t computeContentHash(const std::vector<Ogre::Entity*>& srcMeshes);
+
+    /**
+      * Save verts, tris, normals, bounds and the chunky tri mesh of this inputGeom to a binary file,
+      * so that later builds can load it with loadGeometry() without Ogre entities or a render system.
+      * The arrays are stored 16 byte aligned at offsets listed in the file header, so the file can
+      * also be used in place from a memory mapping.
+      **/
+    bool saveGeometry(const Ogre::String& filename, uint64_t contentHash) const;
+
+    /**
+      * Load an inputGeom saved with saveGeometry(). Returns 0 if the file could not be read or was
+      * saved with another content hash, the hash is not checked if contentHash is 0.
+      * Terrain is not saved, so pass the terrainGroup again if the geometry was created with one.
+      **/
+    static InputGeom* loadGeometry(const Ogre::String& filename, uint64_t contentHash, Ogre::TerrainGroup* terrainGroup = 0);
+
     /**
       * Retrieve vertex data from a mesh
       * From http://www.ogre3d.org/tikiwiki/RetrieveVertexData
@@ -186,11 +197,21 @@ public:
     inline const rcChunkyTriMesh* getChunkyMesh() const { return m_chunkyMesh.get(); }
 
 private:
+    /**
+      * Empty inputGeom, filled by loadGeometry().
+      **/
+    InputGeom();
+
     /**
       * Calculate max and min bounds of this geometry.
       **/
     void calculateExtents(void);
 
+    /**
+      * Calculate the normal of each tri.
+      **/
+    void calculateNormals(void);
+
     /**
       * Build chunky tri mesh.
       * Only needed for building tiled navmeshes.
@@ -200,6 +221,9 @@ private:
     /**
       * Convert triangles and verticies of ogre entities
       * to recast internal geometry format.
+      * Each distinct mesh is read from its buffers once, reading 16 and 32 bit
+      * indices, and every entity using it only adds a transformed copy into its
+      * own part of verts and tris. Both steps run on worker threads.
       **/
     void convertOgreEntities(void);
 
@@ -254,6 +278,11 @@ private:
       **/
     Ogre::SceneNode *mReferenceNode;
 
+    /**
+      * Terrain this inputGeom was constructed with, or 0.
+      **/
+    Ogre::TerrainGroup* mTerrainGroup;
+
     /**
       * Optimized structures that stores triangles in axis aligned boxes of uniform size
       * (tiles). Allows quick access to a part of the geometry, but requires more memory to store.
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "OgreRecastDefinitions.h" // For dtTileRef
+#include "DetourTileCache.h"
+
+#include <Ogre.h>
+
+// Std
+#include <vector>
+
+// A navmesh tile that was rebuilt. Polys of the tile have new references, so anything holding
+// poly or tile references inside it must look them up again.
+struct NavMeshTileChange
+{
+   int       TileX ;
+   int       TileY ;
+   int       Layer ;
+   dtTileRef TileRef ; // The reference of the rebuilt tile, or 0 if the tile is now empty
+} ;
+
+// An obstacle that was added to or removed from the navmesh. Gate obstacles only change the
+// flags of the polys within their bounds, so the tiles they touch are not always rebuilt.
+struct NavMeshObstacleChange
+{
+   dtObstacleRef Obstacle ; // No longer valid if the obstacle was removed
+   bool          Removed ;
+   Ogre::Vector3 BoundsMin ;
+   Ogre::Vector3 BoundsMax ;
+} ;
+
+// The changes made to the navmesh by one OgreRecast::Update. Each tile is listed once.
+struct NavMeshChanges
+{
+   std::vector <NavMeshTileChange>     Tiles ;
+   std::vector <NavMeshObstacleChange> Obstacles ;
+
+   bool
+   Empty () const
+   {
+      return Tiles.empty () && Obstacles.empty () ;
+   }
+
+   void
+   Clear ()
+   {
+      Tiles.clear () ;
+      Obstacles.clear () ;
+   }
+} ;
+
+// Receives the navmesh changes of OgreRecast::Update, see OgreRecast::AddNavMeshChangeListener.
+// Caches, debug views and units can invalidate exactly the tiles and obstacle areas that changed
+// instead of rebuilding everything on a timer.
+class NavMeshChangeListener
+{
+public:
+   virtual ~NavMeshChangeListener () {}
+
+   // Called at the end of every OgreRecast::Update that rebuilt tiles or finished obstacles.
+   // Listeners may query the navmesh, but must not add or remove listeners.
+   virtual void
+   NavMeshChanged ( const NavMeshChanges &changes ) = 0 ;
+} ;
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "OgreRecastDefinitions.h"
+#include "PlayerFlagQueryFilter.h"
+#include "DetourCrowd.h"
+#include "WorkerPool.h"
+
+#include <Ogre.h>
+
+// Std
+#include <array>
+
+// Moves many units over the navmesh at once, created by OgreRecast::CreateCrowd.
+// Every unit keeps a path corridor that follows it and its target, and steers along the corridor
+// while keeping apart from the units around it. Each step of Update is split over a pool of worker
+// threads, the calling thread included, which take the units in small chunks.
+// The crowd is tied to the navmesh it was created for, like the navmesh debugger. OgreRecast::Update
+// must not run at the same time as Update, changed tiles are picked up by the next Update.
+class OgreDetourCrowd
+{
+public:
+   OgreDetourCrowd ( dtNavMesh                   &nav_mesh,
+                     const PlayerFlagQueryFilter &base_filter,
+                     const float                 *poly_search_box,
+                     const int                   max_agents,
+                     const float                 max_agent_radius,
+                     const unsigned int          worker_count ) ;
+
+   // Adds a unit at the navmesh point nearest to position. The include and exclude flags select
+   // the polys the unit may walk on, at most DT_CROWD_MAX_QUERY_FILTER_TYPE different pairs can be
+   // used by one crowd. Units steer around each other and nearby walls. Returns the index of the
+   // unit, or -1 if it could not be added.
+   int
+   AddAgent ( const Ogre::Vector3 &position,
+              const float         radius,
+              const float         height,
+              const float         max_speed,
+              const float         max_acceleration,
+              const unsigned int  include_flags = POLYFLAGS_ALL,
+              const unsigned int  exclude_flags = 0 ) ;
+
+   void
+   RemoveAgent ( const int agent ) ;
+
+   // Sends the unit to target. The path is searched over the next updates, a few hundred polys per
+   // unit and update, while the unit already starts walking.
+   bool
+   SetMoveTarget ( const int           agent,
+                   const Ogre::Vector3 &target ) ;
+
+   // Moves the target of the unit without planning its path again, only the end of its corridor is
+   // changed. For targets that move a little every update, e.g. another unit being followed.
+   bool
+   AdjustMoveTarget ( const int           agent,
+                      const Ogre::Vector3 &target ) ;
+
+   // Stops the unit where it is.
+   bool
+   ResetMoveTarget ( const int agent ) ;
+
+   Ogre::Vector3
+   GetAgentPosition ( const int agent ) const ;
+
+   Ogre::Vector3
+   GetAgentVelocity ( const int agent ) const ;
+
+   // True if the corridor of the unit reaches its target, false while it is still searched or if
+   // the target can't be reached.
+   bool
+   HasPathToTarget ( const int agent ) const ;
+
+   void
+   Update ( const float delta_time ) ;
+
+private:
+   // Returns the crowd filter for the flags, adding it if needed. Returns -1 if all are in use.
+   int
+   GetFilterIndex ( const unsigned int include_flags,
+                    const unsigned int exclude_flags ) ;
+
+   // Finds the navmesh poly and point nearest to position with the filter of agent.
+   bool
+   FindNearestPoly ( const int           agent,
+                     const Ogre::Vector3 &position,
+                     dtPolyRef           &poly,
+                     float               *nearest_point ) const ;
+
+   dtCrowd Crowd ;
+
+   PlayerFlagQueryFilter                                              BaseFilter ;
+   std::array <PlayerFlagQueryFilter, DT_CROWD_MAX_QUERY_FILTER_TYPE> Filters ;
+   int                                                                FilterCount ;
+
+   // Worker 0 is the thread calling Update.
+   WorkerPool Workers ;
+} ;
@@ -38,9 +38,20 @@
 #include "DetourTileCacheBuilder.h"
 #include "DetourTileCache.h"
 #include "DetourCommon.h"
+#include "RecastAlloc.h"
 #include "fastlz.h"
 #include "InputGeom.h"
 #include "OgreRecastDefinitions.h"
+#include "PlayerFlagQueryFilter.h"
+#include "DetourIslands.h"
+#include "DetourPolyMask.h"
+#include "DetourCostOverlay.h"
+#include "NavMeshChangeListener.h"
+
+// Std
+#include <map>
+#include <memory>
+#include <vector>
 
 class OgreRecast ;
 
@@ -204,6 +215,23 @@ struct LinearAllocator : public dtTileCacheAlloc
    }
 } ;
 
+// Serves the scratch buffer of dtBuildTileCacheLayer from rcAlloc, so that it comes from the
+// rcTempAllocator bound while the tiles are built.
+struct RecastTempAlloc : public dtTileCacheAlloc
+{
+   virtual void *
+   alloc ( const size_t size )
+   {
+      return rcAlloc ( size, RC_ALLOC_TEMP ) ;
+   }
+
+   virtual void
+   free ( void *ptr )
+   {
+      rcFree ( ptr ) ;
+   }
+} ;
+
 // Maximum layers (floor levels) that 2D navmeshes can have in the tilecache.
 // This determines the domain size of the tilecache pages, as their dimensions
 // are width*height*layers.
@@ -218,14 +246,17 @@ struct TileCacheData
 
 // Rasterization context stores temporary data used
 // when rasterizing inputGeom into a navmesh.
+// The tilecache keeps one and builds every tile in it, so once it has grown to the largest tile,
+// building a tile does not allocate the heightfields, their span pools or the layer set again.
 struct RasterizationContext
 {
    RasterizationContext () :
       solid    ( nullptr ),
-      triareas ( nullptr ),
       lset     ( nullptr ),
-      chf      ( nullptr ),
-      ntiles   ( 0 )
+      chf         ( nullptr ),
+      ntiles      ( 0 ),
+      volumes     ( nullptr ),
+      volumeCount ( 0 )
    {
       memset ( tiles, 0, sizeof ( TileCacheData ) * MAX_LAYERS ) ;
    }
@@ -233,9 +264,6 @@ struct RasterizationContext
    ~RasterizationContext ()
    {
       rcFreeHeightField ( solid ) ;
-
-      delete [] triareas ;
-
       rcFreeHeightfieldLayerSet ( lset ) ;
       rcFreeCompactHeightfield ( chf ) ;
 
@@ -246,12 +274,22 @@ struct RasterizationContext
       }
    }
 
-   rcHeightfield         *solid ;
-   unsigned char         *triareas ;
-   rcHeightfieldLayerSet *lset ;
-   rcCompactHeightfield  *chf ;
-   TileCacheData         tiles [ MAX_LAYERS ] ;
-   int                   ntiles ;
+   rcHeightfield               *solid ;
+   std::vector <unsigned char> triareas ;
+   rcHeightfieldLayerSet       *lset ;
+   rcCompactHeightfield        *chf ;
+   TileCacheData               tiles [ MAX_LAYERS ] ;
+   int                         ntiles ;
+
+   // The areas of chf before erosion, restored for each agent cache.
+   std::vector <unsigned char> walkableAreas ;
+
+   // The convex volumes of the tilecache that rasterized chf, marked after each erosion.
+   const ConvexVolume * const  *volumes ;
+   int                         volumeCount ;
+
+   // Serves the temporary memory of the Recast build steps while a tile is built.
+   rcTempAllocator             tempAlloc ;
 } ;
 
 // Build context stores temporary data used while
@@ -317,6 +355,13 @@ public :
    class NavMeshDebug *
    CreateDebugger () ;
 
+   class OgreDetourCrowd *
+   CreateCrowd ( const PlayerFlagQueryFilter &filter,
+                 const float                 *poly_search_box,
+                 const int                   max_agents,
+                 const float                 max_agent_radius,
+                 const unsigned int          worker_count ) ;
+
    // Build all tiles of the tilecache and construct a recast navmesh from the
    // specified entities. These entities need to be already added to the scene so that
    // their world position and orientation can be calculated.
@@ -331,9 +376,26 @@ public :
    //
    // Will issue a configure() call so the entities specified will determine the world bounds
    // of the tilecache.
+   //
+   // The agent caches are built from the same geometry for other agent radii, each into its own
+   // tilecache and navmesh. Every tile is rasterized and filtered only once, and its compact
+   // heightfield is then eroded for this and each agent cache. The agent caches must have been
+   // constructed with the same tile size and a config that only differs in walkableRadius.
+   //
+   // The loaded pages of terrain are sampled straight into the heightfield of each tile instead
+   // of being passed in as entities, see InputGeom::rasterizeTerrain.
+   bool
+   TileCacheBuild ( std::vector<Ogre::Entity*>                srcMeshes,
+                    const TerrainAreaVector                   &area_list,
+                    const std::vector <OgreDetourTileCache*> &agent_caches = {},
+                    Ogre::TerrainGroup                        *terrain      = nullptr ) ;
+
+   // As above, from geometry that was already converted, e.g. loaded with InputGeom::loadGeometry
+   // on a machine without a render system.
    bool
-   TileCacheBuild ( std::vector<Ogre::Entity*> srcMeshes,
-                    const TerrainAreaVector    &area_list ) ;
+   TileCacheBuild ( std::unique_ptr <InputGeom>               geometry,
+                    const TerrainAreaVector                   &area_list,
+                    const std::vector <OgreDetourTileCache*> &agent_caches = {} ) ;
 
    bool
    SaveAll ( const Ogre::String &filename ) ;
@@ -342,6 +404,20 @@ public :
    LoadAll ( const Ogre::String         &filename,
              std::vector<Ogre::Entity*> srcMeshes ) ;
 
+   // Adds static geometry to the navmesh without building all tiles again, e.g. a building that was
+   // placed. Like obstacles the geometry is applied by the next update() calls, which rasterize the
+   // tiles it overlaps again from the geometry of TileCacheBuild and all static geometry added since,
+   // for this and the agent caches of TileCacheBuild. Only the tiles within the bounds of the
+   // tilecache can be rebuilt, the geometry beyond them is left out.
+   // Returns an id for RemoveStaticGeometry, or 0 if the geometry has no triangles.
+   int
+   AddStaticGeometry ( std::unique_ptr <InputGeom> geometry ) ;
+
+   // Removes static geometry added with AddStaticGeometry, the tiles it overlapped are rasterized
+   // again by the next update() calls. The geometry of TileCacheBuild cannot be removed.
+   bool
+   RemoveStaticGeometry ( const int id ) ;
+
    // Update (tick) the tilecache.
    // You must call this method in your render loop continuously to dynamically
    // update the navmesh when obstacles are added or removed.
@@ -389,6 +465,65 @@ public :
    bool
    DeleteConvexVolume ( int i ) ;
 
+   // Multiplies the path cost of the polys overlapping a cylinder (base centre, radius and height)
+   // by cost_multiplier, without rebuilding tiles. Multipliers of overlapping shapes multiply, and
+   // multipliers below 1 count as 1. Shapes are applied during the next update() call and repainted
+   // onto tiles that are rebuilt, so they can be moved every frame by removing and adding them.
+   // Returns 0 if the shape could not be added.
+   dtCostShapeRef
+   AddCostCircle ( const Ogre::Vector3 &base,
+                   const float         radius,
+                   const float         height,
+                   const float         cost_multiplier ) ;
+
+   // As above, for the convex area of a volume.
+   dtCostShapeRef
+   AddCostVolume ( const ConvexVolume &volume,
+                   const float        cost_multiplier ) ;
+
+   bool
+   SetCostMultiplier ( const dtCostShapeRef ref,
+                       const float          cost_multiplier ) ;
+
+   bool
+   RemoveCostShape ( const dtCostShapeRef ref ) ;
+
+   // Returns the cost multipliers painted by the cost shapes, or nullptr if there is no navmesh.
+   const dtCostOverlay *
+   GetCostOverlay () const ;
+
+   // Places landmarks on the navmesh and precomputes the path costs from them for the given filter.
+   // Path searches with the same include and exclude flags use them to guide the search.
+   // Building again for the same flags replaces the previous landmarks.
+   bool
+   BuildLandmarks ( const PlayerFlagQueryFilter &filter,
+                    const int                   landmark_count ) ;
+
+   // Returns the landmarks built for the flags, or nullptr if there are none.
+   const dtNavMeshLandmarks *
+   GetLandmarks ( const unsigned short include_flags,
+                  const unsigned short exclude_flags ) const ;
+
+   // Returns the connected islands of the navmesh for the flags of the filter, labelling them on
+   // the first request for those flags. Returns nullptr if the labels could not be built.
+   const dtNavMeshIslands *
+   GetIslands ( const PlayerFlagQueryFilter &filter ) ;
+
+   // Returns a filter passing the same polys as the given filter from bits precomputed per tile,
+   // computing them on the first request for its flags. Queries with the returned filter use the
+   // inlined dtPolyMaskFilter overloads of dtNavMeshQuery. Returns nullptr if the bits could not
+   // be computed.
+   const dtPolyMaskFilter *
+   GetFilterMask ( const PlayerFlagQueryFilter &filter ) ;
+
+   // Makes HandleUpdate record the tiles it rebuilt and the obstacles it finished. Off by default.
+   void
+   SetTrackChanges ( const bool enabled ) ;
+
+   // The changes made by the last HandleUpdate, empty unless changes are tracked.
+   const NavMeshChanges &
+   GetChanges () const ;
+
 private :
    // Configure the tilecache for building navmesh tiles from the specified input geometry.
    // The inputGeom is mainly used for determining the bounds of the world for which a navmesh
@@ -397,29 +532,118 @@ private :
    // to initialize.
    // This method has to be called once after construction, and before any tile builds happen.
    bool
-   ConfigureTileCacheContext () ;
+   ConfigureTileCacheContext ( const InputGeom &geometry ) ;
 
-   // Build the 2D navigation grid divided in layers that is the intermediary format stored in the tilecache.
-   // Builds the specified tile from the given input geometry. Only the part of the geometry that intersects the
-   // needed tile is used.
-   // From this format a 3D navmesh can be quickly generated at runtime.
+   // Rasterizes the specified tile from the input geometry into the compact heightfield of rc, with
+   // border_size cells of padding around it. Only the part of the geometry that intersects the
+   // needed tile is used, and the terrain heights are sampled for the cells of the tile only. The
+   // spans are filtered, but not eroded or marked with the convex volumes yet, so the same
+   // heightfield can serve several agent radii.
    // This process uses a large part of the recast navmesh building pipeline (implemented in OgreRecast::NavMeshBuild()),
    // up till step 4.
+   // Returns false if the tile is empty or could not be built.
+   bool
+   RasterizeTile ( const int            tx,
+                   const int            ty,
+                   const int            border_size,
+                   RasterizationContext &rc ) ;
+
+   // Erodes the compact heightfield of rc by the agent radius of this tilecache, marks the convex
+   // volumes of rc on it and adds the 2D navigation grid divided in layers, the intermediary format
+   // from which a 3D navmesh can be quickly generated at runtime, to the tilecache. The areas of the
+   // heightfield are eroded and marked in place.
+   // Returns the number of layers added.
    int
-   RasterizeTileLayers ( const int     tx,
-                         const int     ty,
-                         TileCacheData *tiles,
-                         const int     maxTiles ) ;
+   AddTileLayers ( const int            tx,
+                   const int            ty,
+                   const int            border_size,
+                   RasterizationContext &rc ) ;
+
+   // Replaces the layers at tx, ty with those of rc, or removes them if rc is nullptr, and builds
+   // the navmesh tiles there again.
+   void
+   ReplaceTileLayers ( const int            tx,
+                       const int            ty,
+                       const int            border_size,
+                       RasterizationContext *rc ) ;
+
+   // Queues the tiles overlapping the geometry to be rasterized again.
+   void
+   QueueStaticGeometryTiles ( const InputGeom &geometry ) ;
+
+   // Rasterizes one queued tile again, or all of them if until_up_to_date is set.
+   void
+   RebuildStaticGeometryTiles ( const bool until_up_to_date ) ;
+
+   // The border around the tiles when rasterizing them for this and the agent caches.
+   int
+   GetBorderSize () const ;
 
    bool
    InitTileCache () ; // Inits the tilecache. Helper used by constructors.
 
+   // Brings the landmarks up to date with rebuilt tiles and obstacles that changed gate flags.
+   // Recomputes one landmark per profile and call, unless until_up_to_date is set. The others
+   // keep guiding queries with their previous tables meanwhile, limited near the changes.
+   void
+   UpdateLandmarks ( const bool until_up_to_date ) ;
+
+   // Brings the island labels up to date with rebuilt tiles.
+   void
+   UpdateIslands () ;
+
+   // Initializes the cost overlay for a newly created navmesh.
+   bool
+   InitCostOverlay () ;
+
+   // Brings the filter masks up to date with rebuilt tiles.
+   void
+   UpdateFilterMasks () ;
+
+   // Marks the islands and filter masks of the tiles touched by obstacles that changed gate flags
+   // out of date.
+   void
+   InvalidateGateTiles () ;
+
+   // Adds a tile rebuilt by the tilecache to Changes.
+   void
+   RecordTileChange ( const dtCompressedTileRef tile_ref ) ;
+
+   void
+   RecordTileChange ( const int tx,
+                      const int ty,
+                      const int layer ) ;
+
+   // Adds the obstacles that finished since the start of the update to Changes.
+   void
+   RecordObstacleChanges () ;
+
+   bool
+   SaveLandmarks ( const Ogre::String &filename ) ;
+
+   bool
+   LoadLandmarks ( const Ogre::String &filename ) ;
+
    // InputGeom from which the tileCache is initially inited (it's bounding box is considered the bounding box
    // for the entire world that the navmesh will cover). Tile build methods without specific geometry or entity
    // input will build navmesh from this geometry.
    // It also stored the convex temp obstacles. (will be gone in the future)
    // In the future this variable will probably disappear.
    InputGeom      *InputGeometry ;
+
+   // Geometry added with AddStaticGeometry by id, each with its own chunky tri mesh so that adding
+   // or removing it does not build the others again.
+   std::map <int, std::unique_ptr <InputGeom>> StaticGeometry ;
+   int                                         NextStaticGeometryId ;
+
+   // Tiles (x, y) waiting to be rasterized again for added or removed static geometry.
+   std::vector <std::pair <int, int>> StaticGeometryTiles ;
+
+   // The tilecaches built from the same tiles by TileCacheBuild, which get the rebuilt tiles too.
+   std::vector <OgreDetourTileCache*> AgentCaches ;
+
+   // The tiles of TileCacheBuild and RebuildStaticGeometryTiles are built in this one context.
+   RasterizationContext TileContext ;
    OgreRecast     &Recast ; // Ogre Recast component that holds the recast config and where the navmesh will be built.
    dtNavMeshQuery &NavQuery ;
 
@@ -452,6 +676,51 @@ private :
    ConvexVolume *m_volumes [ MAX_VOLUMES ] ;
    int          m_volumeCount ;
 
+   // Maximum number of cost shapes that can be added to the cost overlay.
+   static const int MAX_COST_SHAPES = 1024 ;
+
+   dtCostOverlay CostOverlay ;
+
+   // Landmarks are only valid for the costs and flags of the filter they were built with.
+   struct LandmarkProfile
+   {
+      PlayerFlagQueryFilter Filter ;
+      dtNavMeshLandmarks    Landmarks ;
+   } ;
+
+   std::vector <std::unique_ptr <LandmarkProfile>> LandmarkProfiles ;
+
+   // Islands only depend on which polygons the filter passes, so one profile serves all area costs.
+   struct IslandProfile
+   {
+      PlayerFlagQueryFilter Filter ;
+      dtNavMeshIslands      Islands ;
+   } ;
+
+   std::vector <std::unique_ptr <IslandProfile>> IslandProfiles ;
+
+   // Filter masks store which polygons pass the filter, so like islands they ignore area costs.
+   struct FilterMaskProfile
+   {
+      PlayerFlagQueryFilter Filter ;
+      dtPolyMask            Mask ;
+      dtPolyMaskFilter      MaskFilter ;
+   } ;
+
+   std::vector <std::unique_ptr <FilterMaskProfile>> FilterMaskProfiles ;
+
+   // Obstacles that were being processed when the last update started. Finished obstacles change
+   // the flags of gate polygons without a tile rebuild, which the landmarks, islands and filter
+   // masks cannot detect.
+   std::vector <int> ProcessingObstacles ;
+
+   // Obstacles on the navmesh when the last update started, with their references from before
+   // they could be removed. Only collected while changes are tracked.
+   std::vector <std::pair <int, dtObstacleRef>> PlacedObstacles ;
+
+   bool           TrackChanges ;
+   NavMeshChanges Changes ;
+
    struct TileCacheSetHeader
    {
       int               magic ;
@@ -467,4 +736,20 @@ private :
       dtCompressedTileRef tileRef ;
       int                 dataSize ;
    } ;
+
+   struct LandmarkSetHeader
+   {
+      int magic ;
+      int version ;
+      int numProfiles ;
+   } ;
+
+   struct LandmarkProfileHeader
+   {
+      unsigned short includeFlags ;
+      unsigned short excludeFlags ;
+      float          areaCosts [ DT_MAX_AREAS ] ;
+      int            maxLandmarks ;
+      int            dataSize ;
+   } ;
 } ;
@@ -37,12 +37,22 @@
 #include "OgreRecastDefinitions.h"
 #include "OgreDetourTileCache.h"
 #include "PlayerFlagQueryFilter.h"
+#include "PathBuffer.h"
+#include "FlowField.h"
+#include "PathCorridor.h"
+#include "NavMeshChangeListener.h"
+#include "RaycastBatch.h"
+#include "WorkerPool.h"
 
 #include <Ogre.h>
 
+// Std
+#include <unordered_map>
+
 class  OgreRecastNavmeshPruner ;
 struct OgreRecastConfigParams ;
 class  NavMeshDebug ;
+class  OgreDetourCrowd ;
 class  dtNavMeshQuery ;
 
 enum class FindPathReturnCode
@@ -66,11 +76,32 @@ public:
    Update ( const float delta_time,
             const bool  until_up_to_date ) ;
 
+   // Registers a listener that is told which tiles were rebuilt and which obstacles were added or
+   // removed at the end of every Update that changed the navmesh. The listener must stay alive
+   // until it is removed.
+   void
+   AddNavMeshChangeListener ( NavMeshChangeListener *listener ) ;
+
+   void
+   RemoveNavMeshChangeListener ( NavMeshChangeListener *listener ) ;
+
+   // Builds the navmesh from source_meshes and the loaded pages of terrain. Terrain heights are
+   // sampled straight into the heightfield of each tile, which is much cheaper than passing the
+   // terrain in as entities with a triangle per height sample.
    bool
    Generate ( const unsigned int         max_num_obstacles,
               const int                  tile_size,
               std::vector<Ogre::Entity*> source_meshes,
-              const TerrainAreaVector    &area_list ) ;
+              const TerrainAreaVector    &area_list,
+              Ogre::TerrainGroup         *terrain = nullptr ) ;
+
+   // As above, from geometry that was already converted, e.g. loaded with InputGeom::loadGeometry so
+   // that no Ogre entities have to be created, or cleaned up with InputGeom::cleanGeometry first.
+   bool
+   Generate ( const unsigned int          max_num_obstacles,
+              const int                   tile_size,
+              std::unique_ptr <InputGeom> geometry,
+              const TerrainAreaVector     &area_list ) ;
 
    bool
    Load ( const Ogre::String         &filename,
@@ -81,11 +112,31 @@ public:
    bool
    Save ( const Ogre::String &filename ) ;
 
+   // Adds a separate navmesh for agents of agent_radius, e.g. vehicles that need wider passages than
+   // the agent radius of the config params. Generate builds it from the same rasterized tiles as the
+   // main navmesh, which only have to be eroded again, and obstacles are added to and removed from
+   // all navmeshes. Must be called before Generate. Load only loads the main navmesh.
+   // Returns the profile to pass to CreateCrowd and CreateNavMeshDebugger. Profile 0 is the main
+   // navmesh, which is the one all path and poly queries use.
+   int
+   AddAgentProfile ( const float agent_radius ) ;
+
    // A navigation mesh must have been Generated or Loaded before this is called otherwise a nullptr is returned.
    // When a navigation mesh is deleted (e.g. Generate or Load called again will delete any existing), then the
    // previous debugger is invalid as the returned pointer is tied to a given navigation mesh instance.
    std::unique_ptr <NavMeshDebug>
-   CreateNavMeshDebugger () ;
+   CreateNavMeshDebugger ( const int agent_profile = 0 ) ;
+
+   // Creates a crowd of up to max_agents units moving on the navmesh of agent_profile, see
+   // OgreDetourCrowd. Its updates are split over worker_count threads, or one per hardware thread
+   // if it is 0.
+   // Like the debugger, the crowd is tied to the current navigation mesh instance and a nullptr is
+   // returned if there is none.
+   std::unique_ptr <OgreDetourCrowd>
+   CreateCrowd ( const int          max_agents,
+                 const float        max_agent_radius,
+                 const unsigned int worker_count  = 0,
+                 const int          agent_profile = 0 ) ;
 
    dtObstacleRef
    AddObstacle ( const Ogre::Vector3  &min,
@@ -108,12 +159,47 @@ public:
    bool
    RemoveObstacle ( dtObstacleRef ref ) ;
 
+   // Adds the entities to the navmesh of every profile as static geometry, which only rasterizes the
+   // tiles they overlap again during the next Updates instead of generating the navmesh again. The
+   // entities need to be added to a scenenode. Returns an id for RemoveStaticGeometry, or 0 if the
+   // entities have no triangles. See OgreDetourTileCache::AddStaticGeometry.
+   int
+   AddStaticGeometry ( std::vector<Ogre::Entity*> entities ) ;
+
+   // As above, from geometry that was already converted.
+   int
+   AddStaticGeometry ( std::unique_ptr <InputGeom> geometry ) ;
+
+   // Removes static geometry added with AddStaticGeometry. The geometry the navmesh was generated
+   // from cannot be removed.
+   bool
+   RemoveStaticGeometry ( const int id ) ;
+
    int
    AddConvexVolume ( ConvexVolume *vol ) ;
 
    bool
    DeleteConvexVolume ( int volume_index ) ;
 
+   // Cost shapes make the polys they overlap more expensive for path finding without rebuilding
+   // tiles, e.g. for danger zones or crowded areas. See OgreDetourTileCache::AddCostCircle.
+   dtCostShapeRef
+   AddCostCircle ( const Ogre::Vector3 &base,
+                   const float         radius,
+                   const float         height,
+                   const float         cost_multiplier ) ;
+
+   dtCostShapeRef
+   AddCostVolume ( const ConvexVolume &volume,
+                   const float        cost_multiplier ) ;
+
+   bool
+   SetCostMultiplier ( const dtCostShapeRef ref,
+                       const float          cost_multiplier ) ;
+
+   bool
+   RemoveCostShape ( const dtCostShapeRef ref ) ;
+
    // Find a path beween start point and end point and, if possible, generates a list of lines in a path.
    // It might fail if the start or end points aren't near any navmesh polygons, or if the path is too long,
    // or it can't make a path, or various other reasons.
@@ -131,6 +217,88 @@ public:
               const unsigned int         exclude_flags,
               std::vector<Ogre::Vector3> &path ) ;
 
+   // As above, but the path is written into a caller owned buffer that is reused between calls.
+   // The buffer grows when a path does not fit, so long paths no longer fail because of a fixed
+   // limit and repeated calls with the same buffer do not allocate.
+   FindPathReturnCode
+   FindPath ( float              *start_pos,
+              float              *end_pos,
+              const unsigned int include_flags,
+              const unsigned int exclude_flags,
+              PathBuffer         &path ) ;
+
+   FindPathReturnCode
+   FindPath ( const Ogre::Vector3 &start_pos,
+              const Ogre::Vector3 &end_pos,
+              const unsigned int  include_flags,
+              const unsigned int  exclude_flags,
+              PathBuffer          &path ) ;
+
+   // Makes FindPath and FindNearestPolyOnNavmesh look up whether a poly passes the include and
+   // exclude flags in bits precomputed per navmesh tile, instead of evaluating the flags of every
+   // poly visited. The bits are computed on the first query with each pair of flags and follow tile
+   // rebuilds and gate changes during Update. Off by default.
+   void
+   SetPrecomputedFilters ( const bool enabled ) ;
+
+   // Precomputes path costs from a few landmarks spread over the navmesh for the given flags.
+   // FindPath calls with the same include and exclude flags use them to expand far fewer polygons
+   // on large maps. Each landmark costs 8 bytes per navmesh polygon. The landmarks follow tile
+   // rebuilds and gate changes during Update, and are saved and loaded with the navmesh.
+   bool
+   BuildLandmarks ( const unsigned int include_flags,
+                    const unsigned int exclude_flags,
+                    const int          landmark_count = 8 ) ;
+
+   // Builds a flow field towards goal_pos for the given flags, holding the path cost and next
+   // polygon from every polygon within max_cost of the goal. One field replaces the path searches
+   // of all units sent to the same goal. Returns false if goal_pos is not on the navmesh.
+   bool
+   BuildFlowField ( const Ogre::Vector3 &goal_pos,
+                    const unsigned int  include_flags,
+                    const unsigned int  exclude_flags,
+                    FlowField           &field,
+                    const float         max_cost = FLT_MAX ) ;
+
+   // Finds a path from start_pos to the goal of a flow field by following the field, so no path
+   // search is needed. The field is built again first if navmesh tiles changed since it was built.
+   FindPathReturnCode
+   FindPath ( const Ogre::Vector3 &start_pos,
+              FlowField           &field,
+              PathBuffer          &path ) ;
+
+   // Plans a path corridor from start_pos to end_pos for the given flags. Unlike the straight path
+   // of the other FindPath versions, the corridor can follow a moving unit and target and be repaired
+   // after navmesh changes without searching the whole path again. See PathCorridor.
+   FindPathReturnCode
+   FindPath ( const Ogre::Vector3 &start_pos,
+              const Ogre::Vector3 &end_pos,
+              const unsigned int  include_flags,
+              const unsigned int  exclude_flags,
+              PathCorridor        &corridor ) ;
+
+   // Moves the unit of the corridor towards position along the navmesh surface and takes any
+   // shortcut that became visible. Returns false if the corridor has no path or the move failed.
+   bool
+   MoveCorridorPosition ( const Ogre::Vector3 &position,
+                          PathCorridor        &corridor ) ;
+
+   // Moves the target of the corridor. Small moves lengthen or shorten the end of the corridor
+   // directly, larger ones search from the old end of the corridor, expanding at most max_iterations
+   // polys. Returns false if the corridor has no path or the target is not on the navmesh.
+   bool
+   MoveCorridorTarget ( const Ogre::Vector3 &target,
+                        PathCorridor        &corridor,
+                        const int           max_iterations = 64 ) ;
+
+   // Repairs the corridor after navmesh changes, continues the search if the corridor does not
+   // reach its target yet and otherwise looks for a shorter way near the unit. Expands at most
+   // max_iterations polys, so it can be called for every unit each frame. Returns false if the unit
+   // or the target left the navmesh or the target can no longer be reached.
+   bool
+   UpdateCorridor ( PathCorridor &corridor,
+                    const int    max_iterations = 64 ) ;
+
    // Find a point on the navmesh closest to the specified point position, within predefined
    // bounds.
    // Returns true if such a point is found (returned as resultPt), returns false
@@ -148,6 +316,29 @@ public:
                               Ogre::Vector3       &result_point,
                               dtPolyRef           &result_poly ) ;
 
+   // Finds the nearest point and poly on the navmesh for many positions at once, giving the same
+   // results as FindNearestPolyOnNavmesh for each of them. The positions are grouped by navmesh
+   // tile, so this is much cheaper than separate calls for large sets of nearby positions.
+   // The results are in the order of positions. Positions without a poly within the search box get
+   // a zero poly and their own position as point.
+   // Returns false if the query failed.
+   bool
+   FindNearestPolysOnNavmesh ( const std::vector <Ogre::Vector3> &positions,
+                               const unsigned int                include_flags,
+                               const unsigned int                exclude_flags,
+                               std::vector <Ogre::Vector3>       &result_points,
+                               std::vector <dtPolyRef>           &result_polys ) ;
+
+   // Casts every ray of the batch along the navmesh surface for the given flags, stopping at walls
+   // and at polys the flags exclude, and stores the hit t, wall normal and visited polys of each ray
+   // in the batch. The starts are snapped to the navmesh with one batched nearest poly search and
+   // the rays are split over one worker thread per hardware thread.
+   // Returns false if the nearest poly search failed.
+   bool
+   Raycast ( RaycastBatch       &batch,
+             const unsigned int include_flags,
+             const unsigned int exclude_flags ) ;
+
    // Convenience function for converting between Ogre::Vector3 and float* used by recast.
    static void
    OgreVect3ToFloatA ( const Ogre::Vector3 &vect,
@@ -163,14 +354,80 @@ private :
    void
    ConfigureBuildParameters ( const OgreRecastConfigParams &config_params ) ;
 
+   // Returns the tilecache of an agent profile, or nullptr if it has not been built.
+   OgreDetourTileCache *
+   GetProfileTileCache ( const int agent_profile ) const ;
+
+   // Runs dtNavMeshQuery::findNearestPoly with QueryFilter, or its precomputed mask if enabled.
+   dtStatus
+   FindNearestPoly ( const float *position,
+                     dtPolyRef   &poly,
+                     float       *nearest_point ) ;
+
+   // Runs dtNavMeshQuery::findPath into the poly buffer of path, growing it until the corridor fits.
+   dtStatus
+   FindPolyPath ( const dtPolyRef start_poly,
+                  const dtPolyRef end_poly,
+                  const float     *start_point,
+                  const float     *end_point,
+                  PathBuffer      &path ) ;
+
+   // Searches the flow field for the goal, filter and cost limit stored in field.
+   bool
+   BuildFlowField ( FlowField &field ) ;
+
+   // Turns the poly corridor of path into its straight path points.
+   FindPathReturnCode
+   StraightenPath ( const float *start_point,
+                    const float *end_point,
+                    PathBuffer  &path ) ;
+
+   // Runs dtNavMeshQuery::findStraightPath into the vertex buffer of path, growing it until the path fits.
+   dtStatus
+   FindStraightPath ( const float *start_point,
+                      const float *end_point,
+                      PathBuffer  &path ) ;
+
+   // Refreshes the corners of corridor from its current position.
+   void
+   UpdateCorners ( PathCorridor &corridor ) ;
+
    rcConfig                              RecastConfig ;
    rcContext                             BuildContext ;
    std::unique_ptr <OgreDetourTileCache> TileCache ;
    dtNavMeshQuery                        NavQuery ;
 
+   // A navmesh for another agent radius, see AddAgentProfile.
+   struct AgentProfile
+   {
+      rcConfig                              RecastConfig ;
+      dtNavMeshQuery                        NavQuery ;
+      std::unique_ptr <OgreDetourTileCache> TileCache ;
+
+      // The obstacles on this navmesh by the reference of the same obstacle on the main navmesh.
+      std::unordered_map <dtObstacleRef, dtObstacleRef> Obstacles ;
+   } ;
+
+   std::vector <std::unique_ptr <AgentProfile>> AgentProfiles ;
+
    // The poly filter that will be used for all (random) point and nearest poly searches.
    PlayerFlagQueryFilter QueryFilter ;
 
+   // Path storage used by the std::vector versions of FindPath.
+   PathBuffer ScratchPath ;
+
+   // Point storage used by FindNearestPolysOnNavmesh, x, y, z per point.
+   std::vector <float> ScratchPoints ;
+   std::vector <float> ScratchNearestPoints ;
+
+   // If set, queries use the precomputed mask of QueryFilter from the tilecache.
+   bool PrecomputedFilters ;
+
+   std::vector <NavMeshChangeListener*> ChangeListeners ;
+
+   // Workers for batched queries, started by the first one.
+   std::unique_ptr <WorkerPool> QueryWorkers ;
+
    // The offset size (box) around points used to look for nav polygons.
    // This offset is used in all search for points on the navmesh.
    // The maximum offset that a specified point can be off from the navmesh.
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "OgreRecastDefinitions.h" // For MAX_PATHPOLY and MAX_PATHVERT
+
+#include <Ogre.h>
+
+// Std
+#include <vector>
+
+// Caller owned storage for the results of OgreRecast::FindPath.
+// The buffers keep their capacity between calls, so once a buffer has grown to fit the longest
+// path requested from it, path finding does no further heap allocations. When a path does not fit
+// the buffers are grown and the query is repeated, so the path length is only limited by the
+// number of nodes of the navmesh query.
+class PathBuffer
+{
+public:
+   PathBuffer ( const std::size_t poly_capacity   = MAX_PATHPOLY,
+                const std::size_t vertex_capacity = MAX_PATHVERT ) ;
+
+   // The straight path points of the last path found.
+   const std::vector <Ogre::Vector3> &
+   GetPath () const ;
+
+   // The polygon corridor of the last path found.
+   const dtPolyRef *
+   GetPolys () const ;
+
+   int
+   GetPolyCount () const ;
+
+   // Empties the path without releasing any memory.
+   void
+   Clear () ;
+
+private:
+   friend class OgreRecast ;
+
+   std::vector <dtPolyRef>     PolyPath ;
+   int                         PolyCount ;
+   std::vector <float>         StraightPath ; // x, y, z per vertex
+   int                         VertexCount ;
+   std::vector <Ogre::Vector3> Path ;
+} ;
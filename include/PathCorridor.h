@@ -0,0 +1,63 @@
+#pragma once
+
+#include "OgreRecastDefinitions.h" // For MAX_PATHPOLY
+#include "PlayerFlagQueryFilter.h"
+#include "DetourPathCorridor.h"
+
+#include <Ogre.h>
+
+// Std
+#include <vector>
+
+// Caller owned path corridor of a single unit, planned by OgreRecast::FindPath and kept up to
+// date by OgreRecast::MoveCorridorPosition, MoveCorridorTarget and UpdateCorridor.
+// Moving the unit or its target only touches the polys near the moved end of the corridor, and
+// navmesh changes only cause the part of the corridor after the first changed poly to be searched
+// again. So a unit that drifts, follows a moving target or walks through changing tiles no longer
+// needs a full path search each time.
+class PathCorridor
+{
+public:
+   // The number of corners returned by GetCorners.
+   static const int MAX_CORNERS = 8 ;
+
+   PathCorridor ( const int max_polys = MAX_PATHPOLY ) ;
+
+   // The position of the unit, on the navmesh.
+   Ogre::Vector3
+   GetPosition () const ;
+
+   // The end of the corridor, on the navmesh. This is short of the requested target while the
+   // corridor does not reach it.
+   Ogre::Vector3
+   GetTarget () const ;
+
+   // The next few straight path points from the position towards the target. The last point is the
+   // end of the corridor if it is among them. Updated by every OgreRecast call on the corridor.
+   const std::vector <Ogre::Vector3> &
+   GetCorners () const ;
+
+   // True if a path has been planned into the corridor.
+   bool
+   HasPath () const ;
+
+   // True if the corridor ends in the poly of the requested target.
+   bool
+   ReachesTarget () const ;
+
+   // Empties the corridor without releasing any memory.
+   void
+   Clear () ;
+
+private:
+   friend class OgreRecast ;
+
+   dtPathCorridor              Corridor ;
+   PlayerFlagQueryFilter       Filter ;
+   dtPolyRef                   TargetPoly ;
+   float                       TargetPoint [ 3 ] ; // The requested target, on the navmesh
+   float                       CornerVerts [ MAX_CORNERS * 3 ] ;
+   unsigned char               CornerFlags [ MAX_CORNERS ] ;
+   dtPolyRef                   CornerPolys [ MAX_CORNERS ] ;
+   std::vector <Ogre::Vector3> Corners ;
+} ;
@@ -1,11 +1,12 @@
 #pragma once
 
 #include "DetourNavMeshQuery.h"
+#include "DetourCostOverlay.h"
 
 class PlayerFlagQueryFilter : public dtQueryFilter
 {
 public:
-   PlayerFlagQueryFilter () {}
+   PlayerFlagQueryFilter () : CostOverlay ( nullptr ) {}
    virtual ~PlayerFlagQueryFilter () {}
 
    /// Returns true if the polygon can be visited.  (I.e. Is traversable.)
@@ -17,4 +18,28 @@ public:
                 const dtMeshTile *tile,
                 const dtPoly     *poly ) const override ;
 
+   /// Returns the cost of moving along a segment inside the current polygon, which is the
+   /// default area cost multiplied by the cost overlay, if one is set.
+   virtual float
+   getCost ( const float      *pa,
+             const float      *pb,
+             const dtPolyRef  prevRef,
+             const dtMeshTile *prevTile,
+             const dtPoly     *prevPoly,
+             const dtPolyRef  curRef,
+             const dtMeshTile *curTile,
+             const dtPoly     *curPoly,
+             const dtPolyRef  nextRef,
+             const dtMeshTile *nextTile,
+             const dtPoly     *nextPoly ) const override ;
+
+   // The overlay must outlive the filter, or be reset to nullptr first.
+   void
+   SetCostOverlay ( const dtCostOverlay *overlay ) ;
+
+   const dtCostOverlay *
+   GetCostOverlay () const ;
+
+private:
+   const dtCostOverlay *CostOverlay ;
 } ;
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "OgreRecastDefinitions.h" // For dtPolyRef
+
+#include <Ogre.h>
+
+// Std
+#include <vector>
+
+// Caller owned rays and results for OgreRecast::Raycast, which casts all rays of the batch at once.
+// Rays from the same start, e.g. the sight lines of one unit, share one nearest poly search, and
+// the rays are split over worker threads. Like PathBuffer, the batch keeps its memory between
+// uses, so filling it again each tick does not allocate once it has grown to its largest size.
+class RaycastBatch
+{
+public:
+   // Up to max_path_polys polys visited by each ray are stored, none if it is 0.
+   RaycastBatch ( const int max_path_polys = 0 ) ;
+
+   // Removes all rays without releasing any memory.
+   void
+   Clear () ;
+
+   // Adds a ray from start towards end and returns its index. Rays added one after another from
+   // the same start share its nearest poly search.
+   int
+   AddRay ( const Ogre::Vector3 &start,
+            const Ogre::Vector3 &end ) ;
+
+   int
+   GetRayCount () const ;
+
+   // The results of the last OgreRecast::Raycast, one per ray in the order the rays were added.
+
+   // How far each ray got, as a fraction of the way from its start snapped to the navmesh to its
+   // end. FLT_MAX if the ray reached its end, and -1 if its start is not on the navmesh.
+   const float *
+   GetHitT () const ;
+
+   // The normal of the wall each ray hit, zero if it hit none.
+   const Ogre::Vector3 *
+   GetHitNormals () const ;
+
+   // The polys visited by a ray, from the start poly on.
+   const dtPolyRef *
+   GetPath ( const int ray ) const ;
+
+   int
+   GetPathCount ( const int ray ) const ;
+
+private:
+   friend class OgreRecast ;
+
+   int                         MaxPathPolys ;
+   std::vector <float>         Origins ;      // x, y, z per distinct start
+   std::vector <float>         Ends ;         // x, y, z per ray
+   std::vector <int>           RayOrigins ;   // Index into Origins per ray
+   std::vector <dtPolyRef>     OriginPolys ;
+   std::vector <float>         OriginPoints ; // Origins snapped to the navmesh
+   std::vector <float>         HitT ;
+   std::vector <Ogre::Vector3> HitNormals ;
+   std::vector <dtPolyRef>     Paths ;        // MaxPathPolys per ray
+   std::vector <int>           PathCounts ;
+} ;
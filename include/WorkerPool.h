@@ -0,0 +1,55 @@
+#pragma once
+
+// Std
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A pool of threads that split a range of items between them, the calling thread included.
+// The items are taken in small chunks, so items that take longer than others do not leave the
+// other threads idle. Used for the crowd update and batched navmesh queries.
+class WorkerPool
+{
+public:
+   // Calls a job for the items [begin, end) on worker, which is 0 for the thread calling Run and
+   // below GetWorkerCount for the others.
+   using Job = std::function <void ( const int worker, const int begin, const int end )> ;
+
+   // Starts worker_count - 1 threads, the thread calling Run is the first worker.
+   WorkerPool ( const unsigned int worker_count ) ;
+   ~WorkerPool () ;
+
+   int
+   GetWorkerCount () const ;
+
+   // Runs job for the items [0, count) in chunks of chunk_size on all workers and returns when
+   // every item is done. If the items fit in one chunk they are run on the calling thread alone.
+   // Run must not be called again from a job or from two threads at once.
+   void
+   Run ( const int  count,
+         const int  chunk_size,
+         const Job &job ) ;
+
+private:
+   // Takes chunks of the current run until none are left.
+   void
+   RunChunks ( const int worker ) ;
+
+   void
+   WorkerLoop ( const int worker ) ;
+
+   std::vector <std::thread> Workers ;
+   std::mutex                Mutex ;
+   std::condition_variable   WorkReady ;
+   std::condition_variable   WorkDone ;
+   unsigned int              Generation ;  // Counts the runs handed to the workers
+   int                       Pending ;     // Workers still busy with the current run
+   bool                      Quit ;
+   const Job                 *CurrentJob ;
+   int                       Count ;
+   int                       ChunkSize ;
+   std::atomic <int>         NextChunk ;
+} ;
@@ -0,0 +1,401 @@
+/*
+    OgreCrowd
+    ---------
+
+    Copyright (c) 2012 Jonas Hauquier
+
+    Additional contributions by:
+
+    - mkultra333
+    - Paul Wilson
+
+    Sincere thanks and to:
+
+    - Mikko Mononen (developer of Recast navigation libraries)
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+
+*/
+
+#include "ChunkyTriMesh.h"
+#include "WorkerPool.h"
+#include "Recast.h"
+#include <algorithm>
+#include <cfloat>
+#include <thread>
+#include <vector>
+
+struct BoundsItem
+{
+    float bmin[2];
+    float bmax[2];
+    float centre[2];
+    int i;
+};
+
+// A node of the tree while it is built, in the same form as the nodes of rcChunkyTriMesh.
+struct BuildNode
+{
+    float bmin[2];
+    float bmax[2];
+    int first;
+    int count;
+};
+
+// A node at the top of the tree, split before the subtrees below it are built in parallel.
+struct TopNode
+{
+    float bmin[2];
+    float bmax[2];
+    int left;
+    int right;
+    int job; // Index of the subtree built in its place, or -1
+};
+
+// A subtree of the items [imin, imax) built by one job.
+struct SubtreeJob
+{
+    int imin;
+    int imax;
+    std::vector<BuildNode> nodes;
+};
+
+// Number of bins along each axis in which the split positions are evaluated.
+static const int SAH_BINS = 16;
+
+// Ranges of at most this many triangles are built as one job.
+static const int SUBTREE_JOB_TRIS = 16384;
+
+static void calcExtends(const BoundsItem* items, const int imin, const int imax,
+                        float* bmin, float* bmax)
+{
+    bmin[0] = items[imin].bmin[0];
+    bmin[1] = items[imin].bmin[1];
+
+    bmax[0] = items[imin].bmax[0];
+    bmax[1] = items[imin].bmax[1];
+
+    for (int i = imin+1; i < imax; ++i)
+    {
+        const BoundsItem& it = items[i];
+        if (it.bmin[0] < bmin[0]) bmin[0] = it.bmin[0];
+        if (it.bmin[1] < bmin[1]) bmin[1] = it.bmin[1];
+
+        if (it.bmax[0] > bmax[0]) bmax[0] = it.bmax[0];
+        if (it.bmax[1] > bmax[1]) bmax[1] = it.bmax[1];
+    }
+}
+
+inline int longestAxis(float x, float y)
+{
+    return y > x ? 1 : 0;
+}
+
+// Half the perimeter of a box on the xz plane, which takes the place of the surface area of a 3D box:
+// the chance that a box overlaps a query rectangle much larger than itself grows with it.
+inline float halfPerimeter(const float* bmin, const float* bmax)
+{
+    return (bmax[0] - bmin[0]) + (bmax[1] - bmin[1]);
+}
+
+// Splits the items [imin, imax) in two and returns where the second half starts.
+// The centres of the items are sorted into bins along each axis, and the items are split
+// between the bins where the surface area heuristic cost is lowest. If all centres are
+// in one bin, the items are split at the median of the longest axis.
+static int splitItems(BoundsItem* items, const int imin, const int imax, const float* bmin, const float* bmax)
+{
+    float cmin[2] = { items[imin].centre[0], items[imin].centre[1] };
+    float cmax[2] = { cmin[0], cmin[1] };
+    for (int i = imin+1; i < imax; ++i)
+    {
+        for (int a = 0; a < 2; ++a)
+        {
+            cmin[a] = rcMin(cmin[a], items[i].centre[a]);
+            cmax[a] = rcMax(cmax[a], items[i].centre[a]);
+        }
+    }
+
+    float bestCost = FLT_MAX;
+    int bestAxis = -1;
+    int bestBin = 0;
+    for (int axis = 0; axis < 2; ++axis)
+    {
+        const float extent = cmax[axis] - cmin[axis];
+        if (extent <= 0)
+            continue;
+        const float scale = SAH_BINS / extent;
+
+        int binCount[SAH_BINS] = {0};
+        float binMin[SAH_BINS][2], binMax[SAH_BINS][2];
+        for (int b = 0; b < SAH_BINS; ++b)
+        {
+            binMin[b][0] = binMin[b][1] = FLT_MAX;
+            binMax[b][0] = binMax[b][1] = -FLT_MAX;
+        }
+        for (int i = imin; i < imax; ++i)
+        {
+            const BoundsItem& it = items[i];
+            const int b = rcMin(SAH_BINS-1, (int)((it.centre[axis] - cmin[axis])*scale));
+            binCount[b]++;
+            for (int a = 0; a < 2; ++a)
+            {
+                binMin[b][a] = rcMin(binMin[b][a], it.bmin[a]);
+                binMax[b][a] = rcMax(binMax[b][a], it.bmax[a]);
+            }
+        }
+
+        // Cost of the items right of each split, swept from the right
+        float rightCost[SAH_BINS];
+        float rmin[2] = { FLT_MAX, FLT_MAX }, rmax[2] = { -FLT_MAX, -FLT_MAX };
+        int rightCount = 0;
+        for (int b = SAH_BINS-1; b > 0; --b)
+        {
+            rightCount += binCount[b];
+            for (int a = 0; a < 2; ++a)
+            {
+                rmin[a] = rcMin(rmin[a], binMin[b][a]);
+                rmax[a] = rcMax(rmax[a], binMax[b][a]);
+            }
+            rightCost[b] = rightCount ? rightCount*halfPerimeter(rmin, rmax) : -1.0f;
+        }
+
+        float lmin[2] = { FLT_MAX, FLT_MAX }, lmax[2] = { -FLT_MAX, -FLT_MAX };
+        int leftCount = 0;
+        for (int b = 1; b < SAH_BINS; ++b)
+        {
+            leftCount += binCount[b-1];
+            for (int a = 0; a < 2; ++a)
+            {
+                lmin[a] = rcMin(lmin[a], binMin[b-1][a]);
+                lmax[a] = rcMax(lmax[a], binMax[b-1][a]);
+            }
+            if (!leftCount || rightCost[b] < 0)
+                continue;
+            const float cost = leftCount*halfPerimeter(lmin, lmax) + rightCost[b];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = b;
+            }
+        }
+    }
+
+    if (bestAxis < 0)
+    {
+        const int axis = longestAxis(bmax[0] - bmin[0], bmax[1] - bmin[1]);
+        const int isplit = imin + (imax-imin)/2;
+        std::nth_element(items+imin, items+isplit, items+imax, [axis] (const BoundsItem& a, const BoundsItem& b)
+        {
+            return a.bmin[axis] < b.bmin[axis];
+        });
+        return isplit;
+    }
+
+    const float scale = SAH_BINS / (cmax[bestAxis] - cmin[bestAxis]);
+    const float base = cmin[bestAxis];
+    BoundsItem* split = std::partition(items+imin, items+imax, [bestAxis, bestBin, scale, base] (const BoundsItem& it)
+    {
+        return rcMin(SAH_BINS-1, (int)((it.centre[bestAxis] - base)*scale)) < bestBin;
+    });
+    return (int)(split - items);
+}
+
+static void subdivide(BoundsItem* items, int imin, int imax, int trisPerChunk,
+                      std::vector<BuildNode>& nodes)
+{
+    const int icur = (int)nodes.size();
+    nodes.push_back(BuildNode());
+
+    BuildNode node;
+    calcExtends(items, imin, imax, node.bmin, node.bmax);
+
+    if (imax - imin <= trisPerChunk)
+    {
+        // Leaf
+        node.first = imin;
+        node.count = imax - imin;
+    }
+    else
+    {
+        // Split
+        const int isplit = splitItems(items, imin, imax, node.bmin, node.bmax);
+
+        // Left
+        subdivide(items, imin, isplit, trisPerChunk, nodes);
+        // Right
+        subdivide(items, isplit, imax, trisPerChunk, nodes);
+
+        // Negative index means escape.
+        node.first = -((int)nodes.size() - icur);
+        node.count = 0;
+    }
+
+    nodes[icur] = node;
+}
+
+// Splits the top of the tree until each range fits in a job, and returns the index of its top node.
+static int subdivideTop(BoundsItem* items, int imin, int imax, int trisPerChunk,
+                        std::vector<TopNode>& top, std::vector<SubtreeJob>& jobs)
+{
+    const int icur = (int)top.size();
+    top.push_back(TopNode());
+
+    TopNode node;
+    calcExtends(items, imin, imax, node.bmin, node.bmax);
+    node.left = node.right = node.job = -1;
+
+    if (imax - imin <= rcMax(SUBTREE_JOB_TRIS, trisPerChunk))
+    {
+        node.job = (int)jobs.size();
+        jobs.push_back(SubtreeJob());
+        jobs.back().imin = imin;
+        jobs.back().imax = imax;
+    }
+    else
+    {
+        const int isplit = splitItems(items, imin, imax, node.bmin, node.bmax);
+        node.left = subdivideTop(items, imin, isplit, trisPerChunk, top, jobs);
+        node.right = subdivideTop(items, isplit, imax, trisPerChunk, top, jobs);
+    }
+
+    top[icur] = node;
+    return icur;
+}
+
+// Appends the nodes below a top node depth first, with the subtrees of the jobs in their place.
+static void appendTop(const std::vector<TopNode>& top, int itop, const std::vector<SubtreeJob>& jobs,
+                      std::vector<BuildNode>& nodes)
+{
+    const TopNode& node = top[itop];
+    if (node.job >= 0)
+    {
+        // Escapes are relative, so the subtree can be copied as is
+        nodes.insert(nodes.end(), jobs[node.job].nodes.begin(), jobs[node.job].nodes.end());
+        return;
+    }
+
+    const int icur = (int)nodes.size();
+    nodes.push_back(BuildNode());
+    appendTop(top, node.left, jobs, nodes);
+    appendTop(top, node.right, jobs, nodes);
+
+    BuildNode& split = nodes[icur];
+    split.bmin[0] = node.bmin[0];
+    split.bmin[1] = node.bmin[1];
+    split.bmax[0] = node.bmax[0];
+    split.bmax[1] = node.bmax[1];
+    split.first = -((int)nodes.size() - icur);
+    split.count = 0;
+}
+
+void rcAllocChunkyTriMeshNodes(rcChunkyTriMesh* cm, int nnodes)
+{
+    cm->nnodes = nnodes;
+    cm->minX = new float[nnodes*4];
+    cm->minZ = cm->minX + nnodes;
+    cm->maxX = cm->minZ + nnodes;
+    cm->maxZ = cm->maxX + nnodes;
+    cm->first = new int[nnodes*2];
+    cm->count = cm->first + nnodes;
+}
+
+bool rcCreateChunkyTriMesh(const float* verts, const int* tris, int ntris,
+                           int trisPerChunk, rcChunkyTriMesh* cm)
+{
+    cm->ntris = ntris;
+    cm->maxTrisPerChunk = 0;
+    if (ntris <= 0 || trisPerChunk <= 0)
+        return ntris == 0;
+
+    WorkerPool workers(std::max(std::thread::hardware_concurrency(), 1U));
+
+    // Calc triangle XZ bounds.
+    std::vector<BoundsItem> items(ntris);
+    workers.Run(ntris, 4096, [&items, verts, tris] (const int, const int begin, const int end)
+    {
+        for (int i = begin; i < end; ++i)
+        {
+            const int* t = &tris[i*3];
+            BoundsItem& it = items[i];
+            it.i = i;
+            it.bmin[0] = it.bmax[0] = verts[t[0]*3+0];
+            it.bmin[1] = it.bmax[1] = verts[t[0]*3+2];
+            for (int j = 1; j < 3; ++j)
+            {
+                const float* v = &verts[t[j]*3];
+                if (v[0] < it.bmin[0]) it.bmin[0] = v[0];
+                if (v[2] < it.bmin[1]) it.bmin[1] = v[2];
+
+                if (v[0] > it.bmax[0]) it.bmax[0] = v[0];
+                if (v[2] > it.bmax[1]) it.bmax[1] = v[2];
+            }
+            it.centre[0] = (it.bmin[0] + it.bmax[0])*0.5f;
+            it.centre[1] = (it.bmin[1] + it.bmax[1])*0.5f;
+        }
+    });
+
+    // Build tree, the top on this thread and the subtrees below it in parallel
+    std::vector<TopNode> top;
+    std::vector<SubtreeJob> jobs;
+    subdivideTop(items.data(), 0, ntris, trisPerChunk, top, jobs);
+
+    workers.Run((int)jobs.size(), 1, [&items, &jobs, trisPerChunk] (const int, const int begin, const int end)
+    {
+        for (int j = begin; j < end; ++j)
+            subdivide(items.data(), jobs[j].imin, jobs[j].imax, trisPerChunk, jobs[j].nodes);
+    });
+
+    std::vector<BuildNode> nodes;
+    appendTop(top, 0, jobs, nodes);
+    jobs.clear();
+
+    // Store the nodes as arrays, and the tris in the order of the leaves
+    rcAllocChunkyTriMeshNodes(cm, (int)nodes.size());
+    for (int i = 0; i < cm->nnodes; ++i)
+    {
+        const BuildNode& node = nodes[i];
+        cm->minX[i] = node.bmin[0];
+        cm->minZ[i] = node.bmin[1];
+        cm->maxX[i] = node.bmax[0];
+        cm->maxZ[i] = node.bmax[1];
+        cm->first[i] = node.first;
+        cm->count[i] = node.count;
+
+        // Calc max tris per node.
+        if (node.first >= 0 && node.count > cm->maxTrisPerChunk)
+            cm->maxTrisPerChunk = node.count;
+    }
+
+    cm->tris = new int[ntris*3];
+    int* outTris = cm->tris;
+    workers.Run(ntris, 4096, [&items, outTris, tris] (const int, const int begin, const int end)
+    {
+        for (int i = begin; i < end; ++i)
+        {
+            const int* src = &tris[items[i].i*3];
+            int* dst = &outTris[i*3];
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+        }
+    });
+
+    return true;
+}
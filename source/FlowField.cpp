@@ -0,0 +1,47 @@
+#include "FlowField.h"
+
+// Std
+#include <cfloat>
+
+FlowField::
+FlowField () :
+   Goal    ( Ogre::Vector3::ZERO ),
+   MaxCost ( FLT_MAX ),
+   HasGoal ( false )
+{
+}
+
+const Ogre::Vector3 &
+FlowField::
+GetGoal () const
+{
+   return Goal ;
+}
+
+bool
+FlowField::
+IsUpToDate () const
+{
+   return Field.isUpToDate () ;
+}
+
+bool
+FlowField::
+GetCost ( const dtPolyRef poly,
+          float           &cost ) const
+{
+   if ( dtStatusFailed ( Field.getCost ( poly, &cost ) ) )
+   {
+      return false ;
+   }
+
+   return cost < FLT_MAX ;
+}
+
+bool
+FlowField::
+GetNext ( const dtPolyRef poly,
+          dtPolyRef       &next ) const
+{
+   return dtStatusSucceed ( Field.getNext ( poly, &next ) ) ;
+}
@@ -35,33 +35,52 @@
 
 #include "InputGeom.h"
 #include "OgreRecast.h"
+#include "WorkerPool.h"
+#include "RecastAlloc.h"
 #include <OgreStreamSerialiser.h>
 #include <cstdio>
-
-InputGeom::InputGeom(std::vector<Ogre::Entity*> srcMeshes)
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include <cfloat>
+#include <climits>
+#include <limits>
+
+#if !defined(INPUTGEOM_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define INPUTGEOM_SSE
+#include <xmmintrin.h>
+#endif
+
+InputGeom::InputGeom(std::vector<Ogre::Entity*> srcMeshes, Ogre::TerrainGroup* terrainGroup)
     : mSrcMeshes(srcMeshes),
       nverts(0),
       ntris(0),
       mReferenceNode(0),
+      mTerrainGroup(terrainGroup),
       bmin(0),
       bmax(0),
       normals(0),
       verts(0),
       tris(0)
 {
-    if (srcMeshes.empty())
+    if (srcMeshes.empty() && !terrainGroup)
         return;
 
-    // Convert Ogre::Entity source meshes to a format that recast understands
-
-    //set the reference node
-    Ogre::Entity* ent = srcMeshes[0];
-    mReferenceNode = ent->getParentSceneNode()->getCreator()->getRootSceneNode();
-
     // Set the area where the navigation mesh will be build.
-    // Using bounding box of source mesh and specified cell size
+    // Using bounding box of source mesh and terrain
+    if (!srcMeshes.empty())
+    {
+        //set the reference node
+        Ogre::Entity* ent = srcMeshes[0];
+        mReferenceNode = ent->getParentSceneNode()->getCreator()->getRootSceneNode();
+    }
     calculateExtents();
 
+    // Convert Ogre::Entity source meshes to a format that recast understands
+    // Terrain is left out, it is rasterized per tile
+    if (srcMeshes.empty())
+        return;
+
     // Convert ogre geometry (vertices, triangles and normals)
     convertOgreEntities();
 
@@ -69,6 +88,19 @@ InputGeom::InputGeom(std::vector<Ogre::Entity*> srcMeshes)
     buildChunkyTriMesh();
 }
 
+InputGeom::InputGeom()
+    : nverts(0),
+      ntris(0),
+      mReferenceNode(0),
+      mTerrainGroup(0),
+      bmin(0),
+      bmax(0),
+      normals(0),
+      verts(0),
+      tris(0)
+{
+}
+
 void InputGeom::buildChunkyTriMesh()
 {
     m_chunkyMesh = std::make_unique <rcChunkyTriMesh> () ;
@@ -100,75 +132,321 @@ InputGeom::~InputGeom()
         delete[] bmax;
 }
 
-void InputGeom::convertOgreEntities()
+// Vertices and indices are copied by the workers in blocks of at most this many, so that one
+// large mesh does not leave the other workers idle.
+static const size_t EXTRACT_BLOCK_SIZE = 16384;
+
+// A range of vertex positions to copy from a locked buffer into the local geometry of a mesh.
+struct VertexBlock
 {
-    //Convert all vertices and triangles to recast format
-    const int numNodes = mSrcMeshes.size();
-    size_t *meshVertexCount = new size_t[numNodes];
-    size_t *meshIndexCount = new size_t[numNodes];
-    Ogre::Vector3 **meshVertices = new Ogre::Vector3*[numNodes];
-    unsigned long **meshIndices = new unsigned long*[numNodes];
+    const unsigned char* source; // Position of the first vertex in the locked buffer
+    size_t stride;
+    size_t count;
+    size_t mesh;
+    size_t destVertex;
+};
 
-    nverts = 0;
-    ntris = 0;
-    size_t i = 0;
-    for(std::vector<Ogre::Entity*>::iterator iter = mSrcMeshes.begin(); iter != mSrcMeshes.end(); iter++) {
-        getMeshInformation((*iter)->getMesh(), meshVertexCount[i], meshVertices[i], meshIndexCount[i], meshIndices[i]);
-        //total number of verts
-        nverts += meshVertexCount[i];
-        //total number of indices
-        ntris += meshIndexCount[i];
+// A range of submesh indices to copy into the local geometry of a mesh.
+struct IndexBlock
+{
+    const unsigned char* source; // First index in the locked buffer
+    bool is32Bit;
+    size_t count;
+    size_t mesh;
+    int baseVertex;
+    size_t destIndex;
+};
+
+// The geometry of one Ogre mesh in its own space, read from its buffers once and shared by all
+// entities that use the mesh.
+struct MeshGeometry
+{
+    std::vector<float> verts;
+    std::vector<int> tris;
+};
+
+// A range of the vertices and indices of one entity to place into verts and tris.
+struct InstanceBlock
+{
+    size_t entity;
+    size_t firstVertex;
+    size_t vertexCount;
+    size_t firstIndex;
+    size_t indexCount;
+};
 
-        i++;
+// Transforms count positions from source into dest, both x, y, z per vertex. Scene node
+// transforms are affine, so the projective row of the matrix is left out.
+static void transformPositions(const Ogre::Matrix4& m, const float* source, float* dest, size_t count)
+{
+    size_t i = 0;
+#ifdef INPUTGEOM_SSE
+    // Four vertices at a time: the 12 floats are shuffled into x, y and z vectors, transformed
+    // and shuffled back.
+    const __m128 m00 = _mm_set1_ps(m[0][0]), m01 = _mm_set1_ps(m[0][1]), m02 = _mm_set1_ps(m[0][2]), m03 = _mm_set1_ps(m[0][3]);
+    const __m128 m10 = _mm_set1_ps(m[1][0]), m11 = _mm_set1_ps(m[1][1]), m12 = _mm_set1_ps(m[1][2]), m13 = _mm_set1_ps(m[1][3]);
+    const __m128 m20 = _mm_set1_ps(m[2][0]), m21 = _mm_set1_ps(m[2][1]), m22 = _mm_set1_ps(m[2][2]), m23 = _mm_set1_ps(m[2][3]);
+    for (; i + 4 <= count; i += 4, source += 12, dest += 12)
+    {
+        const __m128 a0 = _mm_loadu_ps(source);     // x0 y0 z0 x1
+        const __m128 a1 = _mm_loadu_ps(source + 4); // y1 z1 x2 y2
+        const __m128 a2 = _mm_loadu_ps(source + 8); // z2 x3 y3 z3
+
+        const __m128 x = _mm_shuffle_ps(a0, _mm_shuffle_ps(a1, a2, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+        const __m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a0, a1, _MM_SHUFFLE(0, 0, 1, 1)),
+                                        _mm_shuffle_ps(a1, a2, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a0, a1, _MM_SHUFFLE(1, 1, 2, 2)),
+                                        _mm_shuffle_ps(a2, a2, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+
+        const __m128 tx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, x), _mm_mul_ps(m01, y)), _mm_add_ps(_mm_mul_ps(m02, z), m03));
+        const __m128 ty = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, x), _mm_mul_ps(m11, y)), _mm_add_ps(_mm_mul_ps(m12, z), m13));
+        const __m128 tz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m20, x), _mm_mul_ps(m21, y)), _mm_add_ps(_mm_mul_ps(m22, z), m23));
+
+        _mm_storeu_ps(dest, _mm_shuffle_ps(_mm_shuffle_ps(tx, ty, _MM_SHUFFLE(0, 0, 0, 0)),
+                                           _mm_shuffle_ps(tz, tx, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(dest + 4, _mm_shuffle_ps(_mm_shuffle_ps(ty, tz, _MM_SHUFFLE(1, 1, 1, 1)),
+                                               _mm_shuffle_ps(tx, ty, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(dest + 8, _mm_shuffle_ps(_mm_shuffle_ps(tz, tx, _MM_SHUFFLE(3, 3, 2, 2)),
+                                               _mm_shuffle_ps(ty, tz, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+    }
+#endif
+    // Summed in the same order as above, so that every vertex comes out the same either way.
+    for (; i < count; ++i, source += 3, dest += 3)
+    {
+        const float x = source[0], y = source[1], z = source[2];
+        dest[0] = (float(m[0][0])*x + float(m[0][1])*y) + (float(m[0][2])*z + float(m[0][3]));
+        dest[1] = (float(m[1][0])*x + float(m[1][1])*y) + (float(m[1][2])*z + float(m[1][3]));
+        dest[2] = (float(m[2][0])*x + float(m[2][1])*y) + (float(m[2][2])*z + float(m[2][3]));
     }
+}
 
-    // DECLARE RECAST DATA BUFFERS USING THE INFO WE GRABBED ABOVE
-    verts = new float[nverts*3];// *3 as verts holds x,y,&z for each verts in the array
-    tris = new int[ntris];// tris in recast is really indices like ogre
-
-    //convert index count into tri count
-    ntris = ntris/3; //although the tris array are indices the ntris is actual number of triangles, eg. indices/3;
-
-    //copy all meshes verticies into single buffer and transform to world space relative to parentNode
-    int vertsIndex = 0;
-    int prevVerticiesCount = 0;
-    int prevIndexCountTotal = 0;
-    i = 0;
-    for (std::vector<Ogre::Entity*>::iterator iter = mSrcMeshes.begin(); iter != mSrcMeshes.end(); iter++) {
-        Ogre::Entity *ent = *iter;
+void InputGeom::convertOgreEntities()
+{
+    // Ogre is only called from this thread. Each distinct mesh is read from its locked buffers
+    // once into its own space, then the workers place a transformed copy for every entity.
+    const Ogre::Matrix4 referenceInverse = mReferenceNode->_getFullTransform().inverse();
+
+    std::vector<MeshGeometry> meshes;
+    std::unordered_map<const Ogre::Mesh*, size_t> meshIndices;
+    std::vector<size_t> entityMeshes;
+    std::vector<Ogre::Matrix4> transforms;
+    std::vector<VertexBlock> vertexBlocks;
+    std::vector<IndexBlock> indexBlocks;
+
+    // Buffers shared by several meshes are only locked once.
+    std::vector<std::pair<Ogre::HardwareBuffer*, const unsigned char*> > lockedBuffers;
+    auto lockBuffer = [&lockedBuffers] (Ogre::HardwareBuffer* buffer)
+    {
+        for (const auto& locked : lockedBuffers)
+        {
+            if (locked.first == buffer)
+                return locked.second;
+        }
+        const unsigned char* data = static_cast<const unsigned char*>(buffer->lock(Ogre::HardwareBuffer::HBL_READ_ONLY));
+        lockedBuffers.push_back(std::make_pair(buffer, data));
+        return data;
+    };
+
+    entityMeshes.reserve(mSrcMeshes.size());
+    transforms.reserve(mSrcMeshes.size());
+    for (size_t e = 0; e < mSrcMeshes.size(); ++e)
+    {
+        Ogre::Entity* ent = mSrcMeshes[e];
+        const Ogre::MeshPtr& mesh = ent->getMesh();
         //find the transform between the reference node and this node
-        Ogre::Matrix4 transform = mReferenceNode->_getFullTransform().inverse() * ent->getParentSceneNode()->_getFullTransform();
-        Ogre::Vector3 vertexPos;
-        for (size_t j = 0 ; j < meshVertexCount[i] ; j++)
+        transforms.push_back(referenceInverse * ent->getParentSceneNode()->_getFullTransform());
+
+        auto found = meshIndices.find(mesh.get());
+        if (found != meshIndices.end())
+        {
+            entityMeshes.push_back(found->second);
+            continue;
+        }
+        const size_t m = meshes.size();
+        meshIndices[mesh.get()] = m;
+        entityMeshes.push_back(m);
+
+        // Count the vertices and indices of the mesh, which gives each submesh its offset in the mesh geometry.
+        size_t vertexTotal = 0;
+        size_t indexTotal = 0;
+
+        // We only need to add the shared vertices once
+        bool addedShared = false;
+        size_t sharedOffset = 0;
+        for (unsigned short i = 0; i < mesh->getNumSubMeshes(); ++i)
         {
-            vertexPos = transform*meshVertices[i][j];
-            verts[vertsIndex] = vertexPos.x;
-            verts[vertsIndex+1] = vertexPos.y;
-            verts[vertsIndex+2] = vertexPos.z;
-            vertsIndex+=3;
+            Ogre::SubMesh* submesh = mesh->getSubMesh(i);
+            Ogre::VertexData* vertexData = submesh->useSharedVertices ? mesh->sharedVertexData : submesh->vertexData;
+
+            size_t vertexOffset = vertexTotal;
+            if (submesh->useSharedVertices && addedShared)
+            {
+                vertexOffset = sharedOffset;
+            }
+            else
+            {
+                if (submesh->useSharedVertices)
+                {
+                    addedShared = true;
+                    sharedOffset = vertexTotal;
+                }
+
+                const Ogre::VertexElement* posElem =
+                        vertexData->vertexDeclaration->findElementBySemantic(Ogre::VES_POSITION);
+                Ogre::HardwareVertexBufferSharedPtr vbuf =
+                        vertexData->vertexBufferBinding->getBuffer(posElem->getSource());
+                const unsigned char* vertex = lockBuffer(vbuf.get()) + posElem->getOffset();
+
+                for (size_t j = 0; j < vertexData->vertexCount; j += EXTRACT_BLOCK_SIZE)
+                {
+                    VertexBlock block;
+                    block.source = vertex + j*vbuf->getVertexSize();
+                    block.stride = vbuf->getVertexSize();
+                    block.count = std::min(EXTRACT_BLOCK_SIZE, vertexData->vertexCount - j);
+                    block.mesh = m;
+                    block.destVertex = vertexTotal + j;
+                    vertexBlocks.push_back(block);
+                }
+                vertexTotal += vertexData->vertexCount;
+            }
+
+            Ogre::IndexData* indexData = submesh->indexData;
+            Ogre::HardwareIndexBufferSharedPtr ibuf = indexData->indexBuffer;
+            const size_t indexCount = (indexData->indexCount / 3) * 3;
+            if (!ibuf || indexCount == 0)
+                continue;
+
+            const unsigned char* index = lockBuffer(ibuf.get()) + indexData->indexStart*ibuf->getIndexSize();
+
+            for (size_t j = 0; j < indexCount; j += EXTRACT_BLOCK_SIZE)
+            {
+                IndexBlock block;
+                block.source = index + j*ibuf->getIndexSize();
+                block.is32Bit = (ibuf->getType() == Ogre::HardwareIndexBuffer::IT_32BIT);
+                block.count = std::min(EXTRACT_BLOCK_SIZE, indexCount - j);
+                block.mesh = m;
+                block.baseVertex = static_cast<int>(vertexOffset);
+                block.destIndex = indexTotal + j;
+                indexBlocks.push_back(block);
+            }
+            indexTotal += indexCount;
         }
 
-        for (size_t j = 0 ; j < meshIndexCount[i] ; j++)
+        meshes.emplace_back();
+        meshes.back().verts.resize(vertexTotal*3);
+        meshes.back().tris.resize(indexTotal);
+    }
+
+    WorkerPool workers(std::max(std::thread::hardware_concurrency(), 1U));
+
+    //copy the vertices of each mesh into its geometry, still in the space of the mesh
+    workers.Run(static_cast<int>(vertexBlocks.size()), 1, [&meshes, &vertexBlocks] (const int, const int begin, const int end)
+    {
+        for (int b = begin; b < end; ++b)
         {
-            tris[prevIndexCountTotal+j] = meshIndices[i][j]+prevVerticiesCount;
+            const VertexBlock& block = vertexBlocks[b];
+            const unsigned char* vertex = block.source;
+            float* dest = &meshes[block.mesh].verts[block.destVertex*3];
+            for (size_t j = 0; j < block.count; ++j, vertex += block.stride, dest += 3)
+            {
+                // Positions are always floats, whatever Ogre::Real is.
+                const float* pReal = reinterpret_cast<const float*>(vertex);
+                dest[0] = pReal[0];
+                dest[1] = pReal[1];
+                dest[2] = pReal[2];
+            }
         }
-        prevIndexCountTotal += meshIndexCount[i];
-        prevVerticiesCount += meshVertexCount[i];
+    });
 
-        i++;
+    // Indices are read in the width of their buffer and offset to the first vertex of their submesh.
+    workers.Run(static_cast<int>(indexBlocks.size()), 1, [&meshes, &indexBlocks] (const int, const int begin, const int end)
+    {
+        for (int b = begin; b < end; ++b)
+        {
+            const IndexBlock& block = indexBlocks[b];
+            int* dest = &meshes[block.mesh].tris[block.destIndex];
+            if (block.is32Bit)
+            {
+                const uint32_t* source = reinterpret_cast<const uint32_t*>(block.source);
+                for (size_t k = 0; k < block.count; ++k)
+                    dest[k] = static_cast<int>(source[k]) + block.baseVertex;
+            }
+            else
+            {
+                const uint16_t* source = reinterpret_cast<const uint16_t*>(block.source);
+                for (size_t k = 0; k < block.count; ++k)
+                    dest[k] = static_cast<int>(source[k]) + block.baseVertex;
+            }
+        }
+    });
+
+    // All mesh data is now in the mesh geometry, the buffers are not needed any more.
+    for (const auto& locked : lockedBuffers)
+        locked.first->unlock();
+
+    // Give each entity its offset in verts and tris and split it into blocks.
+    std::vector<size_t> vertexOffsets(mSrcMeshes.size());
+    std::vector<size_t> indexOffsets(mSrcMeshes.size());
+    std::vector<InstanceBlock> instanceBlocks;
+    size_t vertexTotal = 0;
+    size_t indexTotal = 0;
+    for (size_t e = 0; e < mSrcMeshes.size(); ++e)
+    {
+        const MeshGeometry& mesh = meshes[entityMeshes[e]];
+        const size_t vertexCount = mesh.verts.size()/3;
+        const size_t indexCount = mesh.tris.size();
+        vertexOffsets[e] = vertexTotal;
+        indexOffsets[e] = indexTotal;
+        for (size_t j = 0; j < std::max(vertexCount, indexCount); j += EXTRACT_BLOCK_SIZE)
+        {
+            InstanceBlock block;
+            block.entity = e;
+            block.firstVertex = std::min(j, vertexCount);
+            block.vertexCount = std::min(vertexCount, j + EXTRACT_BLOCK_SIZE) - block.firstVertex;
+            block.firstIndex = std::min(j, indexCount);
+            block.indexCount = std::min(indexCount, j + EXTRACT_BLOCK_SIZE) - block.firstIndex;
+            instanceBlocks.push_back(block);
+        }
+        vertexTotal += vertexCount;
+        indexTotal += indexCount;
     }
 
-    //delete tempory arrays
-    //TODO These probably could member varibles, this would increase performance slightly
-    delete[] meshVertices;
-    delete[] meshIndices;
-    delete[] meshVertexCount;
-    delete[] meshIndexCount;
+    // DECLARE RECAST DATA BUFFERS USING THE INFO WE GRABBED ABOVE
+    nverts = static_cast<int>(vertexTotal);
+    ntris = static_cast<int>(indexTotal/3); //although the tris array are indices the ntris is actual number of triangles, eg. indices/3;
+    verts = new float[nverts*3];// *3 as verts holds x,y,&z for each verts in the array
+    tris = new int[ntris*3];// tris in recast is really indices like ogre
+
+    //transform the mesh geometry of every entity to world space relative to parentNode
+    workers.Run(static_cast<int>(instanceBlocks.size()), 1,
+                [this, &meshes, &entityMeshes, &transforms, &vertexOffsets, &indexOffsets, &instanceBlocks] (const int, const int begin, const int end)
+    {
+        for (int b = begin; b < end; ++b)
+        {
+            const InstanceBlock& block = instanceBlocks[b];
+            const MeshGeometry& mesh = meshes[entityMeshes[block.entity]];
+            const size_t vertexOffset = vertexOffsets[block.entity];
+
+            transformPositions(transforms[block.entity], &mesh.verts[block.firstVertex*3],
+                               &verts[(vertexOffset + block.firstVertex)*3], block.vertexCount);
+
+            const int* source = mesh.tris.data() + block.firstIndex;
+            int* dest = &tris[indexOffsets[block.entity] + block.firstIndex];
+            for (size_t k = 0; k < block.indexCount; ++k)
+                dest[k] = source[k] + static_cast<int>(vertexOffset);
+        }
+    });
+
+    calculateNormals();
+}
 
+void InputGeom::calculateNormals()
+{
     // calculate normals data for Recast - im not 100% sure where this is required
     // but it is used, Ogre handles its own Normal data for rendering, this is not related
     // to Ogre at all ( its also not correct lol )
     // TODO : fix this
+    delete[] normals;
     normals = new float[ntris*3];
     for (int i = 0; i < ntris*3; i += 3)
     {
@@ -197,41 +475,182 @@ void InputGeom::convertOgreEntities()
     }
 }
 
+void InputGeom::cleanGeometry(float weldDistance, float minTriangleWidth, float minY, float maxY)
+{
+    if (!verts || !tris)
+        return;
+
+    const int oldVerts = nverts;
+    const int oldTris = ntris;
+
+    // Weld each vertex to the first vertex within weldDistance of it. Vertices are hashed by the
+    // cell of a grid with weldDistance sized cells, so only the 27 cells around a vertex are searched.
+    const float cellSize = weldDistance > 0 ? weldDistance : 1.0f;
+    const float weldDistanceSqr = weldDistance > 0 ? weldDistance*weldDistance : 0;
+    auto cellKey = [] (int x, int y, int z)
+    {
+        return ((uint64_t)(uint32_t)x*73856093u) ^ ((uint64_t)(uint32_t)y*19349663u << 21) ^ ((uint64_t)(uint32_t)z*83492791u << 42);
+    };
+
+    std::unordered_map<uint64_t, int> cellFirst; // First welded vertex in each cell
+    std::vector<int> cellNext;                   // Next welded vertex in the same cell, or -1
+    std::vector<int> welded;                     // Index of each welded vertex in verts
+    std::vector<int> remap(nverts);
+    cellFirst.reserve(nverts);
+    for (int i = 0; i < nverts; ++i)
+    {
+        const float* v = &verts[i*3];
+        const int cx = (int)floorf(v[0]/cellSize);
+        const int cy = (int)floorf(v[1]/cellSize);
+        const int cz = (int)floorf(v[2]/cellSize);
+
+        int found = -1;
+        for (int dz = -1; dz <= 1 && found < 0; ++dz)
+        {
+            for (int dy = -1; dy <= 1 && found < 0; ++dy)
+            {
+                for (int dx = -1; dx <= 1 && found < 0; ++dx)
+                {
+                    auto cell = cellFirst.find(cellKey(cx+dx, cy+dy, cz+dz));
+                    for (int w = cell != cellFirst.end() ? cell->second : -1; w >= 0; w = cellNext[w])
+                    {
+                        if (rcVdistSqr(v, &verts[welded[w]*3]) <= weldDistanceSqr)
+                        {
+                            found = w;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (found < 0)
+        {
+            found = (int)welded.size();
+            const uint64_t key = cellKey(cx, cy, cz);
+            auto cell = cellFirst.find(key);
+            cellNext.push_back(cell != cellFirst.end() ? cell->second : -1);
+            cellFirst[key] = found;
+            welded.push_back(i);
+        }
+        remap[i] = found;
+    }
+
+    // Keep the triangles that still have three corners, are at least minTriangleWidth wide across
+    // their longest edge and are not fully outside [minY, maxY].
+    std::vector<int> keptTris;
+    keptTris.reserve(ntris*3);
+    int degenerate = 0;
+    int outside = 0;
+    for (int i = 0; i < ntris; ++i)
+    {
+        const int a = remap[tris[i*3]], b = remap[tris[i*3+1]], c = remap[tris[i*3+2]];
+        const float* va = &verts[welded[a]*3];
+        const float* vb = &verts[welded[b]*3];
+        const float* vc = &verts[welded[c]*3];
+
+        if (rcMax(rcMax(va[1], vb[1]), vc[1]) < minY || rcMin(rcMin(va[1], vb[1]), vc[1]) > maxY)
+        {
+            outside++;
+            continue;
+        }
+
+        float e0[3], e1[3], e2[3], n[3];
+        rcVsub(e0, vb, va);
+        rcVsub(e1, vc, va);
+        rcVsub(e2, vc, vb);
+        rcVcross(n, e0, e1);
+        const float longestSqr = rcMax(rcMax(rcVdot(e0, e0), rcVdot(e1, e1)), rcVdot(e2, e2));
+        // Twice the area over the longest edge is the height of the triangle on that edge
+        const float doubleArea = sqrtf(rcVdot(n, n));
+        if (a == b || b == c || a == c || doubleArea <= 0 ||
+            doubleArea < minTriangleWidth*sqrtf(longestSqr))
+        {
+            degenerate++;
+            continue;
+        }
+
+        keptTris.push_back(a);
+        keptTris.push_back(b);
+        keptTris.push_back(c);
+    }
+
+    // Keep the welded vertices that are still used, in their original order
+    std::vector<int> used(welded.size(), -1);
+    for (size_t i = 0; i < keptTris.size(); ++i)
+        used[keptTris[i]] = 1;
+    int usedCount = 0;
+    for (size_t w = 0; w < welded.size(); ++w)
+    {
+        if (used[w] >= 0)
+            used[w] = usedCount++;
+    }
+
+    float* newVerts = new float[usedCount*3];
+    for (size_t w = 0; w < welded.size(); ++w)
+    {
+        if (used[w] >= 0)
+            rcVcopy(&newVerts[used[w]*3], &verts[welded[w]*3]);
+    }
+    int* newTris = new int[keptTris.size()];
+    for (size_t i = 0; i < keptTris.size(); ++i)
+        newTris[i] = used[keptTris[i]];
+
+    delete[] verts;
+    delete[] tris;
+    verts = newVerts;
+    tris = newTris;
+    nverts = usedCount;
+    ntris = (int)keptTris.size()/3;
+
+    // Nothing outside the height range is rasterized any more
+    if (bmin && bmax)
+    {
+        bmin[1] = rcMax(bmin[1], minY);
+        bmax[1] = rcMin(bmax[1], maxY);
+    }
+
+    calculateNormals();
+    buildChunkyTriMesh();
+
+    Ogre::LogManager::getSingletonPtr()->logMessage("InputGeom::cleanGeometry: "+
+        Ogre::StringConverter::toString(oldVerts)+" -> "+Ogre::StringConverter::toString(nverts)+" vertices, "+
+        Ogre::StringConverter::toString(oldTris)+" -> "+Ogre::StringConverter::toString(ntris)+" triangles ("+
+        Ogre::StringConverter::toString(degenerate)+" degenerate, "+
+        Ogre::StringConverter::toString(outside)+" outside the height range).");
+}
+
 void InputGeom::calculateExtents()
 {
-    Ogre::Entity* ent = mSrcMeshes[0];
-    Ogre::AxisAlignedBox srcMeshBB = ent->getBoundingBox();
-    Ogre::Matrix4 transform = mReferenceNode->_getFullTransform().inverse() * ent->getParentSceneNode()->_getFullTransform();
-    srcMeshBB.transformAffine(transform);
-    Ogre::Vector3 min = srcMeshBB.getMinimum();
-    Ogre::Vector3 max = srcMeshBB.getMaximum();
+    Ogre::AxisAlignedBox bounds;
 
     // Calculate min and max from all entities
     for(std::vector<Ogre::Entity*>::iterator iter = mSrcMeshes.begin(); iter != mSrcMeshes.end(); iter++) {
         Ogre::Entity* ent = *iter;
 
         //find the transform between the reference node and this node
-        transform = mReferenceNode->_getFullTransform().inverse() * ent->getParentSceneNode()->_getFullTransform();
+        Ogre::Matrix4 transform = mReferenceNode->_getFullTransform().inverse() * ent->getParentSceneNode()->_getFullTransform();
 
         Ogre::AxisAlignedBox srcMeshBB = ent->getBoundingBox();
         srcMeshBB.transformAffine(transform);
-        Ogre::Vector3 min2 = srcMeshBB.getMinimum();
-        if(min2.x < min.x)
-            min.x = min2.x;
-        if(min2.y < min.y)
-            min.y = min2.y;
-        if(min2.z < min.z)
-            min.z = min2.z;
-
-        Ogre::Vector3 max2 = srcMeshBB.getMaximum();
-        if(max2.x > max.x)
-            max.x = max2.x;
-        if(max2.y > max.y)
-            max.y = max2.y;
-        if(max2.z > max.z)
-            max.z = max2.z;
+        bounds.merge(srcMeshBB);
+    }
+
+    // Terrain pages are placed in world space
+    if (mTerrainGroup)
+    {
+        Ogre::TerrainGroup::TerrainIterator ti = mTerrainGroup->getTerrainIterator();
+        while (ti.hasMoreElements())
+        {
+            Ogre::Terrain* terrain = ti.getNext()->instance;
+            if (terrain)
+                bounds.merge(terrain->getWorldAABB());
+        }
     }
 
+    Ogre::Vector3 min = bounds.isNull() ? Ogre::Vector3::ZERO : bounds.getMinimum();
+    Ogre::Vector3 max = bounds.isNull() ? Ogre::Vector3::ZERO : bounds.getMaximum();
+
     if(!bmin)
         bmin = new float[3];
     if(!bmax)
@@ -275,6 +694,451 @@ const float* InputGeom::getNormals() const
    return normals;
 }
 
+bool InputGeom::hasTerrain() const
+{
+    return mTerrainGroup != 0;
+}
+
+void InputGeom::rasterizeTerrain(rcContext* ctx, rcHeightfield& solid, float walkableSlopeAngle, int flagMergeThr) const
+{
+    if (!mTerrainGroup)
+        return;
+
+    const float walkableThr = cosf(walkableSlopeAngle/180.0f*RC_PI);
+    const float ics = 1.0f/solid.cs;
+    const float ich = 1.0f/solid.ch;
+    const float by = solid.bmax[1] - solid.bmin[1];
+
+    // Heights at the corners of the cells, each one sampled once for the up to four cells around it.
+    // Temporary like the other memory of a tile build, so that a tilecache can reuse it.
+    const float noHeight = -FLT_MAX;
+    const int cornersX = solid.width + 1;
+    const int cornersZ = solid.height + 1;
+    rcTempVector<float> heights(cornersX*cornersZ, noHeight);
+
+    Ogre::TerrainGroup::TerrainIterator ti = mTerrainGroup->getTerrainIterator();
+    while (ti.hasMoreElements())
+    {
+        Ogre::Terrain* terrain = ti.getNext()->instance;
+        if (!terrain)
+            continue;
+        if (terrain->getAlignment() != Ogre::Terrain::ALIGN_X_Z)
+        {
+            Ogre::LogManager::getSingletonPtr()->logMessage("rasterizeTerrain: Only terrain aligned to the X-Z plane is supported, skipping page.");
+            continue;
+        }
+
+        // The corners of solid that lie on this page
+        const Ogre::AxisAlignedBox bounds = terrain->getWorldAABB();
+        const int x0 = rcMax(0, (int)ceilf((bounds.getMinimum().x - solid.bmin[0])*ics));
+        const int x1 = rcMin(cornersX-1, (int)floorf((bounds.getMaximum().x - solid.bmin[0])*ics));
+        const int z0 = rcMax(0, (int)ceilf((bounds.getMinimum().z - solid.bmin[2])*ics));
+        const int z1 = rcMin(cornersZ-1, (int)floorf((bounds.getMaximum().z - solid.bmin[2])*ics));
+
+        for (int z = z0; z <= z1; ++z)
+        {
+            for (int x = x0; x <= x1; ++x)
+            {
+                float& height = heights[z*cornersX + x];
+                if (height == noHeight)
+                    height = terrain->getHeightAtWorldPosition(solid.bmin[0] + x*solid.cs, 0, solid.bmin[2] + z*solid.cs);
+            }
+        }
+    }
+
+    for (int z = 0; z < solid.height; ++z)
+    {
+        for (int x = 0; x < solid.width; ++x)
+        {
+            const float h00 = heights[z*cornersX + x];
+            const float h10 = heights[z*cornersX + x+1];
+            const float h01 = heights[(z+1)*cornersX + x];
+            const float h11 = heights[(z+1)*cornersX + x+1];
+            if (h00 == noHeight || h10 == noHeight || h01 == noHeight || h11 == noHeight)
+                continue;
+
+            // Clip the span to the heightfield, as rcRasterizeTriangles does
+            float smin = rcMin(rcMin(h00, h10), rcMin(h01, h11)) - solid.bmin[1];
+            float smax = rcMax(rcMax(h00, h10), rcMax(h01, h11)) - solid.bmin[1];
+            if (smax < 0.0f || smin > by)
+                continue;
+            if (smin < 0.0f) smin = 0;
+            if (smax > by) smax = by;
+
+            // The y of the normal of the plane through the mean height differences across the cell,
+            // compared like the triangle normals of rcMarkWalkableTriangles
+            const float dx = ((h10 - h00) + (h11 - h01))*0.5f*ics;
+            const float dz = ((h01 - h00) + (h11 - h10))*0.5f*ics;
+            const float ny = 1.0f/sqrtf(dx*dx + dz*dz + 1.0f);
+            const unsigned char area = ny > walkableThr ? RC_WALKABLE_AREA : RC_NULL_AREA;
+
+            const unsigned short ismin = (unsigned short)rcClamp((int)floorf(smin*ich), 0, RC_SPAN_MAX_HEIGHT);
+            const unsigned short ismax = (unsigned short)rcClamp((int)ceilf(smax*ich), (int)ismin+1, RC_SPAN_MAX_HEIGHT);
+            if (!rcAddSpan(ctx, solid, x, z, ismin, ismax, area, flagMergeThr))
+            {
+                Ogre::LogManager::getSingletonPtr()->logMessage("rasterizeTerrain: Out of memory.");
+                return;
+            }
+        }
+    }
+}
+
+// Magic and version of the files written by InputGeom::saveGeometry.
+static const int INPUTGEOM_MAGIC = 'I'<<24 | 'G'<<16 | 'E'<<8 | 'O'; //'IGEO';
+static const int INPUTGEOM_VERSION = 2;
+
+// Header of a geometry file. Each array follows at its offset from the start of the file,
+// aligned to 16 bytes.
+struct InputGeomFileHeader
+{
+    int magic;
+    int version;
+    uint64_t contentHash;
+    float bmin[3];
+    float bmax[3];
+    int nverts;
+    int ntris;
+    int nnodes; // 0 if there is no chunky tri mesh
+    int maxTrisPerChunk;
+    uint64_t vertsOffset;      // float[nverts*3]
+    uint64_t trisOffset;       // int[ntris*3]
+    uint64_t normalsOffset;    // float[ntris*3]
+    uint64_t nodeBoundsOffset; // float[nnodes*4], minX, minZ, maxX and maxZ of each node
+    uint64_t nodeTrisOffset;   // int[nnodes*2], first and count of each node
+    uint64_t chunkyTrisOffset; // int[ntris*3]
+};
+
+// File positions are kept in 64 bits, long is only 32 bits on Windows.
+static bool seekTo(FILE* fp, uint64_t offset, int origin = SEEK_SET)
+{
+#ifdef _WIN32
+    return offset <= (uint64_t)std::numeric_limits<__int64>::max() && _fseeki64(fp, (__int64)offset, origin) == 0;
+#else
+    return offset <= (uint64_t)std::numeric_limits<off_t>::max() && fseeko(fp, (off_t)offset, origin) == 0;
+#endif
+}
+
+static int64_t tellPos(FILE* fp)
+{
+#ifdef _WIN32
+    return _ftelli64(fp);
+#else
+    return ftello(fp);
+#endif
+}
+
+// Writes size bytes of data at offset, padding the file with zeros from the current position.
+static bool writeAt(FILE* fp, uint64_t offset, const void* data, size_t size)
+{
+    static const char zeros[16] = {0};
+    const int64_t pos = tellPos(fp);
+    if (pos < 0 || (uint64_t)pos > offset || offset - pos > sizeof(zeros))
+        return false;
+    if (offset != (uint64_t)pos && fwrite(zeros, (size_t)(offset - pos), 1, fp) != 1)
+        return false;
+    return size == 0 || fwrite(data, size, 1, fp) == 1;
+}
+
+static bool readAt(FILE* fp, uint64_t offset, void* data, size_t size)
+{
+    return size == 0 || (seekTo(fp, offset) && fread(data, size, 1, fp) == 1);
+}
+
+// Checks that every index of count indices refers to one of nverts vertices.
+static bool validIndices(const int* indices, size_t count, int nverts)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (indices[i] < 0 || indices[i] >= nverts)
+            return false;
+    }
+    return true;
+}
+
+// Checks that leaf nodes only cover existing triangles and no more than maxTrisPerChunk of them,
+// and that escape indices stay inside the node array.
+static bool validChunkyNodes(const rcChunkyTriMesh* cm)
+{
+    for (int i = 0; i < cm->nnodes; ++i)
+    {
+        const int first = cm->first[i];
+        const int count = cm->count[i];
+        if (first >= 0)
+        {
+            if (count < 0 || count > cm->maxTrisPerChunk || (int64_t)first + count > cm->ntris)
+                return false;
+        }
+        else if (first < i - cm->nnodes)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t InputGeom::computeContentHash(const std::vector<Ogre::Entity*>& srcMeshes)
+{
+    // FNV-1a over the vertex positions and indices of each distinct mesh, and the mesh and
+    // world transform of each entity
+    uint64_t hash = 14695981039346656037ULL;
+    auto add = [&hash] (const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+    };
+
+    // Positions are always floats, whatever Ogre::Real is.
+    auto addPositions = [&add] (const Ogre::VertexData* vertexData)
+    {
+        const uint64_t vertexCount = vertexData->vertexCount;
+        add(&vertexCount, sizeof(vertexCount));
+        if (vertexCount == 0)
+            return;
+
+        const Ogre::VertexElement* posElem =
+                vertexData->vertexDeclaration->findElementBySemantic(Ogre::VES_POSITION);
+        Ogre::HardwareVertexBufferSharedPtr vbuf =
+                vertexData->vertexBufferBinding->getBuffer(posElem->getSource());
+        const unsigned char* vertex =
+                static_cast<const unsigned char*>(vbuf->lock(Ogre::HardwareBuffer::HBL_READ_ONLY)) + posElem->getOffset();
+        for (size_t j = 0; j < vertexCount; ++j, vertex += vbuf->getVertexSize())
+            add(vertex, 3*sizeof(float));
+        vbuf->unlock();
+    };
+
+    std::unordered_map<const Ogre::Mesh*, uint64_t> meshIndices;
+    for (size_t e = 0; e < srcMeshes.size(); ++e)
+    {
+        Ogre::Entity* ent = srcMeshes[e];
+        const Ogre::MeshPtr& mesh = ent->getMesh();
+
+        // The geometry of a mesh is hashed where its first entity is, later entities refer to it.
+        auto found = meshIndices.find(mesh.get());
+        if (found == meshIndices.end())
+        {
+            const uint64_t m = meshIndices.size();
+            meshIndices[mesh.get()] = m;
+            add(&m, sizeof(m));
+
+            if (mesh->sharedVertexData)
+                addPositions(mesh->sharedVertexData);
+
+            const unsigned short numSubMeshes = mesh->getNumSubMeshes();
+            add(&numSubMeshes, sizeof(numSubMeshes));
+            for (unsigned short i = 0; i < numSubMeshes; ++i)
+            {
+                Ogre::SubMesh* submesh = mesh->getSubMesh(i);
+                const unsigned char useShared = submesh->useSharedVertices ? 1 : 0;
+                add(&useShared, sizeof(useShared));
+                if (!submesh->useSharedVertices)
+                    addPositions(submesh->vertexData);
+
+                Ogre::IndexData* indexData = submesh->indexData;
+                Ogre::HardwareIndexBufferSharedPtr ibuf = indexData->indexBuffer;
+                const uint64_t indexCount = ibuf ? (indexData->indexCount / 3) * 3 : 0;
+                add(&indexCount, sizeof(indexCount));
+                if (indexCount == 0)
+                    continue;
+
+                const unsigned char* index =
+                        static_cast<const unsigned char*>(ibuf->lock(Ogre::HardwareBuffer::HBL_READ_ONLY)) + indexData->indexStart*ibuf->getIndexSize();
+                const uint64_t indexSize = ibuf->getIndexSize();
+                add(&indexSize, sizeof(indexSize));
+                add(index, indexCount*indexSize);
+                ibuf->unlock();
+            }
+        }
+        else
+        {
+            add(&found->second, sizeof(found->second));
+        }
+
+        const Ogre::Matrix4& transform = ent->getParentSceneNode()->_getFullTransform();
+        for (int r = 0; r < 3; ++r)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                const float value = static_cast<float>(transform[r][c]);
+                add(&value, sizeof(value));
+            }
+        }
+    }
+
+    // 0 is reserved for not checking the hash in loadGeometry
+    return hash ? hash : 1;
+}
+
+bool InputGeom::saveGeometry(const Ogre::String& filename, uint64_t contentHash) const
+{
+    if (!bmin || !bmax)
+    {
+        Ogre::LogManager::getSingletonPtr()->logMessage("Error: InputGeom::saveGeometry("+filename+"). No geometry to save.");
+        return false;
+    }
+
+    FILE* fp = fopen(filename.data(), "wb");
+    if (!fp)
+    {
+        Ogre::LogManager::getSingletonPtr()->logMessage("Error: InputGeom::saveGeometry("+filename+"). Could not save file.");
+        return false;
+    }
+
+    InputGeomFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = INPUTGEOM_MAGIC;
+    header.version = INPUTGEOM_VERSION;
+    header.contentHash = contentHash;
+    rcVcopy(header.bmin, bmin);
+    rcVcopy(header.bmax, bmax);
+    header.nverts = nverts;
+    header.ntris = ntris;
+    if (m_chunkyMesh)
+    {
+        header.nnodes = m_chunkyMesh->nnodes;
+        header.maxTrisPerChunk = m_chunkyMesh->maxTrisPerChunk;
+    }
+
+    // Lay out the arrays after the header
+    uint64_t offset = sizeof(header);
+    auto place = [&offset] (size_t size)
+    {
+        offset = (offset + 15) & ~(uint64_t)15;
+        const uint64_t start = offset;
+        offset += size;
+        return start;
+    };
+    const size_t vertsSize = (size_t)nverts*3*sizeof(float);
+    const size_t trisSize = (size_t)ntris*3*sizeof(int);
+    const size_t nodeBoundsSize = (size_t)header.nnodes*4*sizeof(float);
+    const size_t nodeTrisSize = (size_t)header.nnodes*2*sizeof(int);
+    header.vertsOffset = place(vertsSize);
+    header.trisOffset = place(trisSize);
+    header.normalsOffset = place(trisSize);
+    header.nodeBoundsOffset = place(nodeBoundsSize);
+    header.nodeTrisOffset = place(nodeTrisSize);
+    header.chunkyTrisOffset = place(header.nnodes ? trisSize : 0);
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok = ok && writeAt(fp, header.vertsOffset, verts, vertsSize);
+    ok = ok && writeAt(fp, header.trisOffset, tris, trisSize);
+    ok = ok && writeAt(fp, header.normalsOffset, normals, trisSize);
+    if (header.nnodes)
+    {
+        ok = ok && writeAt(fp, header.nodeBoundsOffset, m_chunkyMesh->minX, nodeBoundsSize);
+        ok = ok && writeAt(fp, header.nodeTrisOffset, m_chunkyMesh->first, nodeTrisSize);
+        ok = ok && writeAt(fp, header.chunkyTrisOffset, m_chunkyMesh->tris, trisSize);
+    }
+    fclose(fp);
+
+    if (!ok)
+        Ogre::LogManager::getSingletonPtr()->logMessage("Error: InputGeom::saveGeometry("+filename+"). Could not write file.");
+    return ok;
+}
+
+InputGeom* InputGeom::loadGeometry(const Ogre::String& filename, uint64_t contentHash, Ogre::TerrainGroup* terrainGroup)
+{
+    FILE* fp = fopen(filename.data(), "rb");
+    if (!fp)
+    {
+        Ogre::LogManager::getSingletonPtr()->logMessage("Error: InputGeom::loadGeometry("+filename+"). Could not open file.");
+        return 0;
+    }
+
+    InputGeomFileHeader header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 || header.magic != INPUTGEOM_MAGIC)
+    {
+        fclose(fp);
+        Ogre::LogManager::getSingletonPtr()->logMessage("Error: InputGeom::loadGeometry("+filename+"). File does not appear to contain valid geometry data.");
+        return 0;
+    }
+    if (header.version != INPUTGEOM_VERSION)
+    {
+        fclose(fp);
+        Ogre::LogManager::getSingletonPtr()->logMessage("Error: InputGeom::loadGeometry("+filename+"). File contains a different version of the geometry data format ("+Ogre::StringConverter::toString(header.version)+" instead of "+Ogre::StringConverter::toString(INPUTGEOM_VERSION)+").");
+        return 0;
+    }
+    if (contentHash && header.contentHash != contentHash)
+    {
+        fclose(fp);
+        Ogre::LogManager::getSingletonPtr()->logMessage("InputGeom::loadGeometry("+filename+"). File contains the geometry of a different scene, not loaded.");
+        return 0;
+    }
+
+    // Check the counts and the array ranges against the file before allocating anything.
+    // The counts are multiplied in int elsewhere, so they are limited to what fits.
+    const size_t vertsSize = (size_t)header.nverts*3*sizeof(float);
+    const size_t trisSize = (size_t)header.ntris*3*sizeof(int);
+    const size_t nodeBoundsSize = (size_t)header.nnodes*4*sizeof(float);
+    const size_t nodeTrisSize = (size_t)header.nnodes*2*sizeof(int);
+    const int64_t fileSize = seekTo(fp, 0, SEEK_END) ? tellPos(fp) : -1;
+    auto inFile = [fileSize] (uint64_t offset, uint64_t size)
+    {
+        return fileSize >= 0 && offset <= (uint64_t)fileSize && size <= (uint64_t)fileSize - offset;
+    };
+    if (header.nverts < 0 || header.nverts > INT_MAX/3 || header.ntris < 0 || header.ntris > INT_MAX/3 ||
+        header.nnodes < 0 || header.nnodes > INT_MAX/4 || header.maxTrisPerChunk < 0 ||
+        !inFile(header.vertsOffset, vertsSize) || !inFile(header.trisOffset, trisSize) ||
+        !inFile(header.normalsOffset, trisSize) ||
+        (header.nnodes && (!inFile(header.nodeBoundsOffset, nodeBoundsSize) ||
+                           !inFile(header.nodeTrisOffset, nodeTrisSize) ||
+                           !inFile(header.chunkyTrisOffset, trisSize))))
+    {
+        fclose(fp);
+        Ogre::LogManager::getSingletonPtr()->logMessage("Error: InputGeom::loadGeometry("+filename+"). File does not appear to contain valid geometry data.");
+        return 0;
+    }
+
+    InputGeom* geom = new InputGeom();
+    geom->mTerrainGroup = terrainGroup;
+    geom->bmin = new float[3];
+    geom->bmax = new float[3];
+    rcVcopy(geom->bmin, header.bmin);
+    rcVcopy(geom->bmax, header.bmax);
+    geom->nverts = header.nverts;
+    geom->ntris = header.ntris;
+    geom->verts = new float[(size_t)header.nverts*3];
+    geom->tris = new int[(size_t)header.ntris*3];
+    geom->normals = new float[(size_t)header.ntris*3];
+
+    bool ok = readAt(fp, header.vertsOffset, geom->verts, vertsSize);
+    ok = ok && readAt(fp, header.trisOffset, geom->tris, trisSize);
+    ok = ok && readAt(fp, header.normalsOffset, geom->normals, trisSize);
+    if (ok && header.nnodes)
+    {
+        geom->m_chunkyMesh = std::make_unique <rcChunkyTriMesh> ();
+        rcAllocChunkyTriMeshNodes(geom->m_chunkyMesh.get(), header.nnodes);
+        geom->m_chunkyMesh->tris = new int[(size_t)header.ntris*3];
+        geom->m_chunkyMesh->ntris = header.ntris;
+        geom->m_chunkyMesh->maxTrisPerChunk = header.maxTrisPerChunk;
+        ok = readAt(fp, header.nodeBoundsOffset, geom->m_chunkyMesh->minX, nodeBoundsSize);
+        ok = ok && readAt(fp, header.nodeTrisOffset, geom->m_chunkyMesh->first, nodeTrisSize);
+        ok = ok && readAt(fp, header.chunkyTrisOffset, geom->m_chunkyMesh->tris, trisSize);
+    }
+    fclose(fp);
+
+    if (!ok)
+    {
+        delete geom;
+        Ogre::LogManager::getSingletonPtr()->logMessage("Error: InputGeom::loadGeometry("+filename+"). Could not read file.");
+        return 0;
+    }
+
+    // Indices and node ranges are followed without checks when building tiles.
+    if (!validIndices(geom->tris, (size_t)header.ntris*3, header.nverts) ||
+        (geom->m_chunkyMesh && (!validChunkyNodes(geom->m_chunkyMesh.get()) ||
+                                !validIndices(geom->m_chunkyMesh->tris, (size_t)header.ntris*3, header.nverts))))
+    {
+        delete geom;
+        Ogre::LogManager::getSingletonPtr()->logMessage("Error: InputGeom::loadGeometry("+filename+"). File does not appear to contain valid geometry data.");
+        return 0;
+    }
+    return geom;
+}
+
 void InputGeom::getMeshInformation(const Ogre::MeshPtr mesh,
                                    size_t &vertex_count,
                                    Ogre::Vector3* &vertices,
@@ -496,228 +1360,3 @@ void InputGeom::getManualMeshInformation(const Ogre::ManualObject *manual,
     //All done.
     return;
 }
-
-// ChunkyTriMesh
-
-struct BoundsItem
-{
-    float bmin[2];
-    float bmax[2];
-    int i;
-};
-
-static int compareItemX(const void* va, const void* vb)
-{
-    const BoundsItem* a = (const BoundsItem*)va;
-    const BoundsItem* b = (const BoundsItem*)vb;
-    if (a->bmin[0] < b->bmin[0])
-        return -1;
-    if (a->bmin[0] > b->bmin[0])
-        return 1;
-    return 0;
-}
-
-static int compareItemY(const void* va, const void* vb)
-{
-    const BoundsItem* a = (const BoundsItem*)va;
-    const BoundsItem* b = (const BoundsItem*)vb;
-    if (a->bmin[1] < b->bmin[1])
-        return -1;
-    if (a->bmin[1] > b->bmin[1])
-        return 1;
-    return 0;
-}
-
-static void calcExtends(const BoundsItem* items, const int /*nitems*/,
-                        const int imin, const int imax,
-                        float* bmin, float* bmax)
-{
-    bmin[0] = items[imin].bmin[0];
-    bmin[1] = items[imin].bmin[1];
-
-    bmax[0] = items[imin].bmax[0];
-    bmax[1] = items[imin].bmax[1];
-
-    for (int i = imin+1; i < imax; ++i)
-    {
-        const BoundsItem& it = items[i];
-        if (it.bmin[0] < bmin[0]) bmin[0] = it.bmin[0];
-        if (it.bmin[1] < bmin[1]) bmin[1] = it.bmin[1];
-
-        if (it.bmax[0] > bmax[0]) bmax[0] = it.bmax[0];
-        if (it.bmax[1] > bmax[1]) bmax[1] = it.bmax[1];
-    }
-}
-
-inline int longestAxis(float x, float y)
-{
-    return y > x ? 1 : 0;
-}
-
-static void subdivide(BoundsItem* items, int nitems, int imin, int imax, int trisPerChunk,
-                      int& curNode, rcChunkyTriMeshNode* nodes, const int maxNodes,
-                      int& curTri, int* outTris, const int* inTris)
-{
-    int inum = imax - imin;
-    int icur = curNode;
-
-    if (curNode > maxNodes)
-        return;
-
-    rcChunkyTriMeshNode& node = nodes[curNode++];
-
-    if (inum <= trisPerChunk)
-    {
-        // Leaf
-        calcExtends(items, nitems, imin, imax, node.bmin, node.bmax);
-
-        // Copy triangles.
-        node.i = curTri;
-        node.n = inum;
-
-        for (int i = imin; i < imax; ++i)
-        {
-            const int* src = &inTris[items[i].i*3];
-            int* dst = &outTris[curTri*3];
-            curTri++;
-            dst[0] = src[0];
-            dst[1] = src[1];
-            dst[2] = src[2];
-        }
-    }
-    else
-    {
-        // Split
-        calcExtends(items, nitems, imin, imax, node.bmin, node.bmax);
-
-        int	axis = longestAxis(node.bmax[0] - node.bmin[0],
-                                   node.bmax[1] - node.bmin[1]);
-
-        if (axis == 0)
-        {
-            // Sort along x-axis
-            qsort(items+imin, inum, sizeof(BoundsItem), compareItemX);
-        }
-        else if (axis == 1)
-        {
-            // Sort along y-axis
-            qsort(items+imin, inum, sizeof(BoundsItem), compareItemY);
-        }
-
-        int isplit = imin+inum/2;
-
-        // Left
-        subdivide(items, nitems, imin, isplit, trisPerChunk, curNode, nodes, maxNodes, curTri, outTris, inTris);
-        // Right
-        subdivide(items, nitems, isplit, imax, trisPerChunk, curNode, nodes, maxNodes, curTri, outTris, inTris);
-
-        int iescape = curNode - icur;
-        // Negative index means escape.
-        node.i = -iescape;
-    }
-}
-
-bool rcCreateChunkyTriMesh(const float* verts, const int* tris, int ntris,
-                           int trisPerChunk, rcChunkyTriMesh* cm)
-{
-    int nchunks = (ntris + trisPerChunk-1) / trisPerChunk;
-
-    cm->nodes = new rcChunkyTriMeshNode[nchunks*4];
-    if (!cm->nodes)
-        return false;
-
-    cm->tris = new int[ntris*3];
-    if (!cm->tris)
-        return false;
-
-    cm->ntris = ntris;
-
-    // Build tree
-    BoundsItem* items = new BoundsItem[ntris];
-    if (!items)
-        return false;
-
-    for (int i = 0; i < ntris; i++)
-    {
-        const int* t = &tris[i*3];
-        BoundsItem& it = items[i];
-        it.i = i;
-        // Calc triangle XZ bounds.
-        it.bmin[0] = it.bmax[0] = verts[t[0]*3+0];
-        it.bmin[1] = it.bmax[1] = verts[t[0]*3+2];
-        for (int j = 1; j < 3; ++j)
-        {
-            const float* v = &verts[t[j]*3];
-            if (v[0] < it.bmin[0]) it.bmin[0] = v[0];
-            if (v[2] < it.bmin[1]) it.bmin[1] = v[2];
-
-            if (v[0] > it.bmax[0]) it.bmax[0] = v[0];
-            if (v[2] > it.bmax[1]) it.bmax[1] = v[2];
-        }
-    }
-
-    int curTri = 0;
-    int curNode = 0;
-    subdivide(items, ntris, 0, ntris, trisPerChunk, curNode, cm->nodes, nchunks*4, curTri, cm->tris, tris);
-
-    delete [] items;
-
-    cm->nnodes = curNode;
-
-    // Calc max tris per node.
-    cm->maxTrisPerChunk = 0;
-    for (int i = 0; i < cm->nnodes; ++i)
-    {
-        rcChunkyTriMeshNode& node = cm->nodes[i];
-        const bool isLeaf = node.i >= 0;
-        if (!isLeaf) continue;
-        if (node.n > cm->maxTrisPerChunk)
-            cm->maxTrisPerChunk = node.n;
-    }
-
-    return true;
-}
-
-
-inline bool checkOverlapRect(const float amin[2], const float amax[2],
-                             const float bmin[2], const float bmax[2])
-{
-    bool overlap = true;
-    overlap = (amin[0] > bmax[0] || amax[0] < bmin[0]) ? false : overlap;
-    overlap = (amin[1] > bmax[1] || amax[1] < bmin[1]) ? false : overlap;
-    return overlap;
-}
-
-int rcGetChunksOverlappingRect(const rcChunkyTriMesh* cm,
-                               float bmin[2], float bmax[2],
-                               int* ids, const int maxIds)
-{
-    // Traverse tree
-    int i = 0;
-    int n = 0;
-    while (i < cm->nnodes)
-    {
-        const rcChunkyTriMeshNode* node = &cm->nodes[i];
-        const bool overlap = checkOverlapRect(bmin, bmax, node->bmin, node->bmax);
-        const bool isLeafNode = node->i >= 0;
-
-        if (isLeafNode && overlap)
-        {
-            if (n < maxIds)
-            {
-                ids[n] = i;
-                n++;
-            }
-        }
-
-        if (overlap || isLeafNode)
-            i++;
-        else
-        {
-            const int escapeIndex = -node->i;
-            i += escapeIndex;
-        }
-    }
-
-    return n;
-}
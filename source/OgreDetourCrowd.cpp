@@ -0,0 +1,212 @@
+#include "OgreDetourCrowd.h"
+
+// Std
+#include <algorithm>
+#include <cstring>
+
+// The number of units a worker takes at once. Small enough to balance units that search their
+// path against units that only walk, large enough to keep the workers on separate cache lines.
+static const int CHUNK_SIZE = 64 ;
+
+OgreDetourCrowd::
+OgreDetourCrowd ( dtNavMesh                   &nav_mesh,
+                  const PlayerFlagQueryFilter &base_filter,
+                  const float                 *poly_search_box,
+                  const int                   max_agents,
+                  const float                 max_agent_radius,
+                  const unsigned int          worker_count ) :
+   BaseFilter  ( base_filter ),
+   FilterCount ( 0 ),
+   Workers     ( worker_count )
+{
+   if ( ! Crowd.init ( max_agents, max_agent_radius, &nav_mesh, Workers.GetWorkerCount () ) )
+   {
+      Ogre::LogManager::getSingleton ().logMessage ( "Error: OgreDetourCrowd::OgreDetourCrowd(). Could not initialise the crowd." ) ;
+      return ;
+   }
+
+   Crowd.setQueryHalfExtents ( poly_search_box ) ;
+}
+
+int
+OgreDetourCrowd::
+AddAgent ( const Ogre::Vector3 &position,
+           const float         radius,
+           const float         height,
+           const float         max_speed,
+           const float         max_acceleration,
+           const unsigned int  include_flags,
+           const unsigned int  exclude_flags )
+{
+   const int filter = GetFilterIndex ( include_flags, exclude_flags ) ;
+
+   if ( filter < 0 )
+   {
+      Ogre::LogManager::getSingleton ().logMessage ( "Error: OgreDetourCrowd::AddAgent(). Too many different include and exclude flags." ) ;
+      return -1 ;
+   }
+
+   dtCrowdAgentParams params ;
+
+   memset ( &params, 0, sizeof ( params ) ) ;
+   params.radius                = radius ;
+   params.height                = height ;
+   params.maxAcceleration       = max_acceleration ;
+   params.maxSpeed              = max_speed ;
+   params.collisionQueryRange   = radius * 12.0f ;
+   params.pathOptimizationRange = radius * 30.0f ;
+   params.separationWeight      = 2.0f ;
+   params.updateFlags           = DT_CROWD_OBSTACLE_AVOIDANCE ;
+   params.queryFilterType       = static_cast <unsigned char> ( filter ) ;
+
+   float pos [ 3 ] = { position.x, position.y, position.z } ;
+
+   const int agent = Crowd.addAgent ( pos, &params ) ;
+
+   if ( ( agent >= 0 ) &&
+        ( Crowd.getAgentState ( agent ) != DT_CROWDAGENT_STATE_WALKING ) )
+   {
+      Crowd.removeAgent ( agent ) ; // not on the navmesh
+      return -1 ;
+   }
+
+   return agent ;
+}
+
+void
+OgreDetourCrowd::
+RemoveAgent ( const int agent )
+{
+   Crowd.removeAgent ( agent ) ;
+}
+
+bool
+OgreDetourCrowd::
+SetMoveTarget ( const int           agent,
+                const Ogre::Vector3 &target )
+{
+   dtPolyRef poly ;
+   float     nearest_point [ 3 ] ;
+
+   return FindNearestPoly ( agent, target, poly, nearest_point ) &&
+          Crowd.requestMoveTarget ( agent, poly, nearest_point ) ;
+}
+
+bool
+OgreDetourCrowd::
+AdjustMoveTarget ( const int           agent,
+                   const Ogre::Vector3 &target )
+{
+   dtPolyRef poly ;
+   float     nearest_point [ 3 ] ;
+
+   return FindNearestPoly ( agent, target, poly, nearest_point ) &&
+          Crowd.adjustMoveTarget ( agent, poly, nearest_point ) ;
+}
+
+bool
+OgreDetourCrowd::
+ResetMoveTarget ( const int agent )
+{
+   return Crowd.isAgentActive ( agent ) &&
+          Crowd.resetMoveTarget ( agent ) ;
+}
+
+Ogre::Vector3
+OgreDetourCrowd::
+GetAgentPosition ( const int agent ) const
+{
+   const float *pos = Crowd.getAgentPosition ( agent ) ;
+
+   return Ogre::Vector3 ( pos [ 0 ], pos [ 1 ], pos [ 2 ] ) ;
+}
+
+Ogre::Vector3
+OgreDetourCrowd::
+GetAgentVelocity ( const int agent ) const
+{
+   const float *vel = Crowd.getAgentVelocity ( agent ) ;
+
+   return Ogre::Vector3 ( vel [ 0 ], vel [ 1 ], vel [ 2 ] ) ;
+}
+
+bool
+OgreDetourCrowd::
+HasPathToTarget ( const int agent ) const
+{
+   return Crowd.isAgentActive ( agent ) &&
+          ( Crowd.getAgentTargetState ( agent ) == DT_CROWDAGENT_TARGET_VALID ) ;
+}
+
+void
+OgreDetourCrowd::
+Update ( const float delta_time )
+{
+   if ( Crowd.getAgentCount () == 0 )
+   {
+      return ; // the crowd failed to initialise
+   }
+
+   const int active_count = Crowd.beginUpdate ( delta_time ) ;
+
+   // Each step reads what the workers wrote in the one before, so the steps run one after another.
+   for ( int phase = 0 ; phase < DT_CROWD_PHASE_COUNT ; ++phase )
+   {
+      Workers.Run ( active_count, CHUNK_SIZE, [ this, phase ] ( const int worker, const int begin, const int end )
+      {
+         Crowd.updatePhase ( phase, begin, end, worker ) ;
+      } ) ;
+   }
+}
+
+int
+OgreDetourCrowd::
+GetFilterIndex ( const unsigned int include_flags,
+                 const unsigned int exclude_flags )
+{
+   for ( int i = 0 ; i < FilterCount ; ++i )
+   {
+      if ( ( Filters [ i ].getIncludeFlags () == include_flags ) &&
+           ( Filters [ i ].getExcludeFlags () == exclude_flags ) )
+      {
+         return i ;
+      }
+   }
+
+   if ( FilterCount == DT_CROWD_MAX_QUERY_FILTER_TYPE )
+   {
+      return -1 ;
+   }
+
+   // The filters keep the area costs and cost overlay of the OgreRecast filter.
+   PlayerFlagQueryFilter &filter = Filters [ FilterCount ] ;
+
+   filter = BaseFilter ;
+   filter.setIncludeFlags ( include_flags ) ;
+   filter.setExcludeFlags ( exclude_flags ) ;
+
+   Crowd.setFilter ( FilterCount, &filter ) ;
+
+   return FilterCount++ ;
+}
+
+bool
+OgreDetourCrowd::
+FindNearestPoly ( const int           agent,
+                  const Ogre::Vector3 &position,
+                  dtPolyRef           &poly,
+                  float               *nearest_point ) const
+{
+   if ( ! Crowd.isAgentActive ( agent ) )
+   {
+      return false ;
+   }
+
+   const float          pos [ 3 ] = { position.x, position.y, position.z } ;
+   const dtQueryFilter *filter     = Crowd.getFilter ( Crowd.getAgentParams ( agent )->queryFilterType ) ;
+
+   const dtStatus status = Crowd.getNavMeshQuery ()->findNearestPoly ( pos, Crowd.getQueryHalfExtents (), filter, &poly, nearest_point ) ;
+
+   return dtStatusSucceed ( status ) &&
+          ( poly != 0 ) ;
+}
@@ -35,12 +35,16 @@
 
 #include "OgreDetourTileCache.h"
 #include "NavMeshDebug.h"
+#include "OgreDetourCrowd.h"
 #include "DetourTileCache.h"
 #include "OgreRecast.h"
 
 // Boost
 #include <boost/algorithm/clamp.hpp>
 
+// Std
+#include <algorithm>
+
 // Max number of layers a tile can have
 const int   EXPECTED_LAYERS_PER_TILE = 1 ;
 
@@ -50,6 +54,12 @@ const float BORDER_PADDING = 3 ;
 const int TILECACHESET_MAGIC   = 'T'<<24 | 'S'<<16 | 'E'<<8 | 'T' ; //'TSET';
 const int TILECACHESET_VERSION = 2 ;
 
+const int LANDMARKSET_MAGIC   = 'L'<<24 | 'S'<<16 | 'E'<<8 | 'T' ; //'LSET';
+const int LANDMARKSET_VERSION = 1 ;
+
+// Landmarks are stored in a file next to the tilecache, as they are optional.
+const char * const LANDMARKSET_EXTENSION = ".landmarks" ;
+
 OgreDetourTileCache::
 OgreDetourTileCache ( OgreRecast         &recast,
                       rcContext          &context,
@@ -66,9 +76,11 @@ OgreDetourTileCache ( OgreRecast         &recast,
    m_cellSize            ( 0 ),
    m_tcomp               ( nullptr ),
    InputGeometry         ( nullptr ),
+   NextStaticGeometryId  ( 1 ),
    m_th                  ( 0 ),
    m_tw                  ( 0 ),
    m_volumeCount         ( 0 ),
+   TrackChanges          ( false ),
    m_ctx                 ( context ),
    m_cfg                 ( config ),
    NavQuery              ( nav_query )
@@ -100,12 +112,39 @@ CreateDebugger ()
    return new NavMeshDebug ( *m_tileCache, *m_navMesh, NavQuery ) ;
 }
 
+OgreDetourCrowd *
+OgreDetourTileCache::
+CreateCrowd ( const PlayerFlagQueryFilter &filter,
+              const float                 *poly_search_box,
+              const int                   max_agents,
+              const float                 max_agent_radius,
+              const unsigned int          worker_count )
+{
+   return new OgreDetourCrowd ( *m_navMesh, filter, poly_search_box, max_agents, max_agent_radius, worker_count ) ;
+}
+
+bool
+OgreDetourTileCache::
+TileCacheBuild ( std::vector<Ogre::Entity*>                srcMeshes,
+                 const TerrainAreaVector                   &area_list,
+                 const std::vector <OgreDetourTileCache*> &agent_caches,
+                 Ogre::TerrainGroup                        *terrain )
+{
+   return TileCacheBuild ( std::make_unique <InputGeom> ( std::move ( srcMeshes ), terrain ), area_list, agent_caches ) ;
+}
+
 bool
 OgreDetourTileCache::
-TileCacheBuild ( std::vector<Ogre::Entity*> srcMeshes,
-                 const TerrainAreaVector    &area_list )
+TileCacheBuild ( std::unique_ptr <InputGeom>               geometry,
+                 const TerrainAreaVector                   &area_list,
+                 const std::vector <OgreDetourTileCache*> &agent_caches )
 {
-   InputGeometry = new InputGeom ( std::move ( srcMeshes ) ) ;
+   delete InputGeometry ;
+   InputGeometry = geometry.release () ;
+
+   StaticGeometry.clear () ;
+   StaticGeometryTiles.clear () ;
+   AgentCaches = agent_caches ;
 
    // Setup the terrain area volumes before the tile cache is built.
    // This will cause all of the areas marked to have the area id specified by AreaId.
@@ -122,9 +161,21 @@ TileCacheBuild ( std::vector<Ogre::Entity*> srcMeshes,
    }
 
    // Init configuration for specified geometry
-   ConfigureTileCacheContext () ;
+   ConfigureTileCacheContext ( *InputGeometry ) ;
+
+   for ( auto *agent_cache : agent_caches )
+   {
+      if ( ! agent_cache->ConfigureTileCacheContext ( *InputGeometry ) )
+      {
+         return false ;
+      }
+   }
+
+   const int border_size = GetBorderSize () ;
 
-   dtStatus status ;
+   RasterizationContext &rc = TileContext ;
+
+   rcTempAllocScope temp_alloc_scope ( rc.tempAlloc ) ;
 
    // Preprocess tiles.
    // Prepares navmesh tiles in a 2D intermediary format that allows quick conversion to a 3D navmesh
@@ -132,24 +183,24 @@ TileCacheBuild ( std::vector<Ogre::Entity*> srcMeshes,
    {
       for ( int x = 0 ; x < m_tw ; ++x )
       {
-         TileCacheData tiles [ MAX_LAYERS ] ;
+         if ( ! RasterizeTile ( x, y, border_size, rc ) ) // This is where the tile is built
+         {
+            continue ;
+         }
 
-         memset ( tiles, 0, sizeof ( tiles ) ) ;
+         // Erosion and the convex volumes overwrite the areas of the compact heightfield, so they are restored for each agent cache.
+         if ( ! agent_caches.empty () )
+         {
+            rc.walkableAreas.assign ( rc.chf->areas, rc.chf->areas + rc.chf->spanCount ) ;
+         }
 
-         int ntiles = RasterizeTileLayers ( x, y, tiles, MAX_LAYERS ) ; // This is where the tile is built
+         AddTileLayers ( x, y, border_size, rc ) ;
 
-         for ( int i = 0 ; i < ntiles ; ++i )
+         for ( auto *agent_cache : agent_caches )
          {
-            TileCacheData *tile = &tiles [ i ] ;
-
-            status = m_tileCache->addTile ( tile->data, tile->dataSize, DT_COMPRESSEDTILE_FREE_DATA, 0 ) ; // Add compressed tiles to tileCache
+            memcpy ( rc.chf->areas, rc.walkableAreas.data (), rc.walkableAreas.size () ) ;
 
-            if ( dtStatusFailed ( status ) )
-            {
-               dtFree ( tile->data ) ;
-               tile->data = nullptr ;
-               continue ;
-            }
+            agent_cache->AddTileLayers ( x, y, border_size, rc ) ;
          }
       }
    }
@@ -162,6 +213,11 @@ TileCacheBuild ( std::vector<Ogre::Entity*> srcMeshes,
       for ( int x = 0 ; x < m_tw ; ++x )
       {
          m_tileCache->buildNavMeshTilesAt ( x, y, m_navMesh ) ; // This immediately builds the tile, without the need of a dtTileCache::update()
+
+         for ( auto *agent_cache : agent_caches )
+         {
+            agent_cache->m_tileCache->buildNavMeshTilesAt ( x, y, agent_cache->m_navMesh ) ;
+         }
       }
    }
 
@@ -220,6 +276,15 @@ SaveAll ( const Ogre::String &filename )
    }
 
    fclose(fp);
+
+   if ( ! LandmarkProfiles.empty () )
+   {
+      return SaveLandmarks ( filename + LANDMARKSET_EXTENSION ) ;
+   }
+
+   // Landmarks of an earlier save would otherwise be loaded by LoadAll
+   remove ( ( filename + LANDMARKSET_EXTENSION ).data () ) ;
+
    return true;
 }
 
@@ -250,6 +315,8 @@ LoadAll ( const Ogre::String         &filename,
            return false;
        }
 
+       IslandProfiles.clear () ; // Labels refer to the previous navmesh
+       FilterMaskProfiles.clear () ;
        m_navMesh = dtAllocNavMesh();
        if (!m_navMesh)
        {
@@ -264,6 +331,11 @@ LoadAll ( const Ogre::String         &filename,
            Ogre::LogManager::getSingletonPtr()->logMessage("Error: OgreDetourTileCache::loadAll("+filename+"). Could not init navmesh.");
            return false;
        }
+       if (!InitCostOverlay())
+       {
+           fclose(fp);
+           return false;
+       }
 
        m_tileCache = dtAllocTileCache();
        if (!m_tileCache)
@@ -355,6 +427,8 @@ LoadAll ( const Ogre::String         &filename,
          InputGeometry = new InputGeom ( std::move ( srcMeshes ) ) ;
        }
 
+       LoadLandmarks ( filename + LANDMARKSET_EXTENSION ) ;
+
        return true;
 }
 
@@ -373,9 +447,39 @@ HandleUpdate ( const float delta_time,
       return ;
    }
 
+   ProcessingObstacles.clear () ;
+   PlacedObstacles.clear () ;
+   Changes.Clear () ;
+
+   RebuildStaticGeometryTiles ( until_up_to_date ) ;
+
+   if ( TrackChanges ||
+        ! LandmarkProfiles.empty () ||
+        ! IslandProfiles.empty () ||
+        ! FilterMaskProfiles.empty () )
+   {
+      for ( int i = 0 ; i < m_tileCache->getObstacleCount () ; ++i )
+      {
+         const dtTileCacheObstacle *obstacle = m_tileCache->getObstacle ( i ) ;
+
+         if ( obstacle->state == DT_OBSTACLE_PROCESSING )
+         {
+            ProcessingObstacles.push_back ( i ) ;
+         }
+         else if ( TrackChanges && obstacle->state != DT_OBSTACLE_EMPTY )
+         {
+            // Removal changes the salt, so the reference must be taken before.
+            PlacedObstacles.emplace_back ( i, m_tileCache->getObstacleRef ( obstacle ) ) ;
+         }
+      }
+   }
+
+   dtCompressedTileRef rebuilt_tile = 0 ;
+
    if ( ! until_up_to_date )
    {
-      m_tileCache->update ( delta_time, m_navMesh ) ;
+      m_tileCache->update ( delta_time, m_navMesh, nullptr, &rebuilt_tile ) ;
+      RecordTileChange ( rebuilt_tile ) ;
    }
    else
    {
@@ -383,9 +487,22 @@ HandleUpdate ( const float delta_time,
 
       while ( ! up_to_date )
       {
-         m_tileCache->update ( delta_time, m_navMesh, &up_to_date ) ;
+         m_tileCache->update ( delta_time, m_navMesh, &up_to_date, &rebuilt_tile ) ;
+         RecordTileChange ( rebuilt_tile ) ;
       }
    }
+
+   RecordObstacleChanges () ;
+   InvalidateGateTiles () ;
+   UpdateFilterMasks () ;
+
+   if ( dtStatusFailed ( CostOverlay.update () ) )
+   {
+      Ogre::LogManager::getSingleton ().logMessage ( "Error: OgreDetourTileCache::HandleUpdate(). Could not paint the cost overlay." ) ;
+   }
+
+   UpdateIslands () ;
+   UpdateLandmarks ( until_up_to_date ) ;
 }
 
 dtObstacleRef
@@ -452,6 +569,60 @@ RemoveObstacle ( dtObstacleRef obstacleRef )
         return false;
 }
 
+int
+OgreDetourTileCache::
+AddStaticGeometry ( std::unique_ptr <InputGeom> geometry )
+{
+   if ( ! m_tileCache || ! InputGeometry )
+   {
+      Ogre::LogManager::getSingleton ().logMessage ( "Error: OgreDetourTileCache::AddStaticGeometry(). The tilecache has not been built." ) ;
+      return 0 ;
+   }
+
+   if ( ! geometry || ! geometry->getTriCount () || ! geometry->getChunkyMesh () )
+   {
+      return 0 ;
+   }
+
+   const float *bmin = geometry->getMeshBoundsMin () ;
+   const float *bmax = geometry->getMeshBoundsMax () ;
+
+   // The tiles can be made taller, but there are no tiles beyond the grid.
+   if ( ( bmin [ 0 ] < m_cfg.bmin [ 0 ] ) ||
+        ( bmin [ 2 ] < m_cfg.bmin [ 2 ] ) ||
+        ( bmax [ 0 ] > m_cfg.bmax [ 0 ] ) ||
+        ( bmax [ 2 ] > m_cfg.bmax [ 2 ] ) )
+   {
+      Ogre::LogManager::getSingleton ().logMessage ( "Warning: OgreDetourTileCache::AddStaticGeometry(). The geometry exceeds the bounds of the tilecache, the part beyond them is left out." ) ;
+   }
+
+   QueueStaticGeometryTiles ( *geometry ) ;
+
+   const int id = NextStaticGeometryId++ ;
+
+   StaticGeometry [ id ] = std::move ( geometry ) ;
+
+   return id ;
+}
+
+bool
+OgreDetourTileCache::
+RemoveStaticGeometry ( const int id )
+{
+   const auto geometry = StaticGeometry.find ( id ) ;
+
+   if ( geometry == StaticGeometry.end () )
+   {
+      return false ;
+   }
+
+   QueueStaticGeometryTiles ( *geometry->second ) ;
+
+   StaticGeometry.erase ( geometry ) ;
+
+   return true ;
+}
+
 int
 OgreDetourTileCache::
 AddConvexVolume ( ConvexVolume *vol )
@@ -480,199 +651,784 @@ DeleteConvexVolume ( int i )
     return true;
 }
 
-bool
+dtCostShapeRef
 OgreDetourTileCache::
-ConfigureTileCacheContext ()
+AddCostCircle ( const Ogre::Vector3 &base,
+                const float         radius,
+                const float         height,
+                const float         cost_multiplier )
 {
-    // Reuse OgreRecast context for tiled navmesh building
-
-    if (!InputGeometry) {
-        Ogre::LogManager::getSingleton ().logMessage("ERROR: OgreDetourTileCache::configure: No vertices and triangles.");
-        return false;
-    }
-
-    if (!InputGeometry->getChunkyMesh()) {
-        Ogre::LogManager::getSingleton ().logMessage("ERROR: OgreDetourTileCache::configure: Input mesh has no chunkyTriMesh built.");
-        return false;
-    }
-
-    // Init cache bounding box
-    const float* bmin = InputGeometry->getMeshBoundsMin();
-    const float* bmax = InputGeometry->getMeshBoundsMax();
+   dtCostShapeRef result = 0 ;
 
-    // Navmesh generation params
+   float position [ 3 ] ;
+   OgreRecast::OgreVect3ToFloatA ( base, position ) ;
 
-    // Most params are taken from OgreRecast::configure, except for these:
-    m_cfg.tileSize = m_tileSize;
-    m_cfg.borderSize = (int) (m_cfg.walkableRadius + BORDER_PADDING); // Reserve enough padding.
-    m_cfg.width = m_cfg.tileSize + m_cfg.borderSize*2;
-    m_cfg.height = m_cfg.tileSize + m_cfg.borderSize*2;
+   if ( dtStatusFailed ( CostOverlay.addCircle ( position, radius, height, cost_multiplier, &result ) ) )
+   {
+      Ogre::LogManager::getSingleton ().logMessage ( "Error: OgreDetourTileCache::AddCostCircle(). Could not add the cost shape." ) ;
+      return 0 ;
+   }
 
-    // Set mesh bounds
-    rcVcopy(m_cfg.bmin, bmin);
-    rcVcopy(m_cfg.bmax, bmax);
+   return result ;
+}
 
-    // Cell size navmesh generation property is copied from OgreRecast config
-    m_cellSize = m_cfg.cs;
+dtCostShapeRef
+OgreDetourTileCache::
+AddCostVolume ( const ConvexVolume &volume,
+                const float        cost_multiplier )
+{
+   dtCostShapeRef result = 0 ;
 
-    // Determine grid size (number of tiles) based on bounding box and grid cell size
-    int gw = 0, gh = 0;
-    rcCalcGridSize(bmin, bmax, m_cellSize, &gw, &gh);   // Calculates total size of voxel grid
-    const int ts = m_tileSize;
-    const int tw = (gw + ts-1) / ts;    // Tile width
-    const int th = (gh + ts-1) / ts;    // Tile height
-    m_tw = tw;
-    m_th = th;
+   if ( dtStatusFailed ( CostOverlay.addConvex ( volume.verts, volume.nverts, volume.hmin, volume.hmax, cost_multiplier, &result ) ) )
+   {
+      Ogre::LogManager::getSingleton ().logMessage ( "Error: OgreDetourTileCache::AddCostVolume(). Could not add the cost shape (at most " +
+                                                     Ogre::StringConverter::toString ( DT_COST_SHAPE_MAX_VERTS ) + " vertices)." ) ;
+      return 0 ;
+   }
 
+   return result ;
+}
 
-    // Max tiles and max polys affect how the tile IDs are caculated.
-    // There are 22 bits available for identifying a tile and a polygon.
-    int tileBits = rcMin((int)dtIlog2(dtNextPow2(tw*th*EXPECTED_LAYERS_PER_TILE)), 14);
-    if (tileBits > 14) tileBits = 14;
-    int polyBits = 22 - tileBits;
-    m_maxTiles = 1 << tileBits;
-    m_maxPolysPerTile = 1 << polyBits;
+bool
+OgreDetourTileCache::
+SetCostMultiplier ( const dtCostShapeRef ref,
+                    const float          cost_multiplier )
+{
+   return dtStatusSucceed ( CostOverlay.setShapeCost ( ref, cost_multiplier ) ) ;
+}
 
+bool
+OgreDetourTileCache::
+RemoveCostShape ( const dtCostShapeRef ref )
+{
+   return dtStatusSucceed ( CostOverlay.removeShape ( ref ) ) ;
+}
 
-    // Tile cache params.
-    memset(&m_tcparams, 0, sizeof(m_tcparams));
-    rcVcopy(m_tcparams.orig, bmin);
-    m_tcparams.width = m_tileSize;
-    m_tcparams.height = m_tileSize;
-    m_tcparams.maxTiles = tw*th*EXPECTED_LAYERS_PER_TILE;
-    m_tcparams.maxObstacles = MaxNumObstacles;    // Max number of temp obstacles that can be added to or removed from navmesh
+const dtCostOverlay *
+OgreDetourTileCache::
+GetCostOverlay () const
+{
+   return ( CostOverlay.getMaxShapes () > 0 ) ? &CostOverlay : nullptr ;
+}
 
-    // Copy the rest of the parameters from OgreRecast config
-    m_tcparams.cs = m_cfg.cs;
-    m_tcparams.ch = m_cfg.ch;
-    m_tcparams.walkableHeight = (float) m_cfg.walkableHeight;
-    m_tcparams.walkableRadius = (float) m_cfg.walkableRadius;
-    m_tcparams.walkableClimb = (float) m_cfg.walkableClimb;
-    m_tcparams.maxSimplificationError = m_cfg.maxSimplificationError;
+bool
+OgreDetourTileCache::
+InitCostOverlay ()
+{
+   if ( dtStatusFailed ( CostOverlay.init ( m_navMesh, MAX_COST_SHAPES ) ) )
+   {
+      Ogre::LogManager::getSingleton ().logMessage ( "Error: OgreDetourTileCache::InitCostOverlay(). Could not allocate the cost overlay." ) ;
+      return false ;
+   }
 
-    return InitTileCache();
+   return true ;
 }
 
-int
+bool
 OgreDetourTileCache::
-RasterizeTileLayers ( const int     tx,
-                      const int     ty,
-                      TileCacheData *tiles,
-                      const int     maxTiles )
+BuildLandmarks ( const PlayerFlagQueryFilter &filter,
+                 const int                   landmark_count )
 {
-    if (!InputGeometry) {
-        Ogre::LogManager::getSingleton ().logMessage("ERROR: buildTile: Input mesh is not specified.");
-        return 0;
-    }
+   if ( ! m_navMesh )
+   {
+      return false ;
+   }
 
-    if (!InputGeometry->getChunkyMesh()) {
-        Ogre::LogManager::getSingleton ().logMessage("ERROR: buildTile: Input mesh has no chunkyTriMesh built.");
-        return 0;
-    }
+   auto profile = std::find_if ( LandmarkProfiles.begin (), LandmarkProfiles.end (),
+                                 [&filter] ( const std::unique_ptr <LandmarkProfile> &existing )
+                                 {
+                                    return ( existing->Filter.getIncludeFlags () == filter.getIncludeFlags () ) &&
+                                           ( existing->Filter.getExcludeFlags () == filter.getExcludeFlags () ) ;
+                                 } ) ;
 
-//TODO make these member variables?
-    FastLZCompressor comp;
-    RasterizationContext rc;
+   if ( profile == LandmarkProfiles.end () )
+   {
+      LandmarkProfiles.push_back ( std::make_unique <LandmarkProfile> () ) ;
+      profile = LandmarkProfiles.end () - 1 ;
+   }
 
-    const float* verts = InputGeometry->getVerts();
-    const int nverts = InputGeometry->getVertCount();
+   ( *profile )->Filter = filter ;
 
-    // The chunky tri mesh in the inputgeom is a simple spatial subdivision structure that allows to
-    // process the vertices in the geometry relevant to this part of the tile.
-    // The chunky tri mesh is a grid of axis aligned boxes that store indices to the vertices in verts
-    // that are positioned in that box.
-    const rcChunkyTriMesh* chunkyMesh = InputGeometry->getChunkyMesh();
+   const int max_landmarks = boost::algorithm::clamp ( landmark_count, 1, DT_MAX_LANDMARKS ) ;
 
-    // Tile bounds.
-    const float tcs = m_tileSize * m_cellSize;
+   dtStatus status = ( *profile )->Landmarks.init ( m_navMesh, &( *profile )->Filter, max_landmarks ) ;
 
-    rcConfig tcfg;
-    memcpy(&tcfg, &m_cfg, sizeof(tcfg));
+   if ( dtStatusSucceed ( status ) )
+   {
+      status = ( *profile )->Landmarks.build ( max_landmarks ) ;
+   }
 
-    tcfg.bmin[0] = m_cfg.bmin[0] + tx*tcs;
-    tcfg.bmin[1] = m_cfg.bmin[1];
-    tcfg.bmin[2] = m_cfg.bmin[2] + ty*tcs;
-    tcfg.bmax[0] = m_cfg.bmin[0] + (tx+1)*tcs;
-    tcfg.bmax[1] = m_cfg.bmax[1];
-    tcfg.bmax[2] = m_cfg.bmin[2] + (ty+1)*tcs;
-    tcfg.bmin[0] -= tcfg.borderSize*tcfg.cs;
-    tcfg.bmin[2] -= tcfg.borderSize*tcfg.cs;
-    tcfg.bmax[0] += tcfg.borderSize*tcfg.cs;
-    tcfg.bmax[2] += tcfg.borderSize*tcfg.cs;
+   if ( dtStatusFailed ( status ) )
+   {
+      Ogre::LogManager::getSingleton ().logMessage ( "Error: OgreDetourTileCache::BuildLandmarks(). Could not build landmarks." ) ;
+      LandmarkProfiles.erase ( profile ) ;
+      return false ;
+   }
 
+   return true ;
+}
 
-    // This is part of the regular recast navmesh generation pipeline as in OgreRecast::NavMeshBuild()
-    // but only up till step 4 and slightly modified.
+const dtNavMeshLandmarks *
+OgreDetourTileCache::
+GetLandmarks ( const unsigned short include_flags,
+               const unsigned short exclude_flags ) const
+{
+   for ( const auto &profile : LandmarkProfiles )
+   {
+      if ( ( profile->Filter.getIncludeFlags () == include_flags ) &&
+           ( profile->Filter.getExcludeFlags () == exclude_flags ) )
+      {
+         return profile->Landmarks.getActiveLandmarkCount () ? &profile->Landmarks : nullptr ;
+      }
+   }
 
+   return nullptr ;
+}
 
-    // Allocate voxel heightfield where we rasterize our input data to.
-    rc.solid = rcAllocHeightfield();
-    if (!rc.solid)
-    {
-        Ogre::LogManager::getSingleton ().logMessage("ERROR: buildNavigation: Out of memory 'solid'.");
-        return 0;
-    }
-    if (!rcCreateHeightfield(&m_ctx, *rc.solid, tcfg.width, tcfg.height, tcfg.bmin, tcfg.bmax, tcfg.cs, tcfg.ch))
-    {
-        Ogre::LogManager::getSingleton ().logMessage("ERROR: buildNavigation: Could not create solid heightfield.");
-        return 0;
-    }
+const dtNavMeshIslands *
+OgreDetourTileCache::
+GetIslands ( const PlayerFlagQueryFilter &filter )
+{
+   if ( ! m_navMesh )
+   {
+      return nullptr ;
+   }
 
-    // Allocate array that can hold triangle flags.
-    // If you have multiple meshes you need to process, allocate
-    // an array which can hold the max number of triangles you need to process.
-    rc.triareas = new unsigned char[chunkyMesh->maxTrisPerChunk];
-    if (!rc.triareas)
-    {
-        Ogre::LogManager::getSingleton ().logMessage("ERROR: buildNavigation: Out of memory 'm_triareas' ("+Ogre::StringConverter::toString(chunkyMesh->maxTrisPerChunk)+").");
-        return 0;
-    }
+   for ( const auto &profile : IslandProfiles )
+   {
+      if ( ( profile->Filter.getIncludeFlags () == filter.getIncludeFlags () ) &&
+           ( profile->Filter.getExcludeFlags () == filter.getExcludeFlags () ) )
+      {
+         return profile->Islands.isUpToDate () ? &profile->Islands : nullptr ;
+      }
+   }
 
-    float tbmin[2], tbmax[2];
-    tbmin[0] = tcfg.bmin[0];
-    tbmin[1] = tcfg.bmin[2];
-    tbmax[0] = tcfg.bmax[0];
-    tbmax[1] = tcfg.bmax[2];
-    int cid[512];// TODO: Make grow when returning too many items.
-    const int ncid = rcGetChunksOverlappingRect(chunkyMesh, tbmin, tbmax, cid, 512);
-    if (!ncid)
-    {
-        return 0; // empty
-    }
+   auto profile = std::make_unique <IslandProfile> () ;
+   profile->Filter = filter ;
 
-    for (int i = 0; i < ncid; ++i)
-    {
-        const rcChunkyTriMeshNode& node = chunkyMesh->nodes[cid[i]];
-        const int* tris = &chunkyMesh->tris[node.i*3];
-        const int ntris = node.n;
+   dtStatus status = profile->Islands.init ( m_navMesh, &profile->Filter ) ;
 
-        memset(rc.triareas, 0, ntris*sizeof(unsigned char));
-        rcMarkWalkableTriangles(&m_ctx, tcfg.walkableSlopeAngle,
-                                verts, nverts, tris, ntris, rc.triareas);
+   if ( dtStatusSucceed ( status ) )
+   {
+      status = profile->Islands.update () ;
+   }
 
-        rcRasterizeTriangles(&m_ctx, verts, nverts, tris, rc.triareas, ntris, *rc.solid, tcfg.walkableClimb);
-    }
+   if ( dtStatusFailed ( status ) )
+   {
+      Ogre::LogManager::getSingleton ().logMessage ( "Error: OgreDetourTileCache::GetIslands(). Could not label the navmesh islands." ) ;
+      return nullptr ;
+   }
 
-    // Once all geometry is rasterized, we do initial pass of filtering to
-    // remove unwanted overhangs caused by the conservative rasterization
-    // as well as filter spans where the character cannot possibly stand.
-    rcFilterLowHangingWalkableObstacles(&m_ctx, tcfg.walkableClimb, *rc.solid);
-    rcFilterLedgeSpans(&m_ctx, tcfg.walkableHeight, tcfg.walkableClimb, *rc.solid);
-    rcFilterWalkableLowHeightSpans(&m_ctx, tcfg.walkableHeight, *rc.solid);
+   IslandProfiles.push_back ( std::move ( profile ) ) ;
 
+   return &IslandProfiles.back ()->Islands ;
+}
 
-    rc.chf = rcAllocCompactHeightfield();
-    if (!rc.chf)
-    {
+const dtPolyMaskFilter *
+OgreDetourTileCache::
+GetFilterMask ( const PlayerFlagQueryFilter &filter )
+{
+   if ( ! m_navMesh )
+   {
+      return nullptr ;
+   }
+
+   for ( const auto &profile : FilterMaskProfiles )
+   {
+      if ( ( profile->Filter.getIncludeFlags () == filter.getIncludeFlags () ) &&
+           ( profile->Filter.getExcludeFlags () == filter.getExcludeFlags () ) )
+      {
+         return &profile->MaskFilter ;
+      }
+   }
+
+   auto profile = std::make_unique <FilterMaskProfile> () ;
+   profile->Filter = filter ;
+
+   dtStatus status = profile->Mask.init ( m_navMesh, &profile->Filter ) ;
+
+   if ( dtStatusSucceed ( status ) )
+   {
+      status = profile->Mask.update () ;
+   }
+
+   if ( dtStatusFailed ( status ) )
+   {
+      Ogre::LogManager::getSingleton ().logMessage ( "Error: OgreDetourTileCache::GetFilterMask(). Could not compute the filter mask." ) ;
+      return nullptr ;
+   }
+
+   profile->MaskFilter.setMask ( &profile->Mask ) ;
+   profile->MaskFilter.setCostOverlay ( filter.GetCostOverlay () ) ;
+
+   FilterMaskProfiles.push_back ( std::move ( profile ) ) ;
+
+   return &FilterMaskProfiles.back ()->MaskFilter ;
+}
+
+void
+OgreDetourTileCache::
+SetTrackChanges ( const bool enabled )
+{
+   TrackChanges = enabled ;
+
+   if ( ! TrackChanges )
+   {
+      Changes.Clear () ;
+   }
+}
+
+const NavMeshChanges &
+OgreDetourTileCache::
+GetChanges () const
+{
+   return Changes ;
+}
+
+void
+OgreDetourTileCache::
+RecordTileChange ( const dtCompressedTileRef tile_ref )
+{
+   if ( ! TrackChanges || ! tile_ref )
+   {
+      return ;
+   }
+
+   const dtCompressedTile *compressed_tile = m_tileCache->getTileByRef ( tile_ref ) ;
+
+   if ( ! compressed_tile || ! compressed_tile->header )
+   {
+      return ;
+   }
+
+   RecordTileChange ( compressed_tile->header->tx, compressed_tile->header->ty, compressed_tile->header->tlayer ) ;
+}
+
+void
+OgreDetourTileCache::
+RecordTileChange ( const int tx,
+                   const int ty,
+                   const int layer )
+{
+   if ( ! TrackChanges )
+   {
+      return ;
+   }
+
+   NavMeshTileChange change ;
+
+   change.TileX   = tx ;
+   change.TileY   = ty ;
+   change.Layer   = layer ;
+   change.TileRef = m_navMesh->getTileRefAt ( tx, ty, layer ) ;
+
+   // A tile rebuilt more than once during one update is listed once, with its latest reference.
+   for ( auto &tile : Changes.Tiles )
+   {
+      if ( ( tile.TileX == change.TileX ) &&
+           ( tile.TileY == change.TileY ) &&
+           ( tile.Layer == change.Layer ) )
+      {
+         tile.TileRef = change.TileRef ;
+         return ;
+      }
+   }
+
+   Changes.Tiles.push_back ( change ) ;
+}
+
+void
+OgreDetourTileCache::
+RecordObstacleChanges ()
+{
+   if ( ! TrackChanges )
+   {
+      return ;
+   }
+
+   const auto add_change = [this] ( const dtTileCacheObstacle *obstacle,
+                                    const dtObstacleRef       ref,
+                                    const bool                removed )
+   {
+      float bmin [ 3 ] ;
+      float bmax [ 3 ] ;
+      m_tileCache->getObstacleBounds ( obstacle, bmin, bmax ) ;
+
+      NavMeshObstacleChange change ;
+
+      change.Obstacle = ref ;
+      change.Removed  = removed ;
+      OgreRecast::FloatAToOgreVect3 ( bmin, change.BoundsMin ) ;
+      OgreRecast::FloatAToOgreVect3 ( bmax, change.BoundsMax ) ;
+
+      Changes.Obstacles.push_back ( change ) ;
+   } ;
+
+   for ( const auto obstacle_index : ProcessingObstacles )
+   {
+      const dtTileCacheObstacle *obstacle = m_tileCache->getObstacle ( obstacle_index ) ;
+
+      if ( obstacle->state == DT_OBSTACLE_PROCESSED )
+      {
+         add_change ( obstacle, m_tileCache->getObstacleRef ( obstacle ), false ) ;
+      }
+   }
+
+   // Removed obstacles keep their shape until the slot is reused by the next AddObstacle.
+   for ( const auto &placed : PlacedObstacles )
+   {
+      const dtTileCacheObstacle *obstacle = m_tileCache->getObstacle ( placed.first ) ;
+
+      if ( obstacle->state == DT_OBSTACLE_EMPTY )
+      {
+         add_change ( obstacle, placed.second, true ) ;
+      }
+   }
+}
+
+void
+OgreDetourTileCache::
+InvalidateGateTiles ()
+{
+   for ( const auto obstacle_index : ProcessingObstacles )
+   {
+      const dtTileCacheObstacle *obstacle = m_tileCache->getObstacle ( obstacle_index ) ;
+
+      if ( obstacle->state != DT_OBSTACLE_PROCESSED )
+      {
+         continue ;
+      }
+
+      // Gate flags are changed in place, so only the touched tiles need updating again.
+      for ( int i = 0 ; i < obstacle->ntouched ; ++i )
+      {
+         const dtCompressedTile *compressed_tile = m_tileCache->getTileByRef ( obstacle->touched [ i ] ) ;
+
+         if ( ! compressed_tile || ! compressed_tile->header )
+         {
+            continue ;
+         }
+
+         const dtMeshTile *tile = m_navMesh->getTileAt ( compressed_tile->header->tx, compressed_tile->header->ty, compressed_tile->header->tlayer ) ;
+
+         if ( tile )
+         {
+            for ( auto &profile : IslandProfiles )
+            {
+               profile->Islands.invalidateTile ( m_navMesh->getTileRef ( tile ) ) ;
+            }
+
+            for ( auto &profile : FilterMaskProfiles )
+            {
+               profile->Mask.invalidateTile ( m_navMesh->getTileRef ( tile ) ) ;
+            }
+
+            for ( auto &profile : LandmarkProfiles )
+            {
+               profile->Landmarks.invalidateTile ( m_navMesh->getTileRef ( tile ) ) ;
+            }
+         }
+      }
+   }
+}
+
+void
+OgreDetourTileCache::
+UpdateFilterMasks ()
+{
+   for ( auto &profile : FilterMaskProfiles )
+   {
+      // Tile rebuilds are detected by the masks themselves.
+      if ( dtStatusFailed ( profile->Mask.update () ) )
+      {
+         Ogre::LogManager::getSingleton ().logMessage ( "Error: OgreDetourTileCache::UpdateFilterMasks(). Could not compute the filter mask." ) ;
+      }
+   }
+}
+
+void
+OgreDetourTileCache::
+UpdateIslands ()
+{
+   for ( auto &profile : IslandProfiles )
+   {
+      // Tile rebuilds are detected by the islands themselves.
+      if ( dtStatusFailed ( profile->Islands.update () ) )
+      {
+         Ogre::LogManager::getSingleton ().logMessage ( "Error: OgreDetourTileCache::UpdateIslands(). Could not label the navmesh islands." ) ;
+      }
+   }
+}
+
+void
+OgreDetourTileCache::
+UpdateLandmarks ( const bool until_up_to_date )
+{
+   for ( auto &profile : LandmarkProfiles )
+   {
+      // Tile rebuilds are detected by the landmarks themselves. Out of date landmarks keep
+      // guiding the paths that cannot pass the changed tiles until each has been recomputed.
+      profile->Landmarks.update ( until_up_to_date ? DT_MAX_LANDMARKS : 1 ) ;
+   }
+}
+
+bool
+OgreDetourTileCache::
+SaveLandmarks ( const Ogre::String &filename )
+{
+   FILE *fp = fopen ( filename.data (), "wb" ) ;
+
+   if ( ! fp )
+   {
+      Ogre::LogManager::getSingleton ().logMessage ( "Error: OgreDetourTileCache::SaveLandmarks(" + filename + "). Could not save file." ) ;
+      return false ;
+   }
+
+   LandmarkSetHeader header ;
+   header.magic       = LANDMARKSET_MAGIC ;
+   header.version     = LANDMARKSET_VERSION ;
+   header.numProfiles = static_cast <int> ( LandmarkProfiles.size () ) ;
+
+   fwrite ( &header, sizeof ( header ), 1, fp ) ;
+
+   std::vector <unsigned char> data ;
+
+   for ( const auto &profile : LandmarkProfiles )
+   {
+      LandmarkProfileHeader profile_header ;
+      profile_header.includeFlags = profile->Filter.getIncludeFlags () ;
+      profile_header.excludeFlags = profile->Filter.getExcludeFlags () ;
+      profile_header.maxLandmarks = profile->Landmarks.getMaxLandmarks () ;
+      profile_header.dataSize     = profile->Landmarks.getDataSize () ;
+
+      for ( int i = 0 ; i < DT_MAX_AREAS ; ++i )
+      {
+         profile_header.areaCosts [ i ] = profile->Filter.getAreaCost ( i ) ;
+      }
+
+      data.resize ( profile_header.dataSize ) ;
+      profile->Landmarks.storeData ( data.data (), profile_header.dataSize ) ;
+
+      fwrite ( &profile_header, sizeof ( profile_header ), 1, fp ) ;
+      fwrite ( data.data (), data.size (), 1, fp ) ;
+   }
+
+   fclose ( fp ) ;
+   return true ;
+}
+
+bool
+OgreDetourTileCache::
+LoadLandmarks ( const Ogre::String &filename )
+{
+   FILE *fp = fopen ( filename.data (), "rb" ) ;
+
+   if ( ! fp )
+   {
+      return false ; // No landmarks were saved with this tilecache
+   }
+
+   LandmarkSetHeader header ;
+
+   if ( ( fread ( &header, sizeof ( header ), 1, fp ) != 1 ) ||
+        ( header.magic != LANDMARKSET_MAGIC ) ||
+        ( header.version != LANDMARKSET_VERSION ) )
+   {
+      fclose ( fp ) ;
+      Ogre::LogManager::getSingleton ().logMessage ( "Error: OgreDetourTileCache::LoadLandmarks(" + filename + "). File does not contain valid landmark data." ) ;
+      return false ;
+   }
+
+   LandmarkProfiles.clear () ;
+
+   std::vector <unsigned char> data ;
+
+   for ( int i = 0 ; i < header.numProfiles ; ++i )
+   {
+      LandmarkProfileHeader profile_header ;
+
+      if ( fread ( &profile_header, sizeof ( profile_header ), 1, fp ) != 1 )
+      {
+         break ;
+      }
+
+      data.resize ( profile_header.dataSize ) ;
+
+      if ( fread ( data.data (), data.size (), 1, fp ) != 1 )
+      {
+         break ;
+      }
+
+      auto profile = std::make_unique <LandmarkProfile> () ;
+      profile->Filter.setIncludeFlags ( profile_header.includeFlags ) ;
+      profile->Filter.setExcludeFlags ( profile_header.excludeFlags ) ;
+
+      for ( int area = 0 ; area < DT_MAX_AREAS ; ++area )
+      {
+         profile->Filter.setAreaCost ( area, profile_header.areaCosts [ area ] ) ;
+      }
+
+      if ( dtStatusFailed ( profile->Landmarks.init ( m_navMesh, &profile->Filter, profile_header.maxLandmarks ) ) ||
+           dtStatusFailed ( profile->Landmarks.restoreData ( data.data (), profile_header.dataSize ) ) )
+      {
+         Ogre::LogManager::getSingleton ().logMessage ( "Error: OgreDetourTileCache::LoadLandmarks(" + filename + "). Could not restore landmarks." ) ;
+         continue ;
+      }
+
+      // Tables that no longer match the navmesh are recomputed here instead of on the first updates.
+      profile->Landmarks.update ( DT_MAX_LANDMARKS ) ;
+
+      LandmarkProfiles.push_back ( std::move ( profile ) ) ;
+   }
+
+   fclose ( fp ) ;
+   return true ;
+}
+
+bool
+OgreDetourTileCache::
+ConfigureTileCacheContext ( const InputGeom &geometry )
+{
+    // Reuse OgreRecast context for tiled navmesh building
+
+    if (!geometry.getVertCount() && !geometry.hasTerrain()) {
+        Ogre::LogManager::getSingleton ().logMessage("ERROR: OgreDetourTileCache::configure: No vertices and triangles.");
+        return false;
+    }
+
+    if (geometry.getVertCount() && !geometry.getChunkyMesh()) {
+        Ogre::LogManager::getSingleton ().logMessage("ERROR: OgreDetourTileCache::configure: Input mesh has no chunkyTriMesh built.");
+        return false;
+    }
+
+    // Init cache bounding box
+    const float* bmin = geometry.getMeshBoundsMin();
+    const float* bmax = geometry.getMeshBoundsMax();
+
+    // Navmesh generation params
+
+    // Most params are taken from OgreRecast::configure, except for these:
+    m_cfg.tileSize = m_tileSize;
+    m_cfg.borderSize = (int) (m_cfg.walkableRadius + BORDER_PADDING); // Reserve enough padding.
+    m_cfg.width = m_cfg.tileSize + m_cfg.borderSize*2;
+    m_cfg.height = m_cfg.tileSize + m_cfg.borderSize*2;
+
+    // Set mesh bounds
+    rcVcopy(m_cfg.bmin, bmin);
+    rcVcopy(m_cfg.bmax, bmax);
+
+    // Cell size navmesh generation property is copied from OgreRecast config
+    m_cellSize = m_cfg.cs;
+
+    // Determine grid size (number of tiles) based on bounding box and grid cell size
+    int gw = 0, gh = 0;
+    rcCalcGridSize(bmin, bmax, m_cellSize, &gw, &gh);   // Calculates total size of voxel grid
+    const int ts = m_tileSize;
+    const int tw = (gw + ts-1) / ts;    // Tile width
+    const int th = (gh + ts-1) / ts;    // Tile height
+    m_tw = tw;
+    m_th = th;
+
+
+    // Max tiles and max polys affect how the tile IDs are caculated.
+    // There are 22 bits available for identifying a tile and a polygon.
+    int tileBits = rcMin((int)dtIlog2(dtNextPow2(tw*th*EXPECTED_LAYERS_PER_TILE)), 14);
+    if (tileBits > 14) tileBits = 14;
+    int polyBits = 22 - tileBits;
+    m_maxTiles = 1 << tileBits;
+    m_maxPolysPerTile = 1 << polyBits;
+
+
+    // Tile cache params.
+    memset(&m_tcparams, 0, sizeof(m_tcparams));
+    rcVcopy(m_tcparams.orig, bmin);
+    m_tcparams.width = m_tileSize;
+    m_tcparams.height = m_tileSize;
+    m_tcparams.maxTiles = tw*th*EXPECTED_LAYERS_PER_TILE;
+    m_tcparams.maxObstacles = MaxNumObstacles;    // Max number of temp obstacles that can be added to or removed from navmesh
+
+    // Copy the rest of the parameters from OgreRecast config
+    m_tcparams.cs = m_cfg.cs;
+    m_tcparams.ch = m_cfg.ch;
+    m_tcparams.walkableHeight = (float) m_cfg.walkableHeight;
+    m_tcparams.walkableRadius = (float) m_cfg.walkableRadius;
+    m_tcparams.walkableClimb = (float) m_cfg.walkableClimb;
+    m_tcparams.maxSimplificationError = m_cfg.maxSimplificationError;
+
+    return InitTileCache();
+}
+
+bool
+OgreDetourTileCache::
+RasterizeTile ( const int            tx,
+                const int            ty,
+                const int            border_size,
+                RasterizationContext &rc )
+{
+    if (!InputGeometry) {
+        Ogre::LogManager::getSingleton ().logMessage("ERROR: buildTile: Input mesh is not specified.");
+        return false;
+    }
+
+    if (InputGeometry->getVertCount() && !InputGeometry->getChunkyMesh()) {
+        Ogre::LogManager::getSingleton ().logMessage("ERROR: buildTile: Input mesh has no chunkyTriMesh built.");
+        return false;
+    }
+
+    // Tile bounds.
+    const float tcs = m_tileSize * m_cellSize;
+
+    rcConfig tcfg;
+    memcpy(&tcfg, &m_cfg, sizeof(tcfg));
+
+    tcfg.borderSize = border_size;
+    tcfg.width = tcfg.tileSize + border_size*2;
+    tcfg.height = tcfg.tileSize + border_size*2;
+    tcfg.bmin[0] = m_cfg.bmin[0] + tx*tcs;
+    tcfg.bmin[1] = m_cfg.bmin[1];
+    tcfg.bmin[2] = m_cfg.bmin[2] + ty*tcs;
+    tcfg.bmax[0] = m_cfg.bmin[0] + (tx+1)*tcs;
+    tcfg.bmax[1] = m_cfg.bmax[1];
+    tcfg.bmax[2] = m_cfg.bmin[2] + (ty+1)*tcs;
+    tcfg.bmin[0] -= tcfg.borderSize*tcfg.cs;
+    tcfg.bmin[2] -= tcfg.borderSize*tcfg.cs;
+    tcfg.bmax[0] += tcfg.borderSize*tcfg.cs;
+    tcfg.bmax[2] += tcfg.borderSize*tcfg.cs;
+
+    // Static geometry may reach above or below the geometry the tilecache was configured with. The
+    // bottom is only lowered by whole cells, so the heights still line up with the neighbouring tiles.
+    for (const auto& entry : StaticGeometry)
+    {
+        const float* gbmin = entry.second->getMeshBoundsMin();
+        const float* gbmax = entry.second->getMeshBoundsMax();
+        if (gbmin[1] < tcfg.bmin[1])
+            tcfg.bmin[1] -= ceilf((tcfg.bmin[1] - gbmin[1]) / tcfg.ch) * tcfg.ch;
+        tcfg.bmax[1] = rcMax(tcfg.bmax[1], gbmax[1]);
+    }
+
+
+    // This is part of the regular recast navmesh generation pipeline as in OgreRecast::NavMeshBuild()
+    // but only up till step 4 and slightly modified.
+
+
+    // Allocate voxel heightfield where we rasterize our input data to.
+    // The heightfield of the previous tile is reused, along with its span pools.
+    if (!rc.solid)
+        rc.solid = rcAllocHeightfield();
+    if (!rc.solid)
+    {
+        Ogre::LogManager::getSingleton ().logMessage("ERROR: buildNavigation: Out of memory 'solid'.");
+        return false;
+    }
+    if (!rcCreateHeightfield(&m_ctx, *rc.solid, tcfg.width, tcfg.height, tcfg.bmin, tcfg.bmax, tcfg.cs, tcfg.ch))
+    {
+        Ogre::LogManager::getSingleton ().logMessage("ERROR: buildNavigation: Could not create solid heightfield.");
+        return false;
+    }
+
+    // Terrain has no triangles, its heights are sampled straight into the heightfield.
+    if (InputGeometry->hasTerrain())
+    {
+        InputGeometry->rasterizeTerrain(&m_ctx, *rc.solid, tcfg.walkableSlopeAngle, tcfg.walkableClimb);
+    }
+
+    // Static geometry has its own chunky tri mesh, but is rasterized into the same heightfield.
+    int maxTrisPerChunk = InputGeometry->getChunkyMesh() ? InputGeometry->getChunkyMesh()->maxTrisPerChunk : 0;
+    for (const auto& entry : StaticGeometry)
+        maxTrisPerChunk = rcMax(maxTrisPerChunk, entry.second->getChunkyMesh()->maxTrisPerChunk);
+
+    if (maxTrisPerChunk)
+    {
+        // Allocate array that can hold triangle flags.
+        // If you have multiple meshes you need to process, allocate
+        // an array which can hold the max number of triangles you need to process.
+        rc.triareas.resize(maxTrisPerChunk);
+
+        float tbmin[2], tbmax[2];
+        tbmin[0] = tcfg.bmin[0];
+        tbmin[1] = tcfg.bmin[2];
+        tbmax[0] = tcfg.bmax[0];
+        tbmax[1] = tcfg.bmax[2];
+        bool empty = true;
+
+        const auto rasterizeGeometry = [&] (const InputGeom& geometry)
+        {
+            const float* verts = geometry.getVerts();
+            const int nverts = geometry.getVertCount();
+
+            // The chunky tri mesh in the inputgeom is a simple spatial subdivision structure that allows to
+            // process the vertices in the geometry relevant to this part of the tile.
+            // The chunky tri mesh is a grid of axis aligned boxes that store indices to the vertices in verts
+            // that are positioned in that box.
+            const rcChunkyTriMesh* chunkyMesh = geometry.getChunkyMesh();
+            if (!chunkyMesh)
+                return;
+
+            rcForEachChunkOverlappingRect(chunkyMesh, tbmin, tbmax, [&] (const int* tris, const int ntris)
+            {
+                empty = false;
+
+                memset(rc.triareas.data(), 0, ntris*sizeof(unsigned char));
+                rcMarkWalkableTriangles(&m_ctx, tcfg.walkableSlopeAngle,
+                                        verts, nverts, tris, ntris, rc.triareas.data());
+
+                rcRasterizeTriangles(&m_ctx, verts, nverts, tris, rc.triareas.data(), ntris, *rc.solid, tcfg.walkableClimb);
+            });
+        };
+
+        rasterizeGeometry(*InputGeometry);
+        for (const auto& entry : StaticGeometry)
+            rasterizeGeometry(*entry.second);
+
+        if (empty && !InputGeometry->hasTerrain())
+        {
+            return false; // empty
+        }
+    }
+
+    // Once all geometry is rasterized, we do initial pass of filtering to
+    // remove unwanted overhangs caused by the conservative rasterization
+    // as well as filter spans where the character cannot possibly stand.
+    // The three filters are applied in one pass over the heightfield.
+    rcFilterSpans(&m_ctx, tcfg.walkableHeight, tcfg.walkableClimb, *rc.solid);
+
+
+    if (!rc.chf)
+        rc.chf = rcAllocCompactHeightfield();
+    if (!rc.chf)
+    {
         Ogre::LogManager::getSingleton ().logMessage("ERROR: buildNavigation: Out of memory 'chf'.");
-        return 0;
+        return false;
     }
     if (!rcBuildCompactHeightfield(&m_ctx, tcfg.walkableHeight, tcfg.walkableClimb, *rc.solid, *rc.chf))
     {
         Ogre::LogManager::getSingleton ().logMessage("ERROR: buildNavigation: Could not build compact data.");
-        return 0;
+        return false;
     }
 
+    // The convex volumes are marked by AddTileLayers after each erosion.
+    rc.volumes = m_volumes;
+    rc.volumeCount = m_volumeCount;
+
+    return true;
+}
+
+int
+OgreDetourTileCache::
+AddTileLayers ( const int            tx,
+                const int            ty,
+                const int            border_size,
+                RasterizationContext &rc )
+{
+//TODO make these member variables?
+    FastLZCompressor comp;
+    RecastTempAlloc tempAlloc;
+
+    rcConfig tcfg;
+    memcpy(&tcfg, &m_cfg, sizeof(tcfg));
+
+    tcfg.borderSize = border_size;
+
     // Erode the walkable area by agent radius.
     if (!rcErodeWalkableArea(&m_ctx, tcfg.walkableRadius, *rc.chf))
     {
@@ -681,8 +1437,8 @@ RasterizeTileLayers ( const int     tx,
     }
 
     // Mark areas of dynamically added convex polygons
-    const ConvexVolume* const* vols = m_volumes;
-    for (int i  = 0; i < m_volumeCount; ++i)
+    const ConvexVolume* const* vols = rc.volumes;
+    for (int i  = 0; i < rc.volumeCount; ++i)
     {
        // TODO: Check if this is actually used, i.e. are there ever any convex volumes at this point?
        //       This causes the recast height map to be marked instead of the tile cache which would be done using dtMark...
@@ -693,11 +1449,12 @@ RasterizeTileLayers ( const int     tx,
     }
 
 
-
     // Up till this part was more or less the same as OgreRecast::NavMeshBuild()
     // The following part is specific for creating a 2D intermediary navmesh tile.
 
-    rc.lset = rcAllocHeightfieldLayerSet();
+    // The context is reused by the tilecache of each agent radius, and for the next tile.
+    if (!rc.lset)
+        rc.lset = rcAllocHeightfieldLayerSet();
     if (!rc.lset)
     {
         Ogre::LogManager::getSingleton ().logMessage("ERROR: buildNavigation: Out of memory 'lset'.");
@@ -709,6 +1466,12 @@ RasterizeTileLayers ( const int     tx,
         return 0;
     }
 
+    for (int i = 0; i < rc.ntiles; ++i)
+    {
+        dtFree(rc.tiles[i].data); // Left over if a previous call failed
+        rc.tiles[i].data = 0;
+    }
+
     rc.ntiles = 0;
     for (int i = 0; i < rcMin(rc.lset->nlayers, MAX_LAYERS); ++i)
     {
@@ -738,25 +1501,171 @@ RasterizeTileLayers ( const int     tx,
         header.hmax = (unsigned short)layer->hmax;
 
         dtStatus status = dtBuildTileCacheLayer(&comp, &header, layer->heights, layer->areas, layer->cons,
-                                                &tile->data, &tile->dataSize);
+                                                &tile->data, &tile->dataSize, &tempAlloc);
         if (dtStatusFailed(status))
         {
             return 0;
         }
     }
 
-    // Transfer ownsership of tile data from build context to the caller.
+    // Transfer ownsership of tile data from build context to the tilecache.
     int n = 0;
-    for (int i = 0; i < rcMin(rc.ntiles, maxTiles); ++i)
+    for (int i = 0; i < rc.ntiles; ++i)
     {
-        tiles[n++] = rc.tiles[i];
-        rc.tiles[i].data = 0;
+        dtStatus status = m_tileCache->addTile(rc.tiles[i].data, rc.tiles[i].dataSize, DT_COMPRESSEDTILE_FREE_DATA, 0); // Add compressed tiles to tileCache
+        if (dtStatusSucceed(status))
+        {
+            rc.tiles[i].data = 0;
+            n++;
+        }
+        else
+        {
+            dtFree(rc.tiles[i].data);
+            rc.tiles[i].data = 0;
+        }
         rc.tiles[i].dataSize = 0;
     }
 
     return n;
 }
 
+void
+OgreDetourTileCache::
+ReplaceTileLayers ( const int            tx,
+                    const int            ty,
+                    const int            border_size,
+                    RasterizationContext *rc )
+{
+   const int MAX_TILES = 32 ;
+
+   dtCompressedTileRef tiles [ MAX_TILES ] ;
+
+   // The new tile may have fewer layers, so the navmesh tiles of all old layers are removed.
+   const int old_tile_count = m_tileCache->getTilesAt ( tx, ty, tiles, MAX_TILES ) ;
+
+   for ( int i = 0 ; i < old_tile_count ; ++i )
+   {
+      const int layer = m_tileCache->getTileByRef ( tiles [ i ] )->header->tlayer ;
+
+      m_navMesh->removeTile ( m_navMesh->getTileRefAt ( tx, ty, layer ), nullptr, nullptr ) ;
+      m_tileCache->removeTile ( tiles [ i ], nullptr, nullptr ) ;
+
+      RecordTileChange ( tx, ty, layer ) ;
+   }
+
+   if ( rc )
+   {
+      AddTileLayers ( tx, ty, border_size, *rc ) ;
+   }
+
+   // Obstacles still refer to the removed tiles.
+   m_tileCache->updateObstacleTiles ( tx, ty ) ;
+
+   if ( dtStatusFailed ( m_tileCache->buildNavMeshTilesAt ( tx, ty, m_navMesh ) ) )
+   {
+      Ogre::LogManager::getSingleton ().logMessage ( "Error: OgreDetourTileCache::ReplaceTileLayers(). Could not build the navmesh tiles at " + Ogre::StringConverter::toString ( tx ) + ", " + Ogre::StringConverter::toString ( ty ) + "." ) ;
+   }
+
+   const int new_tile_count = m_tileCache->getTilesAt ( tx, ty, tiles, MAX_TILES ) ;
+
+   for ( int i = 0 ; i < new_tile_count ; ++i )
+   {
+      RecordTileChange ( tiles [ i ] ) ;
+   }
+}
+
+void
+OgreDetourTileCache::
+QueueStaticGeometryTiles ( const InputGeom &geometry )
+{
+   // The tiles are rasterized with a border, so geometry within it changes the tile too.
+   const float border = GetBorderSize () * m_cellSize ;
+   const float tcs    = m_tileSize * m_cellSize ;
+
+   const float *bmin = geometry.getMeshBoundsMin () ;
+   const float *bmax = geometry.getMeshBoundsMax () ;
+
+   const int tx0 = std::max ( static_cast <int> ( floorf ( ( bmin [ 0 ] - border - m_cfg.bmin [ 0 ] ) / tcs ) ), 0 ) ;
+   const int tx1 = std::min ( static_cast <int> ( floorf ( ( bmax [ 0 ] + border - m_cfg.bmin [ 0 ] ) / tcs ) ), m_tw - 1 ) ;
+   const int ty0 = std::max ( static_cast <int> ( floorf ( ( bmin [ 2 ] - border - m_cfg.bmin [ 2 ] ) / tcs ) ), 0 ) ;
+   const int ty1 = std::min ( static_cast <int> ( floorf ( ( bmax [ 2 ] + border - m_cfg.bmin [ 2 ] ) / tcs ) ), m_th - 1 ) ;
+
+   for ( int y = ty0 ; y <= ty1 ; ++y )
+   {
+      for ( int x = tx0 ; x <= tx1 ; ++x )
+      {
+         const auto tile = std::make_pair ( x, y ) ;
+
+         if ( std::find ( StaticGeometryTiles.begin (), StaticGeometryTiles.end (), tile ) == StaticGeometryTiles.end () )
+         {
+            StaticGeometryTiles.push_back ( tile ) ;
+         }
+      }
+   }
+}
+
+void
+OgreDetourTileCache::
+RebuildStaticGeometryTiles ( const bool until_up_to_date )
+{
+   if ( StaticGeometryTiles.empty () )
+   {
+      return ;
+   }
+
+   const int    border_size = GetBorderSize () ;
+   const size_t tile_count  = until_up_to_date ? StaticGeometryTiles.size () : 1 ;
+
+   RasterizationContext &rc = TileContext ;
+
+   rcTempAllocScope temp_alloc_scope ( rc.tempAlloc ) ;
+
+   for ( size_t i = 0 ; i < tile_count ; ++i )
+   {
+      const int x = StaticGeometryTiles [ i ].first ;
+      const int y = StaticGeometryTiles [ i ].second ;
+
+      // A tile without any geometry left is removed.
+      const bool rasterized = RasterizeTile ( x, y, border_size, rc ) ;
+
+      // Erosion and the convex volumes overwrite the areas of the compact heightfield, so they are restored for each agent cache.
+      if ( rasterized && ! AgentCaches.empty () )
+      {
+         rc.walkableAreas.assign ( rc.chf->areas, rc.chf->areas + rc.chf->spanCount ) ;
+      }
+
+      ReplaceTileLayers ( x, y, border_size, rasterized ? &rc : nullptr ) ;
+
+      for ( auto *agent_cache : AgentCaches )
+      {
+         if ( rasterized )
+         {
+            memcpy ( rc.chf->areas, rc.walkableAreas.data (), rc.walkableAreas.size () ) ;
+         }
+
+         agent_cache->ReplaceTileLayers ( x, y, border_size, rasterized ? &rc : nullptr ) ;
+      }
+   }
+
+   StaticGeometryTiles.erase ( StaticGeometryTiles.begin (), StaticGeometryTiles.begin () + tile_count ) ;
+}
+
+int
+OgreDetourTileCache::
+GetBorderSize () const
+{
+   // The tiles are rasterized once for all agent caches, so the border must leave room for
+   // eroding the largest agent radius.
+   int border_size = m_cfg.borderSize ;
+
+   for ( const auto *agent_cache : AgentCaches )
+   {
+      border_size = std::max ( border_size, agent_cache->m_cfg.borderSize ) ;
+   }
+
+   return border_size ;
+}
+
 bool
 OgreDetourTileCache::
 InitTileCache ()
@@ -779,6 +1688,8 @@ InitTileCache ()
         return false;
     }
 
+    IslandProfiles.clear () ; // Labels refer to the navmesh that is freed here
+    FilterMaskProfiles.clear () ;
     dtFreeNavMesh(m_navMesh);
 
     m_navMesh = dtAllocNavMesh();
@@ -805,6 +1716,9 @@ InitTileCache ()
         return false;
     }
 
+    if (!InitCostOverlay())
+        return false;
+
     // Init recast navmeshquery with created navmesh (in OgreRecast component)
     status = NavQuery.init(m_navMesh, 2048);
     if (dtStatusFailed(status))
@@ -35,13 +35,22 @@
 #include "OgreRecast.h"
 #include "InputGeom.h"
 #include "DetourTileCacheBuilder.h"
+#include "DetourCommon.h"
 #include "PlayerFlagQueryFilter.h"
 #include "OgreRecastConfigParams.h"
 #include "NavMeshDebug.h"
+#include "OgreDetourCrowd.h"
+
+// Std
+#include <algorithm>
+
+// The number of rays a worker takes at once in Raycast.
+static const int RAYCAST_CHUNK_SIZE = 64 ;
 
 OgreRecast::
 OgreRecast ( const OgreRecastConfigParams &config_params ) :
-   BuildContext ( false )
+   BuildContext       ( false ),
+   PrecomputedFilters ( false )
 {
    // Set default size of box around points to look for nav polygons
    PolySearchBox [ 0 ] = 32.0f ;
@@ -66,7 +75,44 @@ OgreRecast::
 Update ( const float delta_time,
          const bool  until_up_to_date )
 {
+   TileCache->SetTrackChanges ( ! ChangeListeners.empty () ) ;
    TileCache->HandleUpdate ( delta_time, until_up_to_date ) ;
+
+   for ( auto &profile : AgentProfiles )
+   {
+      if ( profile->TileCache )
+      {
+         profile->TileCache->HandleUpdate ( delta_time, until_up_to_date ) ;
+      }
+   }
+
+   const NavMeshChanges &changes = TileCache->GetChanges () ;
+
+   if ( ! changes.Empty () )
+   {
+      for ( auto *listener : ChangeListeners )
+      {
+         listener->NavMeshChanged ( changes ) ;
+      }
+   }
+}
+
+void
+OgreRecast::
+AddNavMeshChangeListener ( NavMeshChangeListener *listener )
+{
+   if ( listener &&
+        ( std::find ( ChangeListeners.begin (), ChangeListeners.end (), listener ) == ChangeListeners.end () ) )
+   {
+      ChangeListeners.push_back ( listener ) ;
+   }
+}
+
+void
+OgreRecast::
+RemoveNavMeshChangeListener ( NavMeshChangeListener *listener )
+{
+   ChangeListeners.erase ( std::remove ( ChangeListeners.begin (), ChangeListeners.end (), listener ), ChangeListeners.end () ) ;
 }
 
 bool
@@ -74,11 +120,36 @@ OgreRecast::
 Generate ( const unsigned int         max_num_obstacles,
            const int                  tile_size,
            std::vector<Ogre::Entity*> source_meshes,
-           const TerrainAreaVector    &area_list )
+           const TerrainAreaVector    &area_list,
+           Ogre::TerrainGroup         *terrain )
+{
+   return Generate ( max_num_obstacles, tile_size, std::make_unique <InputGeom> ( std::move ( source_meshes ), terrain ), area_list ) ;
+}
+
+bool
+OgreRecast::
+Generate ( const unsigned int          max_num_obstacles,
+           const int                   tile_size,
+           std::unique_ptr <InputGeom> geometry,
+           const TerrainAreaVector     &area_list )
 {
    TileCache = std::make_unique <OgreDetourTileCache> ( *this, BuildContext, RecastConfig, NavQuery, max_num_obstacles, tile_size ) ;
 
-   return TileCache->TileCacheBuild ( std::move ( source_meshes ), area_list ) ;
+   std::vector <OgreDetourTileCache*> agent_caches ;
+
+   for ( auto &profile : AgentProfiles )
+   {
+      profile->TileCache = std::make_unique <OgreDetourTileCache> ( *this, BuildContext, profile->RecastConfig, profile->NavQuery, max_num_obstacles, tile_size ) ;
+      profile->Obstacles.clear () ;
+
+      agent_caches.push_back ( profile->TileCache.get () ) ;
+   }
+
+   const bool result = TileCache->TileCacheBuild ( std::move ( geometry ), area_list, agent_caches ) ;
+
+   QueryFilter.SetCostOverlay ( TileCache->GetCostOverlay () ) ;
+
+   return result ;
 }
 
 bool
@@ -90,7 +161,22 @@ Load ( const Ogre::String         &filename,
 {
    TileCache = std::make_unique <OgreDetourTileCache> ( *this, BuildContext, RecastConfig, NavQuery, max_num_obstacles, tile_size ) ;
 
-   return TileCache->LoadAll ( filename, std::move ( source_meshes ) ) ;
+   if ( ! AgentProfiles.empty () )
+   {
+      Ogre::LogManager::getSingleton ().logMessage ( "Warning: OgreRecast::Load(" + filename + "). Agent profiles are not stored in navmesh files, only the main navmesh is loaded." ) ;
+
+      for ( auto &profile : AgentProfiles )
+      {
+         profile->TileCache.reset () ;
+         profile->Obstacles.clear () ;
+      }
+   }
+
+   const bool result = TileCache->LoadAll ( filename, std::move ( source_meshes ) ) ;
+
+   QueryFilter.SetCostOverlay ( TileCache->GetCostOverlay () ) ;
+
+   return result ;
 }
 
 bool
@@ -107,20 +193,62 @@ Save ( const Ogre::String &filename )
    return false ;
 }
 
+int
+OgreRecast::
+AddAgentProfile ( const float agent_radius )
+{
+   auto profile = std::make_unique <AgentProfile> () ;
+
+   // Only the erosion differs between the navmeshes.
+   profile->RecastConfig                = RecastConfig ;
+   profile->RecastConfig.walkableRadius = static_cast <int> ( ceilf ( agent_radius / RecastConfig.cs ) ) ;
+
+   AgentProfiles.push_back ( std::move ( profile ) ) ;
+
+   return static_cast <int> ( AgentProfiles.size () ) ;
+}
+
 std::unique_ptr <NavMeshDebug>
 OgreRecast::
-CreateNavMeshDebugger ()
+CreateNavMeshDebugger ( const int agent_profile )
 {
-   assert ( TileCache ) ;
+   OgreDetourTileCache *tile_cache = GetProfileTileCache ( agent_profile ) ;
 
-   if ( TileCache )
+   assert ( tile_cache ) ;
+
+   if ( tile_cache )
    {
-      return std::move ( std::unique_ptr <NavMeshDebug> ( TileCache->CreateDebugger () ) ) ;
+      return std::move ( std::unique_ptr <NavMeshDebug> ( tile_cache->CreateDebugger () ) ) ;
    }
 
    return std::unique_ptr <NavMeshDebug> () ;
 }
 
+std::unique_ptr <OgreDetourCrowd>
+OgreRecast::
+CreateCrowd ( const int          max_agents,
+              const float        max_agent_radius,
+              const unsigned int worker_count,
+              const int          agent_profile )
+{
+   OgreDetourTileCache *tile_cache = GetProfileTileCache ( agent_profile ) ;
+
+   assert ( tile_cache ) ;
+
+   if ( tile_cache )
+   {
+      const unsigned int workers = worker_count ? worker_count : std::max ( std::thread::hardware_concurrency (), 1U ) ;
+
+      // Cost shapes are painted on the polys of one navmesh only.
+      PlayerFlagQueryFilter filter = QueryFilter ;
+      filter.SetCostOverlay ( tile_cache->GetCostOverlay () ) ;
+
+      return std::unique_ptr <OgreDetourCrowd> ( tile_cache->CreateCrowd ( filter, PolySearchBox, max_agents, max_agent_radius, workers ) ) ;
+   }
+
+   return std::unique_ptr <OgreDetourCrowd> () ;
+}
+
 dtObstacleRef
 OgreRecast::
 AddObstacle ( const Ogre::Vector3  &min,
@@ -128,7 +256,22 @@ AddObstacle ( const Ogre::Vector3  &min,
               const unsigned char  area_id,
               const unsigned short flags )
 {
-   return TileCache->AddObstacle ( min, max, area_id, flags ) ;
+   const dtObstacleRef ref = TileCache->AddObstacle ( min, max, area_id, flags ) ;
+
+   if ( ref )
+   {
+      for ( auto &profile : AgentProfiles )
+      {
+         const dtObstacleRef profile_ref = profile->TileCache ? profile->TileCache->AddObstacle ( min, max, area_id, flags ) : 0 ;
+
+         if ( profile_ref )
+         {
+            profile->Obstacles [ ref ] = profile_ref ;
+         }
+      }
+   }
+
+   return ref ;
 }
 
 dtObstacleRef
@@ -141,7 +284,22 @@ AddObstacle ( const Ogre::Vector3  &centre,
               const unsigned char  area_id,
               const unsigned short flags )
 {
-   return TileCache->AddObstacle ( centre, width, depth, height, y_rotation, area_id, flags ) ;
+   const dtObstacleRef ref = TileCache->AddObstacle ( centre, width, depth, height, y_rotation, area_id, flags ) ;
+
+   if ( ref )
+   {
+      for ( auto &profile : AgentProfiles )
+      {
+         const dtObstacleRef profile_ref = profile->TileCache ? profile->TileCache->AddObstacle ( centre, width, depth, height, y_rotation, area_id, flags ) : 0 ;
+
+         if ( profile_ref )
+         {
+            profile->Obstacles [ ref ] = profile_ref ;
+         }
+      }
+   }
+
+   return ref ;
 }
 
 const dtTileCacheObstacle *
@@ -155,7 +313,45 @@ bool
 OgreRecast::
 RemoveObstacle ( dtObstacleRef ref )
 {
-   return TileCache->RemoveObstacle ( ref ) ;
+   if ( ! TileCache->RemoveObstacle ( ref ) )
+   {
+      return false ;
+   }
+
+   for ( auto &profile : AgentProfiles )
+   {
+      const auto obstacle = profile->Obstacles.find ( ref ) ;
+
+      if ( obstacle != profile->Obstacles.end () )
+      {
+         profile->TileCache->RemoveObstacle ( obstacle->second ) ;
+         profile->Obstacles.erase ( obstacle ) ;
+      }
+   }
+
+   return true ;
+}
+
+int
+OgreRecast::
+AddStaticGeometry ( std::vector<Ogre::Entity*> entities )
+{
+   return AddStaticGeometry ( std::make_unique <InputGeom> ( std::move ( entities ) ) ) ;
+}
+
+int
+OgreRecast::
+AddStaticGeometry ( std::unique_ptr <InputGeom> geometry )
+{
+   // The agent profiles get the rebuilt tiles from the main tilecache.
+   return TileCache->AddStaticGeometry ( std::move ( geometry ) ) ;
+}
+
+bool
+OgreRecast::
+RemoveStaticGeometry ( const int id )
+{
+   return TileCache->RemoveStaticGeometry ( id ) ;
 }
 
 int
@@ -172,6 +368,60 @@ DeleteConvexVolume ( int volume_index )
    return TileCache->DeleteConvexVolume ( volume_index ) ;
 }
 
+dtCostShapeRef
+OgreRecast::
+AddCostCircle ( const Ogre::Vector3 &base,
+                const float         radius,
+                const float         height,
+                const float         cost_multiplier )
+{
+   return TileCache->AddCostCircle ( base, radius, height, cost_multiplier ) ;
+}
+
+dtCostShapeRef
+OgreRecast::
+AddCostVolume ( const ConvexVolume &volume,
+                const float        cost_multiplier )
+{
+   return TileCache->AddCostVolume ( volume, cost_multiplier ) ;
+}
+
+bool
+OgreRecast::
+SetCostMultiplier ( const dtCostShapeRef ref,
+                    const float          cost_multiplier )
+{
+   return TileCache->SetCostMultiplier ( ref, cost_multiplier ) ;
+}
+
+bool
+OgreRecast::
+RemoveCostShape ( const dtCostShapeRef ref )
+{
+   return TileCache->RemoveCostShape ( ref ) ;
+}
+
+bool
+OgreRecast::
+BuildLandmarks ( const unsigned int include_flags,
+                 const unsigned int exclude_flags,
+                 const int          landmark_count )
+{
+   assert ( TileCache ) ;
+
+   if ( TileCache )
+   {
+      PlayerFlagQueryFilter filter = QueryFilter ;
+      filter.setIncludeFlags ( include_flags ) ;
+      filter.setExcludeFlags ( exclude_flags ) ;
+      filter.SetCostOverlay ( nullptr ) ; // Landmarks must not follow the overlay, it only raises costs
+
+      return TileCache->BuildLandmarks ( filter, landmark_count ) ;
+   }
+
+   return false ;
+}
+
 FindPathReturnCode
 OgreRecast::
 FindPath ( float                      *start_pos,
@@ -179,22 +429,38 @@ FindPath ( float                      *start_pos,
            const unsigned int         include_flags,
            const unsigned int         exclude_flags,
            std::vector<Ogre::Vector3> &path )
+{
+   const FindPathReturnCode result = FindPath ( start_pos, end_pos, include_flags, exclude_flags, ScratchPath ) ;
+
+   if ( result == FindPathReturnCode::PATH_FOUND )
+   {
+      path.insert ( path.end (), ScratchPath.GetPath ().begin (), ScratchPath.GetPath ().end () ) ;
+   }
+
+   return result ;
+}
+
+FindPathReturnCode
+OgreRecast::
+FindPath ( float              *start_pos,
+           float              *end_pos,
+           const unsigned int include_flags,
+           const unsigned int exclude_flags,
+           PathBuffer         &path )
 {
    dtStatus  status ;
    dtPolyRef start_poly ;
    dtPolyRef end_poly ;
-   int       path_poly_count = 0 ;
-   int       vertex_count    = 0 ;
    float     start_nearest_point [ 3 ] ;
    float     end_nearest_point   [ 3 ] ;
-   dtPolyRef poly_path     [ MAX_PATHPOLY ] ;
-   float     straight_path [ MAX_PATHVERT * 3 ] ;
+
+   path.Clear () ;
 
    QueryFilter.setIncludeFlags ( include_flags ) ;
    QueryFilter.setExcludeFlags ( exclude_flags ) ;
 
    // Find the start polygon
-   status = NavQuery.findNearestPoly ( start_pos, PolySearchBox, &QueryFilter, &start_poly, start_nearest_point ) ;
+   status = FindNearestPoly ( start_pos, start_poly, start_nearest_point ) ;
 
    if ( ( status & DT_FAILURE ) ||
         ( status & DT_STATUS_DETAIL_MASK ) )
@@ -203,7 +469,7 @@ FindPath ( float                      *start_pos,
    }
 
    // Find the end polygon
-   status = NavQuery.findNearestPoly ( end_pos, PolySearchBox, &QueryFilter, &end_poly, end_nearest_point ) ;
+   status = FindNearestPoly ( end_pos, end_poly, end_nearest_point ) ;
 
    if ( ( status & DT_FAILURE ) ||
         ( status & DT_STATUS_DETAIL_MASK ) )
@@ -211,14 +477,24 @@ FindPath ( float                      *start_pos,
       return FindPathReturnCode::CANNOT_FIND_END ; // couldn't find a polygon
    }
 
-   status = NavQuery.findPath ( start_poly, end_poly, start_nearest_point, end_nearest_point, &QueryFilter, poly_path, &path_poly_count, MAX_PATHPOLY ) ;
+   // Reject ends on islands the start can't reach before searching, as a search for them only
+   // ends once the whole node pool has been used up.
+   const dtNavMeshIslands *islands = TileCache->GetIslands ( QueryFilter ) ;
+
+   if ( islands &&
+        ! islands->isReachable ( start_poly, end_poly ) )
+   {
+      return FindPathReturnCode::CANNOT_FIND_PATH ; // couldn't find a path
+   }
+
+   status = FindPolyPath ( start_poly, end_poly, start_nearest_point, end_nearest_point, path ) ;
 
    if ( ( status & DT_PARTIAL_RESULT ) &&
-        ( path_poly_count > 0 ) )
+        ( path.PolyCount > 0 ) )
    {
-      auto new_start = poly_path [ path_poly_count -1 ] ;
+      auto new_start = path.PolyPath [ path.PolyCount -1 ] ;
 
-      status = NavQuery.findPath ( new_start, end_poly, start_nearest_point, end_nearest_point, &QueryFilter, poly_path, &path_poly_count, MAX_PATHPOLY ) ;
+      status = FindPolyPath ( new_start, end_poly, start_nearest_point, end_nearest_point, path ) ;
    }
 
    if ( ( status & DT_FAILURE ) ||
@@ -227,39 +503,327 @@ FindPath ( float                      *start_pos,
       return FindPathReturnCode::CANNOT_CREATE_PATH ; // couldn't create a path
    }
 
-   if ( path_poly_count == 0 )
+   if ( path.PolyCount == 0 )
    {
       return FindPathReturnCode::CANNOT_FIND_PATH ; // couldn't find a path
    }
 
-   status = NavQuery.findStraightPath ( start_nearest_point, end_nearest_point, poly_path, path_poly_count, straight_path, nullptr, nullptr, &vertex_count, MAX_PATHVERT, DT_STRAIGHTPATH_AREA_CROSSINGS ) ;
+   return StraightenPath ( start_nearest_point, end_nearest_point, path ) ;
+}
+
+bool
+OgreRecast::
+BuildFlowField ( const Ogre::Vector3 &goal_pos,
+                 const unsigned int  include_flags,
+                 const unsigned int  exclude_flags,
+                 FlowField           &field,
+                 const float         max_cost )
+{
+   field.Filter = QueryFilter ;
+   field.Filter.setIncludeFlags ( include_flags ) ;
+   field.Filter.setExcludeFlags ( exclude_flags ) ;
+   field.Goal    = goal_pos ;
+   field.MaxCost = max_cost ;
+   field.HasGoal = true ;
+
+   return BuildFlowField ( field ) ;
+}
+
+FindPathReturnCode
+OgreRecast::
+FindPath ( const Ogre::Vector3 &start_pos,
+           FlowField           &field,
+           PathBuffer          &path )
+{
+   path.Clear () ;
+
+   if ( ! field.HasGoal )
+   {
+      return FindPathReturnCode::CANNOT_FIND_END ;
+   }
+
+   if ( ! field.IsUpToDate () &&
+        ! BuildFlowField ( field ) )
+   {
+      return FindPathReturnCode::CANNOT_FIND_END ; // the goal is no longer on the navmesh
+   }
+
+   float     start [ 3 ] ;
+   float     start_nearest_point [ 3 ] ;
+   dtPolyRef start_poly ;
+
+   OgreVect3ToFloatA ( start_pos, start ) ;
+
+   dtStatus status = NavQuery.findNearestPoly ( start, PolySearchBox, &field.Filter, &start_poly, start_nearest_point ) ;
 
    if ( ( status & DT_FAILURE ) ||
         ( status & DT_STATUS_DETAIL_MASK ) )
    {
-      return FindPathReturnCode::CANNOT_CREATE_STRAIGHT_PATH ; // couldn't create a path
+      return FindPathReturnCode::CANNOT_FIND_START ; // couldn't find a polygon
    }
 
-   if ( vertex_count == 0 )
+   for ( ;; )
    {
-      return FindPathReturnCode::CANNOT_FIND_STRAIGHT_PATH ; // couldn't find a path
+      status = field.Field.getPath ( start_poly, path.PolyPath.data (), &path.PolyCount, static_cast <int> ( path.PolyPath.size () ) ) ;
+
+      if ( ! dtStatusDetail ( status, DT_BUFFER_TOO_SMALL ) )
+      {
+         break ;
+      }
+
+      path.PolyPath.resize ( path.PolyPath.size () * 2U ) ;
+   }
+
+   if ( dtStatusFailed ( status ) ||
+        ( path.PolyCount == 0 ) )
+   {
+      path.PolyCount = 0 ;
+
+      return FindPathReturnCode::CANNOT_FIND_PATH ; // the goal can't be reached from the start
+   }
+
+   return StraightenPath ( start_nearest_point, field.Field.getGoalPos (), path ) ;
+}
+
+FindPathReturnCode
+OgreRecast::
+FindPath ( const Ogre::Vector3 &start_pos,
+           const Ogre::Vector3 &end_pos,
+           const unsigned int  include_flags,
+           const unsigned int  exclude_flags,
+           PathCorridor        &corridor )
+{
+   dtStatus  status ;
+   dtPolyRef start_poly ;
+   dtPolyRef end_poly ;
+   float     start [ 3 ] ;
+   float     end   [ 3 ] ;
+   float     start_nearest_point [ 3 ] ;
+   float     end_nearest_point   [ 3 ] ;
+
+   corridor.Clear () ;
+
+   OgreVect3ToFloatA ( start_pos, start ) ;
+   OgreVect3ToFloatA ( end_pos,   end ) ;
+
+   QueryFilter.setIncludeFlags ( include_flags ) ;
+   QueryFilter.setExcludeFlags ( exclude_flags ) ;
+
+   status = FindNearestPoly ( start, start_poly, start_nearest_point ) ;
+
+   if ( ( status & DT_FAILURE ) ||
+        ( status & DT_STATUS_DETAIL_MASK ) ||
+        ( start_poly == 0 ) )
+   {
+      return FindPathReturnCode::CANNOT_FIND_START ; // couldn't find a polygon
+   }
+
+   status = FindNearestPoly ( end, end_poly, end_nearest_point ) ;
+
+   if ( ( status & DT_FAILURE ) ||
+        ( status & DT_STATUS_DETAIL_MASK ) ||
+        ( end_poly == 0 ) )
+   {
+      return FindPathReturnCode::CANNOT_FIND_END ; // couldn't find a polygon
+   }
+
+   const dtNavMeshIslands *islands = TileCache->GetIslands ( QueryFilter ) ;
+
+   if ( islands &&
+        ! islands->isReachable ( start_poly, end_poly ) )
+   {
+      return FindPathReturnCode::CANNOT_FIND_PATH ; // couldn't find a path
+   }
+
+   status = FindPolyPath ( start_poly, end_poly, start_nearest_point, end_nearest_point, ScratchPath ) ;
+
+   if ( dtStatusFailed ( status ) )
+   {
+      return FindPathReturnCode::CANNOT_CREATE_PATH ; // couldn't create a path
+   }
+
+   if ( ScratchPath.PolyCount == 0 )
+   {
+      return FindPathReturnCode::CANNOT_FIND_PATH ; // couldn't find a path
+   }
+
+   // A path that ran out of search nodes or does not fit the corridor is cut short. The corridor
+   // then ends short of the target and UpdateCorridor continues the search from its end.
+   const int count = std::min ( ScratchPath.PolyCount, corridor.Corridor.getMaxPath () ) ;
+   float     corridor_end [ 3 ] ;
+
+   if ( ScratchPath.PolyPath [ count -1 ] == end_poly )
+   {
+      dtVcopy ( corridor_end, end_nearest_point ) ;
    }
    else
    {
-      // At this point we have our path
-      std::size_t path_poly_index = 0U ;
+      NavQuery.closestPointOnPolyBoundary ( ScratchPath.PolyPath [ count -1 ], end_nearest_point, corridor_end ) ;
+   }
+
+   corridor.Filter     = QueryFilter ;
+   corridor.TargetPoly = end_poly ;
+   dtVcopy ( corridor.TargetPoint, end_nearest_point ) ;
+
+   corridor.Corridor.reset ( start_poly, start_nearest_point ) ;
+   corridor.Corridor.setCorridor ( corridor_end, ScratchPath.PolyPath.data (), count ) ;
+
+   UpdateCorners ( corridor ) ;
+
+   return FindPathReturnCode::PATH_FOUND ;
+}
+
+bool
+OgreRecast::
+MoveCorridorPosition ( const Ogre::Vector3 &position,
+                       PathCorridor        &corridor )
+{
+   if ( ! corridor.HasPath () )
+   {
+      return false ;
+   }
+
+   float pos [ 3 ] ;
+
+   OgreVect3ToFloatA ( position, pos ) ;
+
+   if ( ! corridor.Corridor.movePosition ( pos, &NavQuery, &corridor.Filter ) )
+   {
+      return false ;
+   }
+
+   UpdateCorners ( corridor ) ;
+
+   // Cut the corridor short where the furthest corner can be walked to directly.
+   if ( ! corridor.Corners.empty () )
+   {
+      const int   path_count = corridor.Corridor.getPathCount () ;
+      const float range      = std::max ( RecastConfig.walkableRadius, 1 ) * RecastConfig.cs * 30.0f ; // 30 unit radii
+
+      corridor.Corridor.optimizePathVisibility ( &corridor.CornerVerts [ ( corridor.Corners.size () -1 ) * 3 ],
+                                                 range, &NavQuery, &corridor.Filter ) ;
 
-      for ( auto vertex_index = 0 ; vertex_index < vertex_count ; ++vertex_index )
+      if ( corridor.Corridor.getPathCount () != path_count )
       {
-         path.push_back ( Ogre::Vector3 ( straight_path [ path_poly_index + 0 ],
-                                          straight_path [ path_poly_index + 1 ],
-                                          straight_path [ path_poly_index + 2 ] ) ) ;
+         UpdateCorners ( corridor ) ;
+      }
+   }
+
+   return true ;
+}
+
+bool
+OgreRecast::
+MoveCorridorTarget ( const Ogre::Vector3 &target,
+                     PathCorridor        &corridor,
+                     const int           max_iterations )
+{
+   if ( ! corridor.HasPath () )
+   {
+      return false ;
+   }
+
+   float     pos [ 3 ] ;
+   float     nearest_point [ 3 ] ;
+   dtPolyRef poly ;
+
+   OgreVect3ToFloatA ( target, pos ) ;
+
+   const dtStatus status = NavQuery.findNearestPoly ( pos, PolySearchBox, &corridor.Filter, &poly, nearest_point ) ;
+
+   if ( dtStatusFailed ( status ) ||
+        ( poly == 0 ) )
+   {
+      return false ;
+   }
+
+   corridor.TargetPoly = poly ;
+   dtVcopy ( corridor.TargetPoint, nearest_point ) ;
 
-         path_poly_index += 3 ;
+   // Small moves only change the last polys of the corridor. When the target moved beyond them,
+   // the old end of the corridor is usually still close, so the search starts from there.
+   if ( ! corridor.Corridor.moveTargetPosition ( nearest_point, &NavQuery, &corridor.Filter ) ||
+        ( corridor.Corridor.getLastPoly () != poly ) )
+   {
+      corridor.Corridor.replanPathEnd ( poly, nearest_point, max_iterations, &NavQuery, &corridor.Filter ) ;
+   }
+
+   UpdateCorners ( corridor ) ;
+
+   return true ;
+}
+
+bool
+OgreRecast::
+UpdateCorridor ( PathCorridor &corridor,
+                 const int    max_iterations )
+{
+   if ( ! corridor.HasPath () )
+   {
+      return false ;
+   }
+
+   dtPolyRef poly = corridor.Corridor.getFirstPoly () ;
+   float     nearest_point [ 3 ] ;
+   dtStatus  status ;
+
+   // Tiles rebuilt by the tilecache and closed gates remove polys from under the corridor. Only the
+   // part of the corridor from the first removed poly onwards is planned again.
+   if ( ! NavQuery.isValidPolyRef ( poly, &corridor.Filter ) )
+   {
+      status = NavQuery.findNearestPoly ( corridor.Corridor.getPos (), PolySearchBox, &corridor.Filter, &poly, nearest_point ) ;
+
+      if ( dtStatusFailed ( status ) ||
+           ( poly == 0 ) )
+      {
+         return false ; // the unit is no longer on the navmesh
       }
+   }
+   else
+   {
+      dtVcopy ( nearest_point, corridor.Corridor.getPos () ) ;
+   }
 
-      return FindPathReturnCode::PATH_FOUND ;
+   corridor.Corridor.trimInvalidPath ( poly, nearest_point, &NavQuery, &corridor.Filter ) ;
+
+   if ( ! NavQuery.isValidPolyRef ( corridor.TargetPoly, &corridor.Filter ) )
+   {
+      status = NavQuery.findNearestPoly ( corridor.TargetPoint, PolySearchBox, &corridor.Filter, &poly, nearest_point ) ;
+
+      if ( dtStatusFailed ( status ) ||
+           ( poly == 0 ) )
+      {
+         UpdateCorners ( corridor ) ;
+         return false ; // the target is no longer on the navmesh
+      }
+
+      corridor.TargetPoly = poly ;
+      dtVcopy ( corridor.TargetPoint, nearest_point ) ;
    }
+
+   if ( corridor.Corridor.getLastPoly () != corridor.TargetPoly )
+   {
+      const dtNavMeshIslands *islands = TileCache->GetIslands ( corridor.Filter ) ;
+
+      if ( islands &&
+           ! islands->isReachable ( corridor.Corridor.getLastPoly (), corridor.TargetPoly ) )
+      {
+         UpdateCorners ( corridor ) ;
+         return false ; // the target can't be reached anymore
+      }
+
+      status = corridor.Corridor.replanPathEnd ( corridor.TargetPoly, corridor.TargetPoint, max_iterations, &NavQuery, &corridor.Filter ) ;
+   }
+   else
+   {
+      // Units pushed off their corridor can leave it with a detour, look for a shorter way nearby.
+      corridor.Corridor.optimizePathTopology ( &NavQuery, &corridor.Filter ) ;
+      status = DT_SUCCESS ;
+   }
+
+   UpdateCorners ( corridor ) ;
+
+   return dtStatusSucceed ( status ) ;
 }
 
 FindPathReturnCode
@@ -279,6 +843,211 @@ FindPath ( const Ogre::Vector3        &start_pos,
    return FindPath ( start, end, include_flags, exclude_flags, path ) ;
 }
 
+FindPathReturnCode
+OgreRecast::
+FindPath ( const Ogre::Vector3 &start_pos,
+           const Ogre::Vector3 &end_pos,
+           const unsigned int  include_flags,
+           const unsigned int  exclude_flags,
+           PathBuffer          &path )
+{
+   float start [ 3 ] ;
+   float end   [ 3 ] ;
+
+   OgreVect3ToFloatA ( start_pos, start ) ;
+   OgreVect3ToFloatA ( end_pos,   end ) ;
+
+   return FindPath ( start, end, include_flags, exclude_flags, path ) ;
+}
+
+void
+OgreRecast::
+SetPrecomputedFilters ( const bool enabled )
+{
+   PrecomputedFilters = enabled ;
+}
+
+OgreDetourTileCache *
+OgreRecast::
+GetProfileTileCache ( const int agent_profile ) const
+{
+   if ( agent_profile == 0 )
+   {
+      return TileCache.get () ;
+   }
+
+   if ( ( agent_profile < 0 ) || ( agent_profile > static_cast <int> ( AgentProfiles.size () ) ) )
+   {
+      return nullptr ;
+   }
+
+   return AgentProfiles [ agent_profile - 1 ]->TileCache.get () ;
+}
+
+dtStatus
+OgreRecast::
+FindNearestPoly ( const float *position,
+                  dtPolyRef   &poly,
+                  float       *nearest_point )
+{
+   const dtPolyMaskFilter *mask_filter = PrecomputedFilters ? TileCache->GetFilterMask ( QueryFilter ) : nullptr ;
+
+   if ( mask_filter )
+   {
+      return NavQuery.findNearestPoly ( position, PolySearchBox, mask_filter, &poly, nearest_point ) ;
+   }
+
+   return NavQuery.findNearestPoly ( position, PolySearchBox, &QueryFilter, &poly, nearest_point ) ;
+}
+
+dtStatus
+OgreRecast::
+FindPolyPath ( const dtPolyRef start_poly,
+               const dtPolyRef end_poly,
+               const float     *start_point,
+               const float     *end_point,
+               PathBuffer      &path )
+{
+   const dtNavMeshLandmarks *landmarks   = TileCache->GetLandmarks ( QueryFilter.getIncludeFlags (), QueryFilter.getExcludeFlags () ) ;
+   const dtPolyMaskFilter   *mask_filter = PrecomputedFilters ? TileCache->GetFilterMask ( QueryFilter ) : nullptr ;
+
+   for ( ;; )
+   {
+      const dtStatus status = mask_filter ?
+                              NavQuery.findPath ( start_poly, end_poly, start_point, end_point, mask_filter,
+                                                  path.PolyPath.data (), &path.PolyCount, static_cast <int> ( path.PolyPath.size () ),
+                                                  landmarks ) :
+                              NavQuery.findPath ( start_poly, end_poly, start_point, end_point, &QueryFilter,
+                                                  path.PolyPath.data (), &path.PolyCount, static_cast <int> ( path.PolyPath.size () ),
+                                                  landmarks ) ;
+
+      if ( ! dtStatusDetail ( status, DT_BUFFER_TOO_SMALL ) )
+      {
+         return status ;
+      }
+
+      // The corridor did not fit, so grow the buffer and search again. The corridor can never be
+      // longer than the number of search nodes, so this ends after a few iterations at most and
+      // the grown buffer is kept for the next calls.
+      path.PolyPath.resize ( path.PolyPath.size () * 2U ) ;
+   }
+}
+
+bool
+OgreRecast::
+BuildFlowField ( FlowField &field )
+{
+   assert ( TileCache ) ;
+
+   float     goal [ 3 ] ;
+   float     goal_nearest_point [ 3 ] ;
+   dtPolyRef goal_poly ;
+
+   OgreVect3ToFloatA ( field.Goal, goal ) ;
+
+   dtStatus status = NavQuery.findNearestPoly ( goal, PolySearchBox, &field.Filter, &goal_poly, goal_nearest_point ) ;
+
+   if ( ( status & DT_FAILURE ) ||
+        ( status & DT_STATUS_DETAIL_MASK ) ||
+        ( goal_poly == 0 ) )
+   {
+      return false ;
+   }
+
+   // The navmesh is replaced by Generate and Load, so the field is attached to the current one
+   // every time. This keeps the per tile tables in step with the tile layout of the navmesh.
+   status = field.Field.init ( NavQuery.getAttachedNavMesh () ) ;
+
+   if ( dtStatusSucceed ( status ) )
+   {
+      status = field.Field.build ( goal_poly, goal_nearest_point, &field.Filter, field.MaxCost ) ;
+   }
+
+   if ( dtStatusFailed ( status ) )
+   {
+      Ogre::LogManager::getSingleton ().logMessage ( "Error: OgreRecast::BuildFlowField. Could not build the flow field." ) ;
+      return false ;
+   }
+
+   return true ;
+}
+
+FindPathReturnCode
+OgreRecast::
+StraightenPath ( const float *start_point,
+                 const float *end_point,
+                 PathBuffer  &path )
+{
+   const dtStatus status = FindStraightPath ( start_point, end_point, path ) ;
+
+   if ( ( status & DT_FAILURE ) ||
+        ( status & DT_STATUS_DETAIL_MASK ) )
+   {
+      return FindPathReturnCode::CANNOT_CREATE_STRAIGHT_PATH ; // couldn't create a path
+   }
+
+   if ( path.VertexCount == 0 )
+   {
+      return FindPathReturnCode::CANNOT_FIND_STRAIGHT_PATH ; // couldn't find a path
+   }
+   else
+   {
+      // At this point we have our path
+      path.Path.resize ( path.VertexCount ) ;
+
+      for ( auto vertex_index = 0 ; vertex_index < path.VertexCount ; ++vertex_index )
+      {
+         FloatAToOgreVect3 ( &path.StraightPath [ vertex_index * 3 ], path.Path [ vertex_index ] ) ;
+      }
+
+      return FindPathReturnCode::PATH_FOUND ;
+   }
+}
+
+dtStatus
+OgreRecast::
+FindStraightPath ( const float *start_point,
+                   const float *end_point,
+                   PathBuffer  &path )
+{
+   for ( ;; )
+   {
+      const dtStatus status = NavQuery.findStraightPath ( start_point, end_point, path.PolyPath.data (), path.PolyCount,
+                                                          path.StraightPath.data (), nullptr, nullptr, &path.VertexCount,
+                                                          static_cast <int> ( path.StraightPath.size () / 3U ), DT_STRAIGHTPATH_AREA_CROSSINGS ) ;
+
+      if ( ! dtStatusDetail ( status, DT_BUFFER_TOO_SMALL ) )
+      {
+         return status ;
+      }
+
+      path.StraightPath.resize ( path.StraightPath.size () * 2U ) ;
+      path.Path.reserve ( path.StraightPath.size () / 3U ) ;
+   }
+}
+
+void
+OgreRecast::
+UpdateCorners ( PathCorridor &corridor )
+{
+   corridor.Corners.clear () ;
+
+   if ( ! corridor.HasPath () )
+   {
+      return ;
+   }
+
+   const int count = corridor.Corridor.findCorners ( corridor.CornerVerts, corridor.CornerFlags, corridor.CornerPolys,
+                                                     PathCorridor::MAX_CORNERS, &NavQuery ) ;
+
+   for ( int i = 0 ; i < count ; ++i )
+   {
+      corridor.Corners.push_back ( Ogre::Vector3 ( corridor.CornerVerts [ i * 3 ],
+                                                   corridor.CornerVerts [ i * 3 + 1 ],
+                                                   corridor.CornerVerts [ i * 3 + 2 ] ) ) ;
+   }
+}
+
 void
 OgreRecast::
 OgreVect3ToFloatA ( const Ogre::Vector3 &vect,
@@ -326,7 +1095,7 @@ FindNearestPolyOnNavmesh ( const Ogre::Vector3 &position,
 
    OgreVect3ToFloatA ( position, point ) ;
 
-   dtStatus status = NavQuery.findNearestPoly ( point, PolySearchBox, &QueryFilter, &result_poly, found_point ) ;
+   dtStatus status = FindNearestPoly ( point, result_poly, found_point ) ;
 
    if ( ( status & DT_FAILURE ) ||
         ( status & DT_STATUS_DETAIL_MASK ) )
@@ -341,6 +1110,138 @@ FindNearestPolyOnNavmesh ( const Ogre::Vector3 &position,
    }
 }
 
+bool
+OgreRecast::
+FindNearestPolysOnNavmesh ( const std::vector <Ogre::Vector3> &positions,
+                            const unsigned int                include_flags,
+                            const unsigned int                exclude_flags,
+                            std::vector <Ogre::Vector3>       &result_points,
+                            std::vector <dtPolyRef>           &result_polys )
+{
+   QueryFilter.setIncludeFlags ( include_flags ) ;
+   QueryFilter.setExcludeFlags ( exclude_flags ) ;
+
+   const int count = static_cast <int> ( positions.size () ) ;
+
+   ScratchPoints.resize ( positions.size () * 3U ) ;
+   ScratchNearestPoints.resize ( positions.size () * 3U ) ;
+
+   for ( int i = 0 ; i < count ; ++i )
+   {
+      OgreVect3ToFloatA ( positions [ i ], &ScratchPoints [ i * 3 ] ) ;
+   }
+
+   // Points without a poly keep their own position
+   ScratchNearestPoints = ScratchPoints ;
+
+   result_polys.resize ( positions.size () ) ;
+
+   dtStatus status = NavQuery.findNearestPolys ( ScratchPoints.data (), count, PolySearchBox, &QueryFilter,
+                                                 result_polys.data (), ScratchNearestPoints.data () ) ;
+
+   if ( status & DT_FAILURE )
+   {
+      Ogre::LogManager::getSingleton ().logMessage ( "Error: OgreRecast::FindNearestPolysOnNavmesh(). Nearest poly query failed." ) ;
+
+      return false ;
+   }
+
+   result_points.resize ( positions.size () ) ;
+
+   for ( int i = 0 ; i < count ; ++i )
+   {
+      FloatAToOgreVect3 ( &ScratchNearestPoints [ i * 3 ], result_points [ i ] ) ;
+   }
+
+   return true ;
+}
+
+bool
+OgreRecast::
+Raycast ( RaycastBatch       &batch,
+          const unsigned int include_flags,
+          const unsigned int exclude_flags )
+{
+   assert ( TileCache ) ;
+
+   QueryFilter.setIncludeFlags ( include_flags ) ;
+   QueryFilter.setExcludeFlags ( exclude_flags ) ;
+
+   const int origin_count = static_cast <int> ( batch.Origins.size () / 3U ) ;
+   const int ray_count    = batch.GetRayCount () ;
+
+   // Points without a poly keep their own position
+   batch.OriginPoints = batch.Origins ;
+   batch.OriginPolys.resize ( origin_count ) ;
+
+   dtStatus status = NavQuery.findNearestPolys ( batch.Origins.data (), origin_count, PolySearchBox, &QueryFilter,
+                                                 batch.OriginPolys.data (), batch.OriginPoints.data () ) ;
+
+   if ( status & DT_FAILURE )
+   {
+      Ogre::LogManager::getSingleton ().logMessage ( "Error: OgreRecast::Raycast(). Nearest poly query failed." ) ;
+
+      return false ;
+   }
+
+   batch.HitT.resize ( ray_count ) ;
+   batch.HitNormals.resize ( ray_count ) ;
+   batch.Paths.resize ( ray_count * batch.MaxPathPolys ) ;
+   batch.PathCounts.resize ( ray_count ) ;
+
+   // Computed before the workers start, they only read the navmesh and the filters.
+   const dtPolyMaskFilter *mask_filter = PrecomputedFilters ? TileCache->GetFilterMask ( QueryFilter ) : nullptr ;
+
+   if ( ! QueryWorkers )
+   {
+      QueryWorkers = std::make_unique <WorkerPool> ( std::max ( std::thread::hardware_concurrency (), 1U ) ) ;
+   }
+
+   QueryWorkers->Run ( ray_count, RAYCAST_CHUNK_SIZE, [ this, &batch, mask_filter ] ( const int, const int begin, const int end )
+   {
+      for ( int ray = begin ; ray < end ; ++ray )
+      {
+         const int       origin     = batch.RayOrigins [ ray ] ;
+         const dtPolyRef start_poly = batch.OriginPolys [ origin ] ;
+
+         batch.HitNormals [ ray ] = Ogre::Vector3::ZERO ;
+         batch.PathCounts [ ray ] = 0 ;
+
+         if ( ! start_poly )
+         {
+            batch.HitT [ ray ] = -1.0f ;
+            continue ;
+         }
+
+         dtRaycastHit hit ;
+         hit.path    = batch.MaxPathPolys ? &batch.Paths [ ray * batch.MaxPathPolys ] : nullptr ;
+         hit.maxPath = batch.MaxPathPolys ;
+
+         const float    *start = &batch.OriginPoints [ origin * 3 ] ;
+         const float    *end   = &batch.Ends [ ray * 3 ] ;
+         const dtStatus  ray_status = mask_filter ?
+                                      NavQuery.raycast ( start_poly, start, end, mask_filter, 0, &hit ) :
+                                      NavQuery.raycast ( start_poly, start, end, &QueryFilter, 0, &hit ) ;
+
+         if ( dtStatusFailed ( ray_status ) )
+         {
+            batch.HitT [ ray ] = -1.0f ;
+            continue ;
+         }
+
+         batch.HitT [ ray ]       = hit.t ;
+         batch.PathCounts [ ray ] = hit.pathCount ;
+
+         if ( hit.t != FLT_MAX )
+         {
+            FloatAToOgreVect3 ( hit.hitNormal, batch.HitNormals [ ray ] ) ;
+         }
+      }
+   } ) ;
+
+   return true ;
+}
+
 void
 OgreRecast::
 ConfigureBuildParameters ( const OgreRecastConfigParams &config_params )
@@ -0,0 +1,46 @@
+#include "PathBuffer.h"
+
+// Std
+#include <algorithm>
+
+PathBuffer::
+PathBuffer ( const std::size_t poly_capacity,
+             const std::size_t vertex_capacity ) :
+   PolyPath     ( std::max <std::size_t> ( poly_capacity, 1U ) ),
+   PolyCount    ( 0 ),
+   StraightPath ( std::max <std::size_t> ( vertex_capacity, 2U ) * 3U ),
+   VertexCount  ( 0 )
+{
+   Path.reserve ( StraightPath.size () / 3U ) ;
+}
+
+const std::vector <Ogre::Vector3> &
+PathBuffer::
+GetPath () const
+{
+   return Path ;
+}
+
+const dtPolyRef *
+PathBuffer::
+GetPolys () const
+{
+   return PolyPath.data () ;
+}
+
+int
+PathBuffer::
+GetPolyCount () const
+{
+   return PolyCount ;
+}
+
+void
+PathBuffer::
+Clear ()
+{
+   PolyCount   = 0 ;
+   VertexCount = 0 ;
+
+   Path.clear () ; // Keeps the capacity
+}
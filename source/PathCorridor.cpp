@@ -0,0 +1,69 @@
+#include "PathCorridor.h"
+
+// Std
+#include <algorithm>
+#include <cstring>
+
+PathCorridor::
+PathCorridor ( const int max_polys ) :
+   TargetPoly ( 0 )
+{
+   Corridor.init ( std::max ( max_polys, 1 ) ) ;
+   Corners.reserve ( MAX_CORNERS ) ;
+
+   Clear () ;
+}
+
+Ogre::Vector3
+PathCorridor::
+GetPosition () const
+{
+   const float *pos = Corridor.getPos () ;
+
+   return Ogre::Vector3 ( pos [ 0 ], pos [ 1 ], pos [ 2 ] ) ;
+}
+
+Ogre::Vector3
+PathCorridor::
+GetTarget () const
+{
+   const float *target = Corridor.getTarget () ;
+
+   return Ogre::Vector3 ( target [ 0 ], target [ 1 ], target [ 2 ] ) ;
+}
+
+const std::vector <Ogre::Vector3> &
+PathCorridor::
+GetCorners () const
+{
+   return Corners ;
+}
+
+bool
+PathCorridor::
+HasPath () const
+{
+   return Corridor.getFirstPoly () != 0 ;
+}
+
+bool
+PathCorridor::
+ReachesTarget () const
+{
+   return HasPath () &&
+          ( Corridor.getLastPoly () == TargetPoly ) ;
+}
+
+void
+PathCorridor::
+Clear ()
+{
+   const float zero [ 3 ] = { 0.0f, 0.0f, 0.0f } ;
+
+   // A corridor of the single poly 0 holds no path.
+   Corridor.reset ( 0, zero ) ;
+   TargetPoly = 0 ;
+   memset ( TargetPoint, 0, sizeof ( TargetPoint ) ) ;
+
+   Corners.clear () ; // Keeps the capacity
+}
@@ -28,3 +28,41 @@ passFilter ( const dtPolyRef  ref,
                ( ( movement_flags & getExcludeFlags () ) == 0 ) ) ; // All of the flags do not match
    }
 }
+
+float
+PlayerFlagQueryFilter::
+getCost ( const float      *pa,
+          const float      *pb,
+          const dtPolyRef  prevRef,
+          const dtMeshTile *prevTile,
+          const dtPoly     *prevPoly,
+          const dtPolyRef  curRef,
+          const dtMeshTile *curTile,
+          const dtPoly     *curPoly,
+          const dtPolyRef  nextRef,
+          const dtMeshTile *nextTile,
+          const dtPoly     *nextPoly ) const
+{
+   const float cost = dtQueryFilter::getCost ( pa, pb, prevRef, prevTile, prevPoly, curRef, curTile, curPoly, nextRef, nextTile, nextPoly ) ;
+
+   if ( CostOverlay )
+   {
+      return cost * CostOverlay->getCost ( curTile, curPoly ) ;
+   }
+
+   return cost ;
+}
+
+void
+PlayerFlagQueryFilter::
+SetCostOverlay ( const dtCostOverlay *overlay )
+{
+   CostOverlay = overlay ;
+}
+
+const dtCostOverlay *
+PlayerFlagQueryFilter::
+GetCostOverlay () const
+{
+   return CostOverlay ;
+}
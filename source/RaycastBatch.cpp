@@ -0,0 +1,80 @@
+#include "RaycastBatch.h"
+
+// Std
+#include <algorithm>
+
+RaycastBatch::
+RaycastBatch ( const int max_path_polys ) :
+   MaxPathPolys ( std::max ( max_path_polys, 0 ) )
+{
+}
+
+void
+RaycastBatch::
+Clear ()
+{
+   Origins.clear () ;
+   Ends.clear () ;
+   RayOrigins.clear () ;
+}
+
+int
+RaycastBatch::
+AddRay ( const Ogre::Vector3 &start,
+         const Ogre::Vector3 &end )
+{
+   const std::size_t origin_count = Origins.size () / 3U ;
+
+   if ( ( origin_count == 0 ) ||
+        ( Origins [ origin_count * 3U - 3U ] != start.x ) ||
+        ( Origins [ origin_count * 3U - 2U ] != start.y ) ||
+        ( Origins [ origin_count * 3U - 1U ] != start.z ) )
+   {
+      Origins.push_back ( start.x ) ;
+      Origins.push_back ( start.y ) ;
+      Origins.push_back ( start.z ) ;
+   }
+
+   Ends.push_back ( end.x ) ;
+   Ends.push_back ( end.y ) ;
+   Ends.push_back ( end.z ) ;
+
+   RayOrigins.push_back ( static_cast <int> ( Origins.size () / 3U ) - 1 ) ;
+
+   return static_cast <int> ( RayOrigins.size () ) - 1 ;
+}
+
+int
+RaycastBatch::
+GetRayCount () const
+{
+   return static_cast <int> ( RayOrigins.size () ) ;
+}
+
+const float *
+RaycastBatch::
+GetHitT () const
+{
+   return HitT.data () ;
+}
+
+const Ogre::Vector3 *
+RaycastBatch::
+GetHitNormals () const
+{
+   return HitNormals.data () ;
+}
+
+const dtPolyRef *
+RaycastBatch::
+GetPath ( const int ray ) const
+{
+   return MaxPathPolys ? &Paths [ ray * MaxPathPolys ] : nullptr ;
+}
+
+int
+RaycastBatch::
+GetPathCount ( const int ray ) const
+{
+   return PathCounts [ ray ] ;
+}
@@ -0,0 +1,141 @@
+#include "WorkerPool.h"
+
+// Std
+#include <algorithm>
+
+WorkerPool::
+WorkerPool ( const unsigned int worker_count ) :
+   Generation ( 0 ),
+   Pending    ( 0 ),
+   Quit       ( false ),
+   CurrentJob ( nullptr ),
+   Count      ( 0 ),
+   ChunkSize  ( 1 ),
+   NextChunk  ( 0 )
+{
+   const int workers = static_cast <int> ( std::max ( worker_count, 1U ) ) ;
+
+   for ( int worker = 1 ; worker < workers ; ++worker )
+   {
+      Workers.emplace_back ( &WorkerPool::WorkerLoop, this, worker ) ;
+   }
+}
+
+WorkerPool::
+~WorkerPool ()
+{
+   {
+      std::lock_guard <std::mutex> lock ( Mutex ) ;
+      Quit = true ;
+   }
+
+   WorkReady.notify_all () ;
+
+   for ( auto &worker : Workers )
+   {
+      worker.join () ;
+   }
+}
+
+int
+WorkerPool::
+GetWorkerCount () const
+{
+   return static_cast <int> ( Workers.size () ) + 1 ;
+}
+
+void
+WorkerPool::
+Run ( const int  count,
+      const int  chunk_size,
+      const Job &job )
+{
+   if ( count <= 0 )
+   {
+      return ;
+   }
+
+   if ( Workers.empty () ||
+        ( count <= chunk_size ) )
+   {
+      job ( 0, 0, count ) ;
+      return ;
+   }
+
+   {
+      std::lock_guard <std::mutex> lock ( Mutex ) ;
+
+      CurrentJob = &job ;
+      Count      = count ;
+      ChunkSize  = std::max ( chunk_size, 1 ) ;
+      NextChunk  = 0 ;
+      Pending    = static_cast <int> ( Workers.size () ) ;
+      ++Generation ;
+   }
+
+   WorkReady.notify_all () ;
+
+   RunChunks ( 0 ) ;
+
+   // The caller reads what the other workers wrote in this run.
+   std::unique_lock <std::mutex> lock ( Mutex ) ;
+
+   WorkDone.wait ( lock, [ this ] { return Pending == 0 ; } ) ;
+
+   CurrentJob = nullptr ;
+}
+
+void
+WorkerPool::
+RunChunks ( const int worker )
+{
+   for ( ;; )
+   {
+      const int begin = NextChunk.fetch_add ( ChunkSize ) ;
+
+      if ( begin >= Count )
+      {
+         return ;
+      }
+
+      ( *CurrentJob ) ( worker, begin, std::min ( begin + ChunkSize, Count ) ) ;
+   }
+}
+
+void
+WorkerPool::
+WorkerLoop ( const int worker )
+{
+   unsigned int generation = 0 ;
+
+   for ( ;; )
+   {
+      {
+         std::unique_lock <std::mutex> lock ( Mutex ) ;
+
+         WorkReady.wait ( lock, [ this, generation ] { return Quit || ( Generation != generation ) ; } ) ;
+
+         if ( Quit )
+         {
+            return ;
+         }
+
+         generation = Generation ;
+      }
+
+      RunChunks ( worker ) ;
+
+      bool last ;
+
+      {
+         std::lock_guard <std::mutex> lock ( Mutex ) ;
+
+         last = ( --Pending == 0 ) ;
+      }
+
+      if ( last )
+      {
+         WorkDone.notify_one () ;
+      }
+   }
+}